@@ -486,17 +486,23 @@ int RingSignatureMgr::verifyRingSignature(data_chunk &keyImage,
                                           int nRingSize,
                                           const uint8_t *pPubkeys,
                                           const uint8_t *pSigc,
-                                          const uint8_t *pSigr)
+                                          const uint8_t *pSigr,
+                                          bool fProtocolV3)
 {
     int rv = 0;
 
-    BN_CTX_start(r_bnCtx);
+    // A context of its own, rather than r_bnCtx, so verifications can run in parallel
+    BN_CTX *bnCtx = BN_CTX_new();
+    if (!bnCtx)
+        return errorN(1, "%s: BN_CTX_new failed.");
 
-    BIGNUM   *bnT   = BN_CTX_get(r_bnCtx);
-    BIGNUM   *bnH   = BN_CTX_get(r_bnCtx);
-    BIGNUM   *bnC   = BN_CTX_get(r_bnCtx);
-    BIGNUM   *bnR   = BN_CTX_get(r_bnCtx);
-    BIGNUM   *bnSum = BN_CTX_get(r_bnCtx);
+    BN_CTX_start(bnCtx);
+
+    BIGNUM   *bnT   = BN_CTX_get(bnCtx);
+    BIGNUM   *bnH   = BN_CTX_get(bnCtx);
+    BIGNUM   *bnC   = BN_CTX_get(bnCtx);
+    BIGNUM   *bnR   = BN_CTX_get(bnCtx);
+    BIGNUM   *bnSum = BN_CTX_get(bnCtx);
     EC_POINT *ptT1  = nullptr;
     EC_POINT *ptT2  = nullptr;
     EC_POINT *ptT3  = nullptr;
@@ -531,7 +537,7 @@ int RingSignatureMgr::verifyRingSignature(data_chunk &keyImage,
     }
 
     // get keyimage as point
-    if (!EC_POINT_oct2point(r_ecGrp, ptKi, &keyImage[0], EC_COMPRESSED_SIZE, r_bnCtx)
+    if (!EC_POINT_oct2point(r_ecGrp, ptKi, &keyImage[0], EC_COMPRESSED_SIZE, bnCtx)
         &&(rv = errorN(1, "%s: extract ptKi failed.")))
         goto End;
 
@@ -549,72 +555,72 @@ int RingSignatureMgr::verifyRingSignature(data_chunk &keyImage,
 
         // get Pk i as point
         if (!(bnT = BN_bin2bn(&pPubkeys[i * EC_COMPRESSED_SIZE], EC_COMPRESSED_SIZE, bnT))
-            || !(ptPk) || !(ptPk = EC_POINT_bn2point(r_ecGrp, bnT, ptPk, r_bnCtx)))
+            || !(ptPk) || !(ptPk = EC_POINT_bn2point(r_ecGrp, bnT, ptPk, bnCtx)))
         {
             LogPrintf("%s: extract ptPk failed.\n");
             rv = 1; goto End;
         }
 
         // ptT1 = ci * Pi
-        if (!EC_POINT_mul(r_ecGrp, ptT1, nullptr, ptPk, bnC, r_bnCtx))
+        if (!EC_POINT_mul(r_ecGrp, ptT1, nullptr, ptPk, bnC, bnCtx))
         {
             LogPrintf("%s: EC_POINT_mul failed.\n");
             rv = 1; goto End;
         }
 
         // ptT2 = ri * G
-        if (!EC_POINT_mul(r_ecGrp, ptT2, bnR, nullptr, nullptr, r_bnCtx))
+        if (!EC_POINT_mul(r_ecGrp, ptT2, bnR, nullptr, nullptr, bnCtx))
         {
             LogPrintf("%s: EC_POINT_mul failed.\n");
             rv = 1; goto End;
         }
 
         // ptL = ptT1 + ptT2
-        if (!EC_POINT_add(r_ecGrp, ptL, ptT1, ptT2, r_bnCtx))
+        if (!EC_POINT_add(r_ecGrp, ptL, ptT1, ptT2, bnCtx))
         {
             LogPrintf("%s: EC_POINT_add failed.\n");
             rv = 1; goto End;
         }
 
         // ptT3 = Hp(Pi)
-        if (hashToEC(&pPubkeys[i * EC_COMPRESSED_SIZE], EC_COMPRESSED_SIZE, bnT, ptT3) != 0)
+        if (hashToEC(bnCtx, &pPubkeys[i * EC_COMPRESSED_SIZE], EC_COMPRESSED_SIZE, bnT, ptT3, fProtocolV3) != 0)
         {
             LogPrintf("%s: hashToEC failed.\n");
             rv = 1; goto End;
         }
 
         // ptT1 = k1 * I
-        if (!EC_POINT_mul(r_ecGrp, ptT1, nullptr, ptKi, bnC, r_bnCtx))
+        if (!EC_POINT_mul(r_ecGrp, ptT1, nullptr, ptKi, bnC, bnCtx))
         {
             LogPrintf("%s: EC_POINT_mul failed.\n");
             rv = 1; goto End;
         }
 
         // ptT2 = k2 * ptT3
-        if (!EC_POINT_mul(r_ecGrp, ptT2, nullptr, ptT3, bnR, r_bnCtx))
+        if (!EC_POINT_mul(r_ecGrp, ptT2, nullptr, ptT3, bnR, bnCtx))
         {
             LogPrintf("%s: EC_POINT_mul failed.\n");
             rv = 1; goto End;
         }
 
         // ptR = ptT1 + ptT2
-        if (!EC_POINT_add(r_ecGrp, ptR, ptT1, ptT2, r_bnCtx))
+        if (!EC_POINT_add(r_ecGrp, ptR, ptT1, ptT2, bnCtx))
         {
             LogPrintf("%s: EC_POINT_add failed.\n");
             rv = 1; goto End;
         }
 
         // sum = (sum + ci) % N
-        if (!BN_mod_add(bnSum, bnSum, bnC, r_bnOrder, r_bnCtx))
+        if (!BN_mod_add(bnSum, bnSum, bnC, r_bnOrder, bnCtx))
         {
             LogPrintf("%s: BN_mod_add failed.\n");
             rv = 1; goto End;
         }
 
         // -- add ptL and ptR to hash
-        if (EC_POINT_point2oct(r_ecGrp, ptL, POINT_CONVERSION_COMPRESSED, &tempData[0],  33, r_bnCtx)
+        if (EC_POINT_point2oct(r_ecGrp, ptL, POINT_CONVERSION_COMPRESSED, &tempData[0],  33, bnCtx)
                                                                                                 != EC_COMPRESSED_SIZE ||
-            EC_POINT_point2oct(r_ecGrp, ptR, POINT_CONVERSION_COMPRESSED, &tempData[33], 33, r_bnCtx)
+            EC_POINT_point2oct(r_ecGrp, ptR, POINT_CONVERSION_COMPRESSED, &tempData[33], 33, bnCtx)
                                                                                                   != EC_COMPRESSED_SIZE)
         {
             LogPrintf("%s: extract ptL and ptR failed.\n");
@@ -632,14 +638,14 @@ int RingSignatureMgr::verifyRingSignature(data_chunk &keyImage,
         rv = 1; goto End;
     }
 
-    if (!BN_mod(bnH, bnH, r_bnOrder, r_bnCtx))
+    if (!BN_mod(bnH, bnH, r_bnOrder, bnCtx))
     {
         LogPrintf("%s: BN_mod failed.\n");
         rv = 1; goto End;
     }
 
     // bnT = (bnH - bnSum) % N
-    if (!BN_mod_sub(bnT, bnH, bnSum, r_bnOrder, r_bnCtx))
+    if (!BN_mod_sub(bnT, bnH, bnSum, r_bnOrder, bnCtx))
     {
         LogPrintf("%s: BN_mod_sub failed.\n");
         rv = 1; goto End;
@@ -662,7 +668,8 @@ int RingSignatureMgr::verifyRingSignature(data_chunk &keyImage,
     EC_POINT_free(ptL);
     EC_POINT_free(ptR);
 
-    BN_CTX_end(r_bnCtx);
+    BN_CTX_end(bnCtx);
+    BN_CTX_free(bnCtx);
 
     return rv;
 }
@@ -960,7 +967,8 @@ int RingSignatureMgr::verifyRingSignatureAB(data_chunk &keyImage,
                                             int nRingSize,
                                             const uint8_t *pPubkeys,
                                             const data_chunk &sigC,
-                                            const uint8_t *pSigS)
+                                            const uint8_t *pSigS,
+                                            bool fProtocolV3)
 {
     // https://bitcointalk.org/index.php?topic=972541.msg10619684
 
@@ -987,12 +995,17 @@ int RingSignatureMgr::verifyRingSignatureAB(data_chunk &keyImage,
 
     tmpPkHash = ssPkHash.GetHash();
 
-    BN_CTX_start(r_bnCtx);
+    // A context of its own, rather than r_bnCtx, so verifications can run in parallel
+    BN_CTX *bnCtx = BN_CTX_new();
+    if (!bnCtx)
+        return errorN(1, "%s: BN_CTX_new failed.");
 
-    BIGNUM   *bnC  = BN_CTX_get(r_bnCtx);
-    BIGNUM   *bnC1 = BN_CTX_get(r_bnCtx);
-    BIGNUM   *bnT  = BN_CTX_get(r_bnCtx);
-    BIGNUM   *bnS  = BN_CTX_get(r_bnCtx);
+    BN_CTX_start(bnCtx);
+
+    BIGNUM   *bnC  = BN_CTX_get(bnCtx);
+    BIGNUM   *bnC1 = BN_CTX_get(bnCtx);
+    BIGNUM   *bnT  = BN_CTX_get(bnCtx);
+    BIGNUM   *bnS  = BN_CTX_get(bnCtx);
     EC_POINT *ptKi = nullptr;
     EC_POINT *ptT1 = nullptr;
     EC_POINT *ptT2 = nullptr;
@@ -1010,7 +1023,7 @@ int RingSignatureMgr::verifyRingSignatureAB(data_chunk &keyImage,
     }
 
     // get keyimage as point
-    if (!EC_POINT_oct2point(r_ecGrp, ptKi, &keyImage[0], EC_COMPRESSED_SIZE, r_bnCtx)
+    if (!EC_POINT_oct2point(r_ecGrp, ptKi, &keyImage[0], EC_COMPRESSED_SIZE, bnCtx)
         &&(rv = errorN(1, "%s: extract ptKi failed.")))
         goto End;
 
@@ -1035,20 +1048,20 @@ int RingSignatureMgr::verifyRingSignatureAB(data_chunk &keyImage,
         }
 
         // ptT2 <- pk
-        if (!EC_POINT_oct2point(r_ecGrp, ptPk, &pPubkeys[i * EC_COMPRESSED_SIZE], EC_COMPRESSED_SIZE, r_bnCtx))
+        if (!EC_POINT_oct2point(r_ecGrp, ptPk, &pPubkeys[i * EC_COMPRESSED_SIZE], EC_COMPRESSED_SIZE, bnCtx))
         {
             LogPrintf("%s: EC_POINT_oct2point failed.\n");
             rv = 1; goto End;
         }
 
         // ptT1 = e_i=s_i*G+c_i*P_i
-        if (!EC_POINT_mul(r_ecGrp, ptT1, bnS, ptPk, bnC, r_bnCtx))
+        if (!EC_POINT_mul(r_ecGrp, ptT1, bnS, ptPk, bnC, bnCtx))
         {
             LogPrintf("%s: EC_POINT_mul failed.\n");
             rv = 1; goto End;
         }
 
-        if (EC_POINT_point2oct(r_ecGrp, ptT1, POINT_CONVERSION_COMPRESSED, &tempData[0],  33, r_bnCtx)
+        if (EC_POINT_point2oct(r_ecGrp, ptT1, POINT_CONVERSION_COMPRESSED, &tempData[0],  33, bnCtx)
                                                                                                   != EC_COMPRESSED_SIZE)
         {
             LogPrintf("%s: extract ptT1 failed.\n");
@@ -1058,34 +1071,34 @@ int RingSignatureMgr::verifyRingSignatureAB(data_chunk &keyImage,
         // ptT2 =E_i=s_i*H(P_i)+c_i*I_j
 
         // ptT2 =H(P_i)
-        if (hashToEC(&pPubkeys[i * EC_COMPRESSED_SIZE], EC_COMPRESSED_SIZE, bnT, ptT2) != 0)
+        if (hashToEC(bnCtx, &pPubkeys[i * EC_COMPRESSED_SIZE], EC_COMPRESSED_SIZE, bnT, ptT2, fProtocolV3) != 0)
         {
             LogPrintf("%s: hashToEC failed.\n");
             rv = 1; goto End;
         }
 
         // ptT3 = s_i*ptT2
-        if (!EC_POINT_mul(r_ecGrp, ptT3, nullptr, ptT2, bnS, r_bnCtx))
+        if (!EC_POINT_mul(r_ecGrp, ptT3, nullptr, ptT2, bnS, bnCtx))
         {
             LogPrintf("%s: EC_POINT_mul failed.\n");
             rv = 1; goto End;
         }
 
         // ptT1 = c_i*I_j
-        if (!EC_POINT_mul(r_ecGrp, ptT1, nullptr, ptKi, bnC, r_bnCtx))
+        if (!EC_POINT_mul(r_ecGrp, ptT1, nullptr, ptKi, bnC, bnCtx))
         {
             LogPrintf("%s: EC_POINT_mul failed.\n");
             rv = 1; goto End;
         }
 
         // ptT2 = ptT3 + ptT1
-        if (!EC_POINT_add(r_ecGrp, ptT2, ptT3, ptT1, r_bnCtx))
+        if (!EC_POINT_add(r_ecGrp, ptT2, ptT3, ptT1, bnCtx))
         {
             LogPrintf("%s: EC_POINT_add failed.\n");
             rv = 1; goto End;
         }
 
-        if (EC_POINT_point2oct(r_ecGrp, ptT2, POINT_CONVERSION_COMPRESSED, &tempData[33], 33, r_bnCtx)
+        if (EC_POINT_point2oct(r_ecGrp, ptT2, POINT_CONVERSION_COMPRESSED, &tempData[33], 33, bnCtx)
                                                                                                   != EC_COMPRESSED_SIZE)
         {
             LogPrintf("%s: extract ptT2 failed.\n");
@@ -1098,7 +1111,7 @@ int RingSignatureMgr::verifyRingSignatureAB(data_chunk &keyImage,
         tmpHash = ssCHash.GetHash();
 
         if (!bnC || !(BN_bin2bn(tmpHash.begin(), EC_SECRET_SIZE, bnC))
-            || !BN_mod(bnC, bnC, r_bnOrder, r_bnCtx))
+            || !BN_mod(bnC, bnC, r_bnOrder, bnCtx))
         {
             LogPrintf("%s: tmpHash -> bnC failed.\n");
             rv = 1; goto End;
@@ -1106,7 +1119,7 @@ int RingSignatureMgr::verifyRingSignatureAB(data_chunk &keyImage,
     }
 
     // bnT = (bnC - bnC1) % N
-    if (!BN_mod_sub(bnT, bnC, bnC1, r_bnOrder, r_bnCtx))
+    if (!BN_mod_sub(bnT, bnC, bnC1, r_bnOrder, bnCtx))
     {
         LogPrintf("%s: BN_mod_sub failed.\n");
         rv = 1; goto End;
@@ -1121,7 +1134,8 @@ int RingSignatureMgr::verifyRingSignatureAB(data_chunk &keyImage,
 
     End:
 
-    BN_CTX_end(r_bnCtx);
+    BN_CTX_end(bnCtx);
+    BN_CTX_free(bnCtx);
 
     EC_POINT_free(ptKi);
     EC_POINT_free(ptT1);
@@ -1155,12 +1169,19 @@ RingSignatureMgr::RingSignatureMgr()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 int RingSignatureMgr::hashToEC(const uint8_t *p, uint32_t len, BIGNUM *bnTmp, EC_POINT *ptRet, bool fNew)
+{
+    return hashToEC(r_bnCtx, p, len, bnTmp, ptRet, fNew || Params().GetConsensus().IsProtocolV3(pindexBestHeader ? pindexBestHeader->nHeight : 0));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int RingSignatureMgr::hashToEC(BN_CTX *bnCtx, const uint8_t *p, uint32_t len, BIGNUM *bnTmp, EC_POINT *ptRet, bool fNew)
 {
     // - bn(hash(data)) * (G + bn1)
 
     int count = 0;
     uint256 pkHash = Hash(p, p + len);
-    BIGNUM *bnOne = BN_CTX_get(r_bnCtx);
+    BIGNUM *bnOne = BN_CTX_get(bnCtx);
     BN_one(bnOne);
 
     if (!bnTmp || !BN_bin2bn(pkHash.begin(), EC_SECRET_SIZE, bnTmp))
@@ -1168,9 +1189,9 @@ int RingSignatureMgr::hashToEC(const uint8_t *p, uint32_t len, BIGNUM *bnTmp, EC
         return errorN(1, "%s: BN_bin2bn failed.");
     }
 
-    if (fNew || Params().GetConsensus().IsProtocolV3(pindexBestHeader ? pindexBestHeader->nHeight : 0))
+    if (fNew)
     {
-        while (!EC_POINT_set_compressed_coordinates_GFp(r_ecGrp, ptRet, bnTmp, 0, r_bnCtx) && count < 100)
+        while (!EC_POINT_set_compressed_coordinates_GFp(r_ecGrp, ptRet, bnTmp, 0, bnCtx) && count < 100)
         {
             if (++count == 100)
             {
@@ -1180,7 +1201,7 @@ int RingSignatureMgr::hashToEC(const uint8_t *p, uint32_t len, BIGNUM *bnTmp, EC
             BN_add(bnTmp, bnTmp, bnOne);
         }
     }
-    else if (!EC_POINT_mul(r_ecGrp, ptRet, bnTmp, nullptr, nullptr, r_bnCtx))
+    else if (!EC_POINT_mul(r_ecGrp, ptRet, bnTmp, nullptr, nullptr, bnCtx))
     {
         return errorN(1, "%s: EC_POINT_mul failed.");
     }
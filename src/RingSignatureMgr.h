@@ -69,14 +69,17 @@ public:
                               uint8_t*       pSigr);
 
     /**
-     * TODO TSB
+     * Returns 0 if the signature is valid. fProtocolV3 selects the hash to
+     * curve mapping of protocol v3. Unlike the other methods, this may be
+     * called from several threads at once.
      */
     int verifyRingSignature(data_chunk&    keyImage,
                             uint256&       txnHash,
                             int            nRingSize,
                             const uint8_t* pPubkeys,
                             const uint8_t* pSigc,
-                            const uint8_t* pSigr);
+                            const uint8_t* pSigr,
+                            bool           fProtocolV3);
 
     /**
      * TODO TSB
@@ -91,14 +94,17 @@ public:
                                 uint8_t*       pSigS);
 
     /**
-     * TODO TSB
+     * Returns 0 if the signature is valid. fProtocolV3 selects the hash to
+     * curve mapping of protocol v3. Unlike the other methods, this may be
+     * called from several threads at once.
      */
     int verifyRingSignatureAB(data_chunk&       keyImage,
                               uint256&          txnHash,
                               int               nRingSize,
                               const uint8_t*    pPubkeys,
                               const data_chunk& sigC,
-                              const uint8_t*    pSigS);
+                              const uint8_t*    pSigS,
+                              bool              fProtocolV3);
 
 private:
     EC_GROUP* r_ecGrp;
@@ -108,6 +114,7 @@ private:
     RingSignatureMgr();
 
     int hashToEC(const uint8_t *p, uint32_t len, BIGNUM *bnTmp, EC_POINT *ptRet, bool fNew = false);
+    int hashToEC(BN_CTX *bnCtx, const uint8_t *p, uint32_t len, BIGNUM *bnTmp, EC_POINT *ptRet, bool fNew);
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
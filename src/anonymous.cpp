@@ -13,6 +13,14 @@
 #include <validation.h>
 #include <hash.h>
 #include <txmempool.h>
+#include <RingSignatureMgr.h>
+#include <crypto/sha256.h>
+#include <cuckoocache.h>
+#include <random.h>
+#include <script/sigcache.h>
+#include <validationstats.h>
+
+#include <boost/thread/shared_mutex.hpp>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -53,7 +61,7 @@ int GetTxnPreImage(const CTransaction& iTx, uint256& oPreImage)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool GetKeyImage(CBlockTreeDB& iTxDb, const ec_point& keyImage, CKeyImageSpent& keyImageSpent, bool& fInMempool)
+bool GetKeyImage(CAnonDB& iTxDb, const ec_point& keyImage, CKeyImageSpent& keyImageSpent, bool& fInMempool)
 {
     AssertLockHeld(cs_main);
 
@@ -73,7 +81,7 @@ bool GetKeyImage(CBlockTreeDB& iTxDb, const ec_point& keyImage, CKeyImageSpent&
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-bool TxnHashInSystem(CBlockTreeDB& iTxDb, const uint256& iTxHash)
+bool TxnHashInSystem(CAnonDB& iTxDb, const uint256& iTxHash)
 {
     // -- is the transaction hash known in the system
 
@@ -98,3 +106,132 @@ bool TxnHashInSystem(CBlockTreeDB& iTxDb, const uint256& iTxHash)
     return false;
     */
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ExtractRingPubkeys(const CTxIn& txin, std::vector<CPubKey>& vPubkeys)
+{
+    const CScript& s = txin.scriptSig;
+    int nRingSize = txin.ExtractRingSize();
+    if (nRingSize < (int)MIN_RING_SIZE || nRingSize > (int)MAX_RING_SIZE_OLD)
+        return false;
+
+    const unsigned char* pPubkeys;
+    if (nRingSize > 1 && s.size() == 2 + EC_SECRET_SIZE + (EC_SECRET_SIZE + EC_COMPRESSED_SIZE) * nRingSize)
+    {
+        // -- ringsig AB: c, s values then pubkeys
+        pPubkeys = &s[2 + EC_SECRET_SIZE + EC_SECRET_SIZE * nRingSize];
+    }
+    else if (s.size() >= 2 + (EC_COMPRESSED_SIZE + EC_SECRET_SIZE + EC_SECRET_SIZE) * nRingSize)
+    {
+        // -- pubkeys then c, r values
+        pPubkeys = &s[2];
+    }
+    else
+        return false;
+
+    for (int ri = 0; ri < nRingSize; ++ri)
+        vPubkeys.push_back(CPubKey(&pPubkeys[ri * EC_COMPRESSED_SIZE], EC_COMPRESSED_SIZE));
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+/**
+ * Valid ring signature cache, like CSignatureCache, to avoid verifying the
+ * ring signature of an anon input both when its transaction is pre-verified
+ * and again under cs_main, and when its block is connected
+ */
+class CRingSignatureCache
+{
+private:
+    //! Entries are SHA256(nonce || protocol v3 || preimage || scriptSig)
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_ringsigcache;
+
+public:
+    CRingSignatureCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void ComputeEntry(uint256& entry, const CTxIn& txin, const uint256& preimage, bool fProtocolV3)
+    {
+        const unsigned char v3 = fProtocolV3;
+        CSHA256().Write(nonce.begin(), 32).Write(&v3, 1).Write(preimage.begin(), 32).Write(txin.scriptSig.data(), txin.scriptSig.size()).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_ringsigcache);
+        return setValid.contains(entry, false);
+    }
+
+    void Set(uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_ringsigcache);
+        setValid.insert(entry);
+    }
+
+    uint32_t setup_bytes(size_t n)
+    {
+        return setValid.setup_bytes(n);
+    }
+};
+
+static CRingSignatureCache ringSignatureCache;
+} // namespace
+
+void InitRingSignatureCache()
+{
+    size_t nElems = ringSignatureCache.setup_bytes((size_t)RING_SIGNATURE_CACHE_SIZE << 20);
+    LogPrintf("Using %zu MiB for ring signature cache, able to store %zu elements\n",
+            (nElems * sizeof(uint256)) >> 20, nElems);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VerifyAnonInputSignature(const CTxIn& txin, const uint256& preimage, bool fProtocolV3)
+{
+    const CScript& s = txin.scriptSig;
+    const int nRingSize = txin.ExtractRingSize();
+    if (nRingSize < 1)
+        return false;
+
+    uint256 entry;
+    ringSignatureCache.ComputeEntry(entry, txin, preimage, fProtocolV3);
+    if (ringSignatureCache.Get(entry))
+        return true;
+
+    ec_point vchImage;
+    txin.ExtractKeyImage(vchImage);
+    uint256 txnHash = preimage;
+
+    ValidationStageTimer timer(ValidationStage::RING_SIGNATURE, ConnectBlockStatsScope::InScope());
+    int rv;
+    if (nRingSize > 1 && s.size() == 2 + EC_SECRET_SIZE + (EC_SECRET_SIZE + EC_COMPRESSED_SIZE) * nRingSize)
+    {
+        // -- ringsig AB: c, s values then pubkeys
+        const data_chunk sigC(&s[2], &s[2 + EC_SECRET_SIZE]);
+        rv = RingSignatureMgr::GetInstance().verifyRingSignatureAB(vchImage, txnHash, nRingSize,
+                &s[2 + EC_SECRET_SIZE + EC_SECRET_SIZE * nRingSize], sigC, &s[2 + EC_SECRET_SIZE], fProtocolV3);
+    }
+    else if (s.size() >= 2 + (EC_COMPRESSED_SIZE + EC_SECRET_SIZE + EC_SECRET_SIZE) * nRingSize)
+    {
+        // -- pubkeys then c, r values
+        rv = RingSignatureMgr::GetInstance().verifyRingSignature(vchImage, txnHash, nRingSize,
+                &s[2], &s[2 + EC_COMPRESSED_SIZE * nRingSize], &s[2 + (EC_COMPRESSED_SIZE + EC_SECRET_SIZE) * nRingSize], fProtocolV3);
+    }
+    else
+        return false;
+
+    if (rv != 0)
+        return false;
+
+    ringSignatureCache.Set(entry);
+    return true;
+}
@@ -20,12 +20,13 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 class uint256;
-class CBlockTreeDB;
+class CAnonDB;
+class CPubKey;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 /**
- * Stored in txdb, key is keyimage
+ * Stored in the anon db, key is keyimage
  */
 class CKeyImageSpent
 {
@@ -63,7 +64,7 @@ public:
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 /**
- * Stored in txdb, key is pubkey
+ * Stored in the anon db, key is pubkey
  */
 class CAnonOutput
 {
@@ -226,9 +227,32 @@ public:
 
 int GetTxnPreImage(const CTransaction& iTx, uint256& oPreImage);
 
-bool GetKeyImage(CBlockTreeDB& iTxDb, const ec_point& keyImage, CKeyImageSpent& keyImageSpent, bool& fInMempool);
+bool GetKeyImage(CAnonDB& iTxDb, const ec_point& keyImage, CKeyImageSpent& keyImageSpent, bool& fInMempool);
 
-bool TxnHashInSystem(CBlockTreeDB& iTxDb, const uint256& iTxHash);
+bool TxnHashInSystem(CAnonDB& iTxDb, const uint256& iTxHash);
+
+/**
+ * Append the pubkeys of the ring members of an anon input to vPubkeys, for
+ * either layout of its ring signature. Returns false if the scriptSig is
+ * not a ring signature of a known layout.
+ */
+bool ExtractRingPubkeys(const CTxIn& txin, std::vector<CPubKey>& vPubkeys);
+
+/** Size of the cache of valid ring signatures, in MiB */
+static const unsigned int RING_SIGNATURE_CACHE_SIZE = 4;
+
+/** To be called once at startup, like InitSignatureCache() */
+void InitRingSignatureCache();
+
+/**
+ * Verify the ring signature of an anon input, for either layout, against the
+ * preimage of its transaction. The pubkeys of the ring members are part of the
+ * signature, so this needs neither the anon db nor cs_main, and may run on
+ * several threads at once. Valid signatures are cached, which makes verifying
+ * one again, once its transaction is accepted to the mempool or connected in
+ * a block, cheap.
+ */
+bool VerifyAnonInputSignature(const CTxIn& txin, const uint256& preimage, bool fProtocolV3);
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -0,0 +1,66 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <random.h>
+#include <txdb.h>
+
+#include <assert.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+static const int BLOCK_INDEX_LOAD_BLOCKS = 20000;
+
+/**
+ * Load a block index of version 6 headers, which hash with scrypt, the way
+ * startup does.
+ */
+static void BlockIndexLoad(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    const Consensus::Params& params = Params().GetConsensus();
+    CBlockTreeDB db(1 << 24, true);
+
+    FastRandomContext rng(true);
+    std::vector<uint256> hashes(BLOCK_INDEX_LOAD_BLOCKS);
+    std::vector<CBlockIndex> index(BLOCK_INDEX_LOAD_BLOCKS);
+    std::vector<const CBlockIndex*> blockinfo;
+    for (int i = 0; i < BLOCK_INDEX_LOAD_BLOCKS; ++i) {
+        // Below the regtest proof of work limit
+        hashes[i] = rng.rand256();
+        *(hashes[i].begin() + 31) = 0;
+        index[i].phashBlock = &hashes[i];
+        index[i].pprev = i > 0 ? &index[i - 1] : nullptr;
+        index[i].nHeight = i;
+        index[i].nVersion = 6;
+        index[i].nTime = i;
+        index[i].nBits = UintToArith256(params.powLimit).GetCompact();
+        index[i].nStatus = BLOCK_VALID_TREE;
+        blockinfo.push_back(&index[i]);
+    }
+    bool ret = db.WriteBatchSync({}, 0, blockinfo);
+    assert(ret);
+
+    while (state.KeepRunning()) {
+        std::map<uint256, std::unique_ptr<CBlockIndex>> loaded;
+        auto insert = [&](const uint256& hash) -> CBlockIndex* {
+            if (hash.IsNull()) return nullptr;
+            auto it = loaded.emplace(hash, nullptr).first;
+            if (!it->second) {
+                it->second.reset(new CBlockIndex());
+                it->second->phashBlock = &it->first;
+            }
+            return it->second.get();
+        };
+        ret = db.LoadBlockIndexGuts(params, insert);
+        assert(ret);
+        assert(loaded.size() == (size_t)BLOCK_INDEX_LOAD_BLOCKS);
+    }
+}
+
+BENCHMARK(BlockIndexLoad, 5);
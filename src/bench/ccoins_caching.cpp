@@ -5,6 +5,7 @@
 #include <bench/bench.h>
 #include <coins.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <wallet/crypter.h>
 
 #include <vector>
@@ -85,4 +86,31 @@ static void CCoinsCaching(benchmark::State& state)
     }
 }
 
+// Fill a cache with coins, spend some of them and flush it, like the coins
+// cache sees during IBD. Mostly measures the cost of the cache entries.
+static void CCoinsCacheFlush(benchmark::State& state)
+{
+    static const int COINS = 100000;
+    FastRandomContext rng(true);
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < COINS; ++i) {
+        outpoints.emplace_back(rng.rand256(), i % 4);
+    }
+    CCoinsView coinsDummy;
+    CCoinsViewCache base(&coinsDummy);
+    while (state.KeepRunning()) {
+        CCoinsViewCache coins(&base);
+        for (const COutPoint& outpoint : outpoints) {
+            coins.AddCoin(outpoint, Coin(CTxOut(COIN, CScript() << OP_TRUE), 1, false, false), false);
+        }
+        for (int i = 0; i < COINS; i += 3) {
+            coins.SpendCoin(outpoints[i]);
+        }
+        coins.SetBestBlock(outpoints[0].hash);
+        coins.Flush();
+        base.Flush();
+    }
+}
+
 BENCHMARK(CCoinsCaching, 170 * 1000);
+BENCHMARK(CCoinsCacheFlush, 10);
@@ -6,10 +6,12 @@
 #include <util/system.h>
 #include <validation.h>
 #include <checkqueue.h>
+#include <crypto/sha256.h>
 #include <prevector.h>
 #include <vector>
 #include <boost/thread/thread.hpp>
 #include <random.h>
+#include <uint256.h>
 
 
 static const int MIN_CORES = 2;
@@ -18,38 +20,24 @@ static const size_t BATCH_SIZE = 30;
 static const int PREVECTOR_SIZE = 28;
 static const unsigned int QUEUE_BATCH_SIZE = 128;
 
-// This Benchmark tests the CheckQueue with a slightly realistic workload,
-// where checks all contain a prevector that is indirect 50% of the time
-// and there is a little bit of work done between calls to Add.
-static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+//! Run the checks made by MakeJob in batches, through a queue with nThreads workers
+template <typename Job, typename MakeJob>
+static void RunCheckQueue(benchmark::State& state, int nThreads, MakeJob make_job)
 {
-    struct PrevectorJob {
-        prevector<PREVECTOR_SIZE, uint8_t> p;
-        PrevectorJob(){
-        }
-        explicit PrevectorJob(FastRandomContext& insecure_rand){
-            p.resize(insecure_rand.randrange(PREVECTOR_SIZE*2));
-        }
-        bool operator()()
-        {
-            return true;
-        }
-        void swap(PrevectorJob& x){p.swap(x.p);};
-    };
-    CCheckQueue<PrevectorJob> queue {QUEUE_BATCH_SIZE};
+    CCheckQueue<Job> queue {QUEUE_BATCH_SIZE};
     boost::thread_group tg;
-    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
+    for (auto x = 0; x < nThreads; ++x) {
        tg.create_thread([&]{queue.Thread();});
     }
     while (state.KeepRunning()) {
         // Make insecure_rand here so that each iteration is identical.
         FastRandomContext insecure_rand(true);
-        CCheckQueueControl<PrevectorJob> control(&queue);
-        std::vector<std::vector<PrevectorJob>> vBatches(BATCHES);
+        CCheckQueueControl<Job> control(&queue);
+        std::vector<std::vector<Job>> vBatches(BATCHES);
         for (auto& vChecks : vBatches) {
             vChecks.reserve(BATCH_SIZE);
             for (size_t x = 0; x < BATCH_SIZE; ++x)
-                vChecks.emplace_back(insecure_rand);
+                vChecks.push_back(make_job(insecure_rand));
             control.Add(vChecks);
         }
         // control waits for completion by RAII, but
@@ -59,4 +47,61 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.interrupt_all();
     tg.join_all();
 }
+
+struct PrevectorJob {
+    prevector<PREVECTOR_SIZE, uint8_t> p;
+    PrevectorJob(){
+    }
+    explicit PrevectorJob(FastRandomContext& insecure_rand){
+        p.resize(insecure_rand.randrange(PREVECTOR_SIZE*2));
+    }
+    bool operator()()
+    {
+        return true;
+    }
+    void swap(PrevectorJob& x){p.swap(x.p);};
+};
+
+// This Benchmark tests the CheckQueue with a slightly realistic workload,
+// where checks all contain a prevector that is indirect 50% of the time
+// and there is a little bit of work done between calls to Add.
+static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+{
+    RunCheckQueue<PrevectorJob>(state, std::max(MIN_CORES, GetNumCores()),
+        [](FastRandomContext& insecure_rand) { return PrevectorJob(insecure_rand); });
+}
+
+// Checks of which a few take much longer than the others, like the
+// signatures of a large ring among plain script checks. Workers that get
+// the slow ones have to be relieved by the others.
+struct UnevenJob {
+    int nRounds = 0;
+    UnevenJob(){
+    }
+    explicit UnevenJob(FastRandomContext& insecure_rand){
+        nRounds = insecure_rand.randrange(16) == 0 ? 256 : 4;
+    }
+    bool operator()()
+    {
+        uint256 hash;
+        for (int i = 0; i < nRounds; ++i)
+            CSHA256().Write(hash.begin(), hash.size()).Finalize(hash.begin());
+        return !hash.IsNull();
+    }
+    void swap(UnevenJob& x){std::swap(nRounds, x.nRounds);};
+};
+
+static void CCheckQueueUnevenJob(benchmark::State& state, int nThreads)
+{
+    RunCheckQueue<UnevenJob>(state, nThreads,
+        [](FastRandomContext& insecure_rand) { return UnevenJob(insecure_rand); });
+}
+
+static void CCheckQueueUnevenJob8Threads(benchmark::State& state) { CCheckQueueUnevenJob(state, 8); }
+static void CCheckQueueUnevenJob16Threads(benchmark::State& state) { CCheckQueueUnevenJob(state, 16); }
+static void CCheckQueueUnevenJob32Threads(benchmark::State& state) { CCheckQueueUnevenJob(state, 32); }
+
 BENCHMARK(CCheckQueueSpeedPrevectorJob, 1400);
+BENCHMARK(CCheckQueueUnevenJob8Threads, 50);
+BENCHMARK(CCheckQueueUnevenJob16Threads, 50);
+BENCHMARK(CCheckQueueUnevenJob32Threads, 50);
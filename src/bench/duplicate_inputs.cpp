@@ -38,6 +38,7 @@ static void DuplicateInputs(benchmark::State& state)
     const CChainParams& chainparams = Params();
     {
         ::pblocktree.reset(new CBlockTreeDB(1 << 20, true));
+        ::panondb.reset(new CAnonDB(1 << 20, true));
         ::pcoinsdbview.reset(new CCoinsViewDB(1 << 23, true));
         ::pcoinsTip.reset(new CCoinsViewCache(pcoinsdbview.get()));
 
@@ -0,0 +1,89 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <extkey.h>
+#include <key.h>
+#include <random.h>
+
+#include <assert.h>
+#include <utility>
+#include <vector>
+
+// Lookups per iteration of the HaveKey benchmarks, half of them for keys of the account
+static const size_t HAVEKEY_LOOKUPS = 1000;
+
+/** Account with a single chain, standing in for one of our deposit accounts */
+class BenchAccount
+{
+public:
+    CExtKeyAccount account;
+
+    BenchAccount()
+    {
+        unsigned char seed[32] = {1};
+        CExtKey master;
+        master.SetSeed(seed, sizeof(seed));
+        CStoredExtKey* sek = new CStoredExtKey();
+        sek->kp = CExtKeyPair(master);
+        account.vExtKeys.push_back(sek);
+        account.vExtKeyIDs.push_back(sek->GetID());
+    }
+
+    ~BenchAccount()
+    {
+        account.FreeChains();
+    }
+};
+
+static void LookAhead(benchmark::State& state, uint32_t nKeys)
+{
+    while (state.KeepRunning()) {
+        BenchAccount bench;
+        bench.account.AddLookAhead(0, nKeys);
+        assert(bench.account.mapLookAhead.size() == nKeys);
+    }
+}
+
+static void HaveKey(benchmark::State& state, size_t nKeys)
+{
+    // HaveKey() encodes the address of keys found in the lookahead
+    SelectParams(CBaseChainParams::REGTEST);
+    FastRandomContext rng(true);
+    BenchAccount bench;
+    bench.account.AddLookAhead(0, nKeys);
+    // Save half of the keys, like ones that have been used, so lookups hit
+    // both the saved keys and the lookahead
+    std::vector<std::pair<CKeyID, CEKAKey>> keys(bench.account.mapLookAhead.begin(), bench.account.mapLookAhead.end());
+    for (size_t i = 0; i < keys.size(); i += 2) {
+        bench.account.SaveKey(keys[i].first, keys[i].second);
+    }
+    std::vector<CKeyID> ids;
+    for (size_t i = 0; i < HAVEKEY_LOOKUPS / 2; ++i) {
+        ids.push_back(keys[i].first);
+    }
+    while (ids.size() < HAVEKEY_LOOKUPS) {
+        ids.push_back(CKeyID(uint160(rng.randbytes(20))));
+    }
+
+    CEKAKey ak;
+    while (state.KeepRunning()) {
+        size_t nFound = 0;
+        for (const CKeyID& id : ids) {
+            if (bench.account.HaveKey(id, false, ak) != 0) ++nFound;
+        }
+        assert(nFound == HAVEKEY_LOOKUPS / 2);
+    }
+}
+
+static void ExtKeyLookAhead10k(benchmark::State& state) { LookAhead(state, 10000); }
+static void ExtKeyLookAhead100k(benchmark::State& state) { LookAhead(state, 100000); }
+static void ExtKeyHaveKey10k(benchmark::State& state) { HaveKey(state, 10000); }
+static void ExtKeyHaveKey100k(benchmark::State& state) { HaveKey(state, 100000); }
+
+BENCHMARK(ExtKeyLookAhead10k, 1);
+BENCHMARK(ExtKeyLookAhead100k, 1);
+BENCHMARK(ExtKeyHaveKey10k, 100);
+BENCHMARK(ExtKeyHaveKey100k, 100);
@@ -0,0 +1,52 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <RingSignatureMgr.h>
+#include <chainparams.h>
+#include <key.h>
+#include <random.h>
+
+#include <assert.h>
+#include <string.h>
+
+static const int RING_SIZE = 10;
+
+/**
+ * Verify the ring signature of an anon input. This is what connecting a
+ * block below -assumevalid saves per anon input, while the anon db reads of
+ * its key image and ring members remain.
+ */
+static void RingSignatureVerify(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    const bool fProtocolV3 = Params().GetConsensus().IsProtocolV3(0);
+
+    std::vector<uint8_t> vchPubkeys(EC_COMPRESSED_SIZE * RING_SIZE);
+    CKey keySpend;
+    for (int i = 0; i < RING_SIZE; ++i) {
+        CKey key;
+        key.MakeNewKey(true);
+        memcpy(&vchPubkeys[i * EC_COMPRESSED_SIZE], key.GetPubKey().begin(), EC_COMPRESSED_SIZE);
+        if (i == 0) keySpend = key;
+    }
+
+    ec_secret secret;
+    memcpy(secret.e, keySpend.begin(), EC_SECRET_SIZE);
+    ec_point pkSpend(keySpend.GetPubKey().begin(), keySpend.GetPubKey().end());
+    ec_point keyImage;
+    assert(RingSignatureMgr::GetInstance().generateKeyImage(pkSpend, secret, keyImage) == 0);
+
+    uint256 preimage = GetRandHash();
+    std::vector<uint8_t> vchSigc(EC_SECRET_SIZE * RING_SIZE);
+    std::vector<uint8_t> vchSigr(EC_SECRET_SIZE * RING_SIZE);
+    assert(RingSignatureMgr::GetInstance().generateRingSignature(keyImage, preimage, RING_SIZE, 0, secret, vchPubkeys.data(), vchSigc.data(), vchSigr.data()) == 0);
+
+    while (state.KeepRunning()) {
+        int rv = RingSignatureMgr::GetInstance().verifyRingSignature(keyImage, preimage, RING_SIZE, vchPubkeys.data(), vchSigc.data(), vchSigr.data(), fProtocolV3);
+        assert(rv == 0);
+    }
+}
+
+BENCHMARK(RingSignatureVerify, 20);
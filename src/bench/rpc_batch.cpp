@@ -0,0 +1,134 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <crypto/sha256.h>
+#include <rpc/server.h>
+#include <sync.h>
+#include <util/strencodings.h>
+#include <util/system.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <univalue.h>
+
+static const int MIN_CORES = 2;
+static const size_t BATCH_CALLS = 200;
+// Roughly the cost of decoding a transaction or block header for the reply
+static const size_t CALL_WORK_BYTES = 16 * 1024;
+
+static UniValue benchrpcbatch(const JSONRPCRequest& request)
+{
+    std::vector<unsigned char> data(CALL_WORK_BYTES, (unsigned char)request.params[0].get_int());
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data.data(), data.size()).Finalize(hash);
+    return HexStr(hash, hash + sizeof(hash));
+}
+
+static const CRPCCommand benchCommand = { "hidden", "benchrpcbatch", &benchrpcbatch, {"n"}, true };
+
+static UniValue MakeBatch()
+{
+    static bool registered = false;
+    if (!registered) {
+        tableRPC.appendCommand(benchCommand.name, &benchCommand);
+        SetRPCWarmupFinished();
+        registered = true;
+    }
+    UniValue batch(UniValue::VARR);
+    for (size_t i = 0; i < BATCH_CALLS; ++i) {
+        UniValue params(UniValue::VARR);
+        params.push_back((int)i);
+        UniValue call(UniValue::VOBJ);
+        call.pushKV("method", "benchrpcbatch");
+        call.pushKV("params", params);
+        call.pushKV("id", (int)i);
+        batch.push_back(call);
+    }
+    return batch;
+}
+
+/** Stand-in for the HTTP worker threads a batch is spread over */
+class BenchWorkers
+{
+public:
+    explicit BenchWorkers(int count)
+    {
+        for (int i = 0; i < count; ++i) {
+            threads.emplace_back([this] { Run(); });
+        }
+    }
+
+    ~BenchWorkers()
+    {
+        {
+            LOCK(cs);
+            running = false;
+            cond.notify_all();
+        }
+        for (std::thread& thread : threads) thread.join();
+    }
+
+    bool RunIfIdle(const std::function<void()>& func)
+    {
+        LOCK(cs);
+        if (queue.size() >= idle) return false;
+        queue.push_back(func);
+        cond.notify_one();
+        return true;
+    }
+
+private:
+    void Run()
+    {
+        while (true) {
+            std::function<void()> func;
+            {
+                WAIT_LOCK(cs, lock);
+                idle++;
+                while (running && queue.empty()) cond.wait(lock);
+                idle--;
+                if (!running) return;
+                func = std::move(queue.front());
+                queue.pop_front();
+            }
+            func();
+        }
+    }
+
+    Mutex cs;
+    std::condition_variable cond;
+    std::deque<std::function<void()>> queue;
+    size_t idle = 0;
+    bool running = true;
+    std::vector<std::thread> threads;
+};
+
+static void RpcBatchSequential(benchmark::State& state)
+{
+    const UniValue batch = MakeBatch();
+    JSONRPCRequest jreq;
+    while (state.KeepRunning()) {
+        JSONRPCExecBatch(jreq, batch);
+    }
+}
+
+static void RpcBatchConcurrent(benchmark::State& state)
+{
+    const UniValue batch = MakeBatch();
+    JSONRPCRequest jreq;
+    // The thread calling JSONRPCExecBatch works on the batch as well
+    BenchWorkers workers(std::max(MIN_CORES, GetNumCores()) - 1);
+    const RPCTaskRunner runner = [&workers](const std::function<void()>& func) { return workers.RunIfIdle(func); };
+    while (state.KeepRunning()) {
+        JSONRPCExecBatch(jreq, batch, runner);
+    }
+}
+
+BENCHMARK(RpcBatchSequential, 50);
+BENCHMARK(RpcBatchConcurrent, 50);
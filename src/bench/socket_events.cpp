@@ -0,0 +1,162 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <compat.h>
+#include <net.h>
+#include <random.h>
+#include <util/system.h>
+
+#include <limits>
+#include <vector>
+
+#ifndef WIN32
+#include <fcntl.h>
+
+static const size_t NUM_PEERS = 500;
+// Peers that have sent something by the time the socket handler wakes up
+static const size_t ACTIVE_PEERS = 5;
+
+/** Loopback TCP connections, standing in for the inbound peers of a busy node. */
+class LoopbackPeers
+{
+public:
+    //! Our ends of the connections, owned by the CConnman they are handed to
+    std::vector<SOCKET> local;
+    std::vector<SOCKET> remote;
+
+    explicit LoopbackPeers(size_t count)
+    {
+        RaiseFileDescriptorLimit(2 * count + 64);
+
+        SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (::bind(listener, (struct sockaddr*)&addr, len) != 0 ||
+            listen(listener, SOMAXCONN) != 0 ||
+            getsockname(listener, (struct sockaddr*)&addr, &len) != 0) {
+            throw std::runtime_error("failed to open loopback listener");
+        }
+        for (size_t i = 0; i < count; ++i) {
+            SOCKET out = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (connect(out, (struct sockaddr*)&addr, len) != 0) {
+                throw std::runtime_error("failed to connect loopback peer");
+            }
+            SOCKET in = accept(listener, nullptr, nullptr);
+            fcntl(in, F_SETFL, fcntl(in, F_GETFL, 0) | O_NONBLOCK);
+            local.push_back(in);
+            remote.push_back(out);
+        }
+        close(listener);
+    }
+
+    ~LoopbackPeers()
+    {
+        for (SOCKET s : remote) close(s);
+    }
+
+    /** Have a few random peers send a byte each. */
+    void Send(FastRandomContext& rng)
+    {
+        const char c = 0;
+        for (size_t i = 0; i < ACTIVE_PEERS; ++i) {
+            if (send(remote[rng.randrange(remote.size())], &c, 1, 0) != 1) {
+                throw std::runtime_error("loopback send failed");
+            }
+        }
+    }
+};
+
+/** Message processing that does nothing, so only the socket handler is measured. */
+class NullNetEvents : public NetEventsInterface
+{
+public:
+    bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) override { return false; }
+    bool SendMessages(CNode* pnode) override { return false; }
+    void InitializeNode(CNode* pnode) override {}
+    void FinalizeNode(NodeId id, bool& update_connection_time) override {}
+};
+
+/** A CConnman without threads whose socket handler the benchmark runs by hand. */
+class BenchConnman : public CConnman
+{
+public:
+    BenchConnman(NetEventsInterface* msgproc, bool use_epoll) : CConnman(0x1337, 0x1337)
+    {
+        Options options;
+        options.m_msgproc = msgproc;
+        options.nMaxConnections = NUM_PEERS;
+        // Nothing empties the receive queues, so don't pause the peers once
+        // they fill up, and don't time them out
+        options.nReceiveFloodSize = std::numeric_limits<unsigned int>::max();
+        options.m_peer_connect_timeout = std::numeric_limits<int64_t>::max();
+        Init(options);
+#ifdef USE_EPOLL
+        if (use_epoll && !InitSocketEvents()) {
+            throw std::runtime_error("failed to set up epoll");
+        }
+#endif
+    }
+
+    /** Hand over an accepted socket the way the listening socket would. */
+    void AddPeer(SOCKET hSocket)
+    {
+        struct sockaddr_storage sockaddr;
+        socklen_t len = sizeof(sockaddr);
+        CAddress addr;
+        if (getpeername(hSocket, (struct sockaddr*)&sockaddr, &len) != 0 ||
+            !addr.SetSockAddr((const struct sockaddr*)&sockaddr)) {
+            throw std::runtime_error("failed to get loopback peer address");
+        }
+        CreateNodeFromAcceptedSocket(hSocket, true, addr);
+    }
+
+    using CConnman::SocketHandler;
+};
+
+static void SocketHandler(benchmark::State& state, bool use_epoll)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    LoopbackPeers peers(NUM_PEERS);
+    NullNetEvents events;
+    BenchConnman connman(&events, use_epoll);
+    for (SOCKET s : peers.local) {
+        connman.AddPeer(s);
+    }
+    FastRandomContext rng(true);
+    // Let the epoll backend take in the initial writability of the sockets
+    connman.SocketHandler();
+
+    while (state.KeepRunning()) {
+        peers.Send(rng);
+        connman.SocketHandler();
+    }
+}
+
+// CConnman::SocketHandler() with poll() (or select() where there is no
+// poll()): the socket sets are rebuilt from scratch and every peer is handed
+// to the kernel each time.
+static void SocketEventsPoll(benchmark::State& state)
+{
+    SocketHandler(state, false);
+}
+BENCHMARK(SocketEventsPoll, 500);
+
+#ifdef USE_EPOLL
+// CConnman::SocketHandler() with epoll: peers stay registered and only the
+// sockets that became readable are serviced.
+static void SocketEventsEpoll(benchmark::State& state)
+{
+    SocketHandler(state, true);
+}
+BENCHMARK(SocketEventsEpoll, 500);
+#endif
+#endif
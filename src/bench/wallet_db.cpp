@@ -0,0 +1,50 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <random.h>
+#include <util/system.h>
+#include <wallet/db.h>
+#include <wallet/logdb.h>
+
+#include <assert.h>
+
+// Records written per iteration, about what sending or receiving a transaction writes
+static const int RECORDS_PER_COMMIT = 4;
+static const size_t RECORD_SIZE = 400;
+
+static void WriteRecords(benchmark::State& state, WalletDatabase& database)
+{
+    FastRandomContext rng(true);
+    std::unique_ptr<DatabaseBatch> batch = database.MakeBatch("cr+");
+    const std::vector<unsigned char> value = rng.randbytes(RECORD_SIZE);
+    uint64_t n = 0;
+    while (state.KeepRunning()) {
+        assert(batch->TxnBegin());
+        for (int i = 0; i < RECORDS_PER_COMMIT; ++i) {
+            assert(batch->Write(std::make_pair(std::string("tx"), rng.rand256()), value));
+        }
+        assert(batch->TxnCommit());
+        if (++n % 1000 == 0) database.PeriodicFlush();
+    }
+    batch.reset();
+    database.Flush(true);
+}
+
+static void WalletDbWriteBDB(benchmark::State& state)
+{
+    std::unique_ptr<WalletDatabase> database = BerkeleyDatabase::Create(GetDataDir() / "wallet_db_bdb");
+    WriteRecords(state, *database);
+}
+
+static void WalletDbWriteLog(benchmark::State& state)
+{
+    const fs::path path = GetDataDir() / "wallet_db_log";
+    fs::create_directories(path);
+    LogDatabase database(path / "wallet.dat");
+    WriteRecords(state, database);
+}
+
+BENCHMARK(WalletDbWriteBDB, 5000);
+BENCHMARK(WalletDbWriteLog, 5000);
@@ -0,0 +1,72 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <interfaces/chain.h>
+#include <key.h>
+#include <random.h>
+#include <script/standard.h>
+#include <util/system.h>
+#include <wallet/wallet.h>
+#include <wallet/walletdb.h>
+
+#include <assert.h>
+
+static const int WALLET_LOAD_TXS = 500000;
+static const int WALLET_LOAD_KEYS = 10000;
+// Records written per db transaction while creating the wallet
+static const int WRITES_PER_TXN = 1000;
+
+/** Create a wallet file with synthetic transactions and keys, once per run. */
+static fs::path CreateBenchWallet()
+{
+    const fs::path path = GetDataDir() / "wallet_load";
+    if (fs::exists(path)) return path;
+
+    auto chain = interfaces::MakeChain();
+    CWallet wallet(*chain, WalletLocation("wallet_load"), WalletDatabase::Create(path));
+    bool first_run;
+    wallet.LoadWallet(first_run);
+
+    FastRandomContext rng(true);
+    WalletBatch batch(wallet.GetDBHandle());
+    for (int i = 0; i < WALLET_LOAD_TXS; ++i) {
+        if (i % WRITES_PER_TXN == 0) batch.TxnBegin();
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(COutPoint(rng.rand256(), 0));
+        mtx.vout.emplace_back(COIN, GetScriptForDestination(CKeyID(uint160(rng.randbytes(20)))));
+        mtx.vout.emplace_back(COIN, GetScriptForDestination(CKeyID(uint160(rng.randbytes(20)))));
+        CWalletTx wtx(&wallet, MakeTransactionRef(std::move(mtx)));
+        wtx.nTimeReceived = i;
+        wtx.nOrderPos = i;
+        batch.WriteTx(wtx);
+        if (i % WRITES_PER_TXN == WRITES_PER_TXN - 1) batch.TxnCommit();
+    }
+    batch.TxnCommit();
+
+    batch.TxnBegin();
+    for (int i = 0; i < WALLET_LOAD_KEYS; ++i) {
+        CKey key;
+        key.MakeNewKey(true);
+        batch.WriteKey(key.GetPubKey(), key.GetPrivKey(), CKeyMetadata(i));
+    }
+    batch.TxnCommit();
+    return path;
+}
+
+static void WalletLoad(benchmark::State& state)
+{
+    const fs::path path = CreateBenchWallet();
+    auto chain = interfaces::MakeChain();
+    while (state.KeepRunning()) {
+        CWallet wallet(*chain, WalletLocation("wallet_load"), WalletDatabase::Create(path));
+        bool first_run;
+        DBErrors ret = wallet.LoadWallet(first_run);
+        assert(ret == DBErrors::LOAD_OK);
+        LOCK(wallet.cs_wallet);
+        assert(wallet.mapWallet.size() == (size_t)WALLET_LOAD_TXS);
+    }
+}
+
+BENCHMARK(WalletLoad, 1);
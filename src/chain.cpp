@@ -5,6 +5,13 @@
 
 #include <chain.h>
 
+#include <memusage.h>
+
+size_t CBlockIndexSlabs::DynamicMemoryUsage() const
+{
+    return memusage::MallocUsage(sizeof(CBlockIndex) * SLAB_ENTRIES) * m_slabs.size() + memusage::DynamicUsage(m_slabs);
+}
+
 /**
  * CChain implementation
  */
@@ -8,6 +8,9 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -25,12 +28,38 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every worker, and the master, has a queue of its own, which Add() spreads
+  * the verifications over. A worker takes from the back of its own queue,
+  * and when that is empty, steals from the front of the others. So workers
+  * only contend with each other when stealing, and verifications that take
+  * much longer than others don't hold up the rest of a worker's queue.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! Verifications waiting to be taken by a worker
+    struct WorkQueue
+    {
+        boost::mutex mutex;
+        std::deque<T> checks;
+    };
+
+    //! Queue 0 belongs to the master, the others to workers in the order they start
+    static const size_t MAX_QUEUES = 65;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    //! The number of queues in use, the master's and those of the started workers
+    std::atomic<size_t> nQueues{1};
+
+    //! The number of workers started, not including the master
+    std::atomic<size_t> nWorkers{0};
+
+    //! The queue Add() puts the next batch in, so batches are spread over them in turn
+    size_t nNextQueue{0};
+
+    //! Mutex only taken for sleeping and waking up
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,87 +68,113 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! The number of elements in the queues. May go below zero briefly, as
+    //! workers take elements before Add() is done counting them.
+    std::atomic<int64_t> nQueued{0};
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
-
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! The number of workers that are idle.
+    std::atomic<int> nIdle{0};
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk{true};
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo{0};
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    /**
+     * Move a batch of elements from a queue to vChecks, from the back of a
+     * worker's own queue and from the front of the queue of another.
+     */
+    bool Take(WorkQueue& queue, std::vector<T>& vChecks, bool fOwn)
+    {
+        boost::lock_guard<boost::mutex> lock(queue.mutex);
+        if (queue.checks.empty())
+            return false;
+        // Leave half of the elements, for the other workers to steal, so all
+        // workers finish approximately simultaneously.
+        const size_t nNow = std::max<size_t>(1, std::min<size_t>(nBatchSize, queue.checks.size() / 2));
+        for (size_t i = 0; i < nNow; i++) {
+            // Swap jobs out of the queue instead of copying them.
+            vChecks.emplace_back();
+            if (fOwn) {
+                vChecks.back().swap(queue.checks.back());
+                queue.checks.pop_back();
+            } else {
+                vChecks.back().swap(queue.checks.front());
+                queue.checks.pop_front();
+            }
+        }
+        nQueued -= nNow;
+        return true;
+    }
+
+    //! Take a batch from the own queue, or steal one from another
+    bool GetWork(size_t nOwn, std::vector<T>& vChecks)
+    {
+        if (Take(*queues[nOwn], vChecks, true))
+            return true;
+        const size_t n = nQueues.load();
+        for (size_t i = 1; i < n; i++) {
+            if (Take(*queues[(nOwn + i) % n], vChecks, false))
+                return true;
+        }
+        return false;
+    }
+
     /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false)
+    bool Loop(size_t nOwn, bool fMaster)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if (fMaster && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
+            if (GetWork(nOwn, vChecks)) {
+                // Check whether we need to do work at all
+                bool fOk = fAllOk;
+                for (T& check : vChecks)
+                    if (fOk)
+                        fOk = check();
+                const unsigned int nNow = vChecks.size();
+                // Destroy the checks before they count as done, the master
+                // must not return while any are left.
+                vChecks.clear();
+                if (!fOk)
+                    fAllOk = false;
+                if (nTodo.fetch_sub(nNow) == nNow && !fMaster) {
+                    // We processed the last element; inform the master it can exit and return the result
+                    boost::lock_guard<boost::mutex> lock(mutex);
+                    condMaster.notify_one();
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
+                continue;
+            }
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (fMaster) {
+                // Wait for the elements other workers took to be processed
+                while (nTodo != 0 && nQueued <= 0)
+                    condMaster.wait(lock);
+                if (nTodo == 0) {
+                    bool fRet = fAllOk;
+                    // reset the status for new work later
+                    fAllOk = true;
+                    // return the current status
+                    return fRet;
                 }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+            } else {
+                // Workers count themselves as idle before looking at nQueued,
+                // and Add() counts the elements before looking at nIdle, so
+                // one of them sees the other and no wake up is lost.
+                nIdle++;
+                while (nQueued <= 0)
+                    condWorker.wait(lock); // wait
+                nIdle--;
             }
-            // execute work
-            for (T& check : vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
         } while (true);
     }
 
@@ -128,33 +183,57 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn) : nBatchSize(nBatchSizeIn)
+    {
+        queues.reserve(MAX_QUEUES);
+        for (size_t i = 0; i < MAX_QUEUES; i++)
+            queues.emplace_back(new WorkQueue());
+    }
 
     //! Worker thread
     void Thread()
     {
-        Loop();
+        // Workers beyond the number of queues share them
+        const size_t nOwn = 1 + nWorkers++ % (MAX_QUEUES - 1);
+        size_t n = nQueues.load();
+        while (n < nOwn + 1 && !nQueues.compare_exchange_weak(n, nOwn + 1)) {}
+        Loop(nOwn, false);
     }
 
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
-        return Loop(true);
+        return Loop(0, true);
     }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty())
+            return;
         nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
+        nQueued += vChecks.size();
+
+        // Spread the batch over the queues, taking the lock of each once
+        const size_t n = nQueues.load();
+        const size_t nPerQueue = (vChecks.size() + n - 1) / n;
+        for (size_t i = 0; i < vChecks.size(); i += nPerQueue) {
+            WorkQueue& queue = *queues[nNextQueue];
+            nNextQueue = (nNextQueue + 1) % n;
+            boost::lock_guard<boost::mutex> lock(queue.mutex);
+            for (size_t j = i; j < std::min(i + nPerQueue, vChecks.size()); j++) {
+                queue.checks.emplace_back();
+                queue.checks.back().swap(vChecks[j]);
+            }
+        }
+
+        if (nIdle > 0) {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            if (vChecks.size() == 1)
+                condWorker.notify_one();
+            else
+                condWorker.notify_all();
+        }
     }
 
     ~CCheckQueue()
@@ -163,6 +242,9 @@ public:
 
 };
 
+template <typename T>
+const size_t CCheckQueue<T>::MAX_QUEUES;
+
 /**
  * RAII-style controller object for a CCheckQueue that guarantees the passed
  * queue is finished before continuing.
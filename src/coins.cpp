@@ -134,6 +134,16 @@ bool CCoinsViewCache::HaveCoinInCache(const COutPoint &outpoint) const {
     return (it != cacheCoins.end() && !it->second.coin.IsSpent());
 }
 
+void CCoinsViewCache::CacheCoin(const COutPoint &outpoint, Coin&& coin) {
+    auto inserted = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin)));
+    if (!inserted.second)
+        return;
+    if (inserted.first->second.coin.IsSpent()) {
+        inserted.first->second.flags = CCoinsCacheEntry::FRESH;
+    }
+    cachedCoinsUsage += inserted.first->second.coin.DynamicMemoryUsage();
+}
+
 uint256 CCoinsViewCache::GetBestBlock() const {
     if (hashBlock.IsNull())
         hashBlock = base->GetBestBlock();
@@ -204,7 +214,10 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
 
 bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
+    // Start over with a new pool, so the memory of the flushed entries goes
+    // back to the system instead of staying reserved for this cache
     cacheCoins.clear();
+    cacheCoins = CCoinsMap();
     cachedCoinsUsage = 0;
     return fOk;
 }
@@ -99,6 +99,12 @@ typedef char* sockopt_arg_type;
 #define USE_POLL
 #endif
 
+// epoll keeps the peer sockets registered across iterations of the socket
+// handler; poll() remains the fallback if the epoll instance can't be created
+#if defined(__linux__) && defined(HAVE_SYS_EPOLL_H)
+#define USE_EPOLL
+#endif
+
 bool static inline IsSelectableSocket(const SOCKET& s) {
 #if defined(USE_POLL) || defined(WIN32)
     return true;
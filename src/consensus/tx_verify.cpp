@@ -12,7 +12,6 @@
 #include <validation.h>
 #include <anonymous.h>
 #include <txmempool.h>
-#include <RingSignatureMgr.h>
 
 // TODO remove the following dependencies
 #include <chain.h>
@@ -251,7 +250,7 @@ bool CheckTransaction(const CTransaction& tx, CValidationState &state, bool fChe
     return true;
 }
 
-bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, int nSpendHeight, CAmount& txfee)
+bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, int nSpendHeight, CAmount& txfee, bool fCheckRingSignatures)
 {
     // are the actual inputs available?
     if (!inputs.HaveInputs(tx)) {
@@ -299,7 +298,7 @@ bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, c
         int64_t nSumAnon;
         bool    isInvalid;
 
-        if (!CheckAnonymousTxInputs(*pblocktree, tx, state, nSumAnon, isInvalid))
+        if (!CheckAnonymousTxInputs(*panondb, tx, state, nSumAnon, isInvalid, fCheckRingSignatures))
         {
             return state.DoS(100, false, REJECT_INVALID, "bad-txns-check-anon-tx-inputs");
         }
@@ -329,18 +328,13 @@ bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, c
     return true;
 }
 
-static bool CheckAnonInputAB(CBlockTreeDB& iTxDb, const CTxIn &txin, int nRingSize, std::vector<uint8_t> &vchImage, uint256 &preimage, int64_t &nCoinValue)
+static bool CheckAnonInputAB(CAnonDB& iTxDb, const CTxIn &txin, int nRingSize, const uint256 &preimage, bool fProtocolV3, bool fCheckRingSignatures, int64_t &nCoinValue)
 {
     const CScript &s = txin.scriptSig;
 
     CPubKey pkRingCoin;
     CAnonOutput ao;
 
-    ec_point pSigC;
-    pSigC.resize(EC_SECRET_SIZE);
-    std::memcpy(&pSigC[0], &s[2], EC_SECRET_SIZE);
-
-    const unsigned char *pSigS    = &s[2 + EC_SECRET_SIZE];
     const unsigned char *pPubkeys = &s[2 + EC_SECRET_SIZE + EC_SECRET_SIZE * nRingSize];
 
     for (int ri = 0; ri < nRingSize; ++ri)
@@ -369,7 +363,7 @@ static bool CheckAnonInputAB(CBlockTreeDB& iTxDb, const CTxIn &txin, int nRingSi
         }
     }
 
-    if (RingSignatureMgr::GetInstance().verifyRingSignatureAB(vchImage, preimage, nRingSize, pPubkeys, pSigC, pSigS) != 0)
+    if (fCheckRingSignatures && !VerifyAnonInputSignature(txin, preimage, fProtocolV3))
     {
         LogPrintf("CheckAnonInputsAB(): Error input %s verifyRingSignatureAB() failed.\n", txin.ToString().c_str());
         return false;
@@ -378,16 +372,18 @@ static bool CheckAnonInputAB(CBlockTreeDB& iTxDb, const CTxIn &txin, int nRingSi
     return true;
 }
 
-bool Consensus::CheckAnonymousTxInputs(CBlockTreeDB&       iTxDb,
+bool Consensus::CheckAnonymousTxInputs(CAnonDB&            iTxDb,
                                        const CTransaction& iTx,
                                        CValidationState&   oState,
                                        int64_t&            oSumValue,
-                                       bool&               oInvalid)
+                                       bool&               oInvalid,
+                                       bool                fCheckRingSignatures)
 {
     AssertLockHeld(cs_main);
 
     oSumValue = 0;
     uint256 preimage;
+    const bool fProtocolV3 = ::Params().GetConsensus().IsProtocolV3(pindexBestHeader ? pindexBestHeader->nHeight : 0);
 
     if (GetTxnPreImage(iTx, preimage) != 0)
     {
@@ -441,7 +437,7 @@ bool Consensus::CheckAnonymousTxInputs(CBlockTreeDB&       iTxDb,
         int nRingSize = txin.ExtractRingSize();
 
         if (nRingSize < 1 ||
-            nRingSize > (::Params().GetConsensus().IsProtocolV3(pindexBestHeader ? pindexBestHeader->nHeight : 0) ? (int)MAX_RING_SIZE : (int)MAX_RING_SIZE_OLD))
+            nRingSize > (fProtocolV3 ? (int)MAX_RING_SIZE : (int)MAX_RING_SIZE_OLD))
         {
             LogPrintf("CheckAnonInputs(): Error input %s ringsize %d not in range [%d, %d].\n", txin.ToString().c_str(), nRingSize, MIN_RING_SIZE, MAX_RING_SIZE);
             oInvalid = true;
@@ -451,7 +447,7 @@ bool Consensus::CheckAnonymousTxInputs(CBlockTreeDB&       iTxDb,
         if (nRingSize > 1 && s.size() == 2 + EC_SECRET_SIZE + (EC_SECRET_SIZE + EC_COMPRESSED_SIZE) * nRingSize)
         {
             // ringsig AB
-            if (!CheckAnonInputAB(iTxDb, txin, nRingSize, vchImage, preimage, nCoinValue))
+            if (!CheckAnonInputAB(iTxDb, txin, nRingSize, preimage, fProtocolV3, fCheckRingSignatures, nCoinValue))
             {
                 oInvalid = true;
                 return false;
@@ -473,8 +469,6 @@ bool Consensus::CheckAnonymousTxInputs(CBlockTreeDB&       iTxDb,
         CAnonOutput ao;
 
         const unsigned char* pPubkeys = &s[2];
-        const unsigned char* pSigc    = &s[2 + EC_COMPRESSED_SIZE * nRingSize];
-        const unsigned char* pSigr    = &s[2 + (EC_COMPRESSED_SIZE + EC_SECRET_SIZE) * nRingSize];
         for (int ri = 0; ri < nRingSize; ++ri)
         {
             pkRingCoin = CPubKey(&pPubkeys[ri * EC_COMPRESSED_SIZE], EC_COMPRESSED_SIZE);
@@ -504,7 +498,7 @@ bool Consensus::CheckAnonymousTxInputs(CBlockTreeDB&       iTxDb,
             }
         }
 
-        if (RingSignatureMgr::GetInstance().verifyRingSignature(vchImage, preimage, nRingSize, pPubkeys, pSigc, pSigr) != 0)
+        if (fCheckRingSignatures && !VerifyAnonInputSignature(txin, preimage, fProtocolV3))
         {
             LogPrintf("CheckAnonInputs(): Error input %s verifyRingSignature() failed.\n", txin.ToString().c_str());
             oInvalid = true;
@@ -13,7 +13,7 @@ class CBlockIndex;
 class CCoinsViewCache;
 class CTransaction;
 class CValidationState;
-class CBlockTreeDB;
+class CAnonDB;
 
 /** Transaction validation functions */
 
@@ -23,20 +23,26 @@ bool CheckTransaction(const CTransaction& tx, CValidationState& state, bool fChe
 namespace Consensus {
 /**
  * Check whether all inputs of this transaction are valid (no double spends and amounts)
- * This does not modify the UTXO set. This does not check scripts and sigs.
+ * This does not modify the UTXO set. This does not check scripts and sigs, other
+ * than the ring signatures of anon inputs if fCheckRingSignatures is set.
  * @param[out] txfee Set to the transaction fee if successful.
  * Preconditions: tx.IsCoinBase() is false.
  */
-bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, int nSpendHeight, CAmount& txfee);
+bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, int nSpendHeight, CAmount& txfee, bool fCheckRingSignatures = true);
 
 /**
- * TODO TSB
+ * Check the anon inputs of a transaction: that their key images are unspent,
+ * and that their ring members exist, have the same amount and are deep
+ * enough. Their ring signatures are only verified if fCheckRingSignatures is
+ * set, it is not for blocks under -assumevalid, like scripts.
+ * @param[out] oSumValue Set to the amount of the anon inputs if successful.
  */
-bool CheckAnonymousTxInputs(CBlockTreeDB&       iTxDb,
+bool CheckAnonymousTxInputs(CAnonDB&            iTxDb,
                             const CTransaction& iTx,
                             CValidationState&   oState,
                             int64_t&            oSumValue,
-                            bool&               oInvalid);
+                            bool&               oInvalid,
+                            bool                fCheckRingSignatures);
 } // namespace Consensus
 
 /** Auxiliary functions for transaction validation (ideally should not be exposed) */
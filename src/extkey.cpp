@@ -18,6 +18,10 @@
 #include <openssl/rand.h>
 #include <openssl/hmac.h>
 #include <openssl/evp.h>
+#include <crypto/common.h>
+#include <util/system.h>
+
+#include <thread>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -380,6 +384,98 @@ std::string CStoredExtKey::GetIDString58() const
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static const uint32_t MIN_LOOKAHEAD_KEYS_PER_THREAD = 100;
+
+static inline size_t KeyIDHash(const CKeyID &id)
+{
+    return ReadLE64(id.begin());
+}
+
+size_t CKeyIDTypeTable::Probe(const CKeyID &id) const
+{
+    size_t nMask = vSlots.size() - 1;
+    size_t i = KeyIDHash(id) & nMask;
+    while (vSlots[i].type != AKT_NONE && vSlots[i].id != id)
+        i = (i + 1) & nMask;
+    return i;
+}
+
+AccountKeyType CKeyIDTypeTable::Find(const CKeyID &id) const
+{
+    if (vSlots.empty())
+        return AKT_NONE;
+    return vSlots[Probe(id)].type;
+}
+
+void CKeyIDTypeTable::Reserve(size_t nCount)
+{
+    // - keep the load factor at or below 1/2
+    size_t nSize = 16;
+    while (nSize < nCount * 2)
+        nSize <<= 1;
+    if (nSize <= vSlots.size())
+        return;
+
+    std::vector<Slot> vOld(nSize);
+    vOld.swap(vSlots);
+    for (const Slot &slot : vOld)
+    {
+        if (slot.type != AKT_NONE)
+            vSlots[Probe(slot.id)] = slot;
+    }
+}
+
+void CKeyIDTypeTable::Set(const CKeyID &id, AccountKeyType type)
+{
+    assert(type != AKT_NONE);
+    Reserve(nUsed + 1);
+
+    Slot &slot = vSlots[Probe(id)];
+    if (slot.type == AKT_NONE)
+    {
+        slot.id = id;
+        nUsed++;
+    }
+    slot.type = type;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Derive the non-hardened child pubkeys nFrom .. nFrom+nCount-1 of kp,
+ * spread over several threads for large ranges.
+ * Children that can't be derived are left invalid.
+ */
+static void DeriveKeyRange(const CExtKeyPair &kp, uint32_t nFrom, uint32_t nCount, std::vector<CPubKey> &vOut)
+{
+    if ((nFrom >> 31) == 1)
+        nCount = 0;
+    else
+        nCount = std::min(nCount, (uint32_t)(1u << 31) - nFrom);
+    vOut.assign(nCount, CPubKey());
+
+    auto derive = [&kp, &vOut, nFrom](uint32_t nBegin, uint32_t nEnd)
+    {
+        for (uint32_t i = nBegin; i < nEnd; ++i)
+        {
+            CPubKey pk;
+            if (kp.Derive(pk, nFrom + i))
+                vOut[i] = pk;
+        }
+    };
+
+    uint32_t nThreads = std::max(1, std::min(GetNumCores(), (int)(nCount / MIN_LOOKAHEAD_KEYS_PER_THREAD)));
+    uint32_t nPerThread = nCount / nThreads;
+    std::vector<std::thread> threads;
+    for (uint32_t t = 1; t < nThreads; ++t)
+        threads.emplace_back(derive, t * nPerThread, t + 1 == nThreads ? nCount : (t + 1) * nPerThread);
+    derive(0, nThreads == 1 ? nCount : nPerThread);
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 std::string CExtKeyAccount::GetIDString58() const
 {
     // - 0th chain is always account chain
@@ -398,28 +494,31 @@ int CExtKeyAccount::HaveKey(const CKeyID &id, bool fUpdate, CEKAKey &ak)
 
     LOCK(cs_account);
     // - if fUpdate, promote key if found in look ahead
-    AccKeyMap::const_iterator mi = mapKeys.find(id);
-    if (mi != mapKeys.end())
-        return 1;
-
-    mi = mapLookAhead.find(id);
-    if (mi != mapLookAhead.end())
+    switch (keyTypes.Find(id))
     {
-        CBitcoinAddress addr(mi->first);
-        if (fDebug)
-            LogPrintf("HaveKey in lookAhead %s\n", addr.ToString().c_str());
-        if (fUpdate)
+        case AKT_KEY:
+        case AKT_STEALTH_CHILD:
+            return 1;
+        case AKT_LOOKAHEAD:
         {
-            ak = mi->second; // pass up for save to db
-            return 3;
+            AccKeyMap::const_iterator mi = mapLookAhead.find(id);
+            if (mi == mapLookAhead.end())
+                return 0;
+
+            CBitcoinAddress addr(mi->first);
+            if (fDebug)
+                LogPrintf("HaveKey in lookAhead %s\n", addr.ToString().c_str());
+            if (fUpdate)
+            {
+                ak = mi->second; // pass up for save to db
+                return 3;
+            }
+            return 2;
         }
-        return 2;
+        default:
+            break;
     }
 
-    AccKeySCMap::const_iterator miSck = mapStealthChildKeys.find(id);
-    if (miSck != mapStealthChildKeys.end())
-        return 1;
-
     return 0;
 }
 
@@ -429,6 +528,10 @@ bool CExtKeyAccount::GetKey(const CKeyID &id, CKey &keyOut) const
 {
     LOCK(cs_account);
 
+    AccountKeyType type = keyTypes.Find(id);
+    if (type != AKT_KEY && type != AKT_STEALTH_CHILD)
+        return false;
+
     AccKeyMap::const_iterator mi;
     AccKeySCMap::const_iterator miSck;
     if ((mi = mapKeys.find(id)) != mapKeys.end())
@@ -492,6 +595,10 @@ bool CExtKeyAccount::GetKey(const CEKASCKey &asck, CKey &keyOut) const
 bool CExtKeyAccount::GetPubKey(const CKeyID &id, CPubKey &pkOut) const
 {
     LOCK(cs_account);
+
+    AccountKeyType type = keyTypes.Find(id);
+    if (type != AKT_KEY && type != AKT_STEALTH_CHILD)
+        return false;
     AccKeyMap::const_iterator mi;
     AccKeySCMap::const_iterator miSck;
     if ((mi = mapKeys.find(id)) != mapKeys.end())
@@ -568,6 +675,7 @@ bool CExtKeyAccount::SaveKey(const CKeyID &id, CEKAKey &keyIn)
     }
 
     mapKeys[id] = keyIn;
+    keyTypes.Set(id, AKT_KEY);
 
     CStoredExtKey *pc;
     if ((pc = GetChain(keyIn.nParent)) != NULL)
@@ -627,6 +735,8 @@ bool CExtKeyAccount::SaveKey(const CKeyID &id, CEKASCKey &keyIn)
         return error("SaveKey(): CEKASCKey Stealth key not in this account!");
 
     mapStealthChildKeys[id] = keyIn;
+    if (keyTypes.Find(id) == AKT_NONE)
+        keyTypes.Set(id, AKT_STEALTH_CHILD);
 
     if (fDebug)
     {
@@ -661,10 +771,16 @@ int CExtKeyAccount::AddLookAhead(uint32_t nChain, uint32_t nKeys)
     if (fDebug)
         LogPrintf("%s: chain %s, keys %d.\n", __func__, pc->GetIDString58(), nKeys);
 
-    AccKeyMap::const_iterator mi;
     uint32_t nChild = pc->nGenerated;
     uint32_t nChildOut = nChild;
 
+    // - derive the window on all cores first, DeriveKey() below is only
+    //   needed for children outside it or that couldn't be derived
+    std::vector<CPubKey> vDerived;
+    const uint32_t nFirst = nChild;
+    DeriveKeyRange(pc->kp, nFirst, nKeys, vDerived);
+    keyTypes.Reserve(keyTypes.Size() + nKeys);
+
     CKeyID keyId;
     CPubKey pk;
     for (uint32_t k = 0; k < nKeys; ++k)
@@ -672,6 +788,11 @@ int CExtKeyAccount::AddLookAhead(uint32_t nChain, uint32_t nKeys)
         bool fGotKey = false;
         for (uint32_t i = 0; i < MAX_DERIVE_TRIES; ++i) // MAX_DERIVE_TRIES > lookahead pool
         {
+            if (nChild >= nFirst && nChild - nFirst < vDerived.size() && vDerived[nChild - nFirst].IsValid())
+            {
+                pk = vDerived[nChild - nFirst];
+                nChildOut = nChild;
+            } else
             if (pc->DeriveKey(pk, nChild, nChildOut, false) != 0)
             {
                 LogPrintf("%s: DeriveKey failed, chain %d, child %d.\n", __func__, nChain, nChild);
@@ -681,7 +802,7 @@ int CExtKeyAccount::AddLookAhead(uint32_t nChain, uint32_t nKeys)
             nChild = nChildOut+1;
 
             keyId = pk.GetID();
-            if ((mi = mapKeys.find(keyId)) != mapKeys.end())
+            if (keyTypes.Find(keyId) == AKT_KEY)
             {
                 if (fDebug)
                 {
@@ -701,6 +822,7 @@ int CExtKeyAccount::AddLookAhead(uint32_t nChain, uint32_t nKeys)
         }
 
         mapLookAhead[keyId] = CEKAKey(nChain, nChildOut);
+        keyTypes.Set(keyId, AKT_LOOKAHEAD);
 
         if (fDebug)
         {
@@ -727,18 +849,8 @@ int CExtKeyAccount::ExpandStealthChildKey(const CEKAStealthKey *aks, const ec_se
     if (!GetKey(aks->akSpend, kSpend))
         return errorN(1, "%s: GetKey() failed.");
 
-    ec_secret sSpendR;
-    ec_secret sSpend;
-
-    memcpy(&sSpend.e[0], kSpend.begin(), EC_SECRET_SIZE);
-
-    if (StealthSharedToSecretSpend(sShared, sSpend, sSpendR) != 0)
+    if (StealthSharedToSecretSpend(sShared, kSpend, kOut) != 0)
         return errorN(1, "%s: StealthSharedToSecretSpend() failed.");
-
-    kOut.Set(&sSpendR.e[0], &sSpendR.e[32], true);
-
-    if (!kOut.IsValid())
-        return errorN(1, "%s: Invalid key.");
     return 0;
 }
 
@@ -401,6 +401,52 @@ typedef std::map<CKeyID, CEKAStealthKey> AccStealthKeyMap;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Which of the key maps of an account a key id is in
+ */
+enum AccountKeyType : uint8_t
+{
+    AKT_NONE            = 0,
+    AKT_KEY             = 1, // mapKeys
+    AKT_LOOKAHEAD       = 2, // mapLookAhead
+    AKT_STEALTH_CHILD   = 3, // mapStealthChildKeys
+};
+
+/**
+ * Open addressing hash table (linear probing) from CKeyID to AccountKeyType
+ *
+ * Lets an account answer HaveKey() with a single probe sequence instead of a
+ * lookup in each of its key maps. Key ids are hash160 outputs, so their first
+ * bytes serve as the hash.
+ */
+class CKeyIDTypeTable
+{
+public:
+    AccountKeyType Find(const CKeyID &id) const;
+    void Set(const CKeyID &id, AccountKeyType type);
+    void Reserve(size_t nCount);
+
+    size_t Size() const
+    {
+        return nUsed;
+    }
+
+private:
+    struct Slot
+    {
+        CKeyID id;
+        AccountKeyType type = AKT_NONE;
+    };
+
+    // - slot holding id, or the empty slot that ends its probe sequence
+    size_t Probe(const CKeyID &id) const;
+
+    std::vector<Slot> vSlots; // size is zero or a power of two
+    size_t nUsed = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /**
  * TODO TSB
  *
@@ -531,11 +577,14 @@ public:
     }
 
     // TODO: Could store used keys in archived packs, which don't get loaded into memory
+    // Only change the key maps through SaveKey() and AddLookAhead(), which keep keyTypes in sync
     AccKeyMap mapKeys;
     AccKeyMap mapLookAhead;
 
     AccKeySCMap mapStealthChildKeys; // keys derived from stealth addresses
 
+    CKeyIDTypeTable keyTypes; // which of the maps above a key id is in
+
     AccStealthKeyMap mapStealthKeys;
     AccStealthKeyMap mapLookAheadStealth;
 
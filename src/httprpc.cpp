@@ -7,6 +7,7 @@
 #include <chainparams.h>
 #include <httpserver.h>
 #include <key_io.h>
+#include <rpc/jsonstream.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <random.h>
@@ -175,6 +176,16 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         return false;
     }
 
+    // Methods with large results may stream them into a chunked reply
+    bool chunked = false;
+    JSONStreamWriter stream([req, &chunked](const std::string& chunk) {
+        if (!chunked) {
+            req->WriteHeader("Content-Type", "application/json");
+            chunked = true;
+        }
+        return req->WriteReplyChunk(HTTP_OK, chunk);
+    });
+
     try {
         // Parse request
         UniValue valRequest;
@@ -189,23 +200,45 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            stream.BeginObject();
+            stream.Key("result");
+            jreq.stream = &stream;
             UniValue result = tableRPC.execute(jreq);
 
             // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            if (!stream.AwaitingValue()) {
+                // The method wrote its result into the stream
+                stream.KV("error", NullUniValue);
+                stream.KV("id", jreq.id);
+                stream.EndObject();
+                strReply = stream.TakeBuffer() + "\n";
+            } else {
+                strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            }
 
         // array of requests
         } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(jreq, valRequest.get_array());
+            strReply = JSONRPCExecBatch(jreq, valRequest.get_array(), RunOnIdleHTTPWorker);
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
-        req->WriteHeader("Content-Type", "application/json");
+        if (!chunked) {
+            req->WriteHeader("Content-Type", "application/json");
+        }
         req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
+        if (chunked) {
+            // Too late for an error reply, part of the result is out already
+            req->AbortReply();
+            return false;
+        }
         JSONErrorReply(req, objError, jreq.id);
         return false;
     } catch (const std::exception& e) {
+        if (chunked) {
+            req->AbortReply();
+            return false;
+        }
         JSONErrorReply(req, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
         return false;
     }
@@ -40,6 +40,24 @@
 
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
+/** Amount of chunked reply data that may wait to be sent before the worker producing it blocks */
+static const size_t MAX_CHUNKED_REPLY_QUEUE = 1024 * 1024;
+
+/** State of a chunked reply, shared between the worker thread producing it
+ * and the http thread sending it.
+ */
+class HTTPChunkedReply
+{
+public:
+    Mutex cs;
+    std::condition_variable cond;
+    /** Bytes handed to the http thread and not written to the client yet */
+    size_t queued GUARDED_BY(cs) = 0;
+    /** The client connection went away */
+    bool closed GUARDED_BY(cs) = false;
+    /** Bytes handed to evhttp since the output buffer last drained (http thread only) */
+    size_t buffered = 0;
+};
 
 /** HTTP request work item */
 class HTTPWorkItem final : public HTTPClosure
@@ -61,6 +79,22 @@ private:
     HTTPRequestHandler func;
 };
 
+/** Work item running part of the work of another request */
+class HTTPTaskWorkItem final : public HTTPClosure
+{
+public:
+    explicit HTTPTaskWorkItem(const std::function<void()>& _func) : func(_func)
+    {
+    }
+    void operator()() override
+    {
+        func();
+    }
+
+private:
+    std::function<void()> func;
+};
+
 /** Simple work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
  */
@@ -74,10 +108,13 @@ private:
     std::deque<std::unique_ptr<WorkItem>> queue;
     bool running;
     size_t maxDepth;
+    /** Number of threads waiting for work */
+    size_t numIdle;
 
 public:
     explicit WorkQueue(size_t _maxDepth) : running(true),
-                                 maxDepth(_maxDepth)
+                                 maxDepth(_maxDepth),
+                                 numIdle(0)
     {
     }
     /** Precondition: worker threads have all stopped (they have been joined).
@@ -96,6 +133,17 @@ public:
         cond.notify_one();
         return true;
     }
+    /** Enqueue a work item only if an idle thread will pick it up right away */
+    bool EnqueueIfIdle(WorkItem* item)
+    {
+        LOCK(cs);
+        if (queue.size() >= numIdle) {
+            return false;
+        }
+        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        cond.notify_one();
+        return true;
+    }
     /** Thread function */
     void Run()
     {
@@ -103,8 +151,10 @@ public:
             std::unique_ptr<WorkItem> i;
             {
                 WAIT_LOCK(cs, lock);
+                numIdle++;
                 while (running && queue.empty())
                     cond.wait(lock);
+                numIdle--;
                 if (!running)
                     break;
                 i = std::move(queue.front());
@@ -483,6 +533,19 @@ struct event_base* EventBase()
     return eventBase;
 }
 
+bool RunOnIdleHTTPWorker(const std::function<void()>& func)
+{
+    if (!workQueue) {
+        return false;
+    }
+    std::unique_ptr<HTTPTaskWorkItem> item(new HTTPTaskWorkItem(func));
+    if (!workQueue->EnqueueIfIdle(item.get())) {
+        return false;
+    }
+    item.release(); /* queue took ownership */
+    return true;
+}
+
 static void httpevent_callback_fn(evutil_socket_t, short, void* data)
 {
     // Static handler: simply call inner handler
@@ -509,6 +572,38 @@ void HTTPEvent::trigger(struct timeval* tv)
     else
         evtimer_add(ev, tv); // trigger after timeval passed
 }
+/** Re-enable reading from the socket once a reply is sent. This is the second
+ * part of the libevent workaround in http_request_cb.
+ */
+static void http_reenable_reading(evhttp_connection* conn)
+{
+    if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+        if (bev) {
+            bufferevent_enable(bev, EV_READ | EV_WRITE);
+        }
+    }
+}
+
+/** Callback for when the output buffer of a chunked reply has drained */
+static void http_chunked_reply_sent_cb(struct evhttp_connection*, void* arg)
+{
+    HTTPChunkedReply* reply = static_cast<HTTPChunkedReply*>(arg);
+    LOCK(reply->cs);
+    reply->queued -= std::min(reply->queued, reply->buffered);
+    reply->buffered = 0;
+    reply->cond.notify_all();
+}
+
+/** Callback for when the client of a chunked reply disconnects */
+static void http_chunked_reply_closed_cb(struct evhttp_connection*, void* arg)
+{
+    HTTPChunkedReply* reply = static_cast<HTTPChunkedReply*>(arg);
+    LOCK(reply->cs);
+    reply->closed = true;
+    reply->cond.notify_all();
+}
+
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
                                                        replySent(false)
 {
@@ -518,7 +613,11 @@ HTTPRequest::~HTTPRequest()
     if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
-        WriteReply(HTTP_INTERNAL, "Unhandled request");
+        if (chunkedReply) {
+            AbortReply();
+        } else {
+            WriteReply(HTTP_INTERNAL, "Unhandled request");
+        }
     }
     // evhttpd cleans up the request, as long as a reply was sent.
 }
@@ -569,6 +668,27 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
     assert(!replySent && req);
+    if (chunkedReply) {
+        // Send the remainder and finish the chunked reply
+        if (!strReply.empty()) {
+            WriteReplyChunk(nStatus, strReply);
+        }
+        auto req_copy = req;
+        auto reply = chunkedReply;
+        HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, reply]{
+            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+            if (conn) {
+                evhttp_connection_set_closecb(conn, nullptr, nullptr);
+                http_reenable_reading(conn);
+            }
+            // Also frees the request if the connection is already gone
+            evhttp_send_reply_end(req_copy);
+        });
+        ev->trigger(nullptr);
+        replySent = true;
+        req = nullptr; // transferred back to main thread
+        return;
+    }
     if (ShutdownRequested()) {
         WriteHeader("Connection", "close");
     }
@@ -581,14 +701,82 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
         evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
         // Re-enable reading from the socket. This is the second part of the libevent
         // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn) {
+            http_reenable_reading(conn);
+        }
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = nullptr; // transferred back to main thread
+}
+
+bool HTTPRequest::WriteReplyChunk(int nStatus, const std::string& strChunk)
+{
+    assert(!replySent && req);
+    if (!chunkedReply) {
+        if (ShutdownRequested()) {
+            WriteHeader("Connection", "close");
+        }
+        chunkedReply = std::make_shared<HTTPChunkedReply>();
+        auto req_copy = req;
+        auto reply = chunkedReply;
+        HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, reply, nStatus]{
             evhttp_connection* conn = evhttp_request_get_connection(req_copy);
             if (conn) {
-                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
+                evhttp_connection_set_closecb(conn, http_chunked_reply_closed_cb, reply.get());
             }
+            evhttp_send_reply_start(req_copy, nStatus, nullptr);
+        });
+        ev->trigger(nullptr);
+    }
+    {
+        WAIT_LOCK(chunkedReply->cs, lock);
+        while (!chunkedReply->closed && chunkedReply->queued > MAX_CHUNKED_REPLY_QUEUE && !ShutdownRequested()) {
+            chunkedReply->cond.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        if (chunkedReply->closed) {
+            return false;
+        }
+        chunkedReply->queued += strChunk.size();
+    }
+    // An empty chunk would terminate the reply
+    if (strChunk.empty()) {
+        return true;
+    }
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    auto req_copy = req;
+    auto reply = chunkedReply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, reply, evb]{
+        reply->buffered += evbuffer_get_length(evb);
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+        evhttp_send_reply_chunk_with_cb(req_copy, evb, http_chunked_reply_sent_cb, reply.get());
+#else
+        // No completion callback in this version, so nothing to wait for
+        evhttp_send_reply_chunk(req_copy, evb);
+        http_chunked_reply_sent_cb(nullptr, reply.get());
+#endif
+        evbuffer_free(evb);
+    });
+    ev->trigger(nullptr);
+    return true;
+}
+
+void HTTPRequest::AbortReply()
+{
+    assert(!replySent && req && chunkedReply);
+    auto req_copy = req;
+    auto reply = chunkedReply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, reply]{
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn) {
+            // Frees the request along with the connection
+            evhttp_connection_set_closecb(conn, nullptr, nullptr);
+            evhttp_connection_free(conn);
+        } else {
+            evhttp_request_free(req_copy);
         }
     });
     ev->trigger(nullptr);
@@ -8,6 +8,7 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <memory>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
@@ -17,6 +18,7 @@ struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+class HTTPChunkedReply;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -51,6 +53,11 @@ void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
  */
 struct event_base* EventBase();
 
+/** Run func on an idle HTTP worker thread, to spread the work of a single
+ * request. Returns false if no worker thread is idle.
+ */
+bool RunOnIdleHTTPWorker(const std::function<void()>& func);
+
 /** In-flight HTTP request.
  * Thin C++ wrapper around evhttp_request.
  */
@@ -59,6 +66,8 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    //! Set once the reply is being sent in chunks
+    std::shared_ptr<HTTPChunkedReply> chunkedReply;
 
 public:
     explicit HTTPRequest(struct evhttp_request* req);
@@ -112,8 +121,27 @@ public:
      *
      * @note Can be called only once. As this will give the request back to the
      * main thread, do not call any other HTTPRequest methods after calling this.
+     * If WriteReplyChunk was called before, strReply is sent as the last chunk.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Write part of a chunked HTTP reply, to be finished with WriteReply.
+     * The first call sends the headers with status nStatus, so write all
+     * headers before. Blocks while too much of the reply is still waiting to
+     * be sent to the client.
+     *
+     * @returns false when the client went away and the rest of the reply can
+     * be skipped.
+     */
+    bool WriteReplyChunk(int nStatus, const std::string& strChunk);
+
+    /**
+     * Give up on a chunked reply that cannot be completed. The connection is
+     * closed, so that the client sees a truncated reply rather than a valid
+     * one. Like WriteReply, this gives the request back to the main thread.
+     */
+    void AbortReply();
 };
 
 /** Event handler closure.
@@ -0,0 +1,295 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <anonymous.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <index/coinstatsindex.h>
+#include <txdb.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+constexpr char DB_BLOCK_HASH = 's';
+constexpr char DB_MUHASH = 'M';
+
+std::unique_ptr<CoinStatsIndex> g_coin_stats_index;
+
+/**
+ * Access to the coinstatsindex database (indexes/coinstats/)
+ *
+ * The statistics are stored by block hash, so that those of blocks that got
+ * disconnected don't have to be erased, and blocks can always find the
+ * statistics of their parent. The full set hash is only stored for the block
+ * the index is at.
+ */
+class CoinStatsIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    bool ReadStats(const uint256& block_hash, CoinStats& stats) const;
+
+    /// Read the block the index is at, and its set hash. Returns false if there is none yet.
+    bool ReadTip(uint256& block_hash, MuHash3072& muhash) const;
+
+    /// Write the statistics of a block, and make it the one the index is at.
+    bool WriteStats(const uint256& block_hash, const CoinStats& stats, const MuHash3072& muhash);
+
+    /// Make a block the one the index is at, after its child was taken out.
+    bool WriteTip(const uint256& block_hash, const MuHash3072& muhash);
+};
+
+CoinStatsIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "coinstats", n_cache_size, f_memory, f_wipe)
+{}
+
+bool CoinStatsIndex::DB::ReadStats(const uint256& block_hash, CoinStats& stats) const
+{
+    return Read(std::make_pair(DB_BLOCK_HASH, block_hash), stats);
+}
+
+bool CoinStatsIndex::DB::ReadTip(uint256& block_hash, MuHash3072& muhash) const
+{
+    std::pair<uint256, MuHash3072> tip;
+    if (!Read(DB_MUHASH, tip)) {
+        return false;
+    }
+    block_hash = tip.first;
+    muhash = tip.second;
+    return true;
+}
+
+bool CoinStatsIndex::DB::WriteStats(const uint256& block_hash, const CoinStats& stats, const MuHash3072& muhash)
+{
+    CDBBatch batch(*this);
+    batch.Write(std::make_pair(DB_BLOCK_HASH, block_hash), stats);
+    batch.Write(DB_MUHASH, std::make_pair(block_hash, muhash));
+    return WriteBatch(batch);
+}
+
+bool CoinStatsIndex::DB::WriteTip(const uint256& block_hash, const MuHash3072& muhash)
+{
+    return Write(DB_MUHASH, std::make_pair(block_hash, muhash));
+}
+
+static void TxOutSer(CDataStream& ss, const COutPoint& outpoint, const Coin& coin)
+{
+    ss << outpoint;
+    ss << static_cast<uint32_t>(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+}
+
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    TxOutSer(ss, outpoint, coin);
+    muhash.Insert((const unsigned char*)ss.data(), ss.size());
+}
+
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    TxOutSer(ss, outpoint, coin);
+    muhash.Remove((const unsigned char*)ss.data(), ss.size());
+}
+
+static uint64_t GetBogoSize(const CScript& scriptPubKey)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + scriptPubKey.size() /* scriptPubKey */;
+}
+
+/** The denomination of an anon input, which all members of its ring share */
+static bool GetAnonInputValue(const CTxIn& txin, CAmount& nValue)
+{
+    std::vector<CPubKey> vRingPubkeys;
+    CAnonOutput ao;
+    if (!ExtractRingPubkeys(txin, vRingPubkeys) || !panondb->ReadAnonOutput(vRingPubkeys.front(), ao)) {
+        return false;
+    }
+    nValue = ao.nValue;
+    return true;
+}
+
+bool ApplyBlock(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockundo,
+                MuHash3072& muhash, CoinStats* stats)
+{
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        const CTransaction& tx = *block.vtx[i];
+
+        // Same as AddCoins(), unspendable outputs never make it into the set.
+        // Anon outputs aren't unspendable and stay in the set for good, as
+        // their spends only write key images, so they are counted like any
+        // other coin and per denomination on top.
+        for (size_t o = 0; o < tx.vout.size(); ++o) {
+            const CTxOut& out = tx.vout[o];
+            if (stats && out.IsAnonOutput()) {
+                ++stats->mapAnonSupply[out.nValue];
+            }
+            if (out.scriptPubKey.IsUnspendable()) {
+                continue;
+            }
+            ApplyCoinHash(muhash, COutPoint(tx.GetHash(), o), Coin(out, pindex->nHeight, tx.IsCoinBase(), tx.IsCoinStake()));
+            if (stats) {
+                ++stats->nTransactionOutputs;
+                stats->nTotalAmount += out.nValue;
+                stats->nBogoSize += GetBogoSize(out.scriptPubKey);
+            }
+        }
+
+        if (tx.IsCoinBase()) {
+            continue;
+        }
+
+        // The undo data has a coin for every input but the anon ones
+        const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+        size_t nUndo = 0;
+        for (const CTxIn& txin : tx.vin) {
+            if (tx.IsAnon() && txin.IsAnonInput()) {
+                if (stats) {
+                    CAmount nValue;
+                    if (!GetAnonInputValue(txin, nValue)) {
+                        return error("%s: cannot read anon input value of %s", __func__, tx.GetHash().ToString());
+                    }
+                    if (--stats->mapAnonSupply[nValue] == 0) {
+                        stats->mapAnonSupply.erase(nValue);
+                    }
+                }
+                continue;
+            }
+            if (nUndo >= txundo.vprevout.size()) {
+                return error("%s: transaction %s and undo data inconsistent", __func__, tx.GetHash().ToString());
+            }
+            const Coin& coin = txundo.vprevout[nUndo++];
+            RemoveCoinHash(muhash, txin.prevout, coin);
+            if (stats) {
+                --stats->nTransactionOutputs;
+                stats->nTotalAmount -= coin.out.nValue;
+                stats->nBogoSize -= GetBogoSize(coin.out.scriptPubKey);
+            }
+        }
+    }
+    return true;
+}
+
+/** Read the undo data of a block, which the genesis block has none of */
+static bool ReadUndo(const CBlock& block, const CBlockIndex* pindex, CBlockUndo& blockundo)
+{
+    if (pindex->nHeight == 0) {
+        return true;
+    }
+    if (!UndoReadFromDisk(blockundo, pindex)) {
+        return error("%s: cannot read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size()) {
+        return error("%s: block %s and undo data inconsistent", __func__, pindex->GetBlockHash().ToString());
+    }
+    return true;
+}
+
+CoinStatsIndex::CoinStatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<CoinStatsIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+CoinStatsIndex::~CoinStatsIndex() {}
+
+bool CoinStatsIndex::Init()
+{
+    uint256 tip_hash;
+    if (m_db->ReadTip(tip_hash, m_muhash)) {
+        {
+            LOCK(cs_main);
+            m_tip = LookupBlockIndex(tip_hash);
+        }
+        if (!m_tip || !m_db->ReadStats(tip_hash, m_stats)) {
+            return error("%s: cannot read the statistics of block %s", __func__, tip_hash.ToString());
+        }
+    }
+
+    return BaseIndex::Init();
+}
+
+bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // Take out the blocks of a branch that is no longer active, or that were
+    // added after the best block locator was last written
+    while (m_tip && m_tip != pindex->pprev) {
+        if (!ReverseBlock()) {
+            return false;
+        }
+    }
+    if (m_tip != pindex->pprev) {
+        return error("%s: block %s does not connect to the indexed chain", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    CBlockUndo blockundo;
+    if (!ReadUndo(block, pindex, blockundo)) {
+        return false;
+    }
+    CoinStats stats = m_stats;
+    MuHash3072 muhash;
+    if (pindex->nHeight > 0 && !ApplyBlock(block, pindex, blockundo, muhash, &stats)) {
+        return false;
+    }
+
+    MuHash3072 muhash_new = m_muhash;
+    muhash_new *= muhash;
+    stats.muhash = muhash_new.Finalize();
+    if (!m_db->WriteStats(pindex->GetBlockHash(), stats, muhash_new)) {
+        return error("%s: cannot write the statistics of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    m_tip = pindex;
+    m_muhash = muhash_new;
+    m_stats = stats;
+    return true;
+}
+
+bool CoinStatsIndex::ReverseBlock()
+{
+    CBlock block;
+    if (!ReadBlockFromDisk(block, m_tip, Params().GetConsensus())) {
+        return error("%s: cannot read block %s", __func__, m_tip->GetBlockHash().ToString());
+    }
+    CBlockUndo blockundo;
+    if (!ReadUndo(block, m_tip, blockundo)) {
+        return false;
+    }
+
+    MuHash3072 muhash;
+    if (m_tip->nHeight > 0 && !ApplyBlock(block, m_tip, blockundo, muhash, nullptr)) {
+        return false;
+    }
+    MuHash3072 muhash_new = m_muhash;
+    muhash_new /= muhash;
+
+    // The statistics of the parent are still there, check they match up
+    CoinStats stats;
+    if (m_tip->pprev) {
+        if (!m_db->ReadStats(m_tip->pprev->GetBlockHash(), stats)) {
+            return error("%s: cannot read the statistics of block %s", __func__, m_tip->pprev->GetBlockHash().ToString());
+        }
+        if (stats.muhash != muhash_new.Finalize()) {
+            return error("%s: set hash of block %s does not match", __func__, m_tip->pprev->GetBlockHash().ToString());
+        }
+        if (!m_db->WriteTip(m_tip->pprev->GetBlockHash(), muhash_new)) {
+            return error("%s: cannot write the set hash of block %s", __func__, m_tip->pprev->GetBlockHash().ToString());
+        }
+    } else if (!m_db->Erase(DB_MUHASH)) {
+        return error("%s: cannot erase the set hash", __func__);
+    }
+
+    m_tip = m_tip->pprev;
+    m_muhash = muhash_new;
+    m_stats = stats;
+    return true;
+}
+
+BaseIndex::DB& CoinStatsIndex::GetDB() const { return *m_db; }
+
+bool CoinStatsIndex::LookUpStats(const CBlockIndex* block_index, CoinStats& stats) const
+{
+    return m_db->ReadStats(block_index->GetBlockHash(), stats);
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_COINSTATSINDEX_H
+#define BITCOIN_INDEX_COINSTATSINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <index/base.h>
+#include <muhash.h>
+#include <serialize.h>
+
+#include <map>
+
+class CBlock;
+class CBlockUndo;
+class Coin;
+class COutPoint;
+
+/** Statistics about the unspent transaction output set as of a block */
+struct CoinStats
+{
+    //! Hash of the set of unspent outputs
+    uint256 muhash;
+    uint64_t nTransactionOutputs{0};
+    uint64_t nBogoSize{0};
+    CAmount nTotalAmount{0};
+    //! Number of anon outputs less the number of their key images spent, by denomination
+    std::map<CAmount, int64_t> mapAnonSupply;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(muhash);
+        READWRITE(VARINT(nTransactionOutputs));
+        READWRITE(VARINT(nBogoSize));
+        READWRITE(VARINT(nTotalAmount, VarIntMode::NONNEGATIVE_SIGNED));
+        READWRITE(mapAnonSupply);
+    }
+};
+
+/** Add an unspent output to the hash of a set */
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+/** Remove an unspent output from the hash of a set */
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+/**
+ * Add the outputs a block creates to muhash and remove the ones it spends.
+ * Also update stats for them, unless it is null.
+ */
+bool ApplyBlock(const CBlock& block, const CBlockIndex* pindex, const CBlockUndo& blockundo,
+                MuHash3072& muhash, CoinStats* stats);
+
+/**
+ * CoinStatsIndex keeps the statistics of the unspent transaction output set
+ * for every block, so that they don't need a walk over the chainstate.
+ *
+ * The statistics of a block are those of its parent, updated for the outputs
+ * it creates and the ones it spends, which are read from its undo data. The
+ * set hash is a MuHash3072, kept in full for the best block only. When a block
+ * connects to another block than the best one, after a reorg, the blocks of
+ * the old branch are taken out of it again first.
+ */
+class CoinStatsIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    //! The block the set hash and statistics below are for
+    const CBlockIndex* m_tip{nullptr};
+    MuHash3072 m_muhash;
+    CoinStats m_stats;
+
+    /** Undo the changes of the block at m_tip to the set hash, and step m_tip back to its parent */
+    bool ReverseBlock();
+
+protected:
+    bool Init() override;
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "coinstatsindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit CoinStatsIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~CoinStatsIndex() override;
+
+    /// Look up the statistics of the unspent transaction output set as of a block.
+    bool LookUpStats(const CBlockIndex* block_index, CoinStats& stats) const;
+};
+
+/// The global UTXO set statistics index. May be null.
+extern std::unique_ptr<CoinStatsIndex> g_coin_stats_index;
+
+#endif // BITCOIN_INDEX_COINSTATSINDEX_H
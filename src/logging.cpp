@@ -4,8 +4,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <logging.h>
+#include <util/system.h>
 #include <util/time.h>
 
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+
 const char * const DEFAULT_DEBUGLOGFILE = "debug.log";
 
 /**
@@ -25,11 +30,97 @@ BCLog::Logger* const g_logger = new BCLog::Logger();
 
 bool fLogIPs = DEFAULT_LOGIPS;
 
+//! Number of log records that can wait for the writer thread
+static const size_t LOG_RING_SIZE = 1 << 13;
+//! How often the writer thread writes out what was logged, if not woken up before
+static const int64_t LOG_WRITE_INTERVAL_MS = 50;
+
 static int FileWriteStr(const std::string &str, FILE *fp)
 {
     return fwrite(str.data(), 1, str.size(), fp);
 }
 
+/**
+ * Bounded queue of log records, which any number of threads can add to
+ * without taking a lock. Only one thread at a time may take records out.
+ *
+ * Every slot has a sequence number, which tells whether it is free for the
+ * record at a position (it equals the position), or holds that record (it
+ * equals the position plus one). A producer claims a position by advancing
+ * m_push_pos, and publishes the record by bumping the sequence number.
+ */
+class BCLog::RecordRing
+{
+private:
+    struct Slot {
+        std::atomic<size_t> m_seq;
+        std::string m_record;
+    };
+    std::unique_ptr<Slot[]> m_slots;
+    std::atomic<size_t> m_push_pos{0};
+    std::atomic<size_t> m_pop_pos{0};
+
+public:
+    RecordRing() : m_slots(new Slot[LOG_RING_SIZE])
+    {
+        for (size_t i = 0; i < LOG_RING_SIZE; ++i) {
+            m_slots[i].m_seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /** Add a record, unless the ring is full */
+    bool Push(std::string&& record)
+    {
+        size_t pos = m_push_pos.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = m_slots[pos % LOG_RING_SIZE];
+            const size_t seq = slot.m_seq.load(std::memory_order_acquire);
+            if (seq == pos) {
+                if (m_push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.m_record = std::move(record);
+                    slot.m_seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (seq < pos) {
+                // The slot still holds the record from a round ago
+                return false;
+            } else {
+                pos = m_push_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /** Append the next record to out, if there is one. Only one thread may pop at a time. */
+    bool Pop(std::string& out)
+    {
+        const size_t pos = m_pop_pos.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[pos % LOG_RING_SIZE];
+        if (slot.m_seq.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        out += slot.m_record;
+        slot.m_record.clear();
+        slot.m_seq.store(pos + LOG_RING_SIZE, std::memory_order_release);
+        m_pop_pos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    size_t Size() const
+    {
+        return m_push_pos.load(std::memory_order_relaxed) - m_pop_pos.load(std::memory_order_relaxed);
+    }
+};
+
+BCLog::Logger::Logger() : m_ring(new RecordRing()) {}
+
+BCLog::Logger::~Logger()
+{
+    StopWriterThread();
+    if (m_fileout) {
+        fclose(m_fileout);
+    }
+}
+
 bool BCLog::Logger::OpenDebugLog()
 {
     std::lock_guard<std::mutex> scoped_lock(m_file_mutex);
@@ -123,6 +214,17 @@ const CLogCategoryDesc LogCategories[] =
     {BCLog::ALL, "all"},
 };
 
+/** Name of a single log category */
+static std::string LogCategoryToStr(BCLog::LogFlags flag)
+{
+    for (const CLogCategoryDesc& category_desc : LogCategories) {
+        if (category_desc.flag == flag) {
+            return category_desc.category;
+        }
+    }
+    return "unknown";
+}
+
 bool GetLogCategory(BCLog::LogFlags& flag, const std::string& str)
 {
     if (str == "") {
@@ -198,13 +300,41 @@ std::string BCLog::Logger::LogTimestampStr(const std::string &str)
     return strStamped;
 }
 
-void BCLog::Logger::LogPrintStr(const std::string &str)
+void BCLog::Logger::LogPrintStr(const std::string &str, bool fQueue)
 {
     std::string strTimestamped = LogTimestampStr(str);
 
+    if (fQueue) {
+        // StopWriterThread() waits for m_pushing to drop to zero before it
+        // writes out the ring for the last time
+        ++m_pushing;
+        if (m_async) {
+            if (!m_ring->Push(std::move(strTimestamped))) {
+                ++m_dropped;
+            } else if (m_ring->Size() > LOG_RING_SIZE / 2) {
+                // Don't wait for the next interval when the ring fills up
+                m_writer_cond.notify_one();
+            }
+            --m_pushing;
+            return;
+        }
+        --m_pushing;
+    }
+    if (m_async) {
+        // The records queued before this one go first
+        std::lock_guard<std::mutex> flush_lock(m_flush_mutex);
+        FlushLocked();
+        WriteStr(strTimestamped);
+        return;
+    }
+    WriteStr(strTimestamped);
+}
+
+void BCLog::Logger::WriteStr(const std::string &str)
+{
     if (m_print_to_console) {
         // print to console
-        fwrite(strTimestamped.data(), 1, strTimestamped.size(), stdout);
+        fwrite(str.data(), 1, str.size(), stdout);
         fflush(stdout);
     }
     if (m_print_to_file) {
@@ -212,7 +342,7 @@ void BCLog::Logger::LogPrintStr(const std::string &str)
 
         // buffer if we haven't opened the log yet
         if (m_fileout == nullptr) {
-            m_msgs_before_open.push_back(strTimestamped);
+            m_msgs_before_open.push_back(str);
         }
         else
         {
@@ -226,11 +356,136 @@ void BCLog::Logger::LogPrintStr(const std::string &str)
                     m_fileout = new_fileout;
                 }
             }
-            FileWriteStr(strTimestamped, m_fileout);
+            FileWriteStr(str, m_fileout);
         }
     }
 }
 
+void BCLog::Logger::Flush()
+{
+    std::lock_guard<std::mutex> flush_lock(m_flush_mutex);
+    FlushLocked();
+}
+
+bool BCLog::Logger::TryFlush()
+{
+    for (int i = 0; i < 100; ++i) {
+        if (m_flush_mutex.try_lock()) {
+            FlushLocked();
+            m_flush_mutex.unlock();
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+void BCLog::Logger::FlushLocked()
+{
+    std::string batch;
+    while (m_ring->Pop(batch)) {}
+
+    const uint64_t dropped = m_dropped.load();
+    if (dropped != m_dropped_reported) {
+        batch += strprintf("%s Dropped %u log messages, the writer could not keep up\n",
+            FormatISO8601DateTime(GetSystemTimeInSeconds()), dropped - m_dropped_reported);
+        m_dropped_reported = dropped;
+    }
+    if (!batch.empty()) {
+        WriteStr(batch);
+    }
+}
+
+void BCLog::Logger::WriterThread()
+{
+    RenameThread("bitcoin-log");
+    std::unique_lock<std::mutex> lock(m_writer_mutex);
+    while (!m_writer_stop) {
+        m_writer_cond.wait_for(lock, std::chrono::milliseconds(LOG_WRITE_INTERVAL_MS));
+        lock.unlock();
+        Flush();
+        lock.lock();
+    }
+}
+
+static std::terminate_handler g_prev_terminate_handler = nullptr;
+
+/** Write out the queued log records before the process goes down */
+static void FlushLogOnTerminate()
+{
+    // The writer thread may be the one terminating, in the middle of a flush
+    g_logger->TryFlush();
+    if (g_prev_terminate_handler) {
+        g_prev_terminate_handler();
+    }
+    std::abort();
+}
+
+static void FlushLogOnExit()
+{
+    g_logger->StopWriterThread();
+}
+
+void BCLog::Logger::StartWriterThread()
+{
+    if (m_writer_thread.joinable()) return;
+
+    static std::once_flag handlers_installed;
+    std::call_once(handlers_installed, [] {
+        g_prev_terminate_handler = std::set_terminate(FlushLogOnTerminate);
+        std::atexit(FlushLogOnExit);
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(m_writer_mutex);
+        m_writer_stop = false;
+    }
+    m_writer_thread = std::thread(&BCLog::Logger::WriterThread, this);
+    m_async = true;
+}
+
+void BCLog::Logger::StopWriterThread()
+{
+    if (!m_writer_thread.joinable()) return;
+
+    m_async = false;
+    {
+        std::lock_guard<std::mutex> lock(m_writer_mutex);
+        m_writer_stop = true;
+    }
+    m_writer_cond.notify_one();
+    m_writer_thread.join();
+    // What was queued after the thread's last round, including by threads
+    // that saw m_async just before it was cleared
+    while (m_pushing > 0) {
+        std::this_thread::yield();
+    }
+    Flush();
+}
+
+bool BCLog::Logger::WithinRateLimit(BCLog::LogFlags category)
+{
+    if (m_category_rate_limit == 0) return true;
+
+    int bit = 0;
+    while (bit < 31 && !((category >> bit) & 1)) ++bit;
+    CategoryRate& rate = m_category_rates[bit];
+
+    const int64_t now = GetSystemTimeInSeconds();
+    int64_t second = rate.m_second.load(std::memory_order_relaxed);
+    if (second != now && rate.m_second.compare_exchange_strong(second, now)) {
+        rate.m_count = 0;
+        const uint32_t suppressed = rate.m_suppressed.exchange(0);
+        if (suppressed > 0) {
+            LogPrintf("Suppressed %u %s messages, more than %u were logged in a second\n",
+                suppressed, LogCategoryToStr(category), m_category_rate_limit);
+        }
+    }
+    if (++rate.m_count <= m_category_rate_limit) return true;
+    ++rate.m_suppressed;
+    return false;
+}
+
 void BCLog::Logger::ShrinkDebugFile()
 {
     // Amount of debug.log to save at end when shrinking (must fit in memory)
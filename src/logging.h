@@ -10,15 +10,21 @@
 #include <tinyformat.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 static const bool DEFAULT_LOGTIMEMICROS = false;
 static const bool DEFAULT_LOGIPS        = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
+static const bool DEFAULT_LOGASYNC      = true;
+//! Default for -logratelimit, the number of messages per second a debug category may log (0 = no limit)
+static const unsigned int DEFAULT_LOGRATELIMIT = 0;
 extern const char * const DEFAULT_DEBUGLOGFILE;
 
 extern bool fLogIPs;
@@ -56,6 +62,8 @@ namespace BCLog {
         ALL         = ~(uint32_t)0,
     };
 
+    class RecordRing;
+
     class Logger
     {
     private:
@@ -63,6 +71,35 @@ namespace BCLog {
         std::mutex m_file_mutex;
         std::list<std::string> m_msgs_before_open;
 
+        /**
+         * While the writer thread runs, debug category records are put in
+         * m_ring and written out in batches by that thread, instead of by the
+         * thread that logs them. Records that don't fit in the ring are
+         * dropped and counted in m_dropped.
+         */
+        std::unique_ptr<RecordRing> m_ring;
+        std::atomic<bool> m_async{false};
+        //! Threads between checking m_async and having queued their record
+        std::atomic<int> m_pushing{0};
+        std::atomic<uint64_t> m_dropped{0};
+        //! Taken by whoever takes records out of m_ring
+        std::mutex m_flush_mutex;
+        //! Part of m_dropped that was reported in the log already
+        uint64_t m_dropped_reported = 0;
+
+        std::thread m_writer_thread;
+        std::mutex m_writer_mutex;
+        std::condition_variable m_writer_cond;
+        bool m_writer_stop = false;
+
+        //! Number of messages a debug category logged in the current second, and how many it had to leave out
+        struct CategoryRate {
+            std::atomic<int64_t> m_second{0};
+            std::atomic<uint32_t> m_count{0};
+            std::atomic<uint32_t> m_suppressed{0};
+        };
+        CategoryRate m_category_rates[32];
+
         /**
          * m_started_new_line is a state variable that will suppress printing of
          * the timestamp when multiple calls are made that don't end in a
@@ -75,18 +112,57 @@ namespace BCLog {
 
         std::string LogTimestampStr(const std::string& str);
 
+        /** Write a string to the console and the debug log file */
+        void WriteStr(const std::string& str);
+
+        void WriterThread();
+
+        void FlushLocked();
+
     public:
+        Logger();
+        ~Logger();
+
         bool m_print_to_console = false;
         bool m_print_to_file = false;
 
         bool m_log_timestamps = DEFAULT_LOGTIMESTAMPS;
         bool m_log_time_micros = DEFAULT_LOGTIMEMICROS;
 
+        //! Messages per second a debug category may log, 0 for no limit
+        unsigned int m_category_rate_limit = DEFAULT_LOGRATELIMIT;
+
         fs::path m_file_path;
         std::atomic<bool> m_reopen_file{false};
 
-        /** Send a string to the log output */
-        void LogPrintStr(const std::string &str);
+        /**
+         * Send a string to the log output. If fQueue is set and the writer
+         * thread runs, it is left for that thread to write. Otherwise it is
+         * written before returning, after whatever was queued before it.
+         */
+        void LogPrintStr(const std::string &str, bool fQueue = false);
+
+        /**
+         * Write the debug category records from a background thread from now
+         * on, so that debug logging does not wait for the console or the
+         * disk. Queued records are written out when the thread stops, on exit
+         * and on std::terminate, but not when the process aborts; LogPrintf()
+         * records are always written right away so that those describing a
+         * crash make it to the log.
+         */
+        void StartWriterThread();
+        void StopWriterThread();
+
+        /** Write out the records the writer thread has not gotten to yet */
+        void Flush();
+        /** Like Flush(), but give up after a second if another thread is flushing */
+        bool TryFlush();
+
+        /** Number of records that were dropped because the writer thread fell behind */
+        uint64_t GetDroppedCount() const { return m_dropped.load(); }
+
+        /** Returns whether a message of category fits in its rate limit, and counts it */
+        bool WithinRateLimit(LogFlags category);
 
         /** Returns whether logs will be written to any output */
         bool Enabled() const { return m_print_to_console || m_print_to_file; }
@@ -129,8 +205,10 @@ bool GetLogCategory(BCLog::LogFlags& flag, const std::string& str);
 // unconditionally log to debug.log! It should not be the case that an inbound
 // peer can fill up a user's disk with debug.log entries.
 
+namespace BCLog {
+/** Format a message and log it, queued for the writer thread if fQueue is set */
 template <typename... Args>
-static inline void LogPrintf(const char* fmt, const Args&... args)
+static inline void LogFormat(bool fQueue, const char* fmt, const Args&... args)
 {
     if (g_logger->Enabled()) {
         std::string log_msg;
@@ -140,15 +218,22 @@ static inline void LogPrintf(const char* fmt, const Args&... args)
             /* Original format string will have newline so don't add one here */
             log_msg = "Error \"" + std::string(fmterr.what()) + "\" while formatting log message: " + fmt;
         }
-        g_logger->LogPrintStr(log_msg);
+        g_logger->LogPrintStr(log_msg, fQueue);
     }
 }
+} // namespace BCLog
+
+template <typename... Args>
+static inline void LogPrintf(const char* fmt, const Args&... args)
+{
+    BCLog::LogFormat(false, fmt, args...);
+}
 
 template <typename... Args>
 static inline void LogPrint(const BCLog::LogFlags& category, const Args&... args)
 {
-    if (LogAcceptCategory((category))) {
-        LogPrintf(args...);
+    if (LogAcceptCategory((category)) && g_logger->WithinRateLimit(category)) {
+        BCLog::LogFormat(true, args...);
     }
 }
 
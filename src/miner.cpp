@@ -146,24 +146,15 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    indexed_modified_transaction_set mapModifiedTx;
+    addPackageTxs(mapModifiedTx, nPackagesSelected, nDescendantsUpdated);
 
     int64_t nTime1 = GetTimeMicros();
 
     nLastBlockTx = nBlockTx;
     nLastBlockWeight = nBlockWeight;
 
-    // Create coinbase transaction.
-    CMutableTransaction coinbaseTx;
-    coinbaseTx.vin.resize(1);
-    coinbaseTx.vin[0].prevout.SetNull();
-    coinbaseTx.vout.resize(1);
-    coinbaseTx.vout[0].scriptPubKey = scriptPubKeyIn;
-    coinbaseTx.vout[0].nValue = nFees + GetBlockSubsidy(nHeight, chainparams.GetConsensus());
-    coinbaseTx.vin[0].scriptSig = CScript() << nHeight << OP_0;
-    pblock->vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
-    pblocktemplate->vchCoinbaseCommitment = GenerateCoinbaseCommitment(*pblock, pindexPrev, chainparams.GetConsensus());
-    pblocktemplate->vTxFees[0] = -nFees;
+    CreateCoinbase(scriptPubKeyIn, pindexPrev);
 
     LogPrintf("CreateNewBlock(): block weight: %u txs: %u fees: %ld sigops %d\n", GetBlockWeight(*pblock), nBlockTx, nFees, nBlockSigOpsCost);
 
@@ -185,6 +176,93 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     return std::move(pblocktemplate);
 }
 
+std::unique_ptr<CBlockTemplate> BlockAssembler::UpdateNewBlock(const CBlockTemplate& blocktemplate)
+{
+    int64_t nTimeStart = GetTimeMicros();
+
+    resetBlock();
+
+    pblocktemplate.reset(new CBlockTemplate(blocktemplate));
+    pblock = &pblocktemplate->block; // pointer for convenience
+
+    LOCK2(cs_main, mempool.cs);
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    assert(pindexPrev != nullptr);
+    if (pblock->hashPrevBlock != pindexPrev->GetBlockHash())
+        return nullptr;
+    nHeight = pindexPrev->nHeight + 1;
+
+    const int64_t nMedianTimePast = pindexPrev->GetMedianTimePast();
+    nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+                       ? nMedianTimePast
+                       : pblock->GetBlockTime();
+    fIncludeWitness = IsWitnessEnabled(pindexPrev, chainparams.GetConsensus());
+
+    // Pick up where the template was left, as long as all of its
+    // transactions are still in the mempool
+    for (size_t i = 1; i < pblock->vtx.size(); ++i) {
+        CTxMemPool::txiter iter = mempool.mapTx.find(pblock->vtx[i]->GetHash());
+        if (iter == mempool.mapTx.end())
+            return nullptr;
+        nBlockWeight += iter->GetTxWeight();
+        ++nBlockTx;
+        nBlockSigOpsCost += iter->GetSigOpCost();
+        nFees += iter->GetFee();
+        inBlock.insert(iter);
+    }
+
+    // Better paying transactions only make it into a block that is close to
+    // full by replacing others, which takes a new template
+    if (nBlockWeight > nBlockMaxWeight - 4000)
+        return nullptr;
+
+    // Selection still walks the whole mempool, skipping what is inBlock.
+    // Descendants of the template's transactions have to be scored net of
+    // their in-block ancestors, so seed the modified set with them first.
+    const uint64_t nBlockTxBefore = nBlockTx;
+    int nPackagesSelected = 0;
+    indexed_modified_transaction_set mapModifiedTx;
+    int nDescendantsUpdated = UpdatePackagesForAdded(inBlock, mapModifiedTx);
+    addPackageTxs(mapModifiedTx, nPackagesSelected, nDescendantsUpdated);
+
+    int64_t nTime1 = GetTimeMicros();
+
+    if (nBlockTx == nBlockTxBefore)
+        return std::move(pblocktemplate);
+
+    nLastBlockTx = nBlockTx;
+    nLastBlockWeight = nBlockWeight;
+
+    CreateCoinbase(pblock->vtx[0]->vout[0].scriptPubKey, pindexPrev);
+
+    // The transactions that were in the template already have their scripts
+    // and ring signatures in the validation caches, so this is mostly about
+    // the added ones
+    CValidationState state;
+    if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+        throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+    }
+    int64_t nTime2 = GetTimeMicros();
+
+    LogPrint(BCLog::BENCH, "UpdateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+
+    return std::move(pblocktemplate);
+}
+
+void BlockAssembler::CreateCoinbase(const CScript& scriptPubKeyIn, const CBlockIndex* pindexPrev)
+{
+    CMutableTransaction coinbaseTx;
+    coinbaseTx.vin.resize(1);
+    coinbaseTx.vin[0].prevout.SetNull();
+    coinbaseTx.vout.resize(1);
+    coinbaseTx.vout[0].scriptPubKey = scriptPubKeyIn;
+    coinbaseTx.vout[0].nValue = nFees + GetBlockSubsidy(nHeight, chainparams.GetConsensus());
+    coinbaseTx.vin[0].scriptSig = CScript() << nHeight << OP_0;
+    pblock->vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
+    pblocktemplate->vchCoinbaseCommitment = GenerateCoinbaseCommitment(*pblock, pindexPrev, chainparams.GetConsensus());
+    pblocktemplate->vTxFees[0] = -nFees;
+}
+
 void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
 {
     for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
@@ -305,18 +383,11 @@ void BlockAssembler::SortForBlock(const CTxMemPool::setEntries& package, std::ve
 // Each time through the loop, we compare the best transaction in
 // mapModifiedTxs with the next transaction in the mempool to decide what
 // transaction package to work on next.
-void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpdated)
+void BlockAssembler::addPackageTxs(indexed_modified_transaction_set &mapModifiedTx, int &nPackagesSelected, int &nDescendantsUpdated)
 {
-    // mapModifiedTx will store sorted packages after they are modified
-    // because some of their txs are already in the block
-    indexed_modified_transaction_set mapModifiedTx;
     // Keep track of entries that failed inclusion, to avoid duplicate work
     CTxMemPool::setEntries failedTx;
 
-    // Start by adding all descendants of previously added txs to mapModifiedTx
-    // and modifying them for their already included ancestors
-    UpdatePackagesForAdded(inBlock, mapModifiedTx);
-
     CTxMemPool::indexed_transaction_set::index<ancestor_score>::type::iterator mi = mempool.mapTx.get<ancestor_score>().begin();
     CTxMemPool::txiter iter;
 
@@ -158,6 +158,11 @@ public:
 
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn);
+    /** Construct a copy of blocktemplate and fill it up from the mempool,
+      * keeping the transactions it already has. Returns nullptr if it can't
+      * be brought up to date that way, because the tip changed, some of its
+      * transactions left the mempool, or it is close to full. */
+    std::unique_ptr<CBlockTemplate> UpdateNewBlock(const CBlockTemplate& blocktemplate);
 
 private:
     // utility functions
@@ -165,12 +170,16 @@ private:
     void resetBlock();
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
+    /** Create the coinbase tx, paying the subsidy and nFees to scriptPubKeyIn */
+    void CreateCoinbase(const CScript& scriptPubKeyIn, const CBlockIndex* pindexPrev);
 
     // Methods for how to add transactions to a block.
     /** Add transactions based on feerate including unconfirmed ancestors
       * Increments nPackagesSelected / nDescendantsUpdated with corresponding
-      * statistics from the package selection (for logging statistics). */
-    void addPackageTxs(int &nPackagesSelected, int &nDescendantsUpdated) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
+      * statistics from the package selection (for logging statistics).
+      * mapModifiedTx must hold the descendants of whatever is inBlock already,
+      * as left by UpdatePackagesForAdded(inBlock, mapModifiedTx). */
+    void addPackageTxs(indexed_modified_transaction_set &mapModifiedTx, int &nPackagesSelected, int &nDescendantsUpdated) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 
     // helper functions for addPackageTxs()
     /** Remove confirmed (inBlock) entries from given set */
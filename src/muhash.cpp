@@ -0,0 +1,139 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <muhash.h>
+
+#include <crypto/chacha20.h>
+#include <crypto/sha256.h>
+
+#include <assert.h>
+#include <string.h>
+
+#include <openssl/bn.h>
+
+namespace {
+
+/** The numbers of a MuHash3072 as OpenSSL bignums, for the time of one operation */
+class Num3072
+{
+    BN_CTX* m_ctx;
+    BIGNUM* m_prime;
+
+public:
+    Num3072() : m_ctx(BN_CTX_new()), m_prime(BN_new())
+    {
+        assert(m_ctx && m_prime);
+        // 2^3072 - 1103717
+        BN_one(m_prime);
+        BN_lshift(m_prime, m_prime, 3072);
+        BN_sub_word(m_prime, 1103717);
+    }
+
+    ~Num3072()
+    {
+        BN_free(m_prime);
+        BN_CTX_free(m_ctx);
+    }
+
+    Num3072(const Num3072&) = delete;
+    Num3072& operator=(const Num3072&) = delete;
+
+    BIGNUM* Get(const unsigned char* data)
+    {
+        BIGNUM* bn = BN_bin2bn(data, MuHash3072::BYTE_SIZE, BN_CTX_get(m_ctx));
+        assert(bn);
+        return bn;
+    }
+
+    static void Set(unsigned char* data, const BIGNUM* bn)
+    {
+        const int len = BN_num_bytes(bn);
+        assert(len >= 0 && (size_t)len <= MuHash3072::BYTE_SIZE);
+        memset(data, 0, MuHash3072::BYTE_SIZE - len);
+        BN_bn2bin(bn, data + MuHash3072::BYTE_SIZE - len);
+    }
+
+    /** data = data * other mod p */
+    void MulInto(unsigned char* data, const unsigned char* other)
+    {
+        BN_CTX_start(m_ctx);
+        BIGNUM* a = Get(data);
+        BIGNUM* b = Get(other);
+        const bool ok = BN_mod_mul(a, a, b, m_prime, m_ctx);
+        assert(ok);
+        Set(data, a);
+        BN_CTX_end(m_ctx);
+    }
+
+    /** Return numerator / denominator mod p */
+    void Divide(unsigned char* out, const unsigned char* numerator, const unsigned char* denominator)
+    {
+        BN_CTX_start(m_ctx);
+        BIGNUM* a = Get(numerator);
+        BIGNUM* b = Get(denominator);
+        const bool ok = BN_mod_inverse(b, b, m_prime, m_ctx) && BN_mod_mul(a, a, b, m_prime, m_ctx);
+        assert(ok);
+        Set(out, a);
+        BN_CTX_end(m_ctx);
+    }
+};
+
+/** Hash an element to a number, by expanding its SHA256 with ChaCha20 */
+void ToNum3072(const unsigned char* data, size_t len, unsigned char* out)
+{
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(hash);
+    ChaCha20(hash, sizeof(hash)).Output(out, MuHash3072::BYTE_SIZE);
+}
+
+} // namespace
+
+MuHash3072::MuHash3072()
+{
+    memset(m_numerator, 0, BYTE_SIZE);
+    memset(m_denominator, 0, BYTE_SIZE);
+    m_numerator[BYTE_SIZE - 1] = 1;
+    m_denominator[BYTE_SIZE - 1] = 1;
+}
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    unsigned char element[BYTE_SIZE];
+    ToNum3072(data, len, element);
+    Num3072().MulInto(m_numerator, element);
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    unsigned char element[BYTE_SIZE];
+    ToNum3072(data, len, element);
+    Num3072().MulInto(m_denominator, element);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& other)
+{
+    Num3072 num;
+    num.MulInto(m_numerator, other.m_numerator);
+    num.MulInto(m_denominator, other.m_denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& other)
+{
+    Num3072 num;
+    num.MulInto(m_numerator, other.m_denominator);
+    num.MulInto(m_denominator, other.m_numerator);
+    return *this;
+}
+
+uint256 MuHash3072::Finalize() const
+{
+    unsigned char value[BYTE_SIZE];
+    Num3072().Divide(value, m_numerator, m_denominator);
+    uint256 hash;
+    CSHA256().Write(value, BYTE_SIZE).Finalize(hash.begin());
+    return hash;
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MUHASH_H
+#define BITCOIN_MUHASH_H
+
+#include <uint256.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A hash of a set, which elements can be added to and removed from in any
+ * order, after MuHash (Bellare and Micciancio, "A New Paradigm for
+ * Collision-free Hashing: Incrementality at Reduced Cost").
+ *
+ * Each element is hashed to a number modulo the 3072-bit prime
+ * 2^3072 - 1103717. Adding an element multiplies it into the numerator,
+ * removing it into the denominator, so neither needs a modular inverse until
+ * the hash is finalized. Two sets hash the same when they have the same
+ * elements, however they got there.
+ */
+class MuHash3072
+{
+public:
+    static const size_t BYTE_SIZE = 384;
+
+    /** The hash of the empty set */
+    MuHash3072();
+
+    /** Add an element */
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    /** Remove an element, which need not have been added first */
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+
+    /** Add the elements of another set */
+    MuHash3072& operator*=(const MuHash3072& other);
+    /** Remove the elements of another set */
+    MuHash3072& operator/=(const MuHash3072& other);
+
+    /** The hash of the set */
+    uint256 Finalize() const;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s.write((const char*)m_numerator, sizeof(m_numerator));
+        s.write((const char*)m_denominator, sizeof(m_denominator));
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        s.read((char*)m_numerator, sizeof(m_numerator));
+        s.read((char*)m_denominator, sizeof(m_denominator));
+    }
+
+private:
+    //! Big endian numbers modulo the prime
+    unsigned char m_numerator[BYTE_SIZE];
+    unsigned char m_denominator[BYTE_SIZE];
+};
+
+#endif // BITCOIN_MUHASH_H
@@ -31,6 +31,11 @@
 #include <poll.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -81,6 +86,13 @@ enum BindFlags {
 // The sleep time needs to be small to avoid new sockets stalling
 static const uint64_t SELECT_TIMEOUT_MILLISECONDS = 50;
 
+#ifdef USE_EPOLL
+static const int EPOLL_MAX_EVENTS = 256;
+// epoll_event tags for sockets that are not peers (peers are tagged with their NodeId)
+static const uint64_t EPOLL_TAG_WAKEUP = ~uint64_t{0};
+static const uint64_t EPOLL_TAG_LISTEN = uint64_t{1} << 62;
+#endif
+
 const std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
@@ -908,16 +920,28 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     socklen_t len = sizeof(sockaddr);
     SOCKET hSocket = accept(hListenSocket.socket, (struct sockaddr*)&sockaddr, &len);
     CAddress addr;
-    int nInbound = 0;
-    int nMaxInbound = nMaxConnections - (nMaxOutbound + nMaxFeeler);
 
-    if (hSocket != INVALID_SOCKET) {
-        if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr)) {
-            LogPrintf("Warning: Unknown socket family\n");
-        }
+    if (hSocket == INVALID_SOCKET)
+    {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK)
+            LogPrintf("socket error accept failed: %s\n", NetworkErrorString(nErr));
+        return;
+    }
+
+    if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr)) {
+        LogPrintf("Warning: Unknown socket family\n");
     }
 
-    bool whitelisted = hListenSocket.whitelisted || IsWhitelistedRange(addr);
+    CreateNodeFromAcceptedSocket(hSocket, hListenSocket.whitelisted, addr);
+}
+
+void CConnman::CreateNodeFromAcceptedSocket(SOCKET hSocket, bool whitelisted, const CAddress& addr)
+{
+    int nInbound = 0;
+    int nMaxInbound = nMaxConnections - (nMaxOutbound + nMaxFeeler);
+
+    whitelisted = whitelisted || IsWhitelistedRange(addr);
     {
         LOCK(cs_vNodes);
         for (const CNode* pnode : vNodes) {
@@ -925,14 +949,6 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         }
     }
 
-    if (hSocket == INVALID_SOCKET)
-    {
-        int nErr = WSAGetLastError();
-        if (nErr != WSAEWOULDBLOCK)
-            LogPrintf("socket error accept failed: %s\n", NetworkErrorString(nErr));
-        return;
-    }
-
     if (!fNetworkActive) {
         LogPrintf("connection from %s dropped: not accepting new connections\n", addr.ToString());
         CloseSocket(hSocket);
@@ -986,6 +1002,9 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
+#ifdef USE_EPOLL
+        RegisterNodeSocket(pnode);
+#endif
     }
 }
 
@@ -1262,8 +1281,95 @@ void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_s
 }
 #endif
 
+bool CConnman::ServiceNodeSocket(CNode* pnode, bool recvSet, bool sendSet, bool errorSet)
+{
+    //
+    // Receive
+    //
+    if (recvSet || errorSet)
+    {
+        // typical socket buffer is 8K-64K
+        char pchBuf[0x10000];
+        int nBytes = 0;
+        {
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                return false;
+            nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+        }
+        // A short read means the socket has been drained
+        if (nBytes < (int)sizeof(pchBuf))
+            pnode->m_sock_recv_ready = false;
+        if (nBytes > 0)
+        {
+            bool notify = false;
+            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
+                pnode->CloseSocketDisconnect();
+            RecordBytesRecv(nBytes);
+            if (notify) {
+                size_t nSizeAdded = 0;
+                auto it(pnode->vRecvMsg.begin());
+                for (; it != pnode->vRecvMsg.end(); ++it) {
+                    if (!it->complete())
+                        break;
+                    nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
+                }
+                {
+                    LOCK(pnode->cs_vProcessMsg);
+                    pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
+                    pnode->nProcessQueueSize += nSizeAdded;
+                    pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
+                }
+                WakeMessageHandler();
+            }
+        }
+        else if (nBytes == 0)
+        {
+            // socket closed gracefully
+            if (!pnode->fDisconnect) {
+                LogPrint(BCLog::NET, "socket closed\n");
+            }
+            pnode->CloseSocketDisconnect();
+        }
+        else if (nBytes < 0)
+        {
+            // error
+            int nErr = WSAGetLastError();
+            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
+            {
+                if (!pnode->fDisconnect)
+                    LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
+                pnode->CloseSocketDisconnect();
+            }
+        }
+    }
+
+    //
+    // Send
+    //
+    if (sendSet)
+    {
+        LOCK(pnode->cs_vSend);
+        size_t nBytes = SocketSendData(pnode);
+        if (nBytes) {
+            RecordBytesSent(nBytes);
+        }
+        // Anything left over means the socket buffer is full
+        pnode->m_sock_send_ready = pnode->vSendMsg.empty();
+    }
+
+    return true;
+}
+
 void CConnman::SocketHandler()
 {
+#ifdef USE_EPOLL
+    if (m_epoll_fd != -1) {
+        SocketHandlerEpoll();
+        return;
+    }
+#endif
+
     std::set<SOCKET> recv_set, send_set, error_set;
     SocketEvents(recv_set, send_set, error_set);
 
@@ -1295,9 +1401,6 @@ void CConnman::SocketHandler()
         if (interruptNet)
             return;
 
-        //
-        // Receive
-        //
         bool recvSet = false;
         bool sendSet = false;
         bool errorSet = false;
@@ -1309,74 +1412,166 @@ void CConnman::SocketHandler()
             sendSet = send_set.count(pnode->hSocket) > 0;
             errorSet = error_set.count(pnode->hSocket) > 0;
         }
-        if (recvSet || errorSet)
-        {
-            // typical socket buffer is 8K-64K
-            char pchBuf[0x10000];
-            int nBytes = 0;
-            {
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-                nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-            }
-            if (nBytes > 0)
-            {
-                bool notify = false;
-                if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
-                    pnode->CloseSocketDisconnect();
-                RecordBytesRecv(nBytes);
-                if (notify) {
-                    size_t nSizeAdded = 0;
-                    auto it(pnode->vRecvMsg.begin());
-                    for (; it != pnode->vRecvMsg.end(); ++it) {
-                        if (!it->complete())
-                            break;
-                        nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
-                    }
-                    {
-                        LOCK(pnode->cs_vProcessMsg);
-                        pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
-                        pnode->nProcessQueueSize += nSizeAdded;
-                        pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
-                    }
-                    WakeMessageHandler();
-                }
-            }
-            else if (nBytes == 0)
-            {
-                // socket closed gracefully
-                if (!pnode->fDisconnect) {
-                    LogPrint(BCLog::NET, "socket closed\n");
-                }
-                pnode->CloseSocketDisconnect();
-            }
-            else if (nBytes < 0)
-            {
-                // error
-                int nErr = WSAGetLastError();
-                if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
-                {
-                    if (!pnode->fDisconnect)
-                        LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                    pnode->CloseSocketDisconnect();
-                }
-            }
+        if (!ServiceNodeSocket(pnode, recvSet, sendSet, errorSet))
+            continue;
+
+        InactivityCheck(pnode);
+    }
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodesCopy)
+            pnode->Release();
+    }
+}
+
+#ifdef USE_EPOLL
+bool CConnman::InitSocketEvents()
+{
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd == -1) {
+        LogPrintf("epoll_create1 failed: %s, falling back to poll()\n", NetworkErrorString(errno));
+        return false;
+    }
+
+    m_epoll_wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = EPOLL_TAG_WAKEUP;
+    if (m_epoll_wakeup_fd == -1 || epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_epoll_wakeup_fd, &event) != 0) {
+        LogPrintf("Failed to set up epoll wakeup event: %s, falling back to poll()\n", NetworkErrorString(errno));
+        ShutdownSocketEvents();
+        return false;
+    }
+
+    // Listen sockets are level-triggered, one connection is accepted per event
+    for (size_t i = 0; i < vhListenSocket.size(); ++i) {
+        event.events = EPOLLIN;
+        event.data.u64 = EPOLL_TAG_LISTEN | i;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, vhListenSocket[i].socket, &event) != 0) {
+            LogPrintf("Failed to add listen socket to epoll: %s, falling back to poll()\n", NetworkErrorString(errno));
+            ShutdownSocketEvents();
+            return false;
         }
+    }
 
-        //
-        // Send
-        //
-        if (sendSet)
+    return true;
+}
+
+void CConnman::ShutdownSocketEvents()
+{
+    if (m_epoll_wakeup_fd != -1) {
+        close(m_epoll_wakeup_fd);
+        m_epoll_wakeup_fd = -1;
+    }
+    if (m_epoll_fd != -1) {
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+}
+
+void CConnman::RegisterNodeSocket(CNode* pnode)
+{
+    if (m_epoll_fd == -1)
+        return;
+
+    // Peer sockets are registered once for both directions and edge-triggered:
+    // the handler keeps the readiness in m_sock_recv_ready/m_sock_send_ready
+    // until recv()/send() would block. Closing the socket removes it again.
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.u64 = pnode->GetId();
+
+    LOCK(pnode->cs_hSocket);
+    if (pnode->hSocket == INVALID_SOCKET)
+        return;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, pnode->hSocket, &event) != 0) {
+        LogPrintf("Failed to add socket of peer=%d to epoll: %s\n", pnode->GetId(), NetworkErrorString(errno));
+        pnode->fDisconnect = true;
+    }
+}
+
+void CConnman::SocketHandlerEpoll()
+{
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+    // Time out as often as select() does: peers marked fDisconnect are only
+    // dropped by DisconnectNodes() between waits, and nothing wakes us for them
+    int nEvents = epoll_wait(m_epoll_fd, events, EPOLL_MAX_EVENTS, m_epoll_more_work ? 0 : (int)SELECT_TIMEOUT_MILLISECONDS);
+
+    if (interruptNet) return;
+
+    if (nEvents < 0) {
+        if (errno != EINTR) {
+            LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(errno));
+            interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        }
+        return;
+    }
+
+    std::unordered_map<NodeId, uint32_t> ready_nodes;
+    for (int i = 0; i < nEvents; ++i) {
+        const uint64_t tag = events[i].data.u64;
+        if (tag == EPOLL_TAG_WAKEUP) {
+            uint64_t count;
+            while (read(m_epoll_wakeup_fd, &count, sizeof(count)) > 0) {}
+        } else if (tag & EPOLL_TAG_LISTEN) {
+            const ListenSocket& hListenSocket = vhListenSocket[tag & ~EPOLL_TAG_LISTEN];
+            if (hListenSocket.socket != INVALID_SOCKET)
+                AcceptConnection(hListenSocket);
+        } else {
+            ready_nodes[(NodeId)tag] |= events[i].events;
+        }
+    }
+
+    //
+    // Service each socket
+    //
+    std::vector<CNode*> vNodesCopy;
+    {
+        LOCK(cs_vNodes);
+        vNodesCopy = vNodes;
+        for (CNode* pnode : vNodesCopy)
+            pnode->AddRef();
+    }
+    m_epoll_more_work = false;
+    for (CNode* pnode : vNodesCopy)
+    {
+        if (interruptNet)
+            return;
+
+        bool errorSet = false;
+        auto it = ready_nodes.find(pnode->GetId());
+        if (it != ready_nodes.end()) {
+            if (it->second & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP))
+                pnode->m_sock_recv_ready = true;
+            if (it->second & EPOLLOUT)
+                pnode->m_sock_send_ready = true;
+            errorSet = (it->second & (EPOLLERR | EPOLLHUP)) != 0;
+        }
+
+        // Same policy as GenerateSelectSet: drain the write buffer before
+        // receiving more data from the peer.
+        bool send_pending;
         {
             LOCK(pnode->cs_vSend);
-            size_t nBytes = SocketSendData(pnode);
-            if (nBytes) {
-                RecordBytesSent(nBytes);
-            }
+            send_pending = !pnode->vSendMsg.empty();
         }
+        bool sendSet = send_pending && pnode->m_sock_send_ready;
+        bool recvSet = !send_pending && !pnode->fPauseRecv && pnode->m_sock_recv_ready;
+        if (!ServiceNodeSocket(pnode, recvSet, sendSet, errorSet))
+            continue;
 
         InactivityCheck(pnode);
+
+        // No new edge is reported for data we did not consume yet, so don't
+        // block in the next epoll_wait() if there is still some.
+        {
+            LOCK(pnode->cs_vSend);
+            send_pending = !pnode->vSendMsg.empty();
+        }
+        if ((send_pending && pnode->m_sock_send_ready) ||
+            (!send_pending && !pnode->fPauseRecv && pnode->m_sock_recv_ready)) {
+            m_epoll_more_work = true;
+        }
     }
     {
         LOCK(cs_vNodes);
@@ -1384,6 +1579,7 @@ void CConnman::SocketHandler()
             pnode->Release();
     }
 }
+#endif
 
 void CConnman::ThreadSocketHandler()
 {
@@ -1404,6 +1600,18 @@ void CConnman::WakeMessageHandler()
     condMsgProc.notify_one();
 }
 
+void CConnman::WakeSocketHandler()
+{
+#ifdef USE_EPOLL
+    if (m_epoll_wakeup_fd != -1) {
+        uint64_t one = 1;
+        if (write(m_epoll_wakeup_fd, &one, sizeof(one)) != sizeof(one)) {
+            // Counter is saturated, the socket handler has a wakeup pending anyway
+        }
+    }
+#endif
+}
+
 
 
 
@@ -1950,10 +2158,13 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
+#ifdef USE_EPOLL
+        RegisterNodeSocket(pnode);
+#endif
     }
 }
 
-void CConnman::ThreadMessageHandler()
+void CConnman::ThreadMessageHandler(int thread_index)
 {
     while (!flagInterruptMsgProc)
     {
@@ -1968,24 +2179,40 @@ void CConnman::ThreadMessageHandler()
 
         bool fMoreWork = false;
 
-        for (CNode* pnode : vNodesCopy)
+        // Start each thread at a different peer so they spread out instead of
+        // all contending for the first one
+        const size_t nNodes = vNodesCopy.size();
+        const size_t nOffset = nNodes ? (size_t)thread_index * nNodes / m_msghandler_threads : 0;
+        for (size_t i = 0; i < nNodes; ++i)
         {
+            CNode* pnode = vNodesCopy[(i + nOffset) % nNodes];
             if (pnode->fDisconnect)
                 continue;
 
+            // Skip peers another thread is busy with, it re-checks their queue when done
+            bool expected = false;
+            if (!pnode->m_msgproc_busy.compare_exchange_strong(expected, true))
+                continue;
+
             // Receive messages
             bool fMoreNodeWork = m_msgproc->ProcessMessages(pnode, flagInterruptMsgProc);
             fMoreWork |= (fMoreNodeWork && !pnode->fPauseSend);
-            if (flagInterruptMsgProc)
-                return;
-            // Send messages
-            {
+            if (!flagInterruptMsgProc) {
+                // Send messages
                 LOCK(pnode->cs_sendProcessing);
                 m_msgproc->SendMessages(pnode);
             }
 
+            pnode->m_msgproc_busy = false;
             if (flagInterruptMsgProc)
                 return;
+
+            // A message that came in after ProcessMessages() looked may have
+            // woken a thread that skipped this peer, and that wakeup is gone
+            {
+                LOCK(pnode->cs_vProcessMsg);
+                fMoreWork |= (!pnode->vProcessMsg.empty() && !pnode->fPauseSend);
+            }
         }
 
         {
@@ -2231,6 +2458,12 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
 
     uiInterface.InitMessage(_("Starting network threads..."));
 
+#ifdef USE_EPOLL
+    if (InitSocketEvents()) {
+        LogPrint(BCLog::NET, "Using epoll for socket events\n");
+    }
+#endif
+
     fAddressesInitialized = true;
 
     if (semOutbound == nullptr) {
@@ -2278,7 +2511,13 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         threadOpenConnections = std::thread(&TraceThread<std::function<void()> >, "opencon", std::function<void()>(std::bind(&CConnman::ThreadOpenConnections, this, connOptions.m_specified_outgoing)));
 
     // Process messages
-    threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    LogPrintf("Using %d threads for processing peer messages\n", m_msghandler_threads);
+    for (int i = 0; i < m_msghandler_threads; ++i) {
+        threadMessageHandlers.emplace_back([this, i] {
+            const std::string name = i == 0 ? "msghand" : strprintf("msghand.%d", i);
+            TraceThread(name.c_str(), std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this, i)));
+        });
+    }
 
     // Dump network addresses
     scheduler.scheduleEvery(std::bind(&CConnman::DumpAddresses, this), DUMP_PEERS_INTERVAL * 1000);
@@ -2310,6 +2549,7 @@ void CConnman::Interrupt()
     condMsgProc.notify_all();
 
     interruptNet();
+    WakeSocketHandler();
     InterruptSocks5(true);
 
     if (semOutbound) {
@@ -2327,8 +2567,11 @@ void CConnman::Interrupt()
 
 void CConnman::Stop()
 {
-    if (threadMessageHandler.joinable())
-        threadMessageHandler.join();
+    for (std::thread& thread : threadMessageHandlers) {
+        if (thread.joinable())
+            thread.join();
+    }
+    threadMessageHandlers.clear();
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
@@ -2338,6 +2581,10 @@ void CConnman::Stop()
     if (threadSocketHandler.joinable())
         threadSocketHandler.join();
 
+#ifdef USE_EPOLL
+    ShutdownSocketEvents();
+#endif
+
     if (fAddressesInitialized)
     {
         DumpAddresses();
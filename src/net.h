@@ -83,6 +83,10 @@ static const int64_t DEFAULT_PEER_CONNECT_TIMEOUT = 60;
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** Number of threads processing peer messages, -msghandlerthreads default */
+static const int DEFAULT_MSGHANDLER_THREADS = 4;
+/** Maximum number of message handler threads */
+static const int MAX_MSGHANDLER_THREADS = 16;
 
 typedef int64_t NodeId;
 
@@ -139,6 +143,7 @@ public:
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
         int64_t m_peer_connect_timeout = DEFAULT_PEER_CONNECT_TIMEOUT;
+        int m_msghandler_threads = DEFAULT_MSGHANDLER_THREADS;
         std::vector<std::string> vSeedNodes;
         std::vector<CSubNet> vWhitelistedRange;
         std::vector<CService> vBinds, vWhiteBinds;
@@ -161,6 +166,7 @@ public:
         nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
         nReceiveFloodSize = connOptions.nReceiveFloodSize;
         m_peer_connect_timeout = connOptions.m_peer_connect_timeout;
+        m_msghandler_threads = std::max(1, std::min(connOptions.m_msghandler_threads, MAX_MSGHANDLER_THREADS));
         {
             LOCK(cs_totalBytesSent);
             nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -296,6 +302,8 @@ public:
     unsigned int GetReceiveFloodSize() const;
 
     void WakeMessageHandler();
+    /** Interrupt a socket handler blocked waiting for readiness events (epoll backend only). */
+    void WakeSocketHandler();
 
     /** Attempts to obfuscate tx time through exponentially distributed emitting.
         Works assuming that a single interval is used.
@@ -303,6 +311,17 @@ public:
     */
     int64_t PoissonNextSendInbound(int64_t now, int average_interval_seconds);
 
+protected:
+    // Lets a subclass drive the socket handler without starting its thread
+    // (used by the benchmarks)
+
+    /** Apply the inbound connection limits and bans to an accepted socket and add it as a peer. */
+    void CreateNodeFromAcceptedSocket(SOCKET hSocket, bool whitelisted, const CAddress& addr);
+    void SocketHandler();
+#ifdef USE_EPOLL
+    bool InitSocketEvents();
+#endif
+
 private:
     struct ListenSocket {
         SOCKET socket;
@@ -318,14 +337,19 @@ private:
     void AddOneShot(const std::string& strDest);
     void ProcessOneShot();
     void ThreadOpenConnections(std::vector<std::string> connect);
-    void ThreadMessageHandler();
+    void ThreadMessageHandler(int thread_index);
     void AcceptConnection(const ListenSocket& hListenSocket);
     void DisconnectNodes();
     void NotifyNumConnectionsChanged();
     void InactivityCheck(CNode *pnode);
     bool GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
     void SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
-    void SocketHandler();
+    bool ServiceNodeSocket(CNode* pnode, bool recvSet, bool sendSet, bool errorSet);
+#ifdef USE_EPOLL
+    void ShutdownSocketEvents();
+    void RegisterNodeSocket(CNode* pnode);
+    void SocketHandlerEpoll();
+#endif
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
 
@@ -369,6 +393,9 @@ private:
     // P2P timeout in seconds
     int64_t m_peer_connect_timeout;
 
+    // Number of threads running ThreadMessageHandler()
+    int m_msghandler_threads{1};
+
     // Whitelisted ranges. Any node connecting from these is automatically
     // whitelisted (as well as those connecting to whitelisted binds).
     std::vector<CSubNet> vWhitelistedRange;
@@ -417,11 +444,20 @@ private:
 
     CThreadInterrupt interruptNet;
 
+#ifdef USE_EPOLL
+    /** Persistent epoll set holding the listen and peer sockets, -1 to fall back to poll() */
+    int m_epoll_fd{-1};
+    /** eventfd registered with m_epoll_fd, written to by WakeSocketHandler() */
+    int m_epoll_wakeup_fd{-1};
+    /** Set when a peer socket still has data we could not consume in the last round */
+    bool m_epoll_more_work{false};
+#endif
+
     std::thread threadDNSAddressSeed;
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
-    std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessageHandlers;
 
     /** flag for deciding to connect to an extra outbound peer,
      *  in excess of nMaxOutbound
@@ -629,6 +665,9 @@ public:
     size_t nProcessQueueSize{0};
 
     CCriticalSection cs_sendProcessing;
+    // Set while a message handler thread is processing this node. Messages
+    // of one peer are handled by at most one thread at a time, in order.
+    std::atomic_bool m_msgproc_busy{false};
 
     std::deque<CInv> vRecvGetData;
     uint64_t nRecvBytes GUARDED_BY(cs_vRecv){0};
@@ -675,6 +714,11 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv{false};
     std::atomic_bool fPauseSend{false};
+    // Edge-triggered readiness, only used by the socket handler thread. Set when
+    // epoll reports the socket readable/writable and cleared once recv()/send()
+    // would block, as no further event is delivered until then.
+    bool m_sock_recv_ready{false};
+    bool m_sock_send_ready{false};
 
 protected:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
@@ -685,8 +729,10 @@ public:
     std::atomic<int> nStartingHeight{-1};
 
     // flood relay
-    std::vector<CAddress> vAddrToSend;
-    CRollingBloomFilter addrKnown;
+    // Address relay to this node is also done by threads processing other peers
+    CCriticalSection cs_addrSend;
+    std::vector<CAddress> vAddrToSend GUARDED_BY(cs_addrSend);
+    CRollingBloomFilter addrKnown GUARDED_BY(cs_addrSend);
     bool fGetAddr{false};
     std::set<uint256> setKnown;
     int64_t nNextAddrSend GUARDED_BY(cs_sendProcessing){0};
@@ -809,6 +855,7 @@ public:
 
     void AddAddressKnown(const CAddress& _addr)
     {
+        LOCK(cs_addrSend);
         addrKnown.insert(_addr.GetKey());
     }
 
@@ -817,6 +864,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_addrSend);
         if (_addr.IsValid() && !addrKnown.contains(_addr.GetKey())) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand.randrange(vAddrToSend.size())] = _addr;
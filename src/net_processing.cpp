@@ -76,10 +76,12 @@ struct COrphanBlock
     std::vector<unsigned char> vchBlock;
 };
 
-std::map<uint256, COrphanBlock*> mapOrphanBlocks;
-std::multimap<uint256, COrphanBlock*> mapOrphanBlocksByPrev;
-std::set<std::pair<COutPoint, unsigned int> > setStakeSeenOrphan;
-std::size_t nOrphanBlocksSize = 0;
+/** Guards the orphan block pool. Lock order: cs_main before g_cs_orphan_blocks. */
+CCriticalSection g_cs_orphan_blocks;
+std::map<uint256, COrphanBlock*> mapOrphanBlocks GUARDED_BY(g_cs_orphan_blocks);
+std::multimap<uint256, COrphanBlock*> mapOrphanBlocksByPrev GUARDED_BY(g_cs_orphan_blocks);
+std::set<std::pair<COutPoint, unsigned int> > setStakeSeenOrphan GUARDED_BY(g_cs_orphan_blocks);
+std::size_t nOrphanBlocksSize GUARDED_BY(g_cs_orphan_blocks) = 0;
 
 /**
  * MWC RNG of George Marsaglia
@@ -88,9 +90,9 @@ std::size_t nOrphanBlocksSize = 0;
  *
  * @return random value
  */
-uint32_t insecure_rand_Rz{0};
-uint32_t insecure_rand_Rw{0};
-static inline uint32_t insecure_rand()
+uint32_t insecure_rand_Rz GUARDED_BY(g_cs_orphan_blocks){0};
+uint32_t insecure_rand_Rw GUARDED_BY(g_cs_orphan_blocks){0};
+static inline uint32_t insecure_rand() EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphan_blocks)
 {
     insecure_rand_Rz=36969*(insecure_rand_Rz&65535)+(insecure_rand_Rz>>16);
     insecure_rand_Rw=18000*(insecure_rand_Rw&65535)+(insecure_rand_Rw>>16);
@@ -98,7 +100,7 @@ static inline uint32_t insecure_rand()
 }
 
 
-uint256 static GetOrphanRoot(const uint256& hash)
+uint256 static GetOrphanRoot(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphan_blocks)
 {
     const uint256* prevHash = &hash;
     const uint256* currentHash = &hash;
@@ -120,7 +122,7 @@ uint256 static GetOrphanRoot(const uint256& hash)
     return *prevHash;
 }
 
-uint256 WantedByOrphan(const COrphanBlock* pblockOrphan)
+uint256 WantedByOrphan(const COrphanBlock* pblockOrphan) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphan_blocks)
 {
     // Work back to the first block in the orphan chain
     while (mapOrphanBlocks.count(pblockOrphan->hashPrev))
@@ -128,7 +130,7 @@ uint256 WantedByOrphan(const COrphanBlock* pblockOrphan)
     return pblockOrphan->hashPrev;
 }
 
-const COrphanBlock* AddOrphanBlock(const CBlock* pblock)
+const COrphanBlock* AddOrphanBlock(const CBlock* pblock) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphan_blocks)
 {
     COrphanBlock* orphan = new COrphanBlock();
     {
@@ -150,7 +152,7 @@ const COrphanBlock* AddOrphanBlock(const CBlock* pblock)
 }
 
 // Remove a random orphan block (which does not have any dependent orphans).
-void static PruneOrphanBlocks()
+void static PruneOrphanBlocks() EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphan_blocks)
 {
     size_t nMaxOrphanBlocksSize = gArgs.GetArg("-maxorphanblocksmib", DEFAULT_MAX_ORPHAN_BLOCKS) * ((size_t) 1 << 20);
     while (nOrphanBlocksSize > nMaxOrphanBlocksSize)
@@ -1727,7 +1729,7 @@ bool static ProcessMultiblockMessage(const BlockPtrList& iBlockPtrList, CNode* i
         }
 
         {
-            LOCK(cs_main);
+            LOCK2(cs_main, g_cs_orphan_blocks);
             if (!mapBlockIndex.count(blockPtrItr->hashPrevBlock))
             {
                 LogPrintf("Got orphan=%s, prev=%s, orphans_count=%d\n\n\n", blockPtrItr->GetHash().ToString(), blockPtrItr->hashPrevBlock.ToString(), mapOrphanBlocks.size());
@@ -1820,28 +1822,38 @@ bool static ProcessMultiblockMessage(const BlockPtrList& iBlockPtrList, CNode* i
             for (unsigned int i = 0; i < vWorkQueue.size(); i++)
             {
                 uint256 hashPrev = vWorkQueue[i];
-                for (auto mi = mapOrphanBlocksByPrev.lower_bound(hashPrev); mi != mapOrphanBlocksByPrev.upper_bound(hashPrev); ++mi)
+
+                // Take the children out of the pool first, the orphan block
+                // lock must not be held while calling into validation
+                std::vector<std::pair<uint256, std::shared_ptr<CBlock>>> vChildren;
                 {
-                    auto block{std::make_shared<CBlock>()};
+                    LOCK(g_cs_orphan_blocks);
+                    for (auto mi = mapOrphanBlocksByPrev.lower_bound(hashPrev); mi != mapOrphanBlocksByPrev.upper_bound(hashPrev); ++mi)
                     {
-                        CDataStream ss(mi->second->vchBlock, SER_DISK, 0);
-                        ss >> *block;
+                        auto block{std::make_shared<CBlock>()};
+                        {
+                            CDataStream ss(mi->second->vchBlock, SER_DISK, 0);
+                            ss >> *block;
+                        }
+                        vChildren.emplace_back(mi->second->hashBlock, block);
+
+                        mapOrphanBlocks.erase(mi->second->hashBlock);
+                        setStakeSeenOrphan.erase(mi->second->stake);
+                        nOrphanBlocksSize -= mi->second->vchBlock.size();
+                        delete mi->second;
                     }
+                    mapOrphanBlocksByPrev.erase(hashPrev);
+                }
 
+                for (const auto& child : vChildren)
+                {
                     bool newBlock{false};
-                    if (ProcessNewBlock(iChainParams, block, true, &newBlock))
+                    if (ProcessNewBlock(iChainParams, child.second, true, &newBlock))
                     {
-                        lastNewBlockHash = mi->second->hashBlock;
-                        vWorkQueue.push_back(mi->second->hashBlock);
+                        lastNewBlockHash = child.first;
+                        vWorkQueue.push_back(child.first);
                     }
-
-                    mapOrphanBlocks.erase(mi->second->hashBlock);
-                    setStakeSeenOrphan.erase(block->GetProofOfStake());
-                    nOrphanBlocksSize -= mi->second->vchBlock.size();
-                    delete mi->second;
                 }
-
-                mapOrphanBlocksByPrev.erase(hashPrev);
             }
         }
     }
@@ -2237,11 +2249,38 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         if (pfrom->fWhitelisted && gArgs.GetBoolArg("-whitelistrelay", DEFAULT_WHITELISTRELAY))
             fBlocksOnly = false;
 
+        // Most transactions a peer announces are already in the mempool or
+        // the orphan pool, drop those before taking cs_main, which the rest
+        // needs for AlreadyHave(), UpdateBlockAvailability() and AskFor().
+        std::vector<CInv> vInvNew;
+        vInvNew.reserve(vInv.size());
+        for (const CInv& inv : vInv)
+        {
+            if (inv.type != MSG_BLOCK)
+            {
+                pfrom->AddInventoryKnown(inv);
+                if (fBlocksOnly) {
+                    LogPrint(BCLog::NET, "transaction (%s) inv sent in violation of protocol peer=%d\n", inv.hash.ToString(), pfrom->GetId());
+                    continue;
+                }
+                if (mempool.exists(inv.hash))
+                    continue;
+                {
+                    LOCK(g_cs_orphans);
+                    if (mapOrphanTransactions.count(inv.hash))
+                        continue;
+                }
+            }
+            vInvNew.push_back(inv);
+        }
+        if (vInvNew.empty())
+            return true;
+
         LOCK(cs_main);
 
         uint32_t nFetchFlags = GetFetchFlags(pfrom);
 
-        for (CInv &inv : vInv)
+        for (CInv &inv : vInvNew)
         {
             if (interruptMsgProc)
                 return true;
@@ -2288,14 +2327,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 }
                 */
             }
-            else
+            else if (!fAlreadyHave && !fImporting && !fReindex && !IsInitialBlockDownload())
             {
-                pfrom->AddInventoryKnown(inv);
-                if (fBlocksOnly) {
-                    LogPrint(BCLog::NET, "transaction (%s) inv sent in violation of protocol peer=%d\n", inv.hash.ToString(), pfrom->GetId());
-                } else if (!fAlreadyHave && !fImporting && !fReindex && !IsInitialBlockDownload()) {
-                    pfrom->AskFor(inv);
-                }
+                pfrom->AskFor(inv);
             }
         }
         return true;
@@ -2524,6 +2558,22 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         CInv inv(MSG_TX, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
+        // Verify ring signatures before taking cs_main, so that anon transactions
+        // don't hold up block validation and the other peers for that long. An
+        // invalid one is left to AcceptToMemoryPool() to reject and punish.
+        // Transactions we already have (mempool, orphans, recentRejects) are
+        // dropped below anyway, so don't spend the signature checks on them.
+        bool fAlreadyHave;
+        {
+            LOCK(cs_main);
+            fAlreadyHave = AlreadyHave(inv);
+        }
+        if (!fAlreadyHave)
+            PreVerifyRingSignatures(tx);
+
+        // The rest can't do without cs_main: AcceptToMemoryPool() reads the
+        // inputs from pcoinsTip, and an accepted transaction goes on to accept
+        // the orphans spending it and to punish the peers of invalid ones.
         LOCK2(cs_main, g_cs_orphans);
 
         bool fMissingInputs = false;
@@ -3106,7 +3156,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
         pfrom->fSentAddr = true;
 
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_addrSend);
+            pfrom->vAddrToSend.clear();
+        }
         std::vector<CAddress> vAddr = connman->GetAddresses();
         FastRandomContext insecure_rand;
         for (const CAddress &addr : vAddr)
@@ -3351,6 +3404,7 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         return false;
 
     std::list<CNetMessage> msgs;
+    bool fResumeRecv = false;
     {
         LOCK(pfrom->cs_vProcessMsg);
         if (pfrom->vProcessMsg.empty())
@@ -3358,9 +3412,15 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         // Just take one message
         msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
         pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
+        const bool fWasPaused = pfrom->fPauseRecv;
         pfrom->fPauseRecv = pfrom->nProcessQueueSize > connman->GetReceiveFloodSize();
+        fResumeRecv = fWasPaused && !pfrom->fPauseRecv;
         fMoreWork = !pfrom->vProcessMsg.empty();
     }
+    // The socket handler may be waiting for events that won't come for data
+    // which is already buffered on the paused socket
+    if (fResumeRecv)
+        connman->WakeSocketHandler();
     CNetMessage& msg(msgs.front());
 
     msg.SetVersion(pfrom->GetRecvVersion());
@@ -3440,8 +3500,11 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         LogPrint(BCLog::NET, "%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->GetId());
     }
 
-    LOCK(cs_main);
-    SendRejectsAndCheckIfBanned(pfrom, m_enable_bip61);
+    // Don't queue behind another message handler thread holding cs_main just
+    // for this, SendMessages() does the same check on its next pass.
+    TRY_LOCK(cs_main, lockMain);
+    if (lockMain)
+        SendRejectsAndCheckIfBanned(pfrom, m_enable_bip61);
 
     return fMoreWork;
 }
@@ -3658,27 +3721,27 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         if (pto->nNextAddrSend < nNow) {
             pto->nNextAddrSend = PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
             std::vector<CAddress> vAddr;
-            vAddr.reserve(pto->vAddrToSend.size());
-            for (const CAddress& addr : pto->vAddrToSend)
             {
-                if (!pto->addrKnown.contains(addr.GetKey()))
+                LOCK(pto->cs_addrSend);
+                vAddr.reserve(pto->vAddrToSend.size());
+                for (const CAddress& addr : pto->vAddrToSend)
                 {
-                    pto->addrKnown.insert(addr.GetKey());
-                    vAddr.push_back(addr);
-                    // receiver rejects addr messages larger than 1000
-                    if (vAddr.size() >= 1000)
+                    if (!pto->addrKnown.contains(addr.GetKey()))
                     {
-                        connman->PushMessage(pto, msgMaker.Make(NetMsgType::ADDR, vAddr));
-                        vAddr.clear();
+                        pto->addrKnown.insert(addr.GetKey());
+                        vAddr.push_back(addr);
                     }
                 }
+                pto->vAddrToSend.clear();
+                // we only send the big addr message once
+                if (pto->vAddrToSend.capacity() > 40)
+                    pto->vAddrToSend.shrink_to_fit();
+            }
+            // receiver rejects addr messages larger than 1000
+            for (size_t nStart = 0; nStart < vAddr.size(); nStart += 1000) {
+                std::vector<CAddress> vAddrChunk(vAddr.begin() + nStart, vAddr.begin() + std::min(vAddr.size(), nStart + 1000));
+                connman->PushMessage(pto, msgMaker.Make(NetMsgType::ADDR, vAddrChunk));
             }
-            pto->vAddrToSend.clear();
-            if (!vAddr.empty())
-                connman->PushMessage(pto, msgMaker.Make(NetMsgType::ADDR, vAddr));
-            // we only send the big addr message once
-            if (pto->vAddrToSend.capacity() > 40)
-                pto->vAddrToSend.shrink_to_fit();
         }
 
         // Start block sync
@@ -12,6 +12,7 @@
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <rpc/blockchain.h>
+#include <rpc/jsonstream.h>
 #include <rpc/server.h>
 #include <streams.h>
 #include <sync.h>
@@ -242,10 +243,10 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RetFormat::JSON: {
-        UniValue objBlock = blockToJSON(block, tip, pblockindex, showTxDetails);
-        std::string strJSON = objBlock.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        JSONStreamWriter stream([req](const std::string& chunk) { return req->WriteReplyChunk(HTTP_OK, chunk); });
+        blockToJSON(stream, block, tip, pblockindex, showTxDetails);
+        req->WriteReply(HTTP_OK, stream.TakeBuffer() + "\n");
         return true;
     }
 
@@ -322,11 +323,10 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RetFormat::JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        std::string strJSON = mempoolObject.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        JSONStreamWriter stream([req](const std::string& chunk) { return req->WriteReplyChunk(HTTP_OK, chunk); });
+        mempoolToJSON(stream);
+        req->WriteReply(HTTP_OK, stream.TakeBuffer() + "\n");
         return true;
     }
     default: {
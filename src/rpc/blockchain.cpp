@@ -13,16 +13,21 @@
 #include <coins.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#include <crypto/siphash.h>
 #include <hash.h>
+#include <index/coinstatsindex.h>
 #include <index/txindex.h>
 #include <key_io.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
 #include <primitives/transaction.h>
+#include <random.h>
+#include <rpc/jsonstream.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
+#include <shutdown.h>
 #include <streams.h>
 #include <sync.h>
 #include <txdb.h>
@@ -31,6 +36,7 @@
 #include <util/system.h>
 #include <validation.h>
 #include <validationinterface.h>
+#include <validationstats.h>
 #include <versionbitsinfo.h>
 #include <warnings.h>
 
@@ -43,6 +49,9 @@
 
 #include <memory>
 #include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
 #include <condition_variable>
 
 struct CUpdatedBlock
@@ -115,20 +124,39 @@ UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails)
+/** Block fields that go before ("head") and after ("tail") the transactions */
+static void blockFieldsToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, UniValue& head, UniValue& tail)
 {
-    UniValue result(UniValue::VOBJ);
-    result.pushKV("hash", blockindex->GetBlockHash().GetHex());
+    head.pushKV("hash", blockindex->GetBlockHash().GetHex());
     const CBlockIndex* pnext;
     int confirmations = ComputeNextBlockAndDepth(tip, blockindex, pnext);
-    result.pushKV("confirmations", confirmations);
-    result.pushKV("strippedsize", (int)::GetSerializeSize(block, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
-    result.pushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
-    result.pushKV("weight", (int)::GetBlockWeight(block));
-    result.pushKV("height", blockindex->nHeight);
-    result.pushKV("version", block.nVersion);
-    result.pushKV("versionHex", strprintf("%08x", block.nVersion));
-    result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
+    head.pushKV("confirmations", confirmations);
+    head.pushKV("strippedsize", (int)::GetSerializeSize(block, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
+    head.pushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
+    head.pushKV("weight", (int)::GetBlockWeight(block));
+    head.pushKV("height", blockindex->nHeight);
+    head.pushKV("version", block.nVersion);
+    head.pushKV("versionHex", strprintf("%08x", block.nVersion));
+    head.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
+    tail.pushKV("time", block.GetBlockTime());
+    tail.pushKV("mediantime", (int64_t)blockindex->GetMedianTimePast());
+    tail.pushKV("nonce", (uint64_t)block.nNonce);
+    tail.pushKV("bits", strprintf("%08x", block.nBits));
+    tail.pushKV("difficulty", GetDifficulty(blockindex));
+    tail.pushKV("chainwork", blockindex->nChainWork.GetHex());
+    tail.pushKV("nTx", (uint64_t)blockindex->nTx);
+
+    if (blockindex->pprev)
+        tail.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
+    if (pnext)
+        tail.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
+}
+
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails)
+{
+    UniValue result(UniValue::VOBJ);
+    UniValue tail(UniValue::VOBJ);
+    blockFieldsToJSON(block, tip, blockindex, result, tail);
     UniValue txs(UniValue::VARR);
     for(const auto& tx : block.vtx)
     {
@@ -142,21 +170,44 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIn
             txs.push_back(tx->GetHash().GetHex());
     }
     result.pushKV("tx", txs);
-    result.pushKV("time", block.GetBlockTime());
-    result.pushKV("mediantime", (int64_t)blockindex->GetMedianTimePast());
-    result.pushKV("nonce", (uint64_t)block.nNonce);
-    result.pushKV("bits", strprintf("%08x", block.nBits));
-    result.pushKV("difficulty", GetDifficulty(blockindex));
-    result.pushKV("chainwork", blockindex->nChainWork.GetHex());
-    result.pushKV("nTx", (uint64_t)blockindex->nTx);
-
-    if (blockindex->pprev)
-        result.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
-    if (pnext)
-        result.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
+    result.pushKVs(tail);
     return result;
 }
 
+void blockToJSON(JSONStreamWriter& stream, const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails)
+{
+    UniValue head(UniValue::VOBJ);
+    UniValue tail(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        blockFieldsToJSON(block, tip, blockindex, head, tail);
+    }
+    stream.BeginObject();
+    for (size_t i = 0; i < head.size(); ++i) {
+        stream.KV(head.getKeys()[i], head.getValues()[i]);
+    }
+    stream.Key("tx");
+    stream.BeginArray();
+    for (const auto& tx : block.vtx) {
+        if (stream.Failed()) {
+            return;
+        }
+        if (txDetails) {
+            UniValue objTx(UniValue::VOBJ);
+            TxToUniv(*tx, uint256(), objTx, true, RPCSerializationFlags());
+            stream.Value(objTx);
+        } else {
+            stream.Value(tx->GetHash().GetHex());
+        }
+        stream.MaybeFlush();
+    }
+    stream.EndArray();
+    for (size_t i = 0; i < tail.size(); ++i) {
+        stream.KV(tail.getKeys()[i], tail.getValues()[i]);
+    }
+    stream.EndObject();
+}
+
 static UniValue getblockcount(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -493,6 +544,44 @@ UniValue mempoolToJSON(bool fVerbose)
     }
 }
 
+/** Number of mempool entries described per acquisition of mempool.cs */
+static const size_t MEMPOOL_JSON_BATCH_SIZE = 1000;
+
+void mempoolToJSON(JSONStreamWriter& stream)
+{
+    std::vector<uint256> vtxid;
+    {
+        LOCK(mempool.cs);
+        vtxid.reserve(mempool.mapTx.size());
+        for (const CTxMemPoolEntry& e : mempool.mapTx) {
+            vtxid.push_back(e.GetTx().GetHash());
+        }
+    }
+
+    // Describe the entries in batches, so that mempool.cs is not held while
+    // waiting for the client to read the output
+    stream.BeginObject();
+    size_t i = 0;
+    while (i < vtxid.size() && !stream.Failed()) {
+        {
+            LOCK(mempool.cs);
+            const size_t end = std::min(vtxid.size(), i + MEMPOOL_JSON_BATCH_SIZE);
+            for (; i < end; ++i) {
+                auto it = mempool.mapTx.find(vtxid[i]);
+                if (it == mempool.mapTx.end()) {
+                    // Removed in the meantime
+                    continue;
+                }
+                UniValue info(UniValue::VOBJ);
+                entryToJSON(info, *it);
+                stream.KV(vtxid[i].ToString(), info);
+            }
+        }
+        stream.MaybeFlush();
+    }
+    stream.EndObject();
+}
+
 static UniValue getrawmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 1)
@@ -525,6 +614,11 @@ static UniValue getrawmempool(const JSONRPCRequest& request)
     if (!request.params[0].isNull())
         fVerbose = request.params[0].get_bool();
 
+    if (fVerbose && request.stream) {
+        mempoolToJSON(*request.stream);
+        return NullUniValue;
+    }
+
     return mempoolToJSON(fVerbose);
 }
 
@@ -879,8 +973,6 @@ static UniValue getblock(const JSONRPCRequest& request)
                 },
             }.ToString());
 
-    LOCK(cs_main);
-
     uint256 hash(ParseHashV(request.params[0], "blockhash"));
 
     int verbosity = 1;
@@ -891,12 +983,25 @@ static UniValue getblock(const JSONRPCRequest& request)
             verbosity = request.params[1].get_bool() ? 1 : 0;
     }
 
-    const CBlockIndex* pblockindex = LookupBlockIndex(hash);
-    if (!pblockindex) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    const CBlockIndex* pblockindex;
+    const CBlockIndex* tip;
+    CBlock block;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+        pblockindex = LookupBlockIndex(hash);
+        if (!pblockindex) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+
+        block = GetBlockChecked(pblockindex);
     }
 
-    const CBlock block = GetBlockChecked(pblockindex);
+    if (verbosity >= 2 && request.stream) {
+        // Transactions are written out one by one, without holding cs_main
+        blockToJSON(*request.stream, block, tip, pblockindex, true);
+        return NullUniValue;
+    }
 
     if (verbosity <= 0)
     {
@@ -906,7 +1011,8 @@ static UniValue getblock(const JSONRPCRequest& request)
         return strHex;
     }
 
-    return blockToJSON(block, chainActive.Tip(), pblockindex, verbosity >= 2);
+    LOCK(cs_main);
+    return blockToJSON(block, tip, pblockindex, verbosity >= 2);
 }
 
 struct CCoinsStats
@@ -1035,32 +1141,93 @@ static UniValue pruneblockchain(const JSONRPCRequest& request)
 
 static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 1)
         throw std::runtime_error(
             RPCHelpMan{"gettxoutsetinfo",
                 "\nReturns statistics about the unspent transaction output set.\n"
-                "Note this call may take some time.\n",
-                {},
+                "Note this call may take some time, unless -coinstatsindex is enabled.\n",
+                {
+                    {"hash_or_height", RPCArg::Type::NUM, /* opt */ true, /* default_val */ "the current best block", "The block hash or height to return the statistics as of, which requires -coinstatsindex", "", {"", "string or numeric"}},
+                },
                 RPCResult{
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) The hash of the block at the tip of the chain\n"
-            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs\n"
+            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs (not available with -coinstatsindex)\n"
             "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
-            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
-            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
-            "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash (not available with -coinstatsindex)\n"
+            "  \"muhash\": \"hash\",     (string) The rolling hash of the set (only available with -coinstatsindex)\n"
+            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk (only available for the current best block)\n"
+            "  \"total_amount\": x.xxx,         (numeric) The total amount\n"
+            "  \"anon\": [                (array) The anon outputs less the key images spent, by denomination (only available with -coinstatsindex)\n"
+            "    {\n"
+            "      \"denomination\": x.xxx,   (numeric) The value of the outputs\n"
+            "      \"count\": n,              (numeric) The number of outputs\n"
+            "    }, ...\n"
+            "  ]\n"
             "}\n"
                 },
                 RPCExamples{
                     HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "1000")
             + HelpExampleRpc("gettxoutsetinfo", "")
                 },
             }.ToString());
 
     UniValue ret(UniValue::VOBJ);
 
+    if (g_coin_stats_index) {
+        g_coin_stats_index->BlockUntilSyncedToCurrentChain();
+
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            pindex = chainActive.Tip();
+            if (!request.params[0].isNull()) {
+                if (request.params[0].isNum()) {
+                    const int height = request.params[0].get_int();
+                    if (height < 0 || height > chainActive.Height()) {
+                        throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+                    }
+                    pindex = chainActive[height];
+                } else {
+                    pindex = LookupBlockIndex(ParseHashV(request.params[0], "hash_or_height"));
+                    if (!pindex) {
+                        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+                    }
+                }
+            }
+        }
+
+        CoinStats stats;
+        if (!g_coin_stats_index->LookUpStats(pindex, stats)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set statistics, coinstatsindex may still be syncing");
+        }
+        ret.pushKV("height", (int64_t)pindex->nHeight);
+        ret.pushKV("bestblock", pindex->GetBlockHash().GetHex());
+        ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+        ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+        ret.pushKV("muhash", stats.muhash.GetHex());
+        if (request.params[0].isNull()) {
+            ret.pushKV("disk_size", pcoinsdbview->EstimateSize());
+        }
+        ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+        UniValue anon(UniValue::VARR);
+        for (const auto& supply : stats.mapAnonSupply) {
+            UniValue entry(UniValue::VOBJ);
+            entry.pushKV("denomination", ValueFromAmount(supply.first));
+            entry.pushKV("count", supply.second);
+            anon.push_back(entry);
+        }
+        ret.pushKV("anon", anon);
+        return ret;
+    }
+
+    if (!request.params[0].isNull()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Querying the statistics as of a given block requires -coinstatsindex");
+    }
+
     CCoinsStats stats;
     FlushStateToDisk();
     if (GetUTXOStats(pcoinsdbview.get(), stats)) {
@@ -2050,6 +2217,56 @@ static UniValue getblockstats(const JSONRPCRequest& request)
     return ret;
 }
 
+static UniValue getvalidationstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            RPCHelpMan{"getvalidationstats",
+                "\nReturns how long the stages of block validation took since startup or the last reset.\n"
+                "Percentiles are read from a histogram with four buckets per power of two microseconds, and may be up to 25% high.\n"
+                "ring_signature and anon_lookup only count the work done while connecting a block, not for the mempool, the wallet or the indexes.\n",
+                {
+                    {"reset", RPCArg::Type::BOOL, /* opt */ true, /* default_val */ "false", "Clear the statistics after returning them"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"stage\": {             (json object) Per stage, such as connect_tip, connect_block, verify_inputs,\n"
+            "                           ring_signature, anon_lookup, difficulty_check or header_hash\n"
+            "    \"count\": n,            (numeric) Number of times the stage ran\n"
+            "    \"total_us\": n,         (numeric) Total time spent in it, in microseconds\n"
+            "    \"p50_us\": n,           (numeric) Median time, in microseconds\n"
+            "    \"p90_us\": n,           (numeric) 90th percentile, in microseconds\n"
+            "    \"p99_us\": n,           (numeric) 99th percentile, in microseconds\n"
+            "    \"max_us\": n            (numeric) Longest time, in microseconds\n"
+            "  },...\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getvalidationstats", "")
+            + HelpExampleCli("getvalidationstats", "true")
+            + HelpExampleRpc("getvalidationstats", "true")
+                },
+            }.ToString());
+
+    const bool reset = request.params[0].isNull() ? false : request.params[0].get_bool();
+
+    const std::vector<ValidationStageStats> stages = GetValidationStats();
+    if (reset) ResetValidationStats();
+
+    UniValue result(UniValue::VOBJ);
+    for (const ValidationStageStats& stage : stages) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("count", stage.count);
+        obj.pushKV("total_us", stage.total_us);
+        obj.pushKV("p50_us", stage.Percentile(0.5));
+        obj.pushKV("p90_us", stage.Percentile(0.9));
+        obj.pushKV("p99_us", stage.Percentile(0.99));
+        obj.pushKV("max_us", stage.max_us);
+        result.pushKV(stage.name, obj);
+    }
+    return result;
+}
+
 static UniValue savemempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0) {
@@ -2076,38 +2293,79 @@ static UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
-//! Search for a given set of pubkey scripts
-bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>& should_abort, int64_t& count, CCoinsViewCursor* cursor, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results) {
-    scan_progress = 0;
-    count = 0;
+/** Hasher for the pubkey scripts a scan looks for */
+class SaltedScriptHasher
+{
+private:
+    /** Salt. Not const, so sets using the hasher can be swapped. */
+    uint64_t k0, k1;
+
+public:
+    SaltedScriptHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+    size_t operator()(const CScript& script) const {
+        return CSipHasher(k0, k1).Write(script.data(), script.size()).Finalize();
+    }
+};
+
+typedef std::unordered_set<CScript, SaltedScriptHasher> ScriptSet;
+
+//! Number of transaction hash prefixes the chainstate is split into for a scan
+static const uint32_t SCAN_PREFIXES = 0x10000;
+//! Maximum number of threads a scan runs on
+static const int MAX_SCAN_THREADS = 16;
+
+//! The first two bytes of a transaction hash, which coins are ordered by in the chainstate
+static uint32_t GetScanPrefix(const uint256& hash)
+{
+    return 0x100 * *hash.begin() + *(hash.begin() + 1);
+}
+
+//! A part of the chainstate a scan thread goes over, and what it finds there
+struct ScanRange
+{
+    std::unique_ptr<CCoinsViewCursor> cursor;
+    //! Transaction hash prefixes the range covers, from prefix_begin up to but not including prefix_end
+    uint32_t prefix_begin;
+    uint32_t prefix_end;
+    int64_t count{0};
+    bool success{false};
+    std::map<COutPoint, Coin> results;
+};
+
+//! Search the coins in range for a given set of pubkey scripts, adding the prefixes done to scanned_prefixes
+bool FindScriptPubKey(std::atomic<uint32_t>& scanned_prefixes, const std::atomic<bool>& should_abort, ScanRange& range, const ScriptSet& needles) {
+    uint32_t prefix_reported = range.prefix_begin;
+    CCoinsViewCursor* cursor = range.cursor.get();
     while (cursor->Valid()) {
         COutPoint key;
         Coin coin;
         if (!cursor->GetKey(key) || !cursor->GetValue(coin)) return false;
-        if (++count % 8192 == 0) {
-            boost::this_thread::interruption_point();
-            if (should_abort) {
+        const uint32_t prefix = GetScanPrefix(key.hash);
+        if (prefix >= range.prefix_end) break;
+        if (++range.count % 8192 == 0) {
+            if (should_abort || ShutdownRequested()) {
                 // allow to abort the scan via the abort reference
                 return false;
             }
         }
-        if (count % 256 == 0) {
-            // update progress reference every 256 item
-            uint32_t high = 0x100 * *key.hash.begin() + *(key.hash.begin() + 1);
-            scan_progress = (int)(high * 100.0 / 65536.0 + 0.5);
+        if (range.count % 256 == 0 && prefix > prefix_reported) {
+            // update progress every 256 items
+            scanned_prefixes += prefix - prefix_reported;
+            prefix_reported = prefix;
         }
         if (needles.count(coin.out.scriptPubKey)) {
-            out_results.emplace(key, coin);
+            range.results.emplace(key, coin);
         }
         cursor->Next();
     }
-    scan_progress = 100;
+    scanned_prefixes += range.prefix_end - prefix_reported;
     return true;
 }
 
 /** RAII object to prevent concurrency issue when scanning the txout set */
 static std::mutex g_utxosetscan;
-static std::atomic<int> g_scan_progress;
+static std::atomic<uint32_t> g_scan_progress; //!< Transaction hash prefixes scanned so far
 static std::atomic<bool> g_scan_in_progress;
 static std::atomic<bool> g_should_abort_scan;
 class CoinsViewScanReserver
@@ -2136,6 +2394,64 @@ public:
     }
 };
 
+bool ScanTxOutSet(const CCoinsViewDB& view, uint32_t num_ranges, const std::vector<CScript>& scripts, std::map<COutPoint, Coin>& coins, int64_t& count)
+{
+    const ScriptSet needles(scripts.begin(), scripts.end());
+
+    // The cursors are all made while the chainstate can't be written to, so
+    // they see the same state
+    num_ranges = std::max<uint32_t>(num_ranges, 1);
+    std::vector<ScanRange> ranges(num_ranges);
+    {
+        LOCK(cs_main);
+        for (uint32_t i = 0; i < num_ranges; ++i) {
+            ScanRange& range = ranges[i];
+            range.prefix_begin = SCAN_PREFIXES * i / num_ranges;
+            range.prefix_end = SCAN_PREFIXES * (i + 1) / num_ranges;
+            uint256 hash_start;
+            *hash_start.begin() = range.prefix_begin >> 8;
+            *(hash_start.begin() + 1) = range.prefix_begin & 0xff;
+            range.cursor.reset(view.Cursor(hash_start));
+            assert(range.cursor);
+        }
+    }
+
+    // Doesn't throw, a range that runs into an error just fails
+    auto scan = [&needles](ScanRange& range) {
+        try {
+            range.success = FindScriptPubKey(g_scan_progress, g_should_abort_scan, range, needles);
+        } catch (const std::exception& e) {
+            LogPrintf("ScanTxOutSet: %s\n", e.what());
+            range.success = false;
+        } catch (...) {
+            range.success = false;
+        }
+    };
+    std::vector<std::thread> threads;
+    try {
+        for (uint32_t i = 1; i < num_ranges; ++i) {
+            threads.emplace_back(scan, std::ref(ranges[i]));
+        }
+    } catch (const std::system_error& e) {
+        // Out of threads, the ranges that didn't get one are scanned here
+        LogPrintf("ScanTxOutSet: %s\n", e.what());
+    }
+    for (size_t i = threads.size() + 1; i < num_ranges; ++i) {
+        scan(ranges[i]);
+    }
+    scan(ranges[0]);
+    for (std::thread& thread : threads) thread.join();
+
+    bool res = true;
+    count = 0;
+    for (ScanRange& range : ranges) {
+        res &= range.success;
+        count += range.count;
+        coins.insert(range.results.begin(), range.results.end());
+    }
+    return res;
+}
+
 UniValue scantxoutset(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
@@ -2200,7 +2516,7 @@ UniValue scantxoutset(const JSONRPCRequest& request)
             // no scan in progress
             return NullUniValue;
         }
-        result.pushKV("progress", g_scan_progress);
+        result.pushKV("progress", (int)(g_scan_progress * 100.0 / SCAN_PREFIXES + 0.5));
         return result;
     } else if (request.params[0].get_str() == "abort") {
         CoinsViewScanReserver reserver;
@@ -2216,7 +2532,7 @@ UniValue scantxoutset(const JSONRPCRequest& request)
         if (!reserver.reserve()) {
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Scan already in progress, use action \"abort\" or \"status\"");
         }
-        std::set<CScript> needles;
+        std::vector<CScript> needles;
         std::map<CScript, std::string> descriptors;
         CAmount total_in = 0;
 
@@ -2252,7 +2568,7 @@ UniValue scantxoutset(const JSONRPCRequest& request)
                 }
                 for (const auto& script : scripts) {
                     std::string inferred = InferDescriptor(script, provider)->ToString();
-                    needles.emplace(script);
+                    needles.push_back(script);
                     descriptors.emplace(std::move(script), std::move(inferred));
                 }
             }
@@ -2261,18 +2577,19 @@ UniValue scantxoutset(const JSONRPCRequest& request)
         // Scan the unspent transaction output set for inputs
         UniValue unspents(UniValue::VARR);
         std::vector<CTxOut> input_txos;
-        std::map<COutPoint, Coin> coins;
         g_should_abort_scan = false;
         g_scan_progress = 0;
-        int64_t count = 0;
-        std::unique_ptr<CCoinsViewCursor> pcursor;
+
+        // Split the chainstate into ranges of transaction hashes and scan them
+        // side by side
         {
             LOCK(cs_main);
             FlushStateToDisk();
-            pcursor = std::unique_ptr<CCoinsViewCursor>(pcoinsdbview->Cursor());
-            assert(pcursor);
         }
-        bool res = FindScriptPubKey(g_scan_progress, g_should_abort_scan, count, pcursor.get(), needles, coins);
+        const uint32_t num_ranges = std::max(1, std::min(GetNumCores(), MAX_SCAN_THREADS));
+        int64_t count = 0;
+        std::map<COutPoint, Coin> coins;
+        const bool res = ScanTxOutSet(*pcoinsdbview, num_ranges, needles, coins, count);
         result.pushKV("success", res);
         result.pushKV("searched_items", count);
 
@@ -2305,23 +2622,24 @@ UniValue scantxoutset(const JSONRPCRequest& request)
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
-    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      {} },
-    { "blockchain",         "getchaintxstats",        &getchaintxstats,        {"nblocks", "blockhash"} },
-    { "blockchain",         "getblockstats",          &getblockstats,          {"hash_or_height", "stats"} },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       {} },
-    { "blockchain",         "getblockcount",          &getblockcount,          {} },
-    { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"} },
-    { "blockchain",         "getblockhash",           &getblockhash,           {"height"} },
-    { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"} },
-    { "blockchain",         "getchaintips",           &getchaintips,           {} },
-    { "blockchain",         "getdifficulty",          &getdifficulty,          {} },
-    { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    {"txid","verbose"} },
-    { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  {"txid","verbose"} },
-    { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"} },
-    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
-    { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      {}, true },
+    { "blockchain",         "getchaintxstats",        &getchaintxstats,        {"nblocks", "blockhash"}, true },
+    { "blockchain",         "getblockstats",          &getblockstats,          {"hash_or_height", "stats"}, true },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       {}, true },
+    { "blockchain",         "getblockcount",          &getblockcount,          {}, true },
+    { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"}, true },
+    { "blockchain",         "getblockhash",           &getblockhash,           {"height"}, true },
+    { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"}, true },
+    { "blockchain",         "getchaintips",           &getchaintips,           {}, true },
+    { "blockchain",         "getdifficulty",          &getdifficulty,          {}, true },
+    { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    {"txid","verbose"}, true },
+    { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  {"txid","verbose"}, true },
+    { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"}, true },
+    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {}, true },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"}, true },
+    { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"}, true },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {"hash_or_height"} },
+    { "blockchain",         "getvalidationstats",     &getvalidationstats,     {"reset"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
@@ -5,12 +5,18 @@
 #ifndef BITCOIN_RPC_BLOCKCHAIN_H
 #define BITCOIN_RPC_BLOCKCHAIN_H
 
+#include <map>
 #include <vector>
 #include <stdint.h>
 #include <amount.h>
 
 class CBlock;
 class CBlockIndex;
+class CCoinsViewDB;
+class COutPoint;
+class Coin;
+class CScript;
+class JSONStreamWriter;
 class UniValue;
 
 static constexpr int NUM_GETBLOCKSTATS_PERCENTILES = 5;
@@ -29,15 +35,30 @@ void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 /** Block description to JSON */
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails = false);
 
+/** Block description to JSON, written to stream one transaction at a time. Takes cs_main briefly. */
+void blockToJSON(JSONStreamWriter& stream, const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails);
+
 /** Mempool information to JSON */
 UniValue mempoolInfoToJSON();
 
 /** Mempool to JSON */
 UniValue mempoolToJSON(bool fVerbose = false);
 
+/** Verbose mempool to JSON, written to stream in batches of entries.
+ * Entries added or removed while writing may be missed. */
+void mempoolToJSON(JSONStreamWriter& stream);
+
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex);
 
+/**
+ * Find the coins of view that pay to one of scripts, for scantxoutset. The
+ * coins are split into num_ranges ranges of transaction hashes, scanned side
+ * by side. Returns false if any range failed or the scan was aborted; coins
+ * and count (the number of coins looked at) cover the ranges that were done.
+ */
+bool ScanTxOutSet(const CCoinsViewDB& view, uint32_t num_ranges, const std::vector<CScript>& scripts, std::map<COutPoint, Coin>& coins, int64_t& count);
+
 /** Used by getblockstats to get feerates at different percentiles by weight  */
 void CalculatePercentilesByWeight(CAmount result[NUM_GETBLOCKSTATS_PERCENTILES], std::vector<std::pair<CAmount, int64_t>>& scores, int64_t total_weight);
 
@@ -0,0 +1,89 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/jsonstream.h>
+
+#include <univalue.h>
+
+#include <assert.h>
+
+JSONStreamWriter::JSONStreamWriter(Sink sink, size_t flush_size) : m_sink(std::move(sink)), m_flush_size(flush_size)
+{
+}
+
+void JSONStreamWriter::BeginValue()
+{
+    if (m_after_key) {
+        m_after_key = false;
+        return;
+    }
+    if (!m_nonempty.empty()) {
+        if (m_nonempty.back()) {
+            m_buffer += ',';
+        }
+        m_nonempty.back() = true;
+    }
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    BeginValue();
+    m_buffer += '{';
+    m_nonempty.push_back(false);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!m_nonempty.empty() && !m_after_key);
+    m_nonempty.pop_back();
+    m_buffer += '}';
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    BeginValue();
+    m_buffer += '[';
+    m_nonempty.push_back(false);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!m_nonempty.empty() && !m_after_key);
+    m_nonempty.pop_back();
+    m_buffer += ']';
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    assert(!m_after_key);
+    BeginValue();
+    m_buffer += UniValue(key).write();
+    m_buffer += ':';
+    m_after_key = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& value)
+{
+    BeginValue();
+    m_buffer += value.write();
+}
+
+void JSONStreamWriter::MaybeFlush()
+{
+    if (m_buffer.size() < m_flush_size) {
+        return;
+    }
+    if (!m_failed && !m_sink(m_buffer)) {
+        m_failed = true;
+    }
+    m_flushed = true;
+    m_buffer.clear();
+}
+
+std::string JSONStreamWriter::TakeBuffer()
+{
+    std::string ret;
+    ret.swap(m_buffer);
+    return ret;
+}
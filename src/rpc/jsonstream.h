@@ -0,0 +1,75 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONSTREAM_H
+#define BITCOIN_RPC_JSONSTREAM_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class UniValue;
+
+/**
+ * Writes a JSON document piece by piece, so that large replies do not have
+ * to be built as a single UniValue and string first. Output is compact and
+ * identical to what UniValue::write() produces for the same document.
+ *
+ * Output is buffered and only handed to the sink by MaybeFlush(). Until the
+ * first flush the buffered output can still be taken back with TakeBuffer(),
+ * which lets callers fall back to an ordinary reply.
+ */
+class JSONStreamWriter
+{
+public:
+    /** Receives the output. Returns false once the receiver has gone away. */
+    typedef std::function<bool(const std::string&)> Sink;
+
+    static const size_t DEFAULT_FLUSH_SIZE = 64 * 1024;
+
+    explicit JSONStreamWriter(Sink sink, size_t flush_size = DEFAULT_FLUSH_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    void Key(const std::string& key);
+    void Value(const UniValue& value);
+    void KV(const std::string& key, const UniValue& value)
+    {
+        Key(key);
+        Value(value);
+    }
+
+    /**
+     * Hand the buffered output to the sink once it reached the flush size.
+     * The sink may block until the client catches up, so do not hold any
+     * locks while calling this.
+     */
+    void MaybeFlush();
+
+    /** Take the output that has not been handed to the sink yet */
+    std::string TakeBuffer();
+
+    /** Whether any output was handed to the sink */
+    bool Flushed() const { return m_flushed; }
+    /** Whether the sink went away. Further output is discarded. */
+    bool Failed() const { return m_failed; }
+    /** Whether a Key() was written that still waits for its value */
+    bool AwaitingValue() const { return m_after_key; }
+
+private:
+    void BeginValue();
+
+    Sink m_sink;
+    size_t m_flush_size;
+    std::string m_buffer;
+    //! Per open object or array, whether an element was written into it
+    std::vector<bool> m_nonempty;
+    bool m_after_key = false;
+    bool m_flushed = false;
+    bool m_failed = false;
+};
+
+#endif // BITCOIN_RPC_JSONSTREAM_H
@@ -519,8 +519,22 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
     static CBlockIndex* pindexPrev;
     static int64_t nStart;
     static std::unique_ptr<CBlockTemplate> pblocktemplate;
-    if (pindexPrev != chainActive.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
+    bool fNewBlock = pindexPrev != chainActive.Tip();
+    if (!fNewBlock && mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast)
+    {
+        // Add the transactions that entered the mempool to the template.
+        // Fall back to a new one, at most every five seconds, when that
+        // doesn't do, like when transactions of the template were removed.
+        const unsigned int nTransactionsUpdatedNew = mempool.GetTransactionsUpdated();
+        std::unique_ptr<CBlockTemplate> pblocktemplateNew = BlockAssembler(Params()).UpdateNewBlock(*pblocktemplate);
+        if (pblocktemplateNew) {
+            pblocktemplate = std::move(pblocktemplateNew);
+            nTransactionsUpdatedLast = nTransactionsUpdatedNew;
+        } else {
+            fNewBlock = GetTime() - nStart > 5;
+        }
+    }
+    if (fNewBlock)
     {
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
         pindexPrev = nullptr;
@@ -8,6 +8,7 @@
 #include <core_io.h>
 #include <crypto/ripemd160.h>
 #include <key_io.h>
+#include <memusage.h>
 #include <validation.h>
 #include <httpserver.h>
 #include <net.h>
@@ -17,6 +18,7 @@
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <timedata.h>
+#include <txdb.h>
 #include <util/system.h>
 #include <util/strencodings.h>
 #include <warnings.h>
@@ -287,6 +289,33 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCAnonDBInfo()
+{
+    LOCK(cs_main);
+    UniValue obj(UniValue::VOBJ);
+    if (panondb) {
+        obj.pushKV("cache", uint64_t(panondb->CacheSize()));
+        obj.pushKV("usage", uint64_t(panondb->DynamicMemoryUsage()));
+        obj.pushKV("prefetched", uint64_t(panondb->PrefetchedCount()));
+    }
+    return obj;
+}
+
+static UniValue RPCBlockIndexInfo()
+{
+    LOCK(cs_main);
+    const size_t usage = blockIndexSlabs.DynamicMemoryUsage() + memusage::DynamicUsage(mapBlockIndex);
+    // What the same entries and map nodes would take as heap allocations of
+    // their own, going by memusage's model of malloc rather than measured
+    const size_t unpooled = (memusage::MallocUsage(sizeof(CBlockIndex)) + memusage::MallocUsage(sizeof(memusage::unordered_node<BlockMap::value_type>))) * mapBlockIndex.size() +
+        memusage::MallocUsage(sizeof(void*) * mapBlockIndex.bucket_count());
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("entries", uint64_t(mapBlockIndex.size()));
+    obj.pushKV("usage", uint64_t(usage));
+    obj.pushKV("estimated_saving", int64_t(unpooled) - int64_t(usage));
+    return obj;
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo()
 {
@@ -330,6 +359,16 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"anondb\": {               (json object) Information about the anon output and key image database\n"
+            "    \"cache\": xxxxx,         (numeric) Cache size it was opened with (-anondbcache), in bytes\n"
+            "    \"usage\": xxxxx,         (numeric) Approximate memory used by its cache and write buffer, in bytes\n"
+            "    \"prefetched\": xxxxx,    (numeric) Number of records prefetched for the block being connected\n"
+            "  },\n"
+            "  \"blockindex\": {           (json object) Information about the in-memory block index\n"
+            "    \"entries\": xxxxx,       (numeric) Number of block index entries\n"
+            "    \"usage\": xxxxx,         (numeric) Approximate memory used by the entries and the map of them, in bytes\n"
+            "    \"estimated_saving\": xxxxx, (numeric) Estimate of the malloc overhead avoided by allocating them in slabs and pools, rather than one by one, in bytes\n"
             "  }\n"
             "}\n"
                     },
@@ -347,6 +386,8 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        obj.pushKV("anondb", RPCAnonDBInfo());
+        obj.pushKV("blockindex", RPCBlockIndexInfo());
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -359,6 +400,144 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+static UniValue LockStatsToJSON(const LockSiteStats& stats)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("name", stats.name);
+    if (!stats.file.empty()) {
+        obj.pushKV("file", stats.file);
+        obj.pushKV("line", stats.line);
+    }
+    obj.pushKV("locks", stats.locks);
+    obj.pushKV("contended", stats.contended);
+    obj.pushKV("wait_us", stats.wait_ns / 1000);
+    obj.pushKV("wait_max_us", stats.wait_max_ns / 1000);
+    obj.pushKV("hold_us", stats.hold_ns / 1000);
+    obj.pushKV("hold_max_us", stats.hold_max_ns / 1000);
+    return obj;
+}
+
+static UniValue HistogramToJSON(const std::array<uint64_t, LOCK_STATS_BUCKETS>& histogram)
+{
+    UniValue arr(UniValue::VARR);
+    for (uint64_t count : histogram) {
+        arr.push_back(count);
+    }
+    return arr;
+}
+
+static UniValue getlockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{"getlockstats",
+                "\nReturns how often and how long locks were waited for and held since startup or the last reset.\n"
+                "Statistics are only kept when the node runs with -lockstats.\n"
+                "Histograms count waits and holds in buckets of < 1us, then [1us, 2us), [2us, 4us), ... with the last bucket counting everything above.\n",
+                {
+                    {"count", RPCArg::Type::NUM, /* opt */ true, /* default_val */ "10", "Number of call sites to return, the ones that waited longest first"},
+                    {"reset", RPCArg::Type::BOOL, /* opt */ true, /* default_val */ "false", "Clear the statistics after returning them"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"enabled\": true|false,   (boolean) Whether statistics are being kept (-lockstats)\n"
+            "  \"locks\": [               (json array) Per lock, by the name it is taken by, longest total wait first\n"
+            "    {\n"
+            "      \"name\": \"xxx\",         (string) Name of the lock, such as cs_main\n"
+            "      \"locks\": n,            (numeric) Number of times it was taken\n"
+            "      \"contended\": n,        (numeric) Number of times that had to wait for another thread\n"
+            "      \"wait_us\": n,          (numeric) Total time spent waiting for it, in microseconds\n"
+            "      \"wait_max_us\": n,      (numeric) Longest wait, in microseconds\n"
+            "      \"hold_us\": n,          (numeric) Total time it was held, in microseconds\n"
+            "      \"hold_max_us\": n,      (numeric) Longest hold, in microseconds\n"
+            "      \"wait_histogram\": [n,...], (json array) Number of waits per bucket\n"
+            "      \"hold_histogram\": [n,...]  (json array) Number of holds per bucket\n"
+            "    },...\n"
+            "  ],\n"
+            "  \"sites\": [               (json array) Call sites that waited longest\n"
+            "    {\n"
+            "      \"name\": \"xxx\",         (string) Name of the lock\n"
+            "      \"file\": \"xxx\",         (string) Source file of the call site\n"
+            "      \"line\": n,             (numeric) Line of the call site\n"
+            "      ...                    Same statistics as for locks, without histograms\n"
+            "    },...\n"
+            "  ]\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getlockstats", "")
+            + HelpExampleCli("getlockstats", "20 true")
+            + HelpExampleRpc("getlockstats", "20, true")
+                },
+            }.ToString());
+
+    const int count = request.params[0].isNull() ? 10 : request.params[0].get_int();
+    if (count < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+    }
+    const bool reset = request.params[1].isNull() ? false : request.params[1].get_bool();
+
+    std::vector<LockSiteStats> sites = GetLockStats();
+    if (reset) ResetLockStats();
+
+    // Sum up the sites per lock. The same lock may be named with or without
+    // a leading "::" at different sites.
+    std::map<std::string, LockSiteStats> locks;
+    for (const LockSiteStats& site : sites) {
+        std::string name = site.name.compare(0, 2, "::") == 0 ? site.name.substr(2) : site.name;
+        auto inserted = locks.emplace(name, LockSiteStats{});
+        LockSiteStats& lock = inserted.first->second;
+        if (inserted.second) {
+            lock.name = name;
+            lock.line = 0;
+            lock.locks = lock.contended = lock.wait_ns = lock.wait_max_ns = lock.hold_ns = lock.hold_max_ns = 0;
+            lock.wait_histogram.fill(0);
+            lock.hold_histogram.fill(0);
+        }
+        lock.locks += site.locks;
+        lock.contended += site.contended;
+        lock.wait_ns += site.wait_ns;
+        lock.wait_max_ns = std::max(lock.wait_max_ns, site.wait_max_ns);
+        lock.hold_ns += site.hold_ns;
+        lock.hold_max_ns = std::max(lock.hold_max_ns, site.hold_max_ns);
+        for (int i = 0; i < LOCK_STATS_BUCKETS; ++i) {
+            lock.wait_histogram[i] += site.wait_histogram[i];
+            lock.hold_histogram[i] += site.hold_histogram[i];
+        }
+    }
+
+    auto by_wait = [](const LockSiteStats* a, const LockSiteStats* b) { return a->wait_ns > b->wait_ns; };
+
+    std::vector<const LockSiteStats*> sorted_locks;
+    for (const auto& lock : locks) {
+        sorted_locks.push_back(&lock.second);
+    }
+    std::sort(sorted_locks.begin(), sorted_locks.end(), by_wait);
+    UniValue locks_arr(UniValue::VARR);
+    for (const LockSiteStats* lock : sorted_locks) {
+        UniValue obj = LockStatsToJSON(*lock);
+        obj.pushKV("wait_histogram", HistogramToJSON(lock->wait_histogram));
+        obj.pushKV("hold_histogram", HistogramToJSON(lock->hold_histogram));
+        locks_arr.push_back(obj);
+    }
+
+    std::vector<const LockSiteStats*> sorted_sites;
+    for (const LockSiteStats& site : sites) {
+        sorted_sites.push_back(&site);
+    }
+    std::sort(sorted_sites.begin(), sorted_sites.end(), by_wait);
+    UniValue sites_arr(UniValue::VARR);
+    for (size_t i = 0; i < sorted_sites.size() && i < (size_t)count; ++i) {
+        sites_arr.push_back(LockStatsToJSON(*sorted_sites[i]));
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("enabled", g_lock_stats.load());
+    result.pushKV("locks", locks_arr);
+    result.pushKV("sites", sites_arr);
+    return result;
+}
+
 static void EnableOrDisableLogCategories(UniValue cats, bool enable) {
     cats = cats.get_array();
     for (unsigned int i = 0; i < cats.size(); ++i) {
@@ -470,16 +649,17 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
+    { "control",            "getlockstats",           &getlockstats,           {"count","reset"} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
-    { "util",               "validateaddress",        &validateaddress,        {"address"} },
+    { "util",               "validateaddress",        &validateaddress,        {"address"}, true },
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys","address_type"} },
-    { "util",               "verifymessage",          &verifymessage,          {"address","signature","message"} },
+    { "util",               "verifymessage",          &verifymessage,          {"address","signature","message"}, true },
     { "util",               "signmessagewithprivkey", &signmessagewithprivkey, {"privkey","message"} },
 
     /* Not shown in help */
     { "hidden",             "setmocktime",            &setmocktime,            {"timestamp"}},
-    { "hidden",             "echo",                   &echo,                   {"arg0","arg1","arg2","arg3","arg4","arg5","arg6","arg7","arg8","arg9"}},
-    { "hidden",             "echojson",               &echo,                   {"arg0","arg1","arg2","arg3","arg4","arg5","arg6","arg7","arg8","arg9"}},
+    { "hidden",             "echo",                   &echo,                   {"arg0","arg1","arg2","arg3","arg4","arg5","arg6","arg7","arg8","arg9"}, true },
+    { "hidden",             "echojson",               &echo,                   {"arg0","arg1","arg2","arg3","arg4","arg5","arg6","arg7","arg8","arg9"}, true },
 };
 // clang-format on
 
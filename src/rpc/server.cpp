@@ -19,6 +19,7 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
+#include <condition_variable>
 #include <memory> // for unique_ptr
 #include <unordered_map>
 
@@ -474,11 +475,76 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
     return rpc_result;
 }
 
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
+/** A run of concurrent calls of a batch request, shared by the threads executing it */
+class JSONRPCBatchRun
+{
+public:
+    JSONRPCBatchRun(const JSONRPCRequest& _jreq, std::vector<UniValue> _requests) :
+        jreq(_jreq), requests(std::move(_requests)), results(requests.size()), pending(requests.size()) {}
+
+    /** Execute calls until none are left to claim */
+    void Work()
+    {
+        while (true) {
+            size_t idx;
+            {
+                LOCK(cs);
+                if (next == requests.size()) return;
+                idx = next++;
+            }
+            UniValue result = JSONRPCExecOne(jreq, requests[idx]);
+            LOCK(cs);
+            results[idx] = std::move(result);
+            if (--pending == 0) cond.notify_all();
+        }
+    }
+
+    /** Wait for the calls claimed by other threads */
+    void Wait()
+    {
+        WAIT_LOCK(cs, lock);
+        while (pending > 0) cond.wait(lock);
+    }
+
+    const JSONRPCRequest jreq;
+    const std::vector<UniValue> requests;
+    std::vector<UniValue> results;
+
+private:
+    Mutex cs;
+    std::condition_variable cond;
+    size_t next GUARDED_BY(cs) = 0;
+    size_t pending GUARDED_BY(cs);
+};
+
+std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq, const RPCTaskRunner& runner)
 {
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    unsigned int reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        unsigned int runEnd = reqIdx;
+        if (runner) {
+            while (runEnd < vReq.size() && tableRPC.isConcurrent(vReq[runEnd])) runEnd++;
+        }
+        if (runEnd - reqIdx < 2) {
+            ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+            reqIdx++;
+            continue;
+        }
+
+        // Spread the run over idle threads. This thread takes part as well,
+        // so it only ever waits for calls that are already executing.
+        auto run = std::make_shared<JSONRPCBatchRun>(jreq, std::vector<UniValue>(vReq.getValues().begin() + reqIdx, vReq.getValues().begin() + runEnd));
+        for (unsigned int i = reqIdx + 1; i < runEnd; i++) {
+            if (!runner([run] { run->Work(); })) break;
+        }
+        run->Work();
+        run->Wait();
+        for (UniValue& result : run->results) {
+            ret.push_back(std::move(result));
+        }
+        reqIdx = runEnd;
+    }
 
     return ret.write() + "\n";
 }
@@ -563,6 +629,19 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
     }
 }
 
+bool CRPCTable::isConcurrent(const UniValue& request) const
+{
+    if (!request.isObject()) {
+        return false;
+    }
+    const UniValue& method = find_value(request, "method");
+    if (!method.isStr()) {
+        return false;
+    }
+    const CRPCCommand* pcmd = (*this)[method.get_str()];
+    return pcmd && pcmd->concurrent;
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
@@ -10,6 +10,7 @@
 #include <rpc/protocol.h>
 #include <uint256.h>
 
+#include <functional>
 #include <list>
 #include <map>
 #include <stdint.h>
@@ -20,6 +21,7 @@
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
 
 class CRPCCommand;
+class JSONStreamWriter;
 
 namespace RPCServer
 {
@@ -46,8 +48,11 @@ public:
     std::string URI;
     std::string authUser;
     std::string peerAddr;
+    /** If set, a method with a large result may write it here instead of
+     * returning it. The stream is positioned where the result value goes. */
+    JSONStreamWriter* stream;
 
-    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false) {}
+    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false), stream(nullptr) {}
     void parse(const UniValue& valRequest);
 };
 
@@ -135,6 +140,12 @@ public:
     std::string name;
     rpcfn_type actor;
     std::vector<std::string> argNames;
+    /** Whether the method only reads state, so that the calls of a batch
+     * request around it may run concurrently with it */
+    bool concurrent;
+
+    CRPCCommand(std::string category_, std::string name_, rpcfn_type actor_, std::vector<std::string> argNames_, bool concurrent_ = false)
+        : category(std::move(category_)), name(std::move(name_)), actor(actor_), argNames(std::move(argNames_)), concurrent(concurrent_) {}
 };
 
 /**
@@ -157,6 +168,12 @@ public:
      */
     UniValue execute(const JSONRPCRequest &request) const;
 
+    /**
+     * Whether a request of a batch calls a method that may run concurrently
+     * with the calls around it.
+     */
+    bool isConcurrent(const UniValue& request) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -201,7 +218,15 @@ extern std::string HelpExampleRpc(const std::string& methodname, const std::stri
 void StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq);
+
+/** Runs a task on another thread. Returns false if no thread is available. */
+typedef std::function<bool(const std::function<void()>&)> RPCTaskRunner;
+
+/**
+ * Execute the calls of a batch request. Runs of consecutive concurrent calls
+ * are spread over the threads that runner makes available.
+ */
+std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq, const RPCTaskRunner& runner = nullptr);
 
 // Retrieves any serialization flags requested in command line argument
 int RPCSerializationFlags();
@@ -12,6 +12,7 @@
 #include <base58.h>
 #include <logging.h>
 #include <chainparams.h>
+#include <support/cleanse.h>
 #include <openssl/err.h>
 #include <openssl/rand.h>
 #include <openssl/ec.h>
@@ -654,6 +655,25 @@ int StealthSharedToSecretSpend(const ec_secret& sharedS, const ec_secret& spendS
     return rv;
 }
 
+int StealthSharedToSecretSpend(const ec_secret& sharedS, const CKey& spendKey, CKey& keyOut)
+{
+    ec_secret spendSecret;
+    ec_secret secretOut;
+    memcpy(&spendSecret.e[0], spendKey.begin(), EC_SECRET_SIZE);
+
+    int rv = StealthSharedToSecretSpend(sharedS, spendSecret, secretOut);
+    if (rv == 0)
+    {
+        keyOut.Set(&secretOut.e[0], &secretOut.e[EC_SECRET_SIZE], true);
+        if (!keyOut.IsValid())
+            rv = 1;
+    }
+
+    memory_cleanse(&spendSecret.e[0], EC_SECRET_SIZE);
+    memory_cleanse(&secretOut.e[0], EC_SECRET_SIZE);
+    return rv;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 int StealthSharedToPublicKey(const ec_point& pkSpend, const ec_secret &sharedS, ec_point &pkOut)
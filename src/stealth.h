@@ -140,6 +140,8 @@ int SecretToPublicKey(const ec_secret& secret, ec_point& out);
 int StealthSecret(ec_secret& secret, ec_point& pubkey, const ec_point& pkSpend, ec_secret& sharedSOut, ec_point& pkOut);
 int StealthSecretSpend(ec_secret& scanSecret, ec_point& ephemPubkey, ec_secret& spendSecret, ec_secret& secretOut);
 int StealthSharedToSecretSpend(const ec_secret& sharedS, const ec_secret& spendSecret, ec_secret& secretOut);
+/** Derive the key of a stealth output from its shared secret and the spend key of the address it was paid to. */
+int StealthSharedToSecretSpend(const ec_secret& sharedS, const CKey& spendKey, CKey& keyOut);
 int StealthSharedToPublicKey(const ec_point& pkSpend, const ec_secret &sharedS, ec_point &pkOut);
 bool IsStealthAddress(const std::string& encodedAddress);
 
@@ -0,0 +1,206 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Memory resource for many small allocations of a few different sizes, such
+ * as the nodes of a node based container.
+ *
+ * Memory is taken from the system in chunks, which grow from
+ * MIN_CHUNK_SIZE_BYTES up to MAX_CHUNK_SIZE_BYTES, and handed out in blocks
+ * of a multiple of ALIGN_BYTES, up to MAX_BLOCK_SIZE_BYTES. Freed blocks are
+ * kept on a free list per size and reused by later allocations of the same
+ * size. Chunks are only given back when the resource is destroyed, which
+ * makes freeing a large container that uses it cheap. Larger allocations,
+ * such as the bucket array of a hash table, go to operator new.
+ *
+ * Not thread safe, like the containers it is meant for.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+public:
+    static const std::size_t MIN_CHUNK_SIZE_BYTES = 16 << 10;
+    static const std::size_t MAX_CHUNK_SIZE_BYTES = 256 << 10;
+
+private:
+    //! A free block, linked into the free list for its size
+    struct ListNode {
+        ListNode* m_next;
+    };
+
+    static_assert(ALIGN_BYTES >= alignof(ListNode) && (ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two that fits a ListNode");
+    static_assert(ALIGN_BYTES <= alignof(std::max_align_t), "chunks are only aligned for std::max_align_t");
+    static_assert(MAX_BLOCK_SIZE_BYTES >= sizeof(ListNode), "blocks must fit a ListNode");
+
+    static const std::size_t NUM_FREE_LISTS = (MAX_BLOCK_SIZE_BYTES + ALIGN_BYTES - 1) / ALIGN_BYTES + 1;
+
+    ListNode* m_free_lists[NUM_FREE_LISTS];
+    std::vector<void*> m_chunks;
+    std::size_t m_next_chunk_size_bytes = MIN_CHUNK_SIZE_BYTES;
+    std::size_t m_allocated_bytes = 0;
+    //! Part of the newest chunk that has not been handed out yet
+    char* m_available_begin = nullptr;
+    char* m_available_end = nullptr;
+
+    static std::size_t NumAlignBytes(std::size_t bytes)
+    {
+        return (std::max<std::size_t>(bytes, 1) + ALIGN_BYTES - 1) / ALIGN_BYTES;
+    }
+
+    static bool IsFreeListUsable(std::size_t bytes, std::size_t alignment)
+    {
+        return alignment <= ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    void PushFree(void* p, std::size_t num_align_bytes)
+    {
+        ListNode*& free_list = m_free_lists[num_align_bytes];
+        free_list = new (p) ListNode{free_list};
+    }
+
+    void AllocateChunk()
+    {
+        // What is left of the current chunk is smaller than the request, but
+        // still usable for a smaller one
+        if (m_available_begin != m_available_end) {
+            PushFree(m_available_begin, (m_available_end - m_available_begin) / ALIGN_BYTES);
+        }
+        const std::size_t size = m_next_chunk_size_bytes;
+        m_chunks.push_back(::operator new(size));
+        m_available_begin = static_cast<char*>(m_chunks.back());
+        m_available_end = m_available_begin + size;
+        m_allocated_bytes += size;
+        m_next_chunk_size_bytes = size * 2 < MAX_CHUNK_SIZE_BYTES ? size * 2 : MAX_CHUNK_SIZE_BYTES;
+    }
+
+public:
+    PoolResource()
+    {
+        std::fill(m_free_lists, m_free_lists + NUM_FREE_LISTS, nullptr);
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (void* chunk : m_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            return ::operator new(bytes);
+        }
+        const std::size_t num_align_bytes = NumAlignBytes(bytes);
+        ListNode*& free_list = m_free_lists[num_align_bytes];
+        if (free_list) {
+            ListNode* node = free_list;
+            free_list = node->m_next;
+            node->~ListNode();
+            return node;
+        }
+        const std::size_t round_bytes = num_align_bytes * ALIGN_BYTES;
+        if ((std::size_t)(m_available_end - m_available_begin) < round_bytes) {
+            AllocateChunk();
+        }
+        void* p = m_available_begin;
+        m_available_begin += round_bytes;
+        return p;
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            ::operator delete(p);
+            return;
+        }
+        PushFree(p, NumAlignBytes(bytes));
+    }
+
+    std::size_t NumAllocatedChunks() const { return m_chunks.size(); }
+
+    //! Bytes taken from the system for chunks, whether handed out or not
+    std::size_t AllocatedBytes() const { return m_allocated_bytes; }
+};
+
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+const std::size_t PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>::MIN_CHUNK_SIZE_BYTES;
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+const std::size_t PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>::MAX_CHUNK_SIZE_BYTES;
+
+/**
+ * Allocator that takes memory from a PoolResource.
+ *
+ * Copies, and containers that are copied, moved or swapped, share the
+ * resource, which lives until the last of them is gone. A default constructed
+ * allocator makes a new resource, so each container gets its own.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> ResourceType;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    PoolAllocator() : m_resource(std::make_shared<ResourceType>()) {}
+
+    explicit PoolAllocator(std::shared_ptr<ResourceType> resource) noexcept : m_resource(std::move(resource)) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.resource())
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    const std::shared_ptr<ResourceType>& resource() const noexcept { return m_resource; }
+
+private:
+    std::shared_ptr<ResourceType> m_resource;
+};
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator==(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return a.resource() == b.resource();
+}
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator!=(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
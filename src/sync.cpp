@@ -24,6 +24,150 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+std::atomic<bool> g_lock_stats{DEFAULT_LOCKSTATS};
+
+//! Number of call sites the lock stats table has room for
+static const size_t LOCK_STATS_SITES = 4096;
+
+struct LockSiteEntry
+{
+    //! Set once name, file and line are filled in, they don't change after
+    std::atomic<bool> ready;
+    const char* name;
+    const char* file;
+    int line;
+
+    std::atomic<uint64_t> locks;
+    std::atomic<uint64_t> contended;
+    std::atomic<uint64_t> wait_ns;
+    std::atomic<uint64_t> wait_max_ns;
+    std::atomic<uint64_t> hold_ns;
+    std::atomic<uint64_t> hold_max_ns;
+    std::atomic<uint64_t> wait_histogram[LOCK_STATS_BUCKETS];
+    std::atomic<uint64_t> hold_histogram[LOCK_STATS_BUCKETS];
+};
+
+// Open addressing table of call sites, keyed by the string literals LOCK()
+// passes. Entries are never removed, so a lookup can stop at the first empty
+// one without taking a lock. Zero initialized, so it is usable by locks taken
+// during static initialization.
+static LockSiteEntry g_lock_sites[LOCK_STATS_SITES];
+static std::mutex g_lock_sites_mutex;
+
+static bool IsLockSite(const LockSiteEntry& entry, const char* pszName, const char* pszFile, int nLine)
+{
+    return entry.line == nLine && entry.file == pszFile && entry.name == pszName;
+}
+
+static LockSiteEntry* FindLockSite(const char* pszName, const char* pszFile, int nLine)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)pszFile * 0x9E3779B97F4A7C15ULL;
+    hash ^= (uint64_t)(uintptr_t)pszName * 0xC2B2AE3D27D4EB4FULL;
+    hash ^= (uint64_t)nLine;
+    const size_t start = (hash ^ (hash >> 29)) % LOCK_STATS_SITES;
+
+    for (size_t n = 0; n < LOCK_STATS_SITES; ++n) {
+        LockSiteEntry& entry = g_lock_sites[(start + n) % LOCK_STATS_SITES];
+        if (!entry.ready.load(std::memory_order_acquire)) break;
+        if (IsLockSite(entry, pszName, pszFile, nLine)) return &entry;
+    }
+
+    // First time this site takes a lock, add it
+    std::lock_guard<std::mutex> lock(g_lock_sites_mutex);
+    for (size_t n = 0; n < LOCK_STATS_SITES; ++n) {
+        LockSiteEntry& entry = g_lock_sites[(start + n) % LOCK_STATS_SITES];
+        if (!entry.ready.load(std::memory_order_relaxed)) {
+            entry.name = pszName;
+            entry.file = pszFile;
+            entry.line = nLine;
+            entry.ready.store(true, std::memory_order_release);
+            return &entry;
+        }
+        if (IsLockSite(entry, pszName, pszFile, nLine)) return &entry;
+    }
+    return nullptr;
+}
+
+static int LockStatsBucket(int64_t nNanos)
+{
+    int64_t nMicros = nNanos / 1000;
+    int bucket = 0;
+    while (nMicros > 0 && bucket < LOCK_STATS_BUCKETS - 1) {
+        nMicros >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+static void UpdateMax(std::atomic<uint64_t>& max, uint64_t value)
+{
+    uint64_t prev = max.load(std::memory_order_relaxed);
+    while (prev < value && !max.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {}
+}
+
+LockSiteEntry* RecordLockAcquired(const char* pszName, const char* pszFile, int nLine, bool fContended, int64_t nWaitNanos)
+{
+    LockSiteEntry* site = FindLockSite(pszName, pszFile, nLine);
+    if (!site) return nullptr;
+    site->locks.fetch_add(1, std::memory_order_relaxed);
+    if (fContended) {
+        site->contended.fetch_add(1, std::memory_order_relaxed);
+        site->wait_ns.fetch_add(nWaitNanos, std::memory_order_relaxed);
+        UpdateMax(site->wait_max_ns, nWaitNanos);
+    }
+    site->wait_histogram[LockStatsBucket(nWaitNanos)].fetch_add(1, std::memory_order_relaxed);
+    return site;
+}
+
+void RecordLockReleased(LockSiteEntry* site, int64_t nHoldNanos)
+{
+    site->hold_ns.fetch_add(nHoldNanos, std::memory_order_relaxed);
+    UpdateMax(site->hold_max_ns, nHoldNanos);
+    site->hold_histogram[LockStatsBucket(nHoldNanos)].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<LockSiteStats> GetLockStats()
+{
+    std::vector<LockSiteStats> result;
+    for (const LockSiteEntry& entry : g_lock_sites) {
+        if (!entry.ready.load(std::memory_order_acquire)) continue;
+        LockSiteStats stats;
+        stats.locks = entry.locks.load(std::memory_order_relaxed);
+        if (stats.locks == 0) continue;
+        stats.name = entry.name;
+        stats.file = entry.file;
+        stats.line = entry.line;
+        stats.contended = entry.contended.load(std::memory_order_relaxed);
+        stats.wait_ns = entry.wait_ns.load(std::memory_order_relaxed);
+        stats.wait_max_ns = entry.wait_max_ns.load(std::memory_order_relaxed);
+        stats.hold_ns = entry.hold_ns.load(std::memory_order_relaxed);
+        stats.hold_max_ns = entry.hold_max_ns.load(std::memory_order_relaxed);
+        for (int i = 0; i < LOCK_STATS_BUCKETS; ++i) {
+            stats.wait_histogram[i] = entry.wait_histogram[i].load(std::memory_order_relaxed);
+            stats.hold_histogram[i] = entry.hold_histogram[i].load(std::memory_order_relaxed);
+        }
+        result.push_back(std::move(stats));
+    }
+    return result;
+}
+
+void ResetLockStats()
+{
+    // Locks held meanwhile may still add to the counters, which is fine for statistics
+    for (LockSiteEntry& entry : g_lock_sites) {
+        entry.locks = 0;
+        entry.contended = 0;
+        entry.wait_ns = 0;
+        entry.wait_max_ns = 0;
+        entry.hold_ns = 0;
+        entry.hold_max_ns = 0;
+        for (int i = 0; i < LOCK_STATS_BUCKETS; ++i) {
+            entry.wait_histogram[i] = 0;
+            entry.hold_histogram[i] = 0;
+        }
+    }
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
@@ -0,0 +1,122 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <anonymous.h>
+#include <key.h>
+#include <random.h>
+#include <test/test_bitcoin.h>
+#include <txdb.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(anondb_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(anondb_migrate)
+{
+    CBlockTreeDB block_tree_db(1 << 20, true);
+    CAnonDB anondb(1 << 20, true);
+
+    CKey key;
+    key.MakeNewKey(true);
+    const CPubKey pkCoin = key.GetPubKey();
+    const ec_point keyImage(EC_COMPRESSED_SIZE, 0x02);
+    const CAnonOutput ao(COutPoint(InsecureRand256(), 1), 5 * COIN, 10, 0);
+    const CKeyImageSpent kis(InsecureRand256(), 0, 5 * COIN);
+
+    // Records as older versions wrote them, next to other block tree data
+    BOOST_CHECK(block_tree_db.Write(std::make_pair(std::string("ao"), pkCoin), ao));
+    BOOST_CHECK(block_tree_db.Write(std::make_pair(std::string("ki"), keyImage), kis));
+    BOOST_CHECK(block_tree_db.WriteFlag("prunedblockfiles", true));
+
+    BOOST_CHECK(anondb.MigrateData(block_tree_db));
+    CAnonOutput ao_read;
+    BOOST_CHECK(anondb.ReadAnonOutput(pkCoin, ao_read));
+    BOOST_CHECK(ao_read.outpoint == ao.outpoint);
+    BOOST_CHECK_EQUAL(ao_read.nValue, ao.nValue);
+    CKeyImageSpent kis_read;
+    BOOST_CHECK(anondb.ReadKeyImage(keyImage, kis_read));
+    BOOST_CHECK(kis_read.txnHash == kis.txnHash);
+
+    BOOST_CHECK(!block_tree_db.Exists(std::make_pair(std::string("ao"), pkCoin)));
+    BOOST_CHECK(!block_tree_db.Exists(std::make_pair(std::string("ki"), keyImage)));
+    bool fPruned = false;
+    BOOST_CHECK(block_tree_db.ReadFlag("prunedblockfiles", fPruned) && fPruned);
+
+    // Nothing is left to move the next time
+    BOOST_CHECK(anondb.MigrateData(block_tree_db));
+    BOOST_CHECK(anondb.ReadAnonOutput(pkCoin, ao_read));
+}
+
+BOOST_AUTO_TEST_CASE(anondb_prefetch)
+{
+    CAnonDB anondb(1 << 20, true);
+
+    CKey key;
+    key.MakeNewKey(true);
+    const CPubKey pkKnown = key.GetPubKey();
+    key.MakeNewKey(true);
+    const CPubKey pkUnknown = key.GetPubKey();
+    const ec_point keyImage(EC_COMPRESSED_SIZE, 0x03);
+    const CAnonOutput ao(COutPoint(InsecureRand256(), 0), COIN, 1, 0);
+    BOOST_CHECK(anondb.WriteAnonOutput(pkKnown, ao));
+
+    anondb.PrefetchAnon({pkKnown, pkUnknown}, {keyImage});
+    BOOST_CHECK_EQUAL(anondb.PrefetchedCount(), 3U);
+    CAnonOutput ao_read;
+    BOOST_CHECK(anondb.ReadAnonOutput(pkKnown, ao_read));
+    BOOST_CHECK(ao_read.outpoint == ao.outpoint);
+    BOOST_CHECK(!anondb.ReadAnonOutput(pkUnknown, ao_read));
+    CKeyImageSpent kis_read;
+    BOOST_CHECK(!anondb.ReadKeyImage(keyImage, kis_read));
+
+    // Writes drop the prefetched record, so reads see them
+    BOOST_CHECK(anondb.WriteAnonOutput(pkUnknown, ao));
+    BOOST_CHECK(anondb.WriteKeyImage(keyImage, CKeyImageSpent(InsecureRand256(), 0, COIN)));
+    BOOST_CHECK_EQUAL(anondb.PrefetchedCount(), 1U);
+    BOOST_CHECK(anondb.ReadAnonOutput(pkUnknown, ao_read));
+    BOOST_CHECK(anondb.ReadKeyImage(keyImage, kis_read));
+
+    // The next prefetch replaces the previous one
+    anondb.PrefetchAnon({}, {});
+    BOOST_CHECK_EQUAL(anondb.PrefetchedCount(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(anondb_prefetch_invalidate)
+{
+    CAnonDB anondb(1 << 20, true);
+
+    CKey key;
+    key.MakeNewKey(true);
+    const CPubKey pkCoin = key.GetPubKey();
+    const ec_point keyImage(EC_COMPRESSED_SIZE, 0x02);
+    const CAnonOutput ao(COutPoint(InsecureRand256(), 0), COIN, 1, 0);
+    const CKeyImageSpent kis(InsecureRand256(), 0, COIN);
+    BOOST_CHECK(anondb.WriteAnonOutput(pkCoin, ao));
+    BOOST_CHECK(anondb.WriteKeyImage(keyImage, kis));
+
+    anondb.PrefetchAnon({pkCoin}, {keyImage});
+    BOOST_CHECK_EQUAL(anondb.PrefetchedCount(), 2U);
+
+    // A disconnected block erases the output, reads must not find it prefetched
+    BOOST_CHECK(anondb.EraseAnonOutput(pkCoin));
+    BOOST_CHECK_EQUAL(anondb.PrefetchedCount(), 1U);
+    CAnonOutput ao_read;
+    BOOST_CHECK(!anondb.ReadAnonOutput(pkCoin, ao_read));
+
+    // A key image spent again reads back as last written, not as prefetched
+    const CKeyImageSpent kisNew(InsecureRand256(), 1, 2 * COIN);
+    BOOST_CHECK(anondb.WriteKeyImage(keyImage, kisNew));
+    BOOST_CHECK_EQUAL(anondb.PrefetchedCount(), 0U);
+    CKeyImageSpent kis_read;
+    BOOST_CHECK(anondb.ReadKeyImage(keyImage, kis_read));
+    BOOST_CHECK(kis_read.txnHash == kisNew.txnHash);
+
+    // Same for erasing a prefetched key image
+    anondb.PrefetchAnon({}, {keyImage});
+    BOOST_CHECK_EQUAL(anondb.PrefetchedCount(), 1U);
+    BOOST_CHECK(anondb.EraseKeyImage(keyImage));
+    BOOST_CHECK(!anondb.ReadKeyImage(keyImage, kis_read));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
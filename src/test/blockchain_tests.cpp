@@ -2,8 +2,16 @@
 
 #include <stdlib.h>
 
+#include <coins.h>
 #include <rpc/blockchain.h>
+#include <script/standard.h>
 #include <test/test_bitcoin.h>
+#include <txdb.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
 
 /* Equality between doubles is imprecise. Comparison should be done
  * with a small threshold of tolerance, rather than exact equality.
@@ -68,4 +76,81 @@ BOOST_AUTO_TEST_CASE(get_difficulty_for_very_high_target)
     TestDifficulty(0x12345678, 5913134931067755359633408.0);
 }
 
+static CScript RandomP2PKH()
+{
+    return GetScriptForDestination(CKeyID(uint160(g_insecure_rand_ctx.randbytes(20))));
+}
+
+BOOST_AUTO_TEST_CASE(scantxoutset_ranges)
+{
+    // Coins spread over the whole hash space, a few of them paying to each script
+    CCoinsViewDB db(1 << 20, true);
+    std::vector<CScript> scripts;
+    for (int i = 0; i < 3; ++i) {
+        scripts.push_back(RandomP2PKH());
+    }
+    std::map<COutPoint, Coin> coins;
+    {
+        CCoinsViewCache cache(&db);
+        for (int i = 0; i < 2000; ++i) {
+            const uint256 hash = InsecureRand256();
+            for (uint32_t n = 0, outputs = 1 + InsecureRandRange(3); n < outputs; ++n) {
+                CScript script;
+                if (InsecureRandRange(10) == 0) {
+                    script = scripts[InsecureRandRange(scripts.size())];
+                } else {
+                    // Spendable, or the coin would never be stored
+                    script = RandomP2PKH();
+                }
+                const Coin coin(CTxOut(1 + InsecureRandRange(1000), script), 1, false, false);
+                cache.AddCoin(COutPoint(hash, n), Coin(coin), false);
+                coins.emplace(COutPoint(hash, n), coin);
+            }
+        }
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+
+    // A cursor started at a hash goes over the coins from the first one of
+    // that hash or the one after it, in order, to the end
+    for (int i = 0; i < 20; ++i) {
+        uint256 start = InsecureRand256();
+        if (i == 0) start.SetNull();
+        if (i == 1) start = coins.begin()->first.hash;
+        auto expected = coins.lower_bound(COutPoint(start, 0));
+        std::unique_ptr<CCoinsViewCursor> cursor(db.Cursor(start));
+        while (cursor->Valid()) {
+            COutPoint key;
+            Coin coin;
+            BOOST_REQUIRE(cursor->GetKey(key) && cursor->GetValue(coin));
+            BOOST_REQUIRE(expected != coins.end());
+            BOOST_CHECK(key == expected->first);
+            BOOST_CHECK(coin.out == expected->second.out);
+            ++expected;
+            cursor->Next();
+        }
+        BOOST_CHECK(expected == coins.end());
+    }
+
+    std::map<COutPoint, Coin> expected;
+    for (const auto& item : coins) {
+        if (std::find(scripts.begin(), scripts.end(), item.second.out.scriptPubKey) != scripts.end()) {
+            expected.insert(item);
+        }
+    }
+    BOOST_CHECK(!expected.empty());
+
+    // However many ranges the coins are split into, the scan finds the same as a single cursor
+    for (uint32_t num_ranges : {1, 2, 7, 16}) {
+        std::map<COutPoint, Coin> found;
+        int64_t count = 0;
+        BOOST_CHECK(ScanTxOutSet(db, num_ranges, scripts, found, count));
+        BOOST_CHECK_EQUAL(count, (int64_t)coins.size());
+        BOOST_REQUIRE_EQUAL(found.size(), expected.size());
+        BOOST_CHECK(std::equal(found.begin(), found.end(), expected.begin(), [](const std::pair<const COutPoint, Coin>& a, const std::pair<const COutPoint, Coin>& b) {
+            return a.first == b.first && a.second.out == b.second.out;
+        }));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
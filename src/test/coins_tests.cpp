@@ -7,6 +7,7 @@
 #include <consensus/validation.h>
 #include <script/standard.h>
 #include <test/test_bitcoin.h>
+#include <txdb.h>
 #include <uint256.h>
 #include <undo.h>
 #include <util/strencodings.h>
@@ -874,4 +875,59 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_background_flush)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewBackgroundFlush flusher(&db, &db);
+    CCoinsViewCache cache(&flusher);
+
+    const COutPoint a(InsecureRand256(), 0);
+    const COutPoint b(InsecureRand256(), 1);
+    const uint256 block1 = InsecureRand256();
+    const uint256 block2 = InsecureRand256();
+    cache.AddCoin(a, Coin(CTxOut(1, CScript() << OP_TRUE), 1, false, false), false);
+    cache.SetBestBlock(block1);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(flusher.WaitForFlush());
+    BOOST_CHECK(db.HaveCoin(a));
+    BOOST_CHECK(db.GetBestBlock() == block1);
+    BOOST_CHECK_EQUAL(flusher.DynamicMemoryUsage(), 0U);
+
+    // The frozen layer hides the spend of a and the addition of b from the
+    // database until it is written, lookups see them either way.
+    BOOST_CHECK(cache.SpendCoin(a));
+    cache.AddCoin(b, Coin(CTxOut(2, CScript() << OP_TRUE), 2, false, false), false);
+    cache.SetBestBlock(block2);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!flusher.HaveCoin(a));
+    BOOST_CHECK(flusher.HaveCoin(b));
+    BOOST_CHECK(flusher.GetBestBlock() == block2);
+    BOOST_CHECK(!cache.HaveCoin(a));
+    BOOST_CHECK(cache.AccessCoin(b).out.nValue == 2);
+
+    BOOST_CHECK(flusher.WaitForFlush());
+    BOOST_CHECK(!db.HaveCoin(a));
+    BOOST_CHECK(db.HaveCoin(b));
+    BOOST_CHECK(db.GetBestBlock() == block2);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_cache_coin)
+{
+    CCoinsViewTest base;
+    CCoinsViewCache cache(&base);
+
+    // A prefetched coin is clean, flushing doesn't write it back
+    const COutPoint a(InsecureRand256(), 0);
+    cache.CacheCoin(a, Coin(CTxOut(1, CScript() << OP_TRUE), 1, false, false));
+    BOOST_CHECK(cache.HaveCoinInCache(a));
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!base.HaveCoin(a));
+
+    // An entry the cache has already is kept
+    cache.AddCoin(a, Coin(CTxOut(2, CScript() << OP_TRUE), 2, false, false), false);
+    cache.CacheCoin(a, Coin(CTxOut(3, CScript() << OP_TRUE), 3, false, false));
+    BOOST_CHECK(cache.AccessCoin(a).out.nValue == 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
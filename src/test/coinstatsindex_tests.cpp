@@ -0,0 +1,219 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <anonymous.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <consensus/validation.h>
+#include <index/coinstatsindex.h>
+#include <muhash.h>
+#include <script/standard.h>
+#include <test/test_bitcoin.h>
+#include <txdb.h>
+#include <undo.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(coinstatsindex_tests)
+
+BOOST_FIXTURE_TEST_CASE(muhash_order, BasicTestingSetup)
+{
+    const unsigned char a[] = {1, 2, 3};
+    const unsigned char b[] = {4, 5};
+
+    MuHash3072 ab;
+    ab.Insert(a, sizeof(a));
+    ab.Insert(b, sizeof(b));
+    MuHash3072 ba;
+    ba.Insert(b, sizeof(b));
+    ba.Insert(a, sizeof(a));
+    BOOST_CHECK(ab.Finalize() == ba.Finalize());
+
+    // Removing an element restores the hash of the set without it
+    MuHash3072 only_a;
+    only_a.Insert(a, sizeof(a));
+    ab.Remove(b, sizeof(b));
+    BOOST_CHECK(ab.Finalize() == only_a.Finalize());
+    BOOST_CHECK(ab.Finalize() != ba.Finalize());
+
+    // Sets combine and separate again
+    MuHash3072 only_b;
+    only_b.Insert(b, sizeof(b));
+    only_a *= only_b;
+    BOOST_CHECK(only_a.Finalize() == ba.Finalize());
+    only_a /= only_b;
+    BOOST_CHECK(only_a.Finalize() == ab.Finalize());
+    BOOST_CHECK(MuHash3072().Finalize() != ab.Finalize());
+}
+
+/** Check the statistics the index has for the tip against a walk over the chainstate */
+static void CheckTipStats(const CoinStatsIndex& coin_stats_index)
+{
+    MuHash3072 muhash;
+    uint64_t nTransactionOutputs = 0;
+    CAmount nTotalAmount = 0;
+    const CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        tip = chainActive.Tip();
+        std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsdbview->Cursor());
+        for (; pcursor->Valid(); pcursor->Next()) {
+            COutPoint key;
+            Coin coin;
+            BOOST_REQUIRE(pcursor->GetKey(key) && pcursor->GetValue(coin));
+            ApplyCoinHash(muhash, key, coin);
+            ++nTransactionOutputs;
+            nTotalAmount += coin.out.nValue;
+        }
+    }
+    CoinStats stats;
+    BOOST_REQUIRE(coin_stats_index.LookUpStats(tip, stats));
+    BOOST_CHECK(stats.muhash == muhash.Finalize());
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, nTransactionOutputs);
+    BOOST_CHECK_EQUAL(stats.nTotalAmount, nTotalAmount);
+}
+
+BOOST_FIXTURE_TEST_CASE(coinstatsindex_initial_sync, TestChain100Setup)
+{
+    CoinStatsIndex coin_stats_index(1 << 20, true);
+
+    CoinStats stats;
+    const CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+    }
+    BOOST_CHECK(!coin_stats_index.LookUpStats(tip, stats));
+    BOOST_CHECK(!coin_stats_index.BlockUntilSyncedToCurrentChain());
+
+    coin_stats_index.Start();
+
+    // Allow the index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!coin_stats_index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (i > 0) {
+            CScript coinbase_script_pub_key = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+            std::vector<CMutableTransaction> no_txns;
+            CreateAndProcessBlock(no_txns, coinbase_script_pub_key);
+            BOOST_CHECK(coin_stats_index.BlockUntilSyncedToCurrentChain());
+        }
+
+        // The statistics of the tip match a walk over the chainstate
+        CheckTipStats(coin_stats_index);
+    }
+
+    // Connect a block, invalidate it and connect a competing one instead.
+    // The index takes the first one out again with ReverseBlock().
+    CScript coinbase_script_pub_key = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+    std::vector<CMutableTransaction> no_txns;
+    const CBlock block_stale = CreateAndProcessBlock(no_txns, coinbase_script_pub_key);
+    BOOST_CHECK(coin_stats_index.BlockUntilSyncedToCurrentChain());
+    CheckTipStats(coin_stats_index);
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params(), LookupBlockIndex(block_stale.GetHash())));
+    }
+    {
+        CValidationState state;
+        BOOST_CHECK(ActivateBestChain(state, Params()));
+    }
+    const CBlock block_new = CreateAndProcessBlock(no_txns, CScript() << OP_TRUE);
+    BOOST_CHECK(block_new.GetHash() != block_stale.GetHash());
+    BOOST_CHECK(block_new.hashPrevBlock == block_stale.hashPrevBlock);
+    {
+        LOCK(cs_main);
+        BOOST_REQUIRE(chainActive.Tip()->GetBlockHash() == block_new.GetHash());
+    }
+    BOOST_CHECK(coin_stats_index.BlockUntilSyncedToCurrentChain());
+    CheckTipStats(coin_stats_index);
+
+    coin_stats_index.Stop(); // Stop thread before calling destructor
+}
+
+static CScript AnonOutputScript(const CPubKey& pkTo)
+{
+    CKey keyR;
+    keyR.MakeNewKey(true);
+    return CScript() << OP_RETURN << OP_ANON_MARKER << ToByteVector(pkTo) << ToByteVector(keyR.GetPubKey());
+}
+
+static CTransactionRef CoinbaseTx()
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.emplace_back(50 * COIN, CScript() << OP_TRUE);
+    return MakeTransactionRef(tx);
+}
+
+BOOST_FIXTURE_TEST_CASE(coinstatsindex_anon_supply, TestingSetup)
+{
+    CKey keyA, keyB, keyC;
+    keyA.MakeNewKey(true);
+    keyB.MakeNewKey(true);
+    keyC.MakeNewKey(true);
+
+    // A block with a transaction that sends two anon outputs of 1 and a
+    // plain one of 3 from a coin of 5. Anon outputs are in the set like any
+    // other coin.
+    CMutableTransaction txSend;
+    txSend.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    txSend.vout.emplace_back(COIN, AnonOutputScript(keyA.GetPubKey()));
+    txSend.vout.emplace_back(COIN, AnonOutputScript(keyB.GetPubKey()));
+    txSend.vout.emplace_back(3 * COIN, GetScriptForDestination(keyC.GetPubKey().GetID()));
+    BOOST_CHECK(txSend.vout[0].IsAnonOutput() && !txSend.vout[0].scriptPubKey.IsUnspendable());
+    CBlock block1;
+    block1.vtx = {CoinbaseTx(), MakeTransactionRef(txSend)};
+    CBlockUndo undo1;
+    undo1.vtxundo.resize(1);
+    undo1.vtxundo[0].vprevout.emplace_back(CTxOut(5 * COIN, CScript() << OP_TRUE), 1, false, false);
+    CBlockIndex index1;
+    index1.nHeight = 2;
+
+    CoinStats stats;
+    MuHash3072 muhash;
+    BOOST_REQUIRE(ApplyBlock(block1, &index1, undo1, muhash, &stats));
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, 3U);
+    BOOST_CHECK_EQUAL(stats.nTotalAmount, 51 * COIN);
+    BOOST_CHECK_EQUAL(stats.mapAnonSupply.size(), 1U);
+    BOOST_CHECK_EQUAL(stats.mapAnonSupply[COIN], 2);
+
+    // A block with an anon transaction whose ring is the first anon output
+    // above, sending an anon output of 0.5
+    BOOST_CHECK(panondb->WriteAnonOutput(keyA.GetPubKey(), CAnonOutput(COutPoint(txSend.GetHash(), 0), COIN, 2, 0)));
+    CMutableTransaction txSpend;
+    txSpend.nVersion = ANON_TXN_VERSION;
+    CTxIn txin(COutPoint(InsecureRand256(), 1 << 16));
+    txin.scriptSig << OP_RETURN << OP_ANON_MARKER;
+    const std::vector<unsigned char> vchRing = ToByteVector(keyA.GetPubKey());
+    txin.scriptSig.insert(txin.scriptSig.end(), vchRing.begin(), vchRing.end());
+    txin.scriptSig.insert(txin.scriptSig.end(), 2 * EC_SECRET_SIZE, 0x01);
+    BOOST_CHECK(txin.IsAnonInput());
+    txSpend.vin.push_back(txin);
+    txSpend.vout.emplace_back(COIN / 2, AnonOutputScript(keyC.GetPubKey()));
+    CBlock block2;
+    block2.vtx = {CoinbaseTx(), MakeTransactionRef(txSpend)};
+    CBlockUndo undo2;
+    undo2.vtxundo.resize(1);
+    CBlockIndex index2;
+    index2.nHeight = 3;
+
+    BOOST_REQUIRE(ApplyBlock(block2, &index2, undo2, muhash, &stats));
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, 5U);
+    BOOST_CHECK_EQUAL(stats.nTotalAmount, 101 * COIN + COIN / 2);
+    BOOST_CHECK_EQUAL(stats.mapAnonSupply.size(), 2U);
+    BOOST_CHECK_EQUAL(stats.mapAnonSupply[COIN], 1);
+    BOOST_CHECK_EQUAL(stats.mapAnonSupply[COIN / 2], 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include <keystore.h>
 #include <net.h>
 #include <net_processing.h>
+#include <netmessagemaker.h>
 #include <pow.h>
 #include <script/sign.h>
 #include <serialize.h>
@@ -18,6 +19,7 @@
 #include <test/test_bitcoin.h>
 
 #include <stdint.h>
+#include <thread>
 
 #include <boost/test/unit_test.hpp>
 
@@ -36,6 +38,25 @@ struct CConnmanTest : public CConnman {
         }
         vNodes.clear();
     }
+    void StartMessageHandlers()
+    {
+        flagInterruptMsgProc = false;
+        for (int i = 0; i < m_msghandler_threads; ++i) {
+            threadMessageHandlers.emplace_back(&CConnman::ThreadMessageHandler, this, i);
+        }
+    }
+    void StopMessageHandlers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutexMsgProc);
+            flagInterruptMsgProc = true;
+        }
+        condMsgProc.notify_all();
+        for (std::thread& thread : threadMessageHandlers) {
+            thread.join();
+        }
+        threadMessageHandlers.clear();
+    }
 };
 
 // Tests these internal-to-net_processing.cpp methods:
@@ -445,4 +466,91 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     BOOST_CHECK(mapOrphanTransactions.empty());
 }
 
+/** Queue a message as if the socket handler had received it from the node */
+static void QueueMessage(CNode& node, const CSerializedNetMsg& msg)
+{
+    CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), msg.data.size());
+    uint256 hash = Hash(msg.data.data(), msg.data.data() + msg.data.size());
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    std::vector<unsigned char> header;
+    CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, header, 0, hdr};
+
+    CNetMessage netmsg(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+    BOOST_REQUIRE_EQUAL(netmsg.readHeader((const char*)header.data(), header.size()), (int)header.size());
+    BOOST_REQUIRE_EQUAL(netmsg.readData((const char*)msg.data.data(), msg.data.size()), (int)msg.data.size());
+    BOOST_REQUIRE(netmsg.complete());
+
+    LOCK(node.cs_vProcessMsg);
+    node.nProcessQueueSize += msg.data.size() + CMessageHeader::HEADER_SIZE;
+    node.vProcessMsg.push_back(std::move(netmsg));
+}
+
+BOOST_AUTO_TEST_CASE(message_handler_threads)
+{
+    constexpr int nThreads = 4;
+    constexpr int nPeers = 8;
+    constexpr int nMessages = 20;
+    constexpr int nInvPerMessage = 10;
+
+    auto connman = MakeUnique<CConnmanTest>(0x1337, 0x1337);
+    auto peerLogic = MakeUnique<PeerLogicValidation>(connman.get(), nullptr, scheduler, false);
+    CConnman::Options options;
+    options.nMaxConnections = 125;
+    options.m_msgproc = peerLogic.get();
+    options.nSendBufferMaxSize = 1000 * DEFAULT_MAXSENDBUFFER;
+    options.nReceiveFloodSize = 1000 * DEFAULT_MAXRECEIVEBUFFER;
+    options.m_msghandler_threads = nThreads;
+    connman->Init(options);
+
+    // Every peer announces blocks and transactions of its own. Transactions
+    // aren't requested during initial block download, blocks are.
+    std::vector<CNode*> vNodes;
+    std::vector<uint256> vBlockHashes;
+    for (int i = 0; i < nPeers; ++i) {
+        AddRandomOutboundPeer(vNodes, *peerLogic, connman.get());
+        CNode& node = *vNodes.back();
+        node.SetRecvVersion(PROTOCOL_VERSION);
+        for (int j = 0; j < nMessages; ++j) {
+            std::vector<CInv> vInv;
+            for (int k = 0; k < nInvPerMessage; ++k) {
+                vInv.emplace_back(MSG_TX, InsecureRand256());
+                vBlockHashes.push_back(InsecureRand256());
+                vInv.emplace_back(MSG_BLOCK, vBlockHashes.back());
+            }
+            QueueMessage(node, CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::INV, vInv));
+        }
+    }
+
+    connman->StartMessageHandlers();
+    int64_t nTimeout = GetTimeMillis() + 10 * 1000;
+    bool fDone = false;
+    while (!fDone && GetTimeMillis() < nTimeout) {
+        MilliSleep(10);
+        fDone = true;
+        for (CNode* node : vNodes) {
+            LOCK(node->cs_vProcessMsg);
+            fDone &= node->vProcessMsg.empty() && !node->m_msgproc_busy;
+        }
+    }
+    connman->StopMessageHandlers();
+    BOOST_CHECK(fDone);
+
+    // Each announced block was requested, none got lost between threads
+    {
+        LOCK(cs_main);
+        for (const uint256& hash : vBlockHashes) {
+            BOOST_CHECK(mapAlreadyAskedFor.count(hash));
+        }
+    }
+    for (CNode* node : vNodes) {
+        BOOST_CHECK(!node->fDisconnect);
+    }
+
+    bool dummy;
+    for (const CNode *node : vNodes) {
+        peerLogic->FinalizeNode(node->GetId(), dummy);
+    }
+    connman->ClearNodes();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
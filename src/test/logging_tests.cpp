@@ -0,0 +1,90 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <fs.h>
+#include <logging.h>
+#include <test/test_bitcoin.h>
+
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(logging_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(logging_async_writer)
+{
+    const int num_threads = 4;
+    const int num_messages = 1000;
+
+    BCLog::Logger logger;
+    logger.m_print_to_file = true;
+    logger.m_log_timestamps = false;
+    logger.m_file_path = SetDataDir("logging_async_writer") / "debug.log";
+    BOOST_REQUIRE(logger.OpenDebugLog());
+    logger.LogPrintStr("before\n");
+
+    logger.StartWriterThread();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&logger, t] {
+            for (int i = 0; i < num_messages; ++i) {
+                logger.LogPrintStr(strprintf("thread %d message %d\n", t, i), true);
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    // Not queued, so written right away, after what was queued before it
+    logger.LogPrintStr("sync\n");
+    logger.StopWriterThread();
+    // Queued while the writer thread isn't running, so written right away
+    logger.LogPrintStr("after\n", true);
+
+    // Every message is either written or counted as dropped, and those of a
+    // thread stay in order
+    std::ifstream file(logger.m_file_path.string());
+    std::string line;
+    std::vector<int> next(num_threads, 0);
+    int written = 0;
+    bool dropped_reported = false;
+    std::getline(file, line);
+    BOOST_CHECK_EQUAL(line, "before");
+    while (std::getline(file, line) && line != "sync") {
+        int t, i;
+        if (sscanf(line.c_str(), "thread %d message %d", &t, &i) == 2) {
+            BOOST_REQUIRE(t >= 0 && t < num_threads);
+            BOOST_CHECK(i >= next[t]);
+            next[t] = i + 1;
+            ++written;
+        } else {
+            BOOST_CHECK(line.find("Dropped") != std::string::npos);
+            dropped_reported = true;
+        }
+    }
+    BOOST_CHECK_EQUAL(line, "sync");
+    std::getline(file, line);
+    BOOST_CHECK_EQUAL(line, "after");
+    BOOST_CHECK_EQUAL(written + logger.GetDroppedCount(), (uint64_t)num_threads * num_messages);
+    BOOST_CHECK_EQUAL(dropped_reported, logger.GetDroppedCount() > 0);
+}
+
+BOOST_AUTO_TEST_CASE(logging_rate_limit)
+{
+    BCLog::Logger logger;
+    BOOST_CHECK(logger.WithinRateLimit(BCLog::NET));
+
+    logger.m_category_rate_limit = 10;
+    int accepted = 0;
+    for (int i = 0; i < 100; ++i) {
+        accepted += logger.WithinRateLimit(BCLog::NET);
+    }
+    // At most one second boundary is crossed, which starts the count over
+    BOOST_CHECK(accepted >= 10 && accepted <= 20);
+
+    // Other categories have limits of their own
+    BOOST_CHECK(logger.WithinRateLimit(BCLog::MEMPOOL));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
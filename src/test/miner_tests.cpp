@@ -521,4 +521,71 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+BOOST_AUTO_TEST_CASE(UpdateNewBlock_template)
+{
+    const CChainParams& chainparams = Params();
+    CScript scriptPubKey = CScript() << OP_TRUE;
+
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    BOOST_CHECK(pblocktemplate = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey));
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 1U);
+
+    // Nothing new in the mempool: the template comes back as it was
+    std::unique_ptr<CBlockTemplate> pblocktemplateNew;
+    BOOST_CHECK(pblocktemplateNew = AssemblerForTest(chainparams).UpdateNewBlock(*pblocktemplate));
+    BOOST_CHECK_EQUAL(pblocktemplateNew->block.vtx.size(), 1U);
+    BOOST_CHECK(pblocktemplateNew->block.vtx[0]->GetHash() == pblocktemplate->block.vtx[0]->GetHash());
+
+    // A template on another tip has to be rebuilt
+    CBlockTemplate stale(*pblocktemplate);
+    stale.block.hashPrevBlock = InsecureRand256();
+    BOOST_CHECK(!AssemblerForTest(chainparams).UpdateNewBlock(stale));
+
+    // A parent in the template and its zero fee child in the mempool. The
+    // child only pays for itself once the parent is in the block, so it must
+    // not be selected on the parent's fee. The inputs don't exist, so if it
+    // were selected TestBlockValidity would throw.
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+    txParent.vin[0].scriptSig = CScript() << OP_1;
+    txParent.vout.resize(1);
+    txParent.vout[0].nValue = 5000000000LL - 100000;
+    txParent.vout[0].scriptPubKey = scriptPubKey;
+    CTransactionRef parent = MakeTransactionRef(txParent);
+
+    CMutableTransaction txChild;
+    txChild.vin.resize(1);
+    txChild.vin[0].prevout = COutPoint(parent->GetHash(), 0);
+    txChild.vin[0].scriptSig = CScript() << OP_1;
+    txChild.vout.resize(1);
+    txChild.vout[0].nValue = txParent.vout[0].nValue;
+    txChild.vout[0].scriptPubKey = scriptPubKey;
+    CTransactionRef child = MakeTransactionRef(txChild);
+
+    {
+        LOCK2(cs_main, mempool.cs);
+        LockPoints lp;
+        mempool.addUnchecked(CTxMemPoolEntry(parent, 100000, GetTime(), 1, false, false, 4, lp));
+        mempool.addUnchecked(CTxMemPoolEntry(child, 0, GetTime(), 1, false, false, 4, lp));
+    }
+
+    CBlockTemplate withParent(*pblocktemplate);
+    withParent.block.vtx.push_back(parent);
+    withParent.vTxFees.push_back(100000);
+    withParent.vTxSigOpsCost.push_back(4);
+    BOOST_CHECK_NO_THROW(pblocktemplateNew = AssemblerForTest(chainparams).UpdateNewBlock(withParent));
+    BOOST_CHECK(pblocktemplateNew);
+    BOOST_CHECK_EQUAL(pblocktemplateNew->block.vtx.size(), 2U);
+
+    // A template transaction that left the mempool means starting over
+    CBlockTemplate withMissing(*pblocktemplate);
+    withMissing.block.vtx.push_back(child);
+    {
+        LOCK2(cs_main, mempool.cs);
+        mempool.removeRecursive(*parent);
+    }
+    BOOST_CHECK(!AssemblerForTest(chainparams).UpdateNewBlock(withMissing));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,80 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coins.h>
+#include <memusage.h>
+#include <support/allocators/pool.h>
+#include <test/test_bitcoin.h>
+
+#include <unordered_map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(pool_resource_reuse)
+{
+    typedef PoolResource<64, 8> Resource;
+    Resource resource;
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+
+    void* a = resource.Allocate(24, 8);
+    void* b = resource.Allocate(24, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(resource.AllocatedBytes(), Resource::MIN_CHUNK_SIZE_BYTES);
+    BOOST_CHECK_EQUAL(static_cast<char*>(b) - static_cast<char*>(a), 24);
+
+    // A freed block is handed out again for the same size, not for others
+    resource.Deallocate(a, 24, 8);
+    void* c = resource.Allocate(32, 8);
+    BOOST_CHECK(c != a);
+    BOOST_CHECK(resource.Allocate(20, 8) == a);
+
+    // Too large or too strictly aligned allocations bypass the pool
+    void* large = resource.Allocate(65, 8);
+    resource.Deallocate(large, 65, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    // Chunks grow up to the maximum size
+    while (resource.NumAllocatedChunks() < 10) {
+        resource.Allocate(64, 8);
+    }
+    BOOST_CHECK(resource.AllocatedBytes() > 5 * Resource::MAX_CHUNK_SIZE_BYTES);
+}
+
+BOOST_AUTO_TEST_CASE(pool_coins_map)
+{
+    CCoinsMap map;
+    const std::shared_ptr<CCoinsMapAllocator::ResourceType> resource = map.get_allocator().resource();
+    for (uint32_t i = 0; i < 10000; ++i) {
+        map.emplace(COutPoint(InsecureRand256(), i), CCoinsCacheEntry());
+    }
+    // All nodes come from the pool
+    BOOST_CHECK(resource->AllocatedBytes() >= 10000 * sizeof(CCoinsMap::value_type));
+    const size_t usage = memusage::DynamicUsage(map);
+    BOOST_CHECK(usage >= resource->AllocatedBytes());
+
+    // Erased entries make room for new ones without growing the pool
+    const size_t allocated = resource->AllocatedBytes();
+    std::vector<COutPoint> erase;
+    for (const auto& entry : map) {
+        if (erase.size() == 5000) break;
+        erase.push_back(entry.first);
+    }
+    for (const COutPoint& outpoint : erase) {
+        map.erase(outpoint);
+    }
+    for (uint32_t i = 0; i < 5000; ++i) {
+        map.emplace(COutPoint(InsecureRand256(), i), CCoinsCacheEntry());
+    }
+    BOOST_CHECK_EQUAL(resource->AllocatedBytes(), allocated);
+
+    // Swapped maps take their pools along
+    CCoinsMap other;
+    map.swap(other);
+    BOOST_CHECK(other.get_allocator().resource() == resource);
+    BOOST_CHECK(map.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,176 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <RingSignatureMgr.h>
+#include <anonymous.h>
+#include <chainparams.h>
+#include <consensus/tx_verify.h>
+#include <consensus/validation.h>
+#include <key.h>
+#include <test/test_bitcoin.h>
+#include <txdb.h>
+#include <validation.h>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(ringsig_tests, BasicTestingSetup)
+
+static const int RING_SIZE = 3;
+
+/** Make an anon input with a ring of fresh keys, spending the one at nSecretOffset */
+static CTxIn MakeAnonInput(int nSecretOffset, CKey& keySpend)
+{
+    std::vector<CKey> keys(RING_SIZE);
+    std::vector<uint8_t> vchScript(2 + (EC_COMPRESSED_SIZE + EC_SECRET_SIZE + EC_SECRET_SIZE) * RING_SIZE);
+    vchScript[0] = OP_RETURN;
+    vchScript[1] = OP_ANON_MARKER;
+    for (int i = 0; i < RING_SIZE; ++i) {
+        keys[i].MakeNewKey(true);
+        const CPubKey pubkey = keys[i].GetPubKey();
+        std::memcpy(&vchScript[2 + i * EC_COMPRESSED_SIZE], pubkey.begin(), EC_COMPRESSED_SIZE);
+    }
+    keySpend = keys[nSecretOffset];
+
+    ec_secret secret;
+    std::memcpy(secret.e, keySpend.begin(), EC_SECRET_SIZE);
+    ec_point pkSpend(keySpend.GetPubKey().begin(), keySpend.GetPubKey().end());
+    ec_point keyImage;
+    BOOST_CHECK_EQUAL(RingSignatureMgr::GetInstance().generateKeyImage(pkSpend, secret, keyImage), 0);
+
+    CTxIn txin;
+    std::memcpy(txin.prevout.hash.begin(), &keyImage[0], EC_SECRET_SIZE);
+    txin.prevout.n = (RING_SIZE << 16) | keyImage[EC_SECRET_SIZE];
+    txin.scriptSig = CScript(vchScript.begin(), vchScript.end());
+    return txin;
+}
+
+/** Sign the anon inputs of mtx, whose pubkeys are in place already */
+static void SignAnonInputs(CMutableTransaction& mtx, const std::vector<int>& vSecretOffsets, const std::vector<CKey>& vKeys)
+{
+    uint256 preimage;
+    BOOST_CHECK_EQUAL(GetTxnPreImage(CTransaction(mtx), preimage), 0);
+    for (size_t i = 0; i < mtx.vin.size(); ++i) {
+        std::vector<uint8_t> vchScript(mtx.vin[i].scriptSig.begin(), mtx.vin[i].scriptSig.end());
+        ec_secret secret;
+        std::memcpy(secret.e, vKeys[i].begin(), EC_SECRET_SIZE);
+        ec_point keyImage;
+        mtx.vin[i].ExtractKeyImage(keyImage);
+        BOOST_CHECK_EQUAL(RingSignatureMgr::GetInstance().generateRingSignature(keyImage, preimage, RING_SIZE, vSecretOffsets[i], secret,
+            &vchScript[2], &vchScript[2 + EC_COMPRESSED_SIZE * RING_SIZE], &vchScript[2 + (EC_COMPRESSED_SIZE + EC_SECRET_SIZE) * RING_SIZE]), 0);
+        mtx.vin[i].scriptSig = CScript(vchScript.begin(), vchScript.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ringsig_verify)
+{
+    const bool fProtocolV3 = Params().GetConsensus().IsProtocolV3(0);
+
+    CMutableTransaction mtx;
+    mtx.nVersion = ANON_TXN_VERSION;
+    std::vector<int> vSecretOffsets{1, 2};
+    std::vector<CKey> vKeys(2);
+    for (size_t i = 0; i < vSecretOffsets.size(); ++i) {
+        mtx.vin.push_back(MakeAnonInput(vSecretOffsets[i], vKeys[i]));
+    }
+    mtx.vout.emplace_back(COIN, CScript() << OP_TRUE);
+    SignAnonInputs(mtx, vSecretOffsets, vKeys);
+
+    const CTransaction tx(mtx);
+    uint256 preimage;
+    BOOST_CHECK_EQUAL(GetTxnPreImage(tx, preimage), 0);
+    BOOST_CHECK(VerifyAnonInputSignature(tx.vin[0], preimage, fProtocolV3));
+    BOOST_CHECK(!VerifyAnonInputSignature(tx.vin[0], InsecureRand256(), fProtocolV3));
+    BOOST_CHECK(PreVerifyRingSignatures(tx));
+
+    // Verifications that share the manager run in parallel
+    std::vector<std::thread> threads;
+    std::atomic<int> nValid{0};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 4; ++i) {
+                // Straight to the manager, past the cache
+                std::vector<uint8_t> vchImage;
+                tx.vin[1].ExtractKeyImage(vchImage);
+                uint256 txnHash = preimage;
+                const CScript& s = tx.vin[1].scriptSig;
+                if (RingSignatureMgr::GetInstance().verifyRingSignature(vchImage, txnHash, RING_SIZE, &s[2],
+                        &s[2 + EC_COMPRESSED_SIZE * RING_SIZE], &s[2 + (EC_COMPRESSED_SIZE + EC_SECRET_SIZE) * RING_SIZE], fProtocolV3) == 0) {
+                    ++nValid;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    BOOST_CHECK_EQUAL(nValid.load(), 16);
+
+    // A changed signature no longer matches its cache entry
+    CMutableTransaction mtxBad(tx);
+    std::vector<uint8_t> vchScript(mtxBad.vin[1].scriptSig.begin(), mtxBad.vin[1].scriptSig.end());
+    vchScript.back() ^= 1;
+    mtxBad.vin[1].scriptSig = CScript(vchScript.begin(), vchScript.end());
+    const CTransaction txBad(mtxBad);
+    BOOST_CHECK(!VerifyAnonInputSignature(txBad.vin[1], preimage, fProtocolV3));
+    BOOST_CHECK(!PreVerifyRingSignatures(txBad));
+
+    // So does one claiming a ring larger than consensus allows
+    CMutableTransaction mtxRing(tx);
+    mtxRing.vin[1].prevout.n = (mtxRing.vin[1].prevout.n & 0xFFFF) | ((MAX_RING_SIZE_OLD + 1) << 16);
+    BOOST_CHECK(!PreVerifyRingSignatures(CTransaction(mtxRing)));
+}
+
+BOOST_FIXTURE_TEST_CASE(ringsig_assumevalid, TestingSetup)
+{
+    LOCK(cs_main);
+    // Deep enough for ring members at height 1 to be spent
+    CBlockIndex* const pindexBestHeaderOld = pindexBestHeader;
+    CBlockIndex header;
+    header.nHeight = 1 + MIN_ANON_SPEND_DEPTH;
+    pindexBestHeader = &header;
+
+    CMutableTransaction mtx;
+    mtx.nVersion = ANON_TXN_VERSION;
+    std::vector<int> vSecretOffsets{0, 1};
+    std::vector<CKey> vKeys(2);
+    for (size_t i = 0; i < vSecretOffsets.size(); ++i) {
+        mtx.vin.push_back(MakeAnonInput(vSecretOffsets[i], vKeys[i]));
+    }
+    mtx.vout.emplace_back(COIN, CScript() << OP_TRUE);
+    SignAnonInputs(mtx, vSecretOffsets, vKeys);
+    const CTransaction tx(mtx);
+
+    std::vector<CPubKey> vRingPubkeys;
+    for (const CTxIn& txin : tx.vin) {
+        BOOST_CHECK(ExtractRingPubkeys(txin, vRingPubkeys));
+    }
+    for (const CPubKey& pkCoin : vRingPubkeys) {
+        BOOST_CHECK(panondb->WriteAnonOutput(pkCoin, CAnonOutput(COutPoint(InsecureRand256(), 0), COIN, 1, 0)));
+    }
+
+    CMutableTransaction mtxBad(tx);
+    std::vector<uint8_t> vchScript(mtxBad.vin[1].scriptSig.begin(), mtxBad.vin[1].scriptSig.end());
+    vchScript.back() ^= 1;
+    mtxBad.vin[1].scriptSig = CScript(vchScript.begin(), vchScript.end());
+    const CTransaction txBad(mtxBad);
+
+    CValidationState state;
+    int64_t nSumAnon;
+    bool fInvalid;
+    BOOST_CHECK(Consensus::CheckAnonymousTxInputs(*panondb, tx, state, nSumAnon, fInvalid, true));
+    BOOST_CHECK_EQUAL(nSumAnon, 2 * COIN);
+    BOOST_CHECK(!Consensus::CheckAnonymousTxInputs(*panondb, txBad, state, nSumAnon, fInvalid, true));
+
+    // Under -assumevalid the signature is not verified, the ring members still are
+    BOOST_CHECK(Consensus::CheckAnonymousTxInputs(*panondb, txBad, state, nSumAnon, fInvalid, false));
+    BOOST_CHECK_EQUAL(nSumAnon, 2 * COIN);
+    BOOST_CHECK(panondb->EraseAnonOutput(vRingPubkeys.back()));
+    BOOST_CHECK(!Consensus::CheckAnonymousTxInputs(*panondb, txBad, state, nSumAnon, fInvalid, false));
+
+    pindexBestHeader = pindexBestHeaderOld;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #include <rpc/server.h>
 #include <rpc/client.h>
+#include <rpc/jsonstream.h>
 #include <rpc/util.h>
 
 #include <core_io.h>
@@ -420,4 +421,61 @@ BOOST_AUTO_TEST_CASE(rpc_getblockstats_calculate_percentiles_by_weight)
     }
 }
 
+BOOST_AUTO_TEST_CASE(rpc_json_stream_writer)
+{
+    UniValue expected(UniValue::VOBJ);
+    expected.pushKV("a\"b", 1);
+    expected.pushKV("empty", UniValue(UniValue::VARR));
+    UniValue arr(UniValue::VARR);
+    for (int i = 0; i < 100; i++) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("n", i);
+        obj.pushKV("s", std::string(i, 'x'));
+        arr.push_back(obj);
+    }
+    expected.pushKV("arr", arr);
+    expected.pushKV("null", NullUniValue);
+
+    std::string out;
+    JSONStreamWriter stream([&out](const std::string& chunk) {
+        out += chunk;
+        return true;
+    }, 256);
+    BOOST_CHECK(!stream.AwaitingValue());
+    stream.BeginObject();
+    stream.KV("a\"b", 1);
+    stream.Key("empty");
+    BOOST_CHECK(stream.AwaitingValue());
+    stream.BeginArray();
+    BOOST_CHECK(!stream.AwaitingValue());
+    stream.EndArray();
+    stream.Key("arr");
+    stream.BeginArray();
+    for (size_t i = 0; i < arr.size(); i++) {
+        stream.Value(arr[i]);
+        stream.MaybeFlush();
+    }
+    stream.EndArray();
+    stream.KV("null", NullUniValue);
+    stream.EndObject();
+    BOOST_CHECK(stream.Flushed());
+    BOOST_CHECK(!stream.Failed());
+    out += stream.TakeBuffer();
+    BOOST_CHECK_EQUAL(out, expected.write());
+
+    // Nothing reaches a sink that went away
+    size_t calls = 0;
+    JSONStreamWriter failing([&calls](const std::string& chunk) {
+        ++calls;
+        return false;
+    }, 1);
+    failing.BeginArray();
+    failing.Value(1);
+    failing.MaybeFlush();
+    failing.Value(2);
+    failing.MaybeFlush();
+    BOOST_CHECK(failing.Failed());
+    BOOST_CHECK_EQUAL(calls, 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
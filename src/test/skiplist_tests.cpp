@@ -176,4 +176,43 @@ BOOST_AUTO_TEST_CASE(findearliestatleast_edge_test)
     BOOST_CHECK(!chain.FindEarliestAtLeast(int64_t(std::numeric_limits<unsigned int>::max()) + 1));
 }
 
+BOOST_AUTO_TEST_CASE(blockindex_slabs_test)
+{
+    // A chain over several slabs, whose entries must not move as it grows
+    const int length = CBlockIndexSlabs::SLAB_ENTRIES * 3 + 10;
+    CBlockIndexSlabs slabs;
+    std::vector<CBlockIndex*> vIndex;
+    for (int i = 0; i < length; i++) {
+        CBlockIndex* pindex = slabs.New();
+        pindex->nHeight = i;
+        pindex->pprev = (i == 0) ? nullptr : vIndex.back();
+        pindex->BuildSkip();
+        vIndex.push_back(pindex);
+    }
+    BOOST_CHECK_EQUAL(slabs.Size(), (size_t)length);
+    BOOST_CHECK(slabs.DynamicMemoryUsage() >= length * sizeof(CBlockIndex));
+
+    CChain chain;
+    chain.SetTip(vIndex.back());
+    for (int i = 0; i < length; i++) {
+        BOOST_CHECK_EQUAL(vIndex[i]->nHeight, i);
+        BOOST_CHECK(chain[i] == vIndex[i]);
+        if (i > 0) {
+            BOOST_CHECK(vIndex[i]->pskip == vIndex[vIndex[i]->pskip->nHeight]);
+        }
+    }
+    for (int i = 0; i < 100; i++) {
+        int from = InsecureRandRange(length);
+        int to = InsecureRandRange(from + 1);
+        BOOST_CHECK(vIndex[from]->GetAncestor(to) == vIndex[to]);
+    }
+
+    CBlock block;
+    block.nTime = 42;
+    BOOST_CHECK_EQUAL(slabs.New(block)->nTime, 42U);
+
+    slabs.Clear();
+    BOOST_CHECK_EQUAL(slabs.Size(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
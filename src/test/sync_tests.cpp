@@ -5,6 +5,8 @@
 #include <sync.h>
 #include <test/test_bitcoin.h>
 
+#include <thread>
+
 #include <boost/test/unit_test.hpp>
 
 namespace {
@@ -49,4 +51,50 @@ BOOST_AUTO_TEST_CASE(potential_deadlock_detected)
     #endif
 }
 
+BOOST_AUTO_TEST_CASE(lock_stats)
+{
+    const bool prev = g_lock_stats;
+    g_lock_stats = true;
+    ResetLockStats();
+
+    Mutex mutex;
+    int line_uncontended = __LINE__ + 1;
+    { LOCK(mutex); }
+
+    std::atomic<bool> held{false};
+    std::thread holder([&] {
+        LOCK(mutex);
+        held = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    });
+    while (!held) std::this_thread::yield();
+    int line_contended = __LINE__ + 1;
+    { LOCK(mutex); }
+    holder.join();
+
+    bool found_uncontended = false, found_contended = false;
+    for (const LockSiteStats& site : GetLockStats()) {
+        if (site.name != "mutex" || site.file != __FILE__) continue;
+        if (site.line == line_uncontended) {
+            found_uncontended = true;
+            BOOST_CHECK_EQUAL(site.locks, 1U);
+            BOOST_CHECK_EQUAL(site.contended, 0U);
+            BOOST_CHECK_EQUAL(site.wait_histogram[0], 1U);
+        } else if (site.line == line_contended) {
+            found_contended = true;
+            BOOST_CHECK_EQUAL(site.contended, 1U);
+            BOOST_CHECK(site.wait_ns > 0);
+            BOOST_CHECK_EQUAL(site.wait_max_ns, site.wait_ns);
+        }
+    }
+    BOOST_CHECK(found_uncontended);
+    BOOST_CHECK(found_contended);
+
+    ResetLockStats();
+    for (const LockSiteStats& site : GetLockStats()) {
+        BOOST_CHECK(site.file != __FILE__);
+    }
+    g_lock_stats = prev;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
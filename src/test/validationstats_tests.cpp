@@ -0,0 +1,94 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/test_bitcoin.h>
+#include <validationstats.h>
+
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(validationstats_tests, BasicTestingSetup)
+
+static const ValidationStageStats& GetStage(const std::vector<ValidationStageStats>& stages, const std::string& name)
+{
+    for (const ValidationStageStats& stage : stages) {
+        if (stage.name == name) return stage;
+    }
+    BOOST_FAIL("stage " + name + " not found");
+    return stages.front();
+}
+
+BOOST_AUTO_TEST_CASE(validationstats_percentiles)
+{
+    ResetValidationStats();
+    for (int i = 1; i <= 1000; ++i) {
+        RecordValidationTime(ValidationStage::RING_SIGNATURE, i);
+    }
+    RecordValidationTime(ValidationStage::ANON_LOOKUP, 2);
+
+    std::vector<ValidationStageStats> stages = GetValidationStats();
+    BOOST_CHECK_EQUAL(stages.size(), (size_t)ValidationStage::COUNT);
+
+    const ValidationStageStats& ring = GetStage(stages, "ring_signature");
+    BOOST_CHECK_EQUAL(ring.count, 1000U);
+    BOOST_CHECK_EQUAL(ring.total_us, 500500U);
+    BOOST_CHECK_EQUAL(ring.max_us, 1000U);
+    // Percentiles are rounded up to the end of their bucket, a quarter of a power of two
+    BOOST_CHECK(ring.Percentile(0.5) >= 500 && ring.Percentile(0.5) <= 625);
+    BOOST_CHECK(ring.Percentile(0.9) >= 900 && ring.Percentile(0.9) <= 1000);
+    BOOST_CHECK_EQUAL(ring.Percentile(1.0), 1000U);
+
+    // Small latencies are exact
+    const ValidationStageStats& lookup = GetStage(stages, "anon_lookup");
+    BOOST_CHECK_EQUAL(lookup.count, 1U);
+    BOOST_CHECK_EQUAL(lookup.Percentile(0.5), 2U);
+
+    const ValidationStageStats& tip = GetStage(stages, "connect_tip");
+    BOOST_CHECK_EQUAL(tip.count, 0U);
+    BOOST_CHECK_EQUAL(tip.Percentile(0.5), 0U);
+
+    {
+        ValidationStageTimer timer(ValidationStage::CONNECT_TIP);
+    }
+    BOOST_CHECK_EQUAL(GetStage(GetValidationStats(), "connect_tip").count, 1U);
+
+    ResetValidationStats();
+    BOOST_CHECK_EQUAL(GetStage(GetValidationStats(), "ring_signature").count, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(validationstats_connect_block_scope)
+{
+    ResetValidationStats();
+    BOOST_CHECK(!ConnectBlockStatsScope::InScope());
+    {
+        ValidationStageTimer timer(ValidationStage::ANON_LOOKUP, ConnectBlockStatsScope::InScope());
+    }
+    BOOST_CHECK_EQUAL(GetStage(GetValidationStats(), "anon_lookup").count, 0U);
+
+#ifdef HAVE_THREAD_LOCAL
+    {
+        ConnectBlockStatsScope scope(true);
+        BOOST_CHECK(ConnectBlockStatsScope::InScope());
+        {
+            ValidationStageTimer timer(ValidationStage::ANON_LOOKUP, ConnectBlockStatsScope::InScope());
+        }
+        {
+            // Checking a block template isn't counted
+            ConnectBlockStatsScope inner(false);
+            BOOST_CHECK(!ConnectBlockStatsScope::InScope());
+        }
+        BOOST_CHECK(ConnectBlockStatsScope::InScope());
+
+        // Other threads aren't connecting a block
+        bool fOtherInScope = true;
+        std::thread([&fOtherInScope] { fOtherInScope = ConnectBlockStatsScope::InScope(); }).join();
+        BOOST_CHECK(!fOtherInScope);
+    }
+    BOOST_CHECK(!ConnectBlockStatsScope::InScope());
+    BOOST_CHECK_EQUAL(GetStage(GetValidationStats(), "anon_lookup").count, 1U);
+#endif
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -14,6 +14,8 @@
 #include <uint256.h>
 #include <util/system.h>
 #include <ui_interface.h>
+#include <validation.h>
+#include <validationstats.h>
 
 #include <stdint.h>
 
@@ -30,6 +32,9 @@ static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 
+//! Anon records read per thread by CAnonDB::PrefetchAnon()
+static const size_t MIN_ANON_PREFETCH_PER_THREAD = 8;
+
 namespace {
 
 struct CoinEntry {
@@ -82,6 +87,12 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    bool ret = WriteCoins(mapCoins, hashBlock);
+    mapCoins.clear();
+    return ret;
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -106,7 +117,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); ++it) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             CoinEntry entry(&it->first);
             if (it->second.coin.IsSpent())
@@ -116,8 +127,6 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -147,6 +156,129 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsView* view, CCoinsViewDB* db) : CCoinsViewBacked(view), m_db(db)
+{
+    m_thread = std::thread(&CCoinsViewBackgroundFlush::ThreadWrite, this);
+}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush()
+{
+    {
+        LOCK(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+}
+
+bool CCoinsViewBackgroundFlush::GetCoin(const COutPoint &outpoint, Coin &coin) const
+{
+    {
+        LOCK(m_mutex);
+        CCoinsMap::const_iterator it = m_frozen.find(outpoint);
+        if (it != m_frozen.end()) {
+            // Spent entries have to hide the coin the database may still have
+            if (it->second.coin.IsSpent()) return false;
+            coin = it->second.coin;
+            return true;
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoin(const COutPoint &outpoint) const
+{
+    {
+        LOCK(m_mutex);
+        CCoinsMap::const_iterator it = m_frozen.find(outpoint);
+        if (it != m_frozen.end()) {
+            return !it->second.coin.IsSpent();
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const
+{
+    {
+        LOCK(m_mutex);
+        if (!m_frozen_block.IsNull()) return m_frozen_block;
+    }
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (m_writing) m_cond.wait(lock);
+    if (m_failed) return false;
+
+    assert(m_frozen.empty());
+    m_frozen.swap(mapCoins);
+    m_frozen_block = hashBlock;
+    m_frozen_usage = memusage::DynamicUsage(m_frozen);
+    for (const auto& entry : m_frozen) {
+        m_frozen_usage += entry.second.coin.DynamicMemoryUsage();
+    }
+    m_writing = true;
+    m_cond.notify_all();
+    return true;
+}
+
+bool CCoinsViewBackgroundFlush::WaitForFlush()
+{
+    WAIT_LOCK(m_mutex, lock);
+    while (m_writing) m_cond.wait(lock);
+    return !m_failed;
+}
+
+size_t CCoinsViewBackgroundFlush::DynamicMemoryUsage() const
+{
+    LOCK(m_mutex);
+    return m_frozen_usage;
+}
+
+void CCoinsViewBackgroundFlush::ThreadWrite()
+{
+    RenameThread("bitcoin-coinsflush");
+    while (true) {
+        uint256 hashBlock;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            while (!m_writing && !m_stop) m_cond.wait(lock);
+            if (!m_writing) return;
+            hashBlock = m_frozen_block;
+        }
+
+        // m_frozen is not changed while m_writing is set, so it can be read
+        // without holding m_mutex, alongside lookups.
+        const int64_t nStart = GetTimeMillis();
+        bool fOk;
+        try {
+            fOk = m_db->WriteCoins(m_frozen, hashBlock);
+        } catch (const std::runtime_error& e) {
+            LogPrintf("%s: Error writing coin database: %s\n", __func__, e.what());
+            fOk = false;
+        }
+        LogPrint(BCLog::COINDB, "Background write of coins for %s: %dms\n", hashBlock.ToString(), GetTimeMillis() - nStart);
+
+        CCoinsMap written;
+        {
+            LOCK(m_mutex);
+            if (fOk) {
+                m_frozen.swap(written);
+                m_frozen_block.SetNull();
+                m_frozen_usage = 0;
+            } else {
+                // Keep serving the coins, the node is shut down on the next flush
+                m_failed = true;
+            }
+            m_writing = false;
+        }
+        m_cond.notify_all();
+    }
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe) {
 }
 
@@ -170,12 +302,18 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 }
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
+{
+    return Cursor(uint256());
+}
+
+CCoinsViewCursor *CCoinsViewDB::Cursor(const uint256 &hashStart) const
 {
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COIN);
+    const COutPoint start(hashStart, 0);
+    i->pcursor->Seek(CoinEntry(&start));
     // Cache key of first record
     if (i->pcursor->Valid()) {
         CoinEntry entry(&i->keyTmp.second);
@@ -260,8 +398,11 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
         if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
             CDiskBlockIndex diskindex;
             if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
+                // Construct block index object. The key holds the block hash,
+                // so the header isn't hashed again, which takes scrypt for
+                // blocks before version 7. CheckBlockIndexHashes() does that
+                // under -checkblockindex.
+                CBlockIndex* pindexNew = insertBlockIndex(key.second);
                 pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
                 pindexNew->nHeight        = diskindex.nHeight;
                 pindexNew->nFile          = diskindex.nFile;
@@ -291,34 +432,190 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
     return true;
 }
 
-bool CBlockTreeDB::WriteKeyImage(const ec_point& keyImage, const CKeyImageSpent& keyImageSpent)
+CAnonDB::CAnonDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "anon", nCacheSize, fMemory, fWipe), m_cache_size(nCacheSize) {
+}
+
+// Out of line, the prefetched records are incomplete types in the header
+CAnonDB::~CAnonDB() {}
+
+bool CAnonDB::WriteKeyImage(const ec_point& keyImage, const CKeyImageSpent& keyImageSpent)
 {
-    return Write(std::make_pair(std::string("ki"), keyImage), keyImageSpent);
+    bool ret = Write(std::make_pair(std::string("ki"), keyImage), keyImageSpent);
+    LOCK(m_prefetch_mutex);
+    m_prefetched_key_images.erase(keyImage);
+    m_anon_writes++;
+    return ret;
 }
 
-bool CBlockTreeDB::ReadKeyImage(const ec_point& keyImage, CKeyImageSpent& keyImageSpent)
+bool CAnonDB::ReadKeyImage(const ec_point& keyImage, CKeyImageSpent& keyImageSpent)
 {
+    ValidationStageTimer timer(ValidationStage::ANON_LOOKUP, ConnectBlockStatsScope::InScope());
+    {
+        LOCK(m_prefetch_mutex);
+        auto it = m_prefetched_key_images.find(keyImage);
+        if (it != m_prefetched_key_images.end()) {
+            if (!it->second) return false;
+            keyImageSpent = *it->second;
+            return true;
+        }
+    }
     return Read(std::make_pair(std::string("ki"), keyImage), keyImageSpent);
 }
 
-bool CBlockTreeDB::EraseKeyImage(const ec_point& keyImage)
+bool CAnonDB::EraseKeyImage(const ec_point& keyImage)
 {
-    return Erase(std::make_pair(std::string("ki"), keyImage));
+    bool ret = Erase(std::make_pair(std::string("ki"), keyImage));
+    LOCK(m_prefetch_mutex);
+    m_prefetched_key_images.erase(keyImage);
+    m_anon_writes++;
+    return ret;
 }
 
-bool CBlockTreeDB::WriteAnonOutput(const CPubKey& pkCoin, const CAnonOutput& ao)
+bool CAnonDB::WriteAnonOutput(const CPubKey& pkCoin, const CAnonOutput& ao)
 {
-    return Write(std::make_pair(std::string("ao"), pkCoin), ao);
+    bool ret = Write(std::make_pair(std::string("ao"), pkCoin), ao);
+    LOCK(m_prefetch_mutex);
+    m_prefetched_anon_outputs.erase(pkCoin);
+    m_anon_writes++;
+    return ret;
 }
 
-bool CBlockTreeDB::ReadAnonOutput(const CPubKey& pkCoin, CAnonOutput& ao)
+bool CAnonDB::ReadAnonOutput(const CPubKey& pkCoin, CAnonOutput& ao)
 {
+    ValidationStageTimer timer(ValidationStage::ANON_LOOKUP, ConnectBlockStatsScope::InScope());
+    {
+        LOCK(m_prefetch_mutex);
+        auto it = m_prefetched_anon_outputs.find(pkCoin);
+        if (it != m_prefetched_anon_outputs.end()) {
+            if (!it->second) return false;
+            ao = *it->second;
+            return true;
+        }
+    }
     return Read(std::make_pair(std::string("ao"), pkCoin), ao);
 }
 
-bool CBlockTreeDB::EraseAnonOutput(const CPubKey& pkCoin)
+bool CAnonDB::EraseAnonOutput(const CPubKey& pkCoin)
+{
+    bool ret = Erase(std::make_pair(std::string("ao"), pkCoin));
+    LOCK(m_prefetch_mutex);
+    m_prefetched_anon_outputs.erase(pkCoin);
+    m_anon_writes++;
+    return ret;
+}
+
+void CAnonDB::PrefetchAnon(const std::vector<CPubKey>& anonOutputs, const std::vector<ec_point>& keyImages)
+{
+    uint64_t nWrites;
+    {
+        LOCK(m_prefetch_mutex);
+        m_prefetched_anon_outputs.clear();
+        m_prefetched_key_images.clear();
+        nWrites = m_anon_writes;
+    }
+
+    const size_t nReads = anonOutputs.size() + keyImages.size();
+    if (nReads == 0) return;
+
+    std::vector<std::unique_ptr<CAnonOutput>> vOutputs(anonOutputs.size());
+    std::vector<std::unique_ptr<CKeyImageSpent>> vKeyImages(keyImages.size());
+    const bool fOk = ParallelFor(nReads, MIN_ANON_PREFETCH_PER_THREAD, [&](size_t i) {
+        try {
+            if (i < anonOutputs.size()) {
+                std::unique_ptr<CAnonOutput> ao(new CAnonOutput());
+                if (Read(std::make_pair(std::string("ao"), anonOutputs[i]), *ao)) vOutputs[i] = std::move(ao);
+            } else {
+                const size_t k = i - anonOutputs.size();
+                std::unique_ptr<CKeyImageSpent> kis(new CKeyImageSpent());
+                if (Read(std::make_pair(std::string("ki"), keyImages[k]), *kis)) vKeyImages[k] = std::move(kis);
+            }
+        } catch (const std::exception& e) {
+            // Leave the error to the lookup on the validation thread
+            LogPrintf("%s: %s\n", __func__, e.what());
+            return false;
+        }
+        return true;
+    });
+
+    LOCK(m_prefetch_mutex);
+    // A record written while reading may have been read before the write
+    if (!fOk || m_anon_writes != nWrites) return;
+    for (size_t i = 0; i < anonOutputs.size(); ++i) {
+        m_prefetched_anon_outputs.emplace(anonOutputs[i], std::move(vOutputs[i]));
+    }
+    for (size_t k = 0; k < keyImages.size(); ++k) {
+        m_prefetched_key_images.emplace(keyImages[k], std::move(vKeyImages[k]));
+    }
+}
+
+size_t CAnonDB::PrefetchedCount()
 {
-    return Erase(std::make_pair(std::string("ao"), pkCoin));
+    LOCK(m_prefetch_mutex);
+    return m_prefetched_anon_outputs.size() + m_prefetched_key_images.size();
+}
+
+/**
+ * Move the records under prefix from the block tree db. Each batch is synced
+ * to the anon db before it is erased from the block tree db, so a migration
+ * that is cut short picks up where it stopped on the next start.
+ */
+template <typename K, typename V>
+static bool MigrateAnonRecords(CAnonDB& anondb, CBlockTreeDB& block_tree_db, const std::string& prefix, int64_t& count)
+{
+    const size_t batch_size = 1 << 24; // 16 MiB
+    CDBBatch batch_newdb(anondb);
+    CDBBatch batch_olddb(block_tree_db);
+
+    std::pair<std::string, K> key;
+    std::pair<std::string, K> first_key;
+    bool moved = false;
+    std::unique_ptr<CDBIterator> cursor(block_tree_db.NewIterator());
+    for (cursor->Seek(prefix); cursor->Valid(); cursor->Next()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested()) {
+            break;
+        }
+        if (!cursor->GetKey(key) || key.first != prefix) {
+            break;
+        }
+        V value;
+        if (!cursor->GetValue(value)) {
+            return error("%s: cannot parse %s record", __func__, prefix);
+        }
+        if (!moved) first_key = key;
+        moved = true;
+        batch_newdb.Write(key, value);
+        batch_olddb.Erase(key);
+
+        if (++count % 100000 == 0) {
+            LogPrintf("Upgrading anon database... [%d records]\n", count);
+        }
+        if (batch_newdb.SizeEstimate() > batch_size || batch_olddb.SizeEstimate() > batch_size) {
+            anondb.WriteBatch(batch_newdb, /*fSync=*/ true);
+            block_tree_db.WriteBatch(batch_olddb);
+            batch_newdb.Clear();
+            batch_olddb.Clear();
+        }
+    }
+    if (!moved) return true;
+
+    anondb.WriteBatch(batch_newdb, /*fSync=*/ true);
+    block_tree_db.WriteBatch(batch_olddb);
+    block_tree_db.CompactRange(first_key, key);
+    return true;
+}
+
+bool CAnonDB::MigrateData(CBlockTreeDB& block_tree_db)
+{
+    int64_t count = 0;
+    if (!MigrateAnonRecords<CPubKey, CAnonOutput>(*this, block_tree_db, "ao", count) ||
+        !MigrateAnonRecords<ec_point, CKeyImageSpent>(*this, block_tree_db, "ki", count)) {
+        return false;
+    }
+    if (count > 0) {
+        LogPrintf("Upgrading anon database... %s, moved %d records.\n", ShutdownRequested() ? "[CANCELLED]" : "[DONE]", count);
+    }
+    return true;
 }
 
 namespace {
@@ -10,10 +10,13 @@
 #include <dbwrapper.h>
 #include <chain.h>
 #include <primitives/block.h>
+#include <sync.h>
 
+#include <condition_variable>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -41,6 +44,8 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! -anondbcache default (MiB)
+static const int64_t nDefaultAnonDbCache = 32;
 
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB final : public CCoinsView
@@ -56,12 +61,63 @@ public:
     std::vector<uint256> GetHeadBlocks() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
+    //! Cursor that starts at the first coin of the transaction hashStart, or the one after it
+    CCoinsViewCursor *Cursor(const uint256 &hashStart) const;
+
+    //! Write the dirty entries of mapCoins like BatchWrite, but leave mapCoins as it is
+    bool WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock);
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
 };
 
+/**
+ * CCoinsView that writes flushed coins to the coin database from a background
+ * thread, so blocks can be connected while the previous cache is written.
+ *
+ * BatchWrite() takes the flushed entries over as a frozen layer and returns
+ * right away. Until they are written, lookups find them here before reaching
+ * the database. Only one layer is written at a time, a BatchWrite() while one
+ * is in progress waits for it. A crash during the write is recovered from like
+ * one during a synchronous flush, through the head blocks CCoinsViewDB records.
+ */
+class CCoinsViewBackgroundFlush final : public CCoinsViewBacked
+{
+public:
+    //! Reads fall through to view, writes go to db
+    CCoinsViewBackgroundFlush(CCoinsView* view, CCoinsViewDB* db);
+    ~CCoinsViewBackgroundFlush();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+
+    //! Wait until the coins handed over so far are written. Returns false if that failed.
+    bool WaitForFlush();
+    //! Memory taken up by the coins that are being written
+    size_t DynamicMemoryUsage() const;
+
+private:
+    void ThreadWrite();
+
+    CCoinsViewDB* const m_db;
+
+    mutable Mutex m_mutex;
+    std::condition_variable m_cond;
+    //! Coins being written. Only changed under m_mutex while m_writing is
+    //! false, the writer thread reads it without the lock.
+    CCoinsMap m_frozen;
+    //! Best block of m_frozen, null once it is written
+    uint256 m_frozen_block GUARDED_BY(m_mutex);
+    size_t m_frozen_usage GUARDED_BY(m_mutex) = 0;
+    bool m_writing GUARDED_BY(m_mutex) = false;
+    bool m_failed GUARDED_BY(m_mutex) = false;
+    bool m_stop GUARDED_BY(m_mutex) = false;
+    std::thread m_thread;
+};
+
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
 class CCoinsViewDBCursor: public CCoinsViewCursor
 {
@@ -98,6 +154,20 @@ public:
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+};
+
+/**
+ * Access to the anon output and key image database (anon/)
+ *
+ * Kept apart from the block tree database, which older versions stored these
+ * records in, so that they get a cache of their own (-anondbcache) and are
+ * not evicted by block index and file info reads.
+ */
+class CAnonDB : public CDBWrapper
+{
+public:
+    explicit CAnonDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CAnonDB();
 
     bool WriteKeyImage(const ec_point& keyImage, const CKeyImageSpent& keyImageSpent);
     bool ReadKeyImage(const ec_point& keyImage, CKeyImageSpent& keyImageSpent);
@@ -106,6 +176,31 @@ public:
     bool WriteAnonOutput(const CPubKey& pkCoin, const CAnonOutput& ao);
     bool ReadAnonOutput(const CPubKey& pkCoin, CAnonOutput& ao);
     bool EraseAnonOutput(const CPubKey& pkCoin);
+
+    /**
+     * Read the anon outputs and key images a block is about to look up, on
+     * the ParallelFor() threads, and keep them in memory for ReadAnonOutput()
+     * and ReadKeyImage(). Replaces whatever was prefetched before.
+     */
+    void PrefetchAnon(const std::vector<CPubKey>& anonOutputs, const std::vector<ec_point>& keyImages);
+
+    /** Move the records older versions kept in the block tree db over */
+    bool MigrateData(CBlockTreeDB& block_tree_db);
+
+    //! Cache size the database was opened with (bytes)
+    size_t CacheSize() const { return m_cache_size; }
+    //! Number of records PrefetchAnon() currently holds
+    size_t PrefetchedCount();
+
+private:
+    const size_t m_cache_size;
+
+    Mutex m_prefetch_mutex;
+    //! Prefetched records, null for the ones that don't exist
+    std::map<CPubKey, std::unique_ptr<CAnonOutput>> m_prefetched_anon_outputs GUARDED_BY(m_prefetch_mutex);
+    std::map<ec_point, std::unique_ptr<CKeyImageSpent>> m_prefetched_key_images GUARDED_BY(m_prefetch_mutex);
+    //! Bumped by every anon write, so a prefetch racing with one is dropped
+    uint64_t m_anon_writes GUARDED_BY(m_prefetch_mutex) = 0;
 };
 
 #endif // BITCOIN_TXDB_H
@@ -5,6 +5,7 @@
 
 #include <validation.h>
 
+#include <anonymous.h>
 #include <arith_uint256.h>
 #include <chain.h>
 #include <chainparams.h>
@@ -39,6 +40,7 @@
 #include <util/moneystr.h>
 #include <util/strencodings.h>
 #include <validationinterface.h>
+#include <validationstats.h>
 #include <warnings.h>
 #include <wallet/wallet.h>
 
@@ -154,6 +156,7 @@ private:
 public:
     CChain chainActive;
     BlockMap mapBlockIndex;
+    CBlockIndexSlabs blockIndexSlabs;
     std::multimap<CBlockIndex*, CBlockIndex*> mapBlocksUnlinked;
     CBlockIndex *pindexBestInvalid = nullptr;
 
@@ -224,6 +227,7 @@ private:
 RecursiveMutex cs_main;
 
 BlockMap& mapBlockIndex = g_chainstate.mapBlockIndex;
+CBlockIndexSlabs& blockIndexSlabs = g_chainstate.blockIndexSlabs;
 CChain& chainActive = g_chainstate.chainActive;
 CBlockIndex *pindexBestHeader = nullptr;
 Mutex g_best_block_mutex;
@@ -303,8 +307,10 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 std::unique_ptr<CCoinsViewDB> pcoinsdbview;
+std::unique_ptr<CCoinsViewBackgroundFlush> pcoinsflusher;
 std::unique_ptr<CCoinsViewCache> pcoinsTip;
 std::unique_ptr<CBlockTreeDB> pblocktree;
+std::unique_ptr<CAnonDB> panondb;
 
 enum class FlushStateMode {
     NONE,
@@ -1548,7 +1554,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                 int64_t nSumAnon;
                 bool    isInvalid;
 
-                if (!Consensus::CheckAnonymousTxInputs(*pblocktree, tx, state, nSumAnon, isInvalid))
+                if (!Consensus::CheckAnonymousTxInputs(*panondb, tx, state, nSumAnon, isInvalid, true))
                 {
                     return state.DoS(100, false, REJECT_INVALID, "bad-txns-check-anon-tx-inputs");
                 }
@@ -1595,7 +1601,9 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
+} // namespace
+
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
 {
     CDiskBlockPos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
@@ -1626,6 +1634,8 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
     return true;
 }
 
+namespace {
+
 /** Abort with a message */
 static bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -1795,6 +1805,133 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/** Closure verifying the ring signature of one anon input, for PreVerifyRingSignatures() */
+class CRingSignatureCheck
+{
+private:
+    const CTransaction *ptx;
+    unsigned int nIn;
+    uint256 preimage;
+    bool fProtocolV3;
+
+public:
+    CRingSignatureCheck(): ptx(nullptr), nIn(0), fProtocolV3(false) {}
+    CRingSignatureCheck(const CTransaction& txIn, unsigned int nInIn, const uint256& preimageIn, bool fProtocolV3In) :
+        ptx(&txIn), nIn(nInIn), preimage(preimageIn), fProtocolV3(fProtocolV3In) { }
+
+    bool operator()() { return VerifyAnonInputSignature(ptx->vin[nIn], preimage, fProtocolV3); }
+
+    void swap(CRingSignatureCheck &check) {
+        std::swap(ptx, check.ptx);
+        std::swap(nIn, check.nIn);
+        std::swap(preimage, check.preimage);
+        std::swap(fProtocolV3, check.fProtocolV3);
+    }
+};
+
+//! A ring signature takes milliseconds to verify, so workers take few at a time
+static CCheckQueue<CRingSignatureCheck> ringsigcheckqueue(4);
+
+void ThreadRingSignatureCheck() {
+    RenameThread("bitcoin-ringsig");
+    ringsigcheckqueue.Thread();
+}
+
+bool PreVerifyRingSignatures(const CTransaction& tx)
+{
+    if (!tx.IsAnon())
+        return true;
+
+    uint256 preimage;
+    if (GetTxnPreImage(tx, preimage) != 0)
+        return false;
+
+    // Only held for reading the height, which selects the signature scheme
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = pindexBestHeader ? pindexBestHeader->nHeight : 0;
+    }
+    const bool fProtocolV3 = Params().GetConsensus().IsProtocolV3(nHeight);
+
+    std::vector<CRingSignatureCheck> vChecks;
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        if (tx.vin[i].IsAnonInput()) {
+            // Same bounds as CheckAnonInputs(), checked before any work is queued
+            const int nRingSize = tx.vin[i].ExtractRingSize();
+            if (nRingSize < 1 || nRingSize > (fProtocolV3 ? (int)MAX_RING_SIZE : (int)MAX_RING_SIZE_OLD))
+                return false;
+            vChecks.emplace_back(tx, i, preimage, fProtocolV3);
+        }
+    }
+
+    if (!nScriptCheckThreads || vChecks.size() < 2) {
+        for (CRingSignatureCheck& check : vChecks) {
+            if (!check()) return false;
+        }
+        return true;
+    }
+
+    CCheckQueueControl<CRingSignatureCheck> control(&ringsigcheckqueue);
+    control.Add(vChecks);
+    return control.Wait();
+}
+
+/** Closure calling a ParallelFor() function on a range of indices */
+class CRangeCheck
+{
+private:
+    const std::function<bool(size_t)> *pfn;
+    size_t nBegin;
+    size_t nEnd;
+
+public:
+    CRangeCheck(): pfn(nullptr), nBegin(0), nEnd(0) {}
+    CRangeCheck(const std::function<bool(size_t)>& fnIn, size_t nBeginIn, size_t nEndIn) :
+        pfn(&fnIn), nBegin(nBeginIn), nEnd(nEndIn) { }
+
+    bool operator()() {
+        for (size_t i = nBegin; i < nEnd; ++i) {
+            if (!(*pfn)(i)) return false;
+        }
+        return true;
+    }
+
+    void swap(CRangeCheck &check) {
+        std::swap(pfn, check.pfn);
+        std::swap(nBegin, check.nBegin);
+        std::swap(nEnd, check.nEnd);
+    }
+};
+
+//! The ranges are sized for the threads already, so workers take one at a time
+static CCheckQueue<CRangeCheck> prefetchqueue(1);
+
+void ThreadPrefetch() {
+    RenameThread("bitcoin-prefetch");
+    prefetchqueue.Thread();
+}
+
+bool ParallelFor(size_t nCount, size_t nMinPerThread, const std::function<bool(size_t)>& fn)
+{
+    const size_t nRanges = std::min<size_t>(GetNumCores(), nCount / std::max<size_t>(nMinPerThread, 1));
+    if (nRanges <= 1) {
+        for (size_t i = 0; i < nCount; ++i) {
+            if (!fn(i)) return false;
+        }
+        return true;
+    }
+
+    std::vector<CRangeCheck> vChecks;
+    vChecks.reserve(nRanges);
+    for (size_t r = 0; r < nRanges; ++r) {
+        vChecks.emplace_back(fn, nCount * r / nRanges, nCount * (r + 1) / nRanges);
+    }
+    CCheckQueueControl<CRangeCheck> control(&prefetchqueue);
+    control.Add(vChecks);
+    return control.Wait();
+}
+
 VersionBitsCache versionbitscache GUARDED_BY(cs_main);
 
 int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params)
@@ -1932,6 +2069,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     assert(pindex);
     assert(*pindex->phashBlock == block.GetHash());
     int64_t nTimeStart = GetTimeMicros();
+    ConnectBlockStatsScope stats_scope(!fJustCheck);
 
     // Check it again in case a previous version let a bad block in
     // NOTE: We don't currently (re-)invoke ContextualCheckBlock() or
@@ -1997,6 +2135,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
     int64_t nTime1 = GetTimeMicros(); nTimeCheck += nTime1 - nTimeStart;
+    if (!fJustCheck) RecordValidationTime(ValidationStage::CHECK_BLOCK, nTime1 - nTimeStart);
     LogPrint(BCLog::BENCH, "    - Sanity checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime1 - nTimeStart), nTimeCheck * MICRO, nTimeCheck * MILLI / nBlocksTotal);
 
     // TokenPay: enable overwrite verification regardless
@@ -2113,6 +2252,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     unsigned int flags = GetBlockScriptFlags(pindex, chainparams.GetConsensus());
 
     int64_t nTime2 = GetTimeMicros(); nTimeForks += nTime2 - nTime1;
+    if (!fJustCheck) RecordValidationTime(ValidationStage::FORK_CHECKS, nTime2 - nTime1);
     LogPrint(BCLog::BENCH, "    - Fork checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime2 - nTime1), nTimeForks * MICRO, nTimeForks * MILLI / nBlocksTotal);
 
     CBlockUndo blockundo;
@@ -2135,7 +2275,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         if (!tx.IsCoinBase() && !tx.IsCoinStake())
         {
             CAmount txfee = 0;
-            if (!Consensus::CheckTxInputs(tx, state, view, pindex->nHeight, txfee)) {
+            // Ring signatures are covered by -assumevalid like scripts, the other anon input checks are not
+            if (!Consensus::CheckTxInputs(tx, state, view, pindex->nHeight, txfee, fScriptChecks)) {
                 return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
             }
             nFees += txfee;
@@ -2185,6 +2326,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         UpdateCoins(tx, view, tx.IsCoinBase() ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
     }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
+    if (!fJustCheck) RecordValidationTime(ValidationStage::CONNECT_TRANSACTIONS, nTime3 - nTime2);
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
 
     CAmount blockReward = GetBlockSubsidyTPAY(pindex->nHeight, chainparams.GetConsensus());
@@ -2197,6 +2339,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     if (!control.Wait())
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
+    if (!fJustCheck) RecordValidationTime(ValidationStage::VERIFY_INPUTS, nTime4 - nTime2);
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
 
     if (fJustCheck)
@@ -2215,6 +2358,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     view.SetBestBlock(pindex->GetBlockHash());
 
     int64_t nTime5 = GetTimeMicros(); nTimeIndex += nTime5 - nTime4;
+    RecordValidationTime(ValidationStage::WRITE_UNDO, nTime5 - nTime4);
     LogPrint(BCLog::BENCH, "    - Index writing: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime5 - nTime4), nTimeIndex * MICRO, nTimeIndex * MILLI / nBlocksTotal);
 
     int64_t nTime6 = GetTimeMicros(); nTimeCallbacks += nTime6 - nTime5;
@@ -2269,17 +2413,22 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
         }
         int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
         int64_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+        // Coins handed to the background writer take up memory until they are written
+        int64_t flushingSize = pcoinsflusher ? pcoinsflusher->DynamicMemoryUsage() : 0;
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
         // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
-        bool fCacheLarge = mode == FlushStateMode::PERIODIC && cacheSize > std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024);
+        bool fCacheLarge = mode == FlushStateMode::PERIODIC && cacheSize + flushingSize > std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024);
         // The cache is over the limit, we have to write now.
-        bool fCacheCritical = mode == FlushStateMode::IF_NEEDED && cacheSize > nTotalSpace;
+        bool fCacheCritical = mode == FlushStateMode::IF_NEEDED && cacheSize + flushingSize > nTotalSpace;
+        // With a background writer, start writing the cache once it takes up half of the space,
+        // so the other half can fill up while it is written instead of stalling at the limit.
+        bool fCacheHalf = pcoinsflusher && (mode == FlushStateMode::IF_NEEDED || mode == FlushStateMode::PERIODIC) && cacheSize > nTotalSpace / 2;
         // It's been a while since we wrote the block index to disk. Do this frequently, so we don't need to redownload after a crash.
         bool fPeriodicWrite = mode == FlushStateMode::PERIODIC && nNow > nLastWrite + (int64_t)DATABASE_WRITE_INTERVAL * 1000000;
         // It's been very long since we flushed the cache. Do this infrequently, to optimize cache usage.
         bool fPeriodicFlush = mode == FlushStateMode::PERIODIC && nNow > nLastFlush + (int64_t)DATABASE_FLUSH_INTERVAL * 1000000;
         // Combine all conditions that result in a full cache flush.
-        fDoFullFlush = (mode == FlushStateMode::ALWAYS) || fCacheLarge || fCacheCritical || fPeriodicFlush || fFlushForPrune;
+        fDoFullFlush = (mode == FlushStateMode::ALWAYS) || fCacheLarge || fCacheCritical || fCacheHalf || fPeriodicFlush || fFlushForPrune;
         // Write blocks and block index to disk.
         if (fDoFullFlush || fPeriodicWrite) {
             // Depend on nMinDiskSpace to ensure we can write block index
@@ -2306,8 +2455,12 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                 }
             }
             // Finally remove any pruned files
-            if (fFlushForPrune)
+            if (fFlushForPrune) {
+                // Don't remove files while the coin database may still be catching up with blocks in them
+                if (pcoinsflusher && !pcoinsflusher->WaitForFlush())
+                    return AbortNode(state, "Failed to write to coin database");
                 UnlinkPrunedFiles(setFilesToPrune);
+            }
             nLastWrite = nNow;
         }
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
@@ -2322,6 +2475,9 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             // Flush the chainstate (which may refer to block index entries).
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
+            // Writing the coins may continue in the background, unless the caller relies on them being on disk
+            if ((mode == FlushStateMode::ALWAYS || fFlushForPrune) && pcoinsflusher && !pcoinsflusher->WaitForFlush())
+                return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
             full_flush_completed = true;
         }
@@ -2483,6 +2639,7 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -2550,6 +2707,61 @@ public:
     }
 };
 
+//! Coins read per thread by PrefetchBlockInputs()
+static const size_t MIN_PREFETCH_COINS_PER_THREAD = 16;
+
+/**
+ * Read the coins, anon outputs and key images the block spends into the
+ * caches from several threads, so that ConnectBlock() finds them there
+ * instead of reading them from disk one by one.
+ */
+static void PrefetchBlockInputs(const CBlock& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+
+    std::set<uint256> setBlockTxids;
+    std::vector<COutPoint> vOutpoints;
+    std::vector<CPubKey> vAnonOutputs;
+    std::vector<ec_point> vKeyImages;
+    for (const auto& tx : block.vtx) {
+        setBlockTxids.insert(tx->GetHash());
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (tx->IsAnon() && txin.IsAnonInput()) {
+                ec_point vchImage;
+                txin.ExtractKeyImage(vchImage);
+                vKeyImages.push_back(vchImage);
+                ExtractRingPubkeys(txin, vAnonOutputs);
+                continue;
+            }
+            // Outputs of earlier transactions of the block are not on disk yet
+            if (setBlockTxids.count(txin.prevout.hash) || pcoinsTip->HaveCoinInCache(txin.prevout))
+                continue;
+            vOutpoints.push_back(txin.prevout);
+        }
+    }
+
+    CCoinsView* pcoinsview = pcoinsflusher ? static_cast<CCoinsView*>(pcoinsflusher.get()) : pcoinsdbview.get();
+    std::vector<Coin> vCoins(vOutpoints.size());
+    std::vector<char> vFound(vOutpoints.size(), false);
+    ParallelFor(vOutpoints.size(), MIN_PREFETCH_COINS_PER_THREAD, [&](size_t i) {
+        try {
+            vFound[i] = pcoinsview->GetCoin(vOutpoints[i], vCoins[i]);
+        } catch (const std::exception& e) {
+            // ConnectBlock() will run into the same error and handle it
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        return true;
+    });
+    // The anon records come from their own db, on the same threads
+    panondb->PrefetchAnon(vAnonOutputs, vKeyImages);
+
+    for (size_t i = 0; i < vOutpoints.size(); ++i) {
+        if (vFound[i]) pcoinsTip->CacheCoin(vOutpoints[i], std::move(vCoins[i]));
+    }
+}
+
 /**
  * Connect a new block to chainActive. pblock is either nullptr or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
@@ -2573,8 +2785,13 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     const CBlock& blockConnecting = *pthisBlock;
     // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
+    if (!pblock) RecordValidationTime(ValidationStage::READ_BLOCK, nTime2 - nTime1);
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    PrefetchBlockInputs(blockConnecting);
+    int64_t nTimePrefetched = GetTimeMicros(); nTimePrefetch += nTimePrefetched - nTime2;
+    RecordValidationTime(ValidationStage::PREFETCH_INPUTS, nTimePrefetched - nTime2);
+    LogPrint(BCLog::BENCH, "  - Prefetch inputs: %.2fms [%.2fs]\n", (nTimePrefetched - nTime2) * MILLI, nTimePrefetch * MICRO);
     {
         CCoinsViewCache view(pcoinsTip.get());
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
@@ -2584,17 +2801,20 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
                 InvalidBlockFound(pindexNew, state);
             return error("%s: ConnectBlock %s failed, %s", __func__, pindexNew->GetBlockHash().ToString(), FormatStateMessage(state));
         }
-        nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
-        LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
+        nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTimePrefetched;
+        RecordValidationTime(ValidationStage::CONNECT_BLOCK, nTime3 - nTimePrefetched);
+        LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTimePrefetched) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
         bool flushed = view.Flush();
         assert(flushed);
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
+    RecordValidationTime(ValidationStage::FLUSH_VIEW, nTime4 - nTime3);
     LogPrint(BCLog::BENCH, "  - Flush: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime4 - nTime3) * MILLI, nTimeFlush * MICRO, nTimeFlush * MILLI / nBlocksTotal);
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(chainparams, state, FlushStateMode::IF_NEEDED))
         return false;
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
+    RecordValidationTime(ValidationStage::WRITE_CHAINSTATE, nTime5 - nTime4);
     LogPrint(BCLog::BENCH, "  - Writing chainstate: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime5 - nTime4) * MILLI, nTimeChainState * MICRO, nTimeChainState * MILLI / nBlocksTotal);
     // Remove conflicting transactions from the mempool.;
     mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
@@ -2604,6 +2824,8 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     UpdateTip(pindexNew, chainparams);
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
+    RecordValidationTime(ValidationStage::POST_CONNECT, nTime6 - nTime5);
+    RecordValidationTime(ValidationStage::CONNECT_TIP, nTime6 - nTime1);
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
 
@@ -3051,7 +3273,7 @@ CBlockIndex* CChainState::AddToBlockIndex(const CBlock& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = blockIndexSlabs.New(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -3432,7 +3654,12 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
 
     // TokenPay: check PoW
     //
-    if (block.nBits != GetNextWorkRequiredTPAY(pindexPrev, block.IsProofOfStake(), consensusParams))
+    unsigned int nBitsRequired;
+    {
+        ValidationStageTimer timer(ValidationStage::DIFFICULTY_CHECK);
+        nBitsRequired = GetNextWorkRequiredTPAY(pindexPrev, block.IsProofOfStake(), consensusParams);
+    }
+    if (block.nBits != nBitsRequired)
     {
         return state.DoS(100, false, REJECT_INVALID, "bad-diffbits", false, "incorrect proof of work");
     }
@@ -3522,7 +3749,9 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
+    const int64_t nTimeHash = GetTimeMicros();
     uint256 hash = block.GetHash();
+    RecordValidationTime(ValidationStage::HEADER_HASH, GetTimeMicros() - nTimeHash);
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = nullptr;
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
@@ -4007,18 +4236,51 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
+    CBlockIndex* pindexNew = blockIndexSlabs.New();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
     return pindexNew;
 }
 
+//! Headers hashed per thread by CheckBlockIndexHashes()
+static const size_t MIN_HEADERS_PER_THREAD = 1000;
+
+/**
+ * Check that the hash each block index entry is stored under is the hash of
+ * its header. Hashing is spread over the prefetch threads, as the older
+ * headers take scrypt.
+ */
+static bool CheckBlockIndexHashes() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    std::vector<const CBlockIndex*> vIndex;
+    vIndex.reserve(mapBlockIndex.size());
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex) {
+        vIndex.push_back(item.second);
+    }
+
+    return ParallelFor(vIndex.size(), MIN_HEADERS_PER_THREAD, [&](size_t i) {
+        const CBlockIndex* pindex = vIndex[i];
+        if (pindex->GetBlockHeader().GetHash() != pindex->GetBlockHash()) {
+            LogPrintf("%s: header does not hash to %s\n", __func__, pindex->ToString());
+            return false;
+        }
+        return true;
+    });
+}
+
 bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlockTreeDB& blocktree)
 {
     if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }))
         return false;
 
+    if (fCheckBlockIndex) {
+        int64_t nStart = GetTimeMillis();
+        if (!CheckBlockIndexHashes())
+            return error("%s: block index hash check failed", __func__);
+        LogPrintf("%s: checked block index hashes in %dms\n", __func__, GetTimeMillis() - nStart);
+    }
+
     // Calculate nChainWork
     std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
     vSortedByHeight.reserve(mapBlockIndex.size());
@@ -4487,10 +4749,9 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
-    for (const BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
-    }
-    mapBlockIndex.clear();
+    // Assign a new map rather than clear() it, so the pool its nodes came from is freed too
+    mapBlockIndex = BlockMap();
+    blockIndexSlabs.Clear();
     fHavePruned = false;
 
     g_chainstate.UnloadBlockIndex();
@@ -5034,16 +5295,3 @@ double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex *pin
 
     return pindex->nChainTx / fTxTotal;
 }
-
-class CMainCleanup
-{
-public:
-    CMainCleanup() {}
-    ~CMainCleanup() {
-        // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
-        mapBlockIndex.clear();
-    }
-} instance_of_cmaincleanup;
@@ -17,11 +17,13 @@
 #include <protocol.h> // For CMessageHeader::MessageStartChars
 #include <policy/feerate.h>
 #include <script/script_error.h>
+#include <support/allocators/pool.h>
 #include <sync.h>
 #include <versionbits.h>
 
 #include <algorithm>
 #include <exception>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
@@ -32,9 +34,12 @@
 
 #include <atomic>
 
+class CAnonDB;
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CChainParams;
+class CCoinsViewBackgroundFlush;
 class CCoinsViewDB;
 class CInv;
 class CConnman;
@@ -118,6 +123,7 @@ static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = false;
+static const bool DEFAULT_COINSTATSINDEX = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
@@ -153,8 +159,16 @@ extern CCriticalSection cs_main;
 //extern CBlockPolicyEstimator feeEstimator;
 extern CTxMemPool mempool;
 extern std::atomic_bool g_is_mempool_loaded;
-typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
+/**
+ * The nodes of a BlockMap are taken from a pool, like those of a CCoinsMap,
+ * and the entries it points to from blockIndexSlabs.
+ */
+typedef PoolAllocator<std::pair<const uint256, CBlockIndex*>,
+                      sizeof(std::pair<const uint256, CBlockIndex*>) + sizeof(void*) * 4,
+                      alignof(void*)> BlockMapAllocator;
+typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher, std::equal_to<uint256>, BlockMapAllocator> BlockMap;
 extern BlockMap& mapBlockIndex;
+extern CBlockIndexSlabs& blockIndexSlabs;
 extern uint64_t nLastBlockTx;
 extern uint64_t nLastBlockWeight;
 extern const std::string strMessageMagic;
@@ -269,6 +283,18 @@ bool LoadChainTip(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs_m
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the ring signature checking thread */
+void ThreadRingSignatureCheck();
+/** Run an instance of the thread ParallelFor() hands its work to */
+void ThreadPrefetch();
+/**
+ * Call fn for each index in [0, nCount) on the prefetch threads and the
+ * calling one, at least nMinPerThread indices per thread, and wait for them.
+ * Returns false, skipping the indices not reached yet, once fn returns false.
+ * Used for the input prefetch before ConnectBlock() and the block index hash
+ * check, so they share one pool of threads instead of starting their own.
+ */
+bool ParallelFor(size_t nCount, size_t nMinPerThread, const std::function<bool(size_t)>& fn);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -312,6 +338,15 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced,
                         bool bypass_limits, const CAmount nAbsurdFee, bool test_accept=false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/**
+ * Verify the ring signatures of the anon inputs of tx on the ring signature
+ * checking threads, before cs_main is taken for AcceptToMemoryPool(). Valid
+ * signatures are cached, which leaves AcceptToMemoryPool() with the key image,
+ * ring member and depth checks. Returns false if a signature is invalid; the
+ * transaction is then rejected by AcceptToMemoryPool() as before.
+ */
+bool PreVerifyRingSignatures(const CTransaction& tx) LOCKS_EXCLUDED(cs_main);
+
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
 
@@ -401,6 +436,7 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -465,12 +501,18 @@ extern CChain& chainActive;
 /** Global variable that points to the coins database (protected by cs_main) */
 extern std::unique_ptr<CCoinsViewDB> pcoinsdbview;
 
+/** Global variable that points to the background writer between pcoinsTip and the coins database (protected by cs_main) */
+extern std::unique_ptr<CCoinsViewBackgroundFlush> pcoinsflusher;
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern std::unique_ptr<CCoinsViewCache> pcoinsTip;
 
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern std::unique_ptr<CBlockTreeDB> pblocktree;
 
+/** Global variable that points to the anon output and key image database (protected by cs_main) */
+extern std::unique_ptr<CAnonDB> panondb;
+
 /**
  * Return the spend height, which is one more than the inputs.GetBestBlock().
  * While checking, GetBestBlock() refers to the parent block. (protected by cs_main)
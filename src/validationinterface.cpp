@@ -10,6 +10,7 @@
 #include <txmempool.h>
 #include <util/system.h>
 #include <validation.h>
+#include <validationstats.h>
 
 #include <list>
 #include <atomic>
@@ -159,6 +160,7 @@ void CMainSignals::TransactionAddedToMempool(const CTransactionRef &ptx) {
 
 void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::shared_ptr<const std::vector<CTransactionRef>>& pvtxConflicted) {
     m_internals->m_schedulerClient.AddToProcessQueue([pblock, pindex, pvtxConflicted, this] {
+        ValidationStageTimer timer(ValidationStage::NOTIFY_BLOCK_CONNECTED);
         m_internals->BlockConnected(pblock, pindex, *pvtxConflicted);
     });
 }
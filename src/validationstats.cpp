@@ -0,0 +1,158 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
+#include <validationstats.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace {
+
+const char* const STAGE_NAMES[] = {
+    "header_hash",
+    "difficulty_check",
+    "read_block",
+    "prefetch_inputs",
+    "check_block",
+    "fork_checks",
+    "connect_transactions",
+    "verify_inputs",
+    "ring_signature",
+    "anon_lookup",
+    "write_undo",
+    "connect_block",
+    "flush_view",
+    "write_chainstate",
+    "post_connect",
+    "connect_tip",
+    "notify_block_connected",
+};
+static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == (size_t)ValidationStage::COUNT, "every stage needs a name");
+
+struct StageEntry
+{
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_us{0};
+    std::atomic<uint64_t> max_us{0};
+    std::array<std::atomic<uint64_t>, VALIDATION_STATS_BUCKETS> histogram;
+
+    StageEntry()
+    {
+        for (std::atomic<uint64_t>& bucket : histogram) bucket.store(0, std::memory_order_relaxed);
+    }
+};
+
+StageEntry g_stages[(size_t)ValidationStage::COUNT];
+
+/**
+ * Bucket of a latency. Below 4us every microsecond has a bucket, above that
+ * every power of two is split into four, so that a percentile read from the
+ * histogram is at most 25% off.
+ */
+int ValidationStatsBucket(int64_t nMicros)
+{
+    if (nMicros < 4) return nMicros < 0 ? 0 : (int)nMicros;
+    int msb = 2;
+    while ((nMicros >> (msb + 1)) != 0) ++msb;
+    const int bucket = 4 * (msb - 1) + (int)((nMicros >> (msb - 2)) & 3);
+    return bucket < VALIDATION_STATS_BUCKETS ? bucket : VALIDATION_STATS_BUCKETS - 1;
+}
+
+/** Largest latency that falls in a bucket */
+uint64_t ValidationStatsBucketMax(int bucket)
+{
+    if (bucket < 4) return bucket;
+    const int msb = bucket / 4 + 1;
+    const uint64_t lower = (uint64_t)(4 + bucket % 4) << (msb - 2);
+    return lower + ((uint64_t)1 << (msb - 2)) - 1;
+}
+
+} // namespace
+
+#ifdef HAVE_THREAD_LOCAL
+static thread_local bool g_connect_block_scope{false};
+
+ConnectBlockStatsScope::ConnectBlockStatsScope(bool fActive) : m_prev(g_connect_block_scope)
+{
+    g_connect_block_scope = fActive;
+}
+
+ConnectBlockStatsScope::~ConnectBlockStatsScope()
+{
+    g_connect_block_scope = m_prev;
+}
+
+bool ConnectBlockStatsScope::InScope()
+{
+    return g_connect_block_scope;
+}
+#else
+// Without thread_local the stages that need a scope are not recorded
+ConnectBlockStatsScope::ConnectBlockStatsScope(bool fActive) : m_prev(false) {}
+ConnectBlockStatsScope::~ConnectBlockStatsScope() {}
+bool ConnectBlockStatsScope::InScope() { return false; }
+#endif
+
+void RecordValidationTime(ValidationStage stage, int64_t nMicros)
+{
+    StageEntry& entry = g_stages[(size_t)stage];
+    const uint64_t us = nMicros < 0 ? 0 : nMicros;
+    entry.count.fetch_add(1, std::memory_order_relaxed);
+    entry.total_us.fetch_add(us, std::memory_order_relaxed);
+    uint64_t prev = entry.max_us.load(std::memory_order_relaxed);
+    while (prev < us && !entry.max_us.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {}
+    entry.histogram[ValidationStatsBucket(nMicros)].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<ValidationStageStats> GetValidationStats()
+{
+    std::vector<ValidationStageStats> ret;
+    for (size_t i = 0; i < (size_t)ValidationStage::COUNT; ++i) {
+        const StageEntry& entry = g_stages[i];
+        ValidationStageStats stats;
+        stats.name = STAGE_NAMES[i];
+        stats.count = entry.count.load(std::memory_order_relaxed);
+        stats.total_us = entry.total_us.load(std::memory_order_relaxed);
+        stats.max_us = entry.max_us.load(std::memory_order_relaxed);
+        for (int b = 0; b < VALIDATION_STATS_BUCKETS; ++b) {
+            stats.histogram[b] = entry.histogram[b].load(std::memory_order_relaxed);
+        }
+        ret.push_back(stats);
+    }
+    return ret;
+}
+
+void ResetValidationStats()
+{
+    for (StageEntry& entry : g_stages) {
+        entry.count = 0;
+        entry.total_us = 0;
+        entry.max_us = 0;
+        for (std::atomic<uint64_t>& bucket : entry.histogram) bucket = 0;
+    }
+}
+
+uint64_t ValidationStageStats::Percentile(double fraction) const
+{
+    // Count the histogram, which may be slightly ahead of or behind count
+    uint64_t samples = 0;
+    for (uint64_t n : histogram) samples += n;
+    if (samples == 0) return 0;
+
+    const uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(fraction * samples));
+    uint64_t seen = 0;
+    for (int b = 0; b < VALIDATION_STATS_BUCKETS; ++b) {
+        seen += histogram[b];
+        if (seen >= rank) {
+            // The last bucket also counts everything above it
+            return b == VALIDATION_STATS_BUCKETS - 1 ? max_us : std::min(ValidationStatsBucketMax(b), max_us);
+        }
+    }
+    return max_us;
+}
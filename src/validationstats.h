@@ -0,0 +1,94 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_VALIDATIONSTATS_H
+#define BITCOIN_VALIDATIONSTATS_H
+
+#include <util/time.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** Stages of block validation whose latencies are kept for getvalidationstats */
+enum class ValidationStage {
+    HEADER_HASH,            //!< Hashing a header as it is accepted, scrypt for older block versions
+    DIFFICULTY_CHECK,       //!< Checking nBits against the proof of work or stake difficulty
+    READ_BLOCK,             //!< Reading a block from disk to connect it
+    PREFETCH_INPUTS,        //!< Prefetching the inputs of a block from the chainstate
+    CHECK_BLOCK,            //!< Context free checks of a block in ConnectBlock()
+    FORK_CHECKS,            //!< BIP30 and the script flags in ConnectBlock()
+    CONNECT_TRANSACTIONS,   //!< Spending the inputs and adding the outputs of a block
+    VERIFY_INPUTS,          //!< The above plus waiting for the script checks
+    RING_SIGNATURE,         //!< Verifying the ring signature of an anon input in ConnectBlock()
+    ANON_LOOKUP,            //!< Reading a key image or ring member from the anon database in ConnectBlock()
+    WRITE_UNDO,             //!< Writing the undo data of a block
+    CONNECT_BLOCK,          //!< All of ConnectBlock()
+    FLUSH_VIEW,             //!< Flushing the changes of a block into the coins cache
+    WRITE_CHAINSTATE,       //!< Writing the chainstate to disk, when needed
+    POST_CONNECT,           //!< Updating the mempool and the tip after a block
+    CONNECT_TIP,            //!< All of ConnectTip()
+    NOTIFY_BLOCK_CONNECTED, //!< Subscribers, such as the wallet, handling a connected block
+    COUNT
+};
+
+/** Number of latency histogram buckets, four per power of two microseconds */
+static const int VALIDATION_STATS_BUCKETS = 128;
+
+/** Latencies of a stage since startup or the last reset, as returned by GetValidationStats() */
+struct ValidationStageStats
+{
+    std::string name;
+    uint64_t count;
+    uint64_t total_us;
+    uint64_t max_us;
+    std::array<uint64_t, VALIDATION_STATS_BUCKETS> histogram;
+
+    /** Latency that a fraction of the samples did not exceed, rounded up to the end of its bucket */
+    uint64_t Percentile(double fraction) const;
+};
+
+void RecordValidationTime(ValidationStage stage, int64_t nMicros);
+std::vector<ValidationStageStats> GetValidationStats();
+void ResetValidationStats();
+
+/**
+ * Marks this thread as connecting a block while it exists. Ring signatures
+ * and anon database reads are also done for the mempool, the wallet and the
+ * indexes, so their timers only record inside one of these.
+ */
+class ConnectBlockStatsScope
+{
+private:
+    const bool m_prev;
+
+public:
+    explicit ConnectBlockStatsScope(bool fActive);
+    ~ConnectBlockStatsScope();
+
+    ConnectBlockStatsScope(const ConnectBlockStatsScope&) = delete;
+    ConnectBlockStatsScope& operator=(const ConnectBlockStatsScope&) = delete;
+
+    /** Whether this thread is inside an active scope */
+    static bool InScope();
+};
+
+/** Records the time from its construction to its destruction for a stage, if fRecord is set */
+class ValidationStageTimer
+{
+private:
+    const ValidationStage m_stage;
+    const int64_t m_start;
+    const bool m_record;
+
+public:
+    explicit ValidationStageTimer(ValidationStage stage, bool fRecord = true) : m_stage(stage), m_start(GetTimeMicros()), m_record(fRecord) {}
+    ~ValidationStageTimer() { if (m_record) RecordValidationTime(m_stage, GetTimeMicros() - m_start); }
+
+    ValidationStageTimer(const ValidationStageTimer&) = delete;
+    ValidationStageTimer& operator=(const ValidationStageTimer&) = delete;
+};
+
+#endif // BITCOIN_VALIDATIONSTATS_H
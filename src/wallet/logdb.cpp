@@ -0,0 +1,698 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/logdb.h>
+
+#include <clientversion.h>
+#include <crypto/common.h>
+#include <crypto/siphash.h>
+#include <logging.h>
+#include <util/system.h>
+
+#include <set>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+const unsigned char LOG_DB_MAGIC[8] = {'w', 'a', 'l', 'l', 'e', 't', 'l', 0x01};
+const unsigned char LOG_PUT = 1;
+const unsigned char LOG_ERASE = 2;
+const uint64_t FRAME_HEADER_SIZE = 8;
+//! Anything larger is taken as a damaged frame header
+const uint32_t MAX_FRAME_SIZE = 0x10000000;
+//! The mapping is grown in steps of this size, so appends rarely need a new one
+const uint64_t MAP_RESERVE = 64 << 20;
+//! Don't bother compacting files smaller than this
+const uint64_t MIN_COMPACT_SIZE = 1 << 20;
+//! Payload size of the frames a compaction writes
+const size_t COMPACT_FRAME_SIZE = 1 << 20;
+const uint64_t CHECKSUM_K0 = 0x77616c6c65746c6fULL;
+const uint64_t CHECKSUM_K1 = 0x6766726d63686b73ULL;
+
+CCriticalSection cs_log_databases;
+//! Paths of the log databases that are open
+std::set<std::string> g_log_databases GUARDED_BY(cs_log_databases);
+
+uint32_t FrameChecksum(const unsigned char* data, size_t size)
+{
+    return (uint32_t)CSipHasher(CHECKSUM_K0, CHECKSUM_K1).Write(data, size).Finalize();
+}
+
+//! Size of a record in a frame
+uint64_t RecordSize(size_t key_size, size_t value_size)
+{
+    return 1 + 4 + key_size + 4 + value_size;
+}
+
+/**
+ * Call fn(type, key, key_size, value_offset, value_size) for each record of
+ * a frame payload. value_offset is relative to the start of the payload.
+ * Returns false if the payload is malformed.
+ */
+template <typename Fn>
+bool ForEachRecord(const unsigned char* payload, uint64_t size, Fn fn)
+{
+    uint64_t pos = 0;
+    while (pos < size) {
+        const unsigned char type = payload[pos++];
+        if (type != LOG_PUT && type != LOG_ERASE) return false;
+        if (size - pos < 4) return false;
+        const uint32_t key_size = ReadLE32(payload + pos);
+        pos += 4;
+        if (size - pos < key_size) return false;
+        const unsigned char* key = payload + pos;
+        pos += key_size;
+        uint32_t value_size = 0;
+        const uint64_t value_offset = pos + 4;
+        if (type == LOG_PUT) {
+            if (size - pos < 4) return false;
+            value_size = ReadLE32(payload + pos);
+            pos += 4;
+            if (size - pos < value_size) return false;
+            pos += value_size;
+        }
+        fn(type, key, key_size, value_offset, value_size);
+    }
+    return true;
+}
+
+bool IsIntactFrame(const unsigned char* header, const unsigned char* payload, uint32_t payload_size)
+{
+    if (FrameChecksum(payload, payload_size) != ReadLE32(header + 4)) return false;
+    return ForEachRecord(payload, payload_size, [](unsigned char, const unsigned char*, uint32_t, uint64_t, uint32_t) {});
+}
+
+void AppendRecord(std::vector<unsigned char>& payload, const std::vector<unsigned char>& key, const std::vector<unsigned char>* value)
+{
+    unsigned char size[4];
+    payload.push_back(value ? LOG_PUT : LOG_ERASE);
+    WriteLE32(size, key.size());
+    payload.insert(payload.end(), size, size + 4);
+    payload.insert(payload.end(), key.begin(), key.end());
+    if (value) {
+        WriteLE32(size, value->size());
+        payload.insert(payload.end(), size, size + 4);
+        payload.insert(payload.end(), value->begin(), value->end());
+    }
+}
+
+bool WriteFrame(FILE* file, const std::vector<unsigned char>& payload)
+{
+    unsigned char header[FRAME_HEADER_SIZE];
+    WriteLE32(header, payload.size());
+    WriteLE32(header + 4, FrameChecksum(payload.data(), payload.size()));
+    return fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+           fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+}
+
+} // namespace
+
+//
+// LogDatabase
+//
+
+LogDatabase::LogDatabase(const fs::path& file_path) : m_path(file_path)
+{
+    {
+        LOCK(cs_log_databases);
+        if (!g_log_databases.insert(m_path.string()).second) {
+            throw std::runtime_error(strprintf("LogDatabase: %s is already open", m_path.string()));
+        }
+    }
+    LOCK(cs_log);
+    if (!Open()) {
+        LOCK(cs_log_databases);
+        g_log_databases.erase(m_path.string());
+        throw std::runtime_error(strprintf("LogDatabase: Can't open database %s", m_path.string()));
+    }
+}
+
+LogDatabase::~LogDatabase()
+{
+    {
+        LOCK(cs_log);
+        Sync();
+        Close();
+    }
+    LOCK(cs_log_databases);
+    g_log_databases.erase(m_path.string());
+}
+
+bool LogDatabase::IsLogFile(const fs::path& file_path)
+{
+    if (!fs::is_regular_file(file_path)) return false;
+    FILE* file = fsbridge::fopen(file_path, "rb");
+    if (!file) return false;
+    unsigned char magic[sizeof(LOG_DB_MAGIC)];
+    bool ret = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, LOG_DB_MAGIC, sizeof(magic)) == 0;
+    fclose(file);
+    return ret;
+}
+
+bool LogDatabase::IsLoaded(const fs::path& file_path)
+{
+    LOCK(cs_log_databases);
+    return g_log_databases.count(file_path.string()) != 0;
+}
+
+bool LogDatabase::Verify(const fs::path& file_path, std::string& warningStr, std::string& errorStr)
+{
+    if (IsLoaded(file_path)) return true;
+
+    FILE* file = fsbridge::fopen(file_path, "rb");
+    if (!file) {
+        errorStr = strprintf(_("Error opening wallet file %s"), file_path.string());
+        return false;
+    }
+    unsigned char magic[sizeof(LOG_DB_MAGIC)];
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, LOG_DB_MAGIC, sizeof(magic)) != 0) {
+        fclose(file);
+        errorStr = strprintf(_("%s is not a log format wallet file"), file_path.string());
+        return false;
+    }
+
+    uint64_t intact = sizeof(LOG_DB_MAGIC);
+    unsigned char header[FRAME_HEADER_SIZE];
+    std::vector<unsigned char> payload;
+    while (fread(header, 1, sizeof(header), file) == sizeof(header)) {
+        const uint32_t payload_size = ReadLE32(header);
+        if (payload_size > MAX_FRAME_SIZE) break;
+        payload.resize(payload_size);
+        if (fread(payload.data(), 1, payload_size, file) != payload_size) break;
+        if (!IsIntactFrame(header, payload.data(), payload_size)) break;
+        intact += FRAME_HEADER_SIZE + payload_size;
+    }
+    fclose(file);
+
+    const uint64_t file_size = fs::file_size(file_path);
+    if (intact < file_size) {
+        warningStr = strprintf(_("Warning: Wallet file %s ends in an incomplete or damaged frame of %u bytes, which will be dropped."
+                                 " If your balance or transactions are incorrect you should restore from a backup."),
+                               file_path.string(), file_size - intact);
+    }
+    return true;
+}
+
+bool LogDatabase::Open()
+{
+    if (m_file) return true;
+
+    if (!LockDirectory(m_path.parent_path(), ".walletlock")) {
+        LogPrintf("Cannot obtain a lock on wallet directory %s. Another instance of bitcoin may be using it.\n", m_path.parent_path().string());
+        return false;
+    }
+
+    const bool fCreate = !fs::exists(m_path);
+    m_file = fsbridge::fopen(m_path, fCreate ? "wb+" : "rb+");
+    if (!m_file) {
+        return error("%s: Failed to open %s", __func__, m_path.string());
+    }
+    if (fCreate) {
+        if (fwrite(LOG_DB_MAGIC, 1, sizeof(LOG_DB_MAGIC), m_file) != sizeof(LOG_DB_MAGIC) || !FileCommit(m_file)) {
+            Close();
+            return error("%s: Failed to write to %s", __func__, m_path.string());
+        }
+    }
+    m_file_size = fs::file_size(m_path);
+    if (!Map(m_file_size)) {
+        Close();
+        return false;
+    }
+    if (m_file_size < sizeof(LOG_DB_MAGIC) || memcmp(m_map, LOG_DB_MAGIC, sizeof(LOG_DB_MAGIC)) != 0) {
+        Close();
+        return error("%s: %s is not a log format wallet file", __func__, m_path.string());
+    }
+
+    m_index.clear();
+    m_live_size = 0;
+    const uint64_t intact = sizeof(LOG_DB_MAGIC) + Replay(m_map + sizeof(LOG_DB_MAGIC), m_file_size - sizeof(LOG_DB_MAGIC), sizeof(LOG_DB_MAGIC));
+    if (intact < m_file_size) {
+        // A commit that did not make it to disk completely, or damage. Either
+        // way the frames after it can't be trusted to follow on from it.
+        LogPrintf("%s: Dropping incomplete or damaged frames of %u bytes at the end of %s\n", __func__, m_file_size - intact, m_path.string());
+        Unmap();
+        if (!TruncateFile(m_file, intact) || !FileCommit(m_file)) {
+            Close();
+            return error("%s: Failed to truncate %s", __func__, m_path.string());
+        }
+        m_file_size = intact;
+        if (!Map(m_file_size)) {
+            Close();
+            return false;
+        }
+    }
+    m_dirty = false;
+    LogPrint(BCLog::DB, "Opened %s: %u records, %u of %u bytes live\n", m_path.string(), m_index.size(), m_live_size, m_file_size);
+    return true;
+}
+
+void LogDatabase::Close()
+{
+    Unmap();
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+    m_file_size = 0;
+    m_index.clear();
+    m_live_size = 0;
+}
+
+bool LogDatabase::Map(uint64_t size)
+{
+    if (m_map && size <= m_map_size) return true;
+    Unmap();
+#ifndef WIN32
+    const uint64_t map_size = size + MAP_RESERVE;
+    void* map = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fileno(m_file), 0);
+    if (map == MAP_FAILED) {
+        return error("%s: Failed to map %s", __func__, m_path.string());
+    }
+    m_map = static_cast<const unsigned char*>(map);
+    m_map_size = map_size;
+#else
+    m_map_buffer.resize(size);
+    if (fseek(m_file, 0, SEEK_SET) != 0 || fread(m_map_buffer.data(), 1, size, m_file) != size) {
+        m_map_buffer.clear();
+        return error("%s: Failed to read %s", __func__, m_path.string());
+    }
+    m_map = m_map_buffer.data();
+    m_map_size = size;
+#endif
+    return true;
+}
+
+void LogDatabase::Unmap()
+{
+    if (!m_map) return;
+#ifndef WIN32
+    munmap(const_cast<unsigned char*>(m_map), m_map_size);
+#else
+    m_map_buffer.clear();
+    m_map_buffer.shrink_to_fit();
+#endif
+    m_map = nullptr;
+    m_map_size = 0;
+}
+
+uint64_t LogDatabase::Replay(const unsigned char* data, uint64_t size, uint64_t base_pos)
+{
+    uint64_t pos = 0;
+    while (size - pos >= FRAME_HEADER_SIZE) {
+        const unsigned char* header = data + pos;
+        const uint32_t payload_size = ReadLE32(header);
+        if (payload_size > MAX_FRAME_SIZE || size - pos - FRAME_HEADER_SIZE < payload_size) break;
+        const unsigned char* payload = header + FRAME_HEADER_SIZE;
+        if (!IsIntactFrame(header, payload, payload_size)) break;
+
+        const uint64_t payload_pos = base_pos + pos + FRAME_HEADER_SIZE;
+        ForEachRecord(payload, payload_size, [this, payload_pos](unsigned char type, const unsigned char* key, uint32_t key_size, uint64_t value_offset, uint32_t value_size) {
+            AssertLockHeld(cs_log);
+            Bytes vchKey(key, key + key_size);
+            auto it = m_index.find(vchKey);
+            if (it != m_index.end()) {
+                m_live_size -= RecordSize(key_size, it->second.size);
+                if (type == LOG_ERASE) {
+                    m_index.erase(it);
+                }
+            }
+            if (type == LOG_PUT) {
+                m_index[std::move(vchKey)] = ValueLocation{payload_pos + value_offset, value_size};
+                m_live_size += RecordSize(key_size, value_size);
+            }
+        });
+        pos += FRAME_HEADER_SIZE + payload_size;
+    }
+    return pos;
+}
+
+bool LogDatabase::Append(const Bytes& payload)
+{
+    if (fseek(m_file, 0, SEEK_END) != 0 || !WriteFrame(m_file, payload) || fflush(m_file) != 0) {
+        // Don't leave a partial frame behind, later frames would be lost with it
+        TruncateFile(m_file, m_file_size);
+        return error("%s: Failed to write to %s", __func__, m_path.string());
+    }
+    const uint64_t frame_pos = m_file_size;
+    m_file_size += FRAME_HEADER_SIZE + payload.size();
+    m_dirty = true;
+#ifdef WIN32
+    unsigned char header[FRAME_HEADER_SIZE];
+    WriteLE32(header, payload.size());
+    WriteLE32(header + 4, FrameChecksum(payload.data(), payload.size()));
+    m_map_buffer.insert(m_map_buffer.end(), header, header + sizeof(header));
+    m_map_buffer.insert(m_map_buffer.end(), payload.begin(), payload.end());
+    m_map = m_map_buffer.data();
+    m_map_size = m_map_buffer.size();
+#else
+    if (!Map(m_file_size)) {
+        return false;
+    }
+#endif
+    Replay(m_map + frame_pos, m_file_size - frame_pos, frame_pos);
+    return true;
+}
+
+bool LogDatabase::Read(const Bytes& key, CDataStream& value)
+{
+    LOCK(cs_log);
+    if (!Open()) return false;
+    auto it = m_index.find(key);
+    if (it == m_index.end()) return false;
+    value.write((const char*)m_map + it->second.pos, it->second.size);
+    return true;
+}
+
+bool LogDatabase::Exists(const Bytes& key)
+{
+    LOCK(cs_log);
+    if (!Open()) return false;
+    return m_index.count(key) != 0;
+}
+
+bool LogDatabase::Commit(const std::vector<Record>& records, bool overwrite)
+{
+    LOCK(cs_log);
+    if (!Open()) return false;
+    Bytes payload;
+    for (const Record& record : records) {
+        if (!overwrite && record.value && m_index.count(record.key)) {
+            return false;
+        }
+        AppendRecord(payload, record.key, record.value.get());
+    }
+    if (payload.size() > MAX_FRAME_SIZE) {
+        return error("%s: Transaction of %u bytes is too large", __func__, payload.size());
+    }
+    return Append(payload);
+}
+
+bool LogDatabase::ReadNext(const Bytes* after, Bytes& key, CDataStream& value, bool& complete)
+{
+    LOCK(cs_log);
+    complete = false;
+    if (!Open()) return false;
+    auto it = after ? m_index.upper_bound(*after) : m_index.begin();
+    if (it == m_index.end()) {
+        complete = true;
+        return false;
+    }
+    key = it->first;
+    value.write((const char*)m_map + it->second.pos, it->second.size);
+    return true;
+}
+
+bool LogDatabase::Sync()
+{
+    if (!m_file || !m_dirty) return true;
+    if (!FileCommit(m_file)) {
+        return error("%s: Failed to sync %s", __func__, m_path.string());
+    }
+    m_dirty = false;
+    return true;
+}
+
+bool LogDatabase::NeedsCompaction()
+{
+    return m_file_size >= MIN_COMPACT_SIZE && m_live_size * 2 < m_file_size;
+}
+
+bool LogDatabase::Compact(const char* pszSkip)
+{
+    LOCK(cs_compact);
+    const fs::path tmp_path = m_path.string() + ".compact";
+
+    // Take a snapshot of the index. The records it points to stay where they
+    // are in the file, so they can be copied without blocking writers.
+    std::vector<std::pair<Bytes, ValueLocation>> live;
+    uint64_t snapshot_size;
+    {
+        LOCK(cs_log);
+        if (!Open()) return false;
+        live.assign(m_index.begin(), m_index.end());
+        snapshot_size = m_file_size;
+    }
+    LogPrint(BCLog::DB, "LogDatabase::Compact: Compacting %s, %u records...\n", m_path.string(), live.size());
+    const int64_t nStart = GetTimeMillis();
+
+    FILE* out = fsbridge::fopen(tmp_path, "wb");
+    if (!out) {
+        return error("%s: Can't create database file %s", __func__, tmp_path.string());
+    }
+    bool fSuccess = fwrite(LOG_DB_MAGIC, 1, sizeof(LOG_DB_MAGIC), out) == sizeof(LOG_DB_MAGIC);
+
+    CDataStream ssVersion(SER_DISK, CLIENT_VERSION);
+    ssVersion << std::string("version");
+    const Bytes version_key(ssVersion.begin(), ssVersion.end());
+    ssVersion.clear();
+    ssVersion << CLIENT_VERSION;
+    const Bytes version_value(ssVersion.begin(), ssVersion.end());
+
+    size_t next = 0;
+    Bytes payload;
+    Bytes value;
+    while (fSuccess && next < live.size()) {
+        payload.clear();
+        {
+            LOCK(cs_log);
+            if (!m_file) {
+                // Closed in the meantime
+                fSuccess = false;
+                break;
+            }
+            for (; next < live.size() && payload.size() < COMPACT_FRAME_SIZE; ++next) {
+                const Bytes& key = live[next].first;
+                if (pszSkip && strncmp((const char*)key.data(), pszSkip, std::min(key.size(), strlen(pszSkip))) == 0) {
+                    continue;
+                }
+                if (key == version_key) {
+                    AppendRecord(payload, key, &version_value);
+                    continue;
+                }
+                value.assign(m_map + live[next].second.pos, m_map + live[next].second.pos + live[next].second.size);
+                AppendRecord(payload, key, &value);
+            }
+        }
+        if (!payload.empty()) {
+            fSuccess = WriteFrame(out, payload);
+        }
+    }
+
+    {
+        LOCK(cs_log);
+        if (fSuccess && m_file) {
+            // Take over what was committed since the snapshot, and replace the file
+            const uint64_t tail = m_file_size - snapshot_size;
+            fSuccess = fwrite(m_map + snapshot_size, 1, tail, out) == tail && FileCommit(out);
+            fclose(out);
+            if (fSuccess) {
+                Close();
+                fSuccess = RenameOver(tmp_path, m_path);
+                if (!Open()) {
+                    return error("%s: Failed to reopen %s", __func__, m_path.string());
+                }
+            }
+        } else {
+            fSuccess = false;
+            fclose(out);
+        }
+    }
+    if (!fSuccess) {
+        fs::remove(tmp_path);
+        return error("%s: Failed to compact %s", __func__, m_path.string());
+    }
+    LogPrint(BCLog::DB, "LogDatabase::Compact: Compacted %s %dms\n", m_path.string(), GetTimeMillis() - nStart);
+    return true;
+}
+
+std::unique_ptr<DatabaseBatch> LogDatabase::MakeBatch(const char* pszMode, bool fFlushOnClose)
+{
+    const bool read_only = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
+    return MakeUnique<LogBatch>(*this, read_only);
+}
+
+bool LogDatabase::Rewrite(const char* pszSkip)
+{
+    return Compact(pszSkip);
+}
+
+bool LogDatabase::Backup(const std::string& strDest)
+{
+    LOCK(cs_log);
+    if (!Sync()) return false;
+
+    fs::path pathDest(strDest);
+    if (fs::is_directory(pathDest))
+        pathDest /= m_path.filename();
+
+    try {
+        if (fs::exists(pathDest) && fs::equivalent(m_path, pathDest)) {
+            LogPrintf("cannot backup to wallet source file %s\n", pathDest.string());
+            return false;
+        }
+
+        fs::copy_file(m_path, pathDest, fs::copy_option::overwrite_if_exists);
+        LogPrintf("copied %s to %s\n", m_path.filename().string(), pathDest.string());
+        return true;
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("error copying %s to %s - %s\n", m_path.filename().string(), pathDest.string(), fsbridge::get_filesystem_error_message(e));
+        return false;
+    }
+}
+
+void LogDatabase::Flush(bool shutdown)
+{
+    LOCK(cs_log);
+    Sync();
+    if (shutdown) {
+        Close();
+    }
+}
+
+bool LogDatabase::PeriodicFlush()
+{
+    {
+        LOCK(cs_log);
+        if (!m_file) return true;
+        if (!Sync()) return false;
+        if (!NeedsCompaction()) return true;
+    }
+    return Compact(nullptr);
+}
+
+//
+// LogBatch
+//
+
+LogBatch::LogBatch(LogDatabase& database, bool read_only) : m_database(database), m_read_only(read_only)
+{
+}
+
+bool LogBatch::ReadKey(const CDataStream& key, CDataStream& value)
+{
+    Bytes vchKey(key.begin(), key.end());
+    if (m_txn_open) {
+        auto it = m_txn.find(vchKey);
+        if (it != m_txn.end()) {
+            if (!it->second) return false;
+            value.write((const char*)it->second->data(), it->second->size());
+            return true;
+        }
+    }
+    return m_database.Read(vchKey, value);
+}
+
+bool LogBatch::WriteKey(const CDataStream& key, const CDataStream& value, bool overwrite)
+{
+    if (m_read_only)
+        assert(!"Write called on database in read-only mode");
+
+    Bytes vchKey(key.begin(), key.end());
+    if (m_txn_open) {
+        if (!overwrite && HasKey(key)) return false;
+        m_txn[std::move(vchKey)] = MakeUnique<Bytes>(value.begin(), value.end());
+        return true;
+    }
+    std::vector<LogDatabase::Record> records(1);
+    records[0].key = std::move(vchKey);
+    records[0].value = MakeUnique<Bytes>(value.begin(), value.end());
+    return m_database.Commit(records, overwrite);
+}
+
+bool LogBatch::EraseKey(const CDataStream& key)
+{
+    if (m_read_only)
+        assert(!"Erase called on database in read-only mode");
+
+    Bytes vchKey(key.begin(), key.end());
+    if (m_txn_open) {
+        m_txn[std::move(vchKey)].reset();
+        return true;
+    }
+    if (!m_database.Exists(vchKey)) return true;
+    std::vector<LogDatabase::Record> records(1);
+    records[0].key = std::move(vchKey);
+    return m_database.Commit(records, true);
+}
+
+bool LogBatch::HasKey(const CDataStream& key)
+{
+    Bytes vchKey(key.begin(), key.end());
+    if (m_txn_open) {
+        auto it = m_txn.find(vchKey);
+        if (it != m_txn.end()) return it->second != nullptr;
+    }
+    return m_database.Exists(vchKey);
+}
+
+void LogBatch::Close()
+{
+    if (m_txn_open) TxnAbort();
+    CloseCursor();
+}
+
+bool LogBatch::StartCursor()
+{
+    assert(!m_cursor_open);
+    m_cursor_open = true;
+    m_cursor_key.reset();
+    return true;
+}
+
+bool LogBatch::ReadAtCursor(CDataStream& ssKey, CDataStream& ssValue, bool& complete)
+{
+    complete = false;
+    if (!m_cursor_open) return false;
+
+    Bytes key;
+    ssValue.SetType(SER_DISK);
+    ssValue.clear();
+    if (!m_database.ReadNext(m_cursor_key.get(), key, ssValue, complete)) return false;
+    ssKey.SetType(SER_DISK);
+    ssKey.clear();
+    ssKey.write((const char*)key.data(), key.size());
+    m_cursor_key = MakeUnique<Bytes>(std::move(key));
+    return true;
+}
+
+void LogBatch::CloseCursor()
+{
+    m_cursor_open = false;
+    m_cursor_key.reset();
+}
+
+bool LogBatch::TxnBegin()
+{
+    if (m_txn_open) return false;
+    m_txn_open = true;
+    return true;
+}
+
+bool LogBatch::TxnCommit()
+{
+    if (!m_txn_open) return false;
+    std::vector<LogDatabase::Record> records;
+    records.reserve(m_txn.size());
+    for (auto& write : m_txn) {
+        records.emplace_back();
+        records.back().key = write.first;
+        records.back().value = std::move(write.second);
+    }
+    m_txn.clear();
+    m_txn_open = false;
+    if (records.empty()) return true;
+    return m_database.Commit(records, true);
+}
+
+bool LogBatch::TxnAbort()
+{
+    if (!m_txn_open) return false;
+    m_txn.clear();
+    m_txn_open = false;
+    return true;
+}
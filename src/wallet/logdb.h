@@ -0,0 +1,164 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_LOGDB_H
+#define BITCOIN_WALLET_LOGDB_H
+
+#include <fs.h>
+#include <sync.h>
+#include <wallet/db.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+/**
+ * A wallet database kept as an append-only log of key/value records, as an
+ * alternative to BerkeleyDB for busy wallets.
+ *
+ * The file starts with a magic string, followed by frames:
+ *
+ *   [uint32 payload size][uint32 checksum of payload][payload]
+ *
+ * A payload is a sequence of [uint8 LOG_PUT][uint32 size][key][uint32 size][value]
+ * and [uint8 LOG_ERASE][uint32 size][key] records. Each frame holds one
+ * committed batch transaction, or a single write made outside of one, so it
+ * is applied either completely or not at all.
+ *
+ * On open the frames are replayed into an in-memory index of where the
+ * current value of each key is, and a torn frame at the end of the file is
+ * cut off. Values are read straight from a memory mapping of the file.
+ *
+ * Commits are appended to the file as they happen, but only synced to disk by
+ * Flush() and PeriodicFlush(), so a single sync covers all commits made since
+ * the previous one. PeriodicFlush() also compacts the file once most of it
+ * is taken up by overwritten and erased records. The live records are copied
+ * into a new file without holding up readers and writers, which are only
+ * blocked for taking over the frames committed in the meantime.
+ */
+class LogDatabase : public WalletDatabase
+{
+    friend class LogBatch;
+public:
+    /** Open the log database at file_path, creating it if it does not exist */
+    explicit LogDatabase(const fs::path& file_path);
+    ~LogDatabase() override;
+
+    /** Whether the file at file_path is a log database */
+    static bool IsLogFile(const fs::path& file_path);
+    /** Whether a log database is currently open at file_path */
+    static bool IsLoaded(const fs::path& file_path);
+    /** Check that the frames of the log database at file_path are intact */
+    static bool Verify(const fs::path& file_path, std::string& warningStr, std::string& errorStr);
+
+    std::unique_ptr<DatabaseBatch> MakeBatch(const char* pszMode = "r+", bool fFlushOnClose = true) override;
+
+    bool Rewrite(const char* pszSkip=nullptr) override;
+    bool Backup(const std::string& strDest) override;
+    void Flush(bool shutdown) override;
+    bool PeriodicFlush() override;
+    void ReloadDbEnv() override {}
+
+private:
+    typedef std::vector<unsigned char> Bytes;
+
+    /** Where the value of a key is in the file */
+    struct ValueLocation
+    {
+        uint64_t pos;
+        uint32_t size;
+    };
+
+    /** A record of a frame, value is null for erases */
+    struct Record
+    {
+        Bytes key;
+        std::unique_ptr<Bytes> value;
+    };
+
+    bool Open() EXCLUSIVE_LOCKS_REQUIRED(cs_log);
+    void Close() EXCLUSIVE_LOCKS_REQUIRED(cs_log);
+    bool Map(uint64_t size) EXCLUSIVE_LOCKS_REQUIRED(cs_log);
+    void Unmap() EXCLUSIVE_LOCKS_REQUIRED(cs_log);
+
+    /** Apply the frames in data to the index. Returns the size of the intact frames. */
+    uint64_t Replay(const unsigned char* data, uint64_t size, uint64_t base_pos) EXCLUSIVE_LOCKS_REQUIRED(cs_log);
+    /** Append a frame to the file */
+    bool Append(const Bytes& payload) EXCLUSIVE_LOCKS_REQUIRED(cs_log);
+
+    bool Read(const Bytes& key, CDataStream& value);
+    bool Exists(const Bytes& key);
+    /** Write the records as one frame. Fails for an existing key if overwrite is false. */
+    bool Commit(const std::vector<Record>& records, bool overwrite);
+    /** Read the first record with a key after the given one */
+    bool ReadNext(const Bytes* after, Bytes& key, CDataStream& value, bool& complete);
+
+    bool Sync() EXCLUSIVE_LOCKS_REQUIRED(cs_log);
+    bool Compact(const char* pszSkip);
+    bool NeedsCompaction() EXCLUSIVE_LOCKS_REQUIRED(cs_log);
+
+    CCriticalSection cs_log;
+    //! Held by Compact() for its whole run, so compactions don't overlap
+    CCriticalSection cs_compact;
+
+    const fs::path m_path;
+    FILE* m_file GUARDED_BY(cs_log) = nullptr;
+    uint64_t m_file_size GUARDED_BY(cs_log) = 0;
+    //! Bytes of the file taken up by the records in the index
+    uint64_t m_live_size GUARDED_BY(cs_log) = 0;
+    //! Whether there are commits that have not been synced to disk yet
+    bool m_dirty GUARDED_BY(cs_log) = false;
+    std::map<Bytes, ValueLocation> m_index GUARDED_BY(cs_log);
+
+    const unsigned char* m_map GUARDED_BY(cs_log) = nullptr;
+    uint64_t m_map_size GUARDED_BY(cs_log) = 0;
+#ifdef WIN32
+    //! Without mmap the file contents are kept in memory
+    std::vector<unsigned char> m_map_buffer GUARDED_BY(cs_log);
+#endif
+};
+
+/** RAII class that provides access to a log database */
+class LogBatch : public DatabaseBatch
+{
+private:
+    typedef std::vector<unsigned char> Bytes;
+
+    bool ReadKey(const CDataStream& key, CDataStream& value) override;
+    bool WriteKey(const CDataStream& key, const CDataStream& value, bool overwrite) override;
+    bool EraseKey(const CDataStream& key) override;
+    bool HasKey(const CDataStream& key) override;
+
+    LogDatabase& m_database;
+    bool m_read_only;
+
+    bool m_cursor_open = false;
+    //! Key of the record last read at the cursor, empty before the first one
+    std::unique_ptr<Bytes> m_cursor_key;
+
+    bool m_txn_open = false;
+    //! Writes of the open transaction by key, a null value marks an erase
+    std::map<Bytes, std::unique_ptr<Bytes>> m_txn;
+
+public:
+    LogBatch(LogDatabase& database, bool read_only);
+    ~LogBatch() override { Close(); }
+
+    //! Commits reach the file as they happen, syncing is left to the database
+    void Flush() override {}
+    void Close() override;
+
+    bool StartCursor() override;
+    bool ReadAtCursor(CDataStream& ssKey, CDataStream& ssValue, bool& complete) override;
+    void CloseCursor() override;
+
+    bool TxnBegin() override;
+    bool TxnCommit() override;
+    bool TxnAbort() override;
+};
+
+#endif // BITCOIN_WALLET_LOGDB_H
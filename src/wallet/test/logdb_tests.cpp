@@ -0,0 +1,158 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <memory>
+
+#include <boost/test/unit_test.hpp>
+
+#include <fs.h>
+#include <test/test_bitcoin.h>
+#include <util/memory.h>
+#include <wallet/logdb.h>
+
+BOOST_FIXTURE_TEST_SUITE(logdb_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(logdb_write_read_erase)
+{
+    fs::path file_path = SetDataDir("logdb_write_read_erase") / "wallet.dat";
+    {
+        LogDatabase database(file_path);
+        BOOST_CHECK(LogDatabase::IsLogFile(file_path));
+        BOOST_CHECK(LogDatabase::IsLoaded(file_path));
+        BOOST_CHECK_THROW(MakeUnique<LogDatabase>(file_path), std::runtime_error);
+
+        std::unique_ptr<DatabaseBatch> batch = database.MakeBatch();
+        BOOST_CHECK(batch->Write(std::string("a"), 1));
+        BOOST_CHECK(batch->Write(std::string("b"), 2));
+        BOOST_CHECK(!batch->Write(std::string("b"), 3, false));
+        BOOST_CHECK(batch->Write(std::string("b"), 4));
+        BOOST_CHECK(batch->Write(std::string("c"), 5));
+        BOOST_CHECK(batch->Erase(std::string("c")));
+        BOOST_CHECK(batch->Erase(std::string("d")));
+
+        int value;
+        BOOST_CHECK(batch->Read(std::string("b"), value));
+        BOOST_CHECK_EQUAL(value, 4);
+        BOOST_CHECK(!batch->Exists(std::string("c")));
+    }
+    BOOST_CHECK(!LogDatabase::IsLoaded(file_path));
+
+    LogDatabase database(file_path);
+    std::unique_ptr<DatabaseBatch> batch = database.MakeBatch("r");
+    int value;
+    BOOST_CHECK(batch->Read(std::string("a"), value));
+    BOOST_CHECK_EQUAL(value, 1);
+    BOOST_CHECK(batch->Read(std::string("b"), value));
+    BOOST_CHECK_EQUAL(value, 4);
+    BOOST_CHECK(!batch->Exists(std::string("c")));
+
+    // The cursor returns the records in key order
+    std::vector<std::string> keys;
+    BOOST_CHECK(batch->StartCursor());
+    while (true) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        bool complete;
+        if (!batch->ReadAtCursor(ssKey, ssValue, complete)) {
+            BOOST_CHECK(complete);
+            break;
+        }
+        std::string key;
+        ssKey >> key;
+        keys.push_back(key);
+    }
+    batch->CloseCursor();
+    BOOST_CHECK(keys == std::vector<std::string>({"a", "b"}));
+}
+
+BOOST_AUTO_TEST_CASE(logdb_txn)
+{
+    fs::path file_path = SetDataDir("logdb_txn") / "wallet.dat";
+    {
+        LogDatabase database(file_path);
+        std::unique_ptr<DatabaseBatch> batch = database.MakeBatch();
+        BOOST_CHECK(batch->Write(std::string("a"), 1));
+
+        BOOST_CHECK(batch->TxnBegin());
+        BOOST_CHECK(batch->Write(std::string("b"), 2));
+        BOOST_CHECK(batch->Erase(std::string("a")));
+        // Reads see the writes of the open transaction
+        BOOST_CHECK(batch->Exists(std::string("b")));
+        BOOST_CHECK(!batch->Exists(std::string("a")));
+        BOOST_CHECK(batch->TxnAbort());
+        BOOST_CHECK(!batch->Exists(std::string("b")));
+        BOOST_CHECK(batch->Exists(std::string("a")));
+
+        BOOST_CHECK(batch->TxnBegin());
+        BOOST_CHECK(batch->Write(std::string("c"), 3));
+        BOOST_CHECK(batch->Erase(std::string("a")));
+        BOOST_CHECK(batch->TxnCommit());
+    }
+
+    LogDatabase database(file_path);
+    std::unique_ptr<DatabaseBatch> batch = database.MakeBatch("r");
+    BOOST_CHECK(!batch->Exists(std::string("a")));
+    BOOST_CHECK(!batch->Exists(std::string("b")));
+    BOOST_CHECK(batch->Exists(std::string("c")));
+}
+
+BOOST_AUTO_TEST_CASE(logdb_compact)
+{
+    fs::path file_path = SetDataDir("logdb_compact") / "wallet.dat";
+    LogDatabase database(file_path);
+    {
+        std::unique_ptr<DatabaseBatch> batch = database.MakeBatch();
+        const std::vector<unsigned char> data(1000, 0x55);
+        for (int i = 0; i < 100; ++i) {
+            for (int j = 0; j < 20; ++j) {
+                BOOST_CHECK(batch->Write(std::make_pair(std::string("data"), j), data));
+            }
+            BOOST_CHECK(batch->Write(std::make_pair(std::string("pool"), i), i));
+        }
+    }
+    const uint64_t size_before = fs::file_size(file_path);
+    BOOST_CHECK(database.Rewrite("\x04pool"));
+    BOOST_CHECK(fs::file_size(file_path) < size_before / 50);
+
+    std::unique_ptr<DatabaseBatch> batch = database.MakeBatch();
+    BOOST_CHECK(batch->Exists(std::make_pair(std::string("data"), 19)));
+    BOOST_CHECK(!batch->Exists(std::make_pair(std::string("pool"), 0)));
+    BOOST_CHECK(batch->Write(std::string("after"), 1));
+    int value;
+    BOOST_CHECK(batch->Read(std::string("after"), value));
+    BOOST_CHECK_EQUAL(value, 1);
+}
+
+BOOST_AUTO_TEST_CASE(logdb_torn_frame)
+{
+    fs::path file_path = SetDataDir("logdb_torn_frame") / "wallet.dat";
+    {
+        LogDatabase database(file_path);
+        std::unique_ptr<DatabaseBatch> batch = database.MakeBatch();
+        BOOST_CHECK(batch->Write(std::string("a"), 1));
+        BOOST_CHECK(batch->Write(std::string("b"), 2));
+    }
+
+    // Cut the last frame short, as if the process died while appending it
+    const uint64_t size = fs::file_size(file_path);
+    fs::resize_file(file_path, size - 2);
+    std::string warning, error;
+    BOOST_CHECK(LogDatabase::Verify(file_path, warning, error));
+    BOOST_CHECK(!warning.empty());
+
+    {
+        LogDatabase database(file_path);
+        std::unique_ptr<DatabaseBatch> batch = database.MakeBatch();
+        BOOST_CHECK(batch->Exists(std::string("a")));
+        BOOST_CHECK(!batch->Exists(std::string("b")));
+        BOOST_CHECK(batch->Write(std::string("c"), 3));
+    }
+
+    LogDatabase database(file_path);
+    std::unique_ptr<DatabaseBatch> batch = database.MakeBatch("r");
+    BOOST_CHECK(batch->Exists(std::string("a")));
+    BOOST_CHECK(batch->Exists(std::string("c")));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -269,7 +269,7 @@ static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64
     CBlockIndex* block = nullptr;
     if (blockTime > 0) {
         auto locked_chain = wallet.chain().lock();
-        auto inserted = mapBlockIndex.emplace(GetRandHash(), new CBlockIndex);
+        auto inserted = mapBlockIndex.emplace(GetRandHash(), blockIndexSlabs.New());
         assert(inserted.second);
         const uint256& hash = inserted.first->first;
         block = inserted.first->second;
@@ -445,6 +445,40 @@ BOOST_FIXTURE_TEST_CASE(ListCoins, ListCoinsTestingSetup)
     BOOST_CHECK_EQUAL(list.begin()->second.size(), 2U);
 }
 
+BOOST_FIXTURE_TEST_CASE(balance_cache, ListCoinsTestingSetup)
+{
+    // Balances come from the cache on the second call
+    CWallet::Balance before = wallet->GetBalances();
+    BOOST_CHECK_EQUAL(before.m_mine_trusted, 50 * COIN);
+    BOOST_CHECK_EQUAL(wallet->GetBalance(), 50 * COIN);
+    BOOST_CHECK_EQUAL(wallet->GetBalances().m_mine_immature, before.m_mine_immature);
+
+    // Spending the coin has to drop the cached balance. The block mining the
+    // spend also matures the next coinbase.
+    AddTx(CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */});
+    CWallet::Balance after = wallet->GetBalances();
+    BOOST_CHECK_EQUAL(after.m_mine_immature, before.m_mine_immature - 50 * COIN);
+    BOOST_CHECK_EQUAL(after.m_mine_trusted, wallet->GetAvailableBalance());
+    {
+        LOCK2(cs_main, wallet->cs_wallet);
+        std::vector<COutput> available;
+        wallet->AvailableCoins(*m_locked_chain, available);
+        BOOST_CHECK_EQUAL(available.size(), 2U);
+
+        // The tracked transactions give the same balances as all of mapWallet
+        CAmount trusted = 0, immature = 0;
+        for (const auto& entry : wallet->mapWallet) {
+            const CWalletTx& wtx = entry.second;
+            if (wtx.IsTrusted(*m_locked_chain) && wtx.GetDepthInMainChain(*m_locked_chain) >= 0) {
+                trusted += wtx.GetAvailableCredit(*m_locked_chain);
+            }
+            immature += wtx.GetImmatureCredit(*m_locked_chain);
+        }
+        BOOST_CHECK_EQUAL(after.m_mine_trusted, trusted);
+        BOOST_CHECK_EQUAL(after.m_mine_immature, immature);
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(wallet_disableprivkeys, TestChain100Setup)
 {
     auto chain = interfaces::MakeChain();
@@ -498,4 +532,106 @@ BOOST_FIXTURE_TEST_CASE(dummy_input_size_test, TestChain100Setup)
     BOOST_CHECK_EQUAL(CalculateNestedKeyhashInputSize(true), DUMMY_NESTED_P2WPKH_INPUT_SIZE);
 }
 
+BOOST_AUTO_TEST_CASE(stealth_output_key)
+{
+    ec_secret sScan;
+    ec_secret sSpend;
+    ec_point pkScan;
+    ec_point pkSpend;
+    BOOST_REQUIRE_EQUAL(GenerateRandomSecret(sScan), 0);
+    BOOST_REQUIRE_EQUAL(GenerateRandomSecret(sSpend), 0);
+    BOOST_REQUIRE_EQUAL(SecretToPublicKey(sScan, pkScan), 0);
+    BOOST_REQUIRE_EQUAL(SecretToPublicKey(sSpend, pkSpend), 0);
+
+    // Pay to the stealth address like a sender does: to a key derived from
+    // an ephemeral secret, which is published after it
+    ec_secret sEphem;
+    ec_secret sShared;
+    ec_point pkEphem;
+    ec_point pkSendTo;
+    BOOST_REQUIRE_EQUAL(GenerateRandomSecret(sEphem), 0);
+    BOOST_REQUIRE_EQUAL(SecretToPublicKey(sEphem, pkEphem), 0);
+    BOOST_REQUIRE_EQUAL(StealthSecret(sEphem, pkScan, pkSpend, sShared, pkSendTo), 0);
+
+    // The receiver finds the output with the scan secret and derives its key
+    // from the spend key, as ExpandLockedOutputs() does after an unlock
+    ec_secret sSharedR;
+    ec_point pkExtracted;
+    BOOST_REQUIRE_EQUAL(StealthSecret(sScan, pkEphem, pkSpend, sSharedR, pkExtracted), 0);
+    BOOST_CHECK(pkExtracted == pkSendTo);
+    CKey kSpend;
+    kSpend.Set(&sSpend.e[0], &sSpend.e[EC_SECRET_SIZE], true);
+    CKey key;
+    BOOST_REQUIRE_EQUAL(StealthSharedToSecretSpend(sSharedR, kSpend, key), 0);
+    BOOST_CHECK(key.GetPubKey() == CPubKey(pkSendTo));
+
+    // Same as the ec_secret version
+    ec_secret sSpendR;
+    BOOST_REQUIRE_EQUAL(StealthSharedToSecretSpend(sSharedR, sSpend, sSpendR), 0);
+    BOOST_CHECK(std::equal(key.begin(), key.end(), &sSpendR.e[0]));
+}
+
+BOOST_AUTO_TEST_CASE(block_batch_rollback)
+{
+    // A transaction the wallet has, and one that spends it
+    CMutableTransaction mtxOld;
+    mtxOld.vout.emplace_back(1 * COIN, CScript() << OP_TRUE);
+    const CTransactionRef txOld = MakeTransactionRef(mtxOld);
+    CMutableTransaction mtxNew;
+    mtxNew.vin.emplace_back(COutPoint(txOld->GetHash(), 0));
+    mtxNew.vout.emplace_back(COIN / 2, CScript() << OP_TRUE);
+    const CTransactionRef txNew = MakeTransactionRef(mtxNew);
+
+    const uint256 hashGood = InsecureRand256();
+    int64_t nOrderPosNext;
+    {
+        LOCK(m_wallet.cs_wallet);
+        BOOST_REQUIRE(m_wallet.AddToWallet(CWalletTx(&m_wallet, txOld)));
+        nOrderPosNext = m_wallet.nOrderPosNext;
+    }
+    m_wallet.ChainStateFlushed(CBlockLocator({hashGood}));
+
+    // A block confirms the first and adds the second, then fails half way
+    try {
+        LOCK(m_wallet.cs_wallet);
+        WalletBlockBatch block_batch(&m_wallet);
+        CWalletTx wtxConfirmed(&m_wallet, txOld);
+        wtxConfirmed.hashBlock = InsecureRand256();
+        wtxConfirmed.nIndex = 1;
+        BOOST_CHECK(m_wallet.AddToWallet(wtxConfirmed));
+        BOOST_CHECK(m_wallet.AddToWallet(CWalletTx(&m_wallet, txNew)));
+        throw std::runtime_error("failure mid-block");
+    } catch (const std::runtime_error&) {
+    }
+
+    // Neither memory...
+    {
+        auto locked_chain = m_chain->lock();
+        LOCK(m_wallet.cs_wallet);
+        BOOST_CHECK_EQUAL(m_wallet.mapWallet.size(), 1U);
+        const CWalletTx* wtx = m_wallet.GetWalletTx(txOld->GetHash());
+        BOOST_REQUIRE(wtx);
+        BOOST_CHECK(wtx->hashUnset());
+        BOOST_CHECK_EQUAL(wtx->nIndex, -1);
+        BOOST_CHECK(!m_wallet.IsSpent(*locked_chain, txOld->GetHash(), 0));
+        BOOST_CHECK_EQUAL(m_wallet.nOrderPosNext, nOrderPosNext);
+        BOOST_CHECK_EQUAL(m_wallet.wtxOrdered.size(), 1U);
+    }
+
+    // ...nor the file keeps any of the block
+    std::vector<uint256> vTxHash;
+    std::vector<CWalletTx> vWtx;
+    BOOST_CHECK(WalletBatch(m_wallet.GetDBHandle()).FindWalletTx(vTxHash, vWtx) == DBErrors::LOAD_OK);
+    BOOST_REQUIRE_EQUAL(vWtx.size(), 1U);
+    BOOST_CHECK(vWtx[0].GetHash() == txOld->GetHash());
+    BOOST_CHECK(vWtx[0].hashUnset());
+
+    // The best block stays before the failed one, so it is rescanned
+    m_wallet.ChainStateFlushed(CBlockLocator({InsecureRand256()}));
+    CBlockLocator locator;
+    BOOST_CHECK(WalletBatch(m_wallet.GetDBHandle()).ReadBestBlock(locator));
+    BOOST_REQUIRE_EQUAL(locator.vHave.size(), 1U);
+    BOOST_CHECK(locator.vHave[0] == hashGood);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
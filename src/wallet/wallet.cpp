@@ -26,6 +26,7 @@
 #include <script/descriptor.h>
 #include <script/script.h>
 #include <shutdown.h>
+#include <support/cleanse.h>
 #include <timedata.h>
 #include <txmempool.h>
 #include <util/moneystr.h>
@@ -36,10 +37,13 @@
 #include <algorithm>
 #include <assert.h>
 #include <future>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 
 static const size_t OUTPUT_GROUP_MAX_ENTRIES = 10;
+//! Don't start a thread for fewer locked outputs than this in ExpandLockedOutputs()
+static const size_t MIN_LOCKED_OUTPUTS_PER_THREAD = 64;
 
 static CCriticalSection cs_wallets;
 static std::vector<std::shared_ptr<CWallet>> vpwallets GUARDED_BY(cs_wallets);
@@ -291,8 +295,8 @@ bool CWallet::AddKeyPubKeyWithDB(WalletBatch &batch, const CKey& secret, const C
 
 bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
 {
-    WalletBatch batch(*database);
-    return CWallet::AddKeyPubKeyWithDB(batch, secret, pubkey);
+    std::unique_ptr<WalletBatch> owned_batch;
+    return CWallet::AddKeyPubKeyWithDB(GetBatch(owned_batch), secret, pubkey);
 }
 
 bool CWallet::AddCryptedKey(const CPubKey &vchPubKey,
@@ -306,10 +310,10 @@ bool CWallet::AddCryptedKey(const CPubKey &vchPubKey,
             return encrypted_batch->WriteCryptedKey(vchPubKey,
                                                         vchCryptedSecret,
                                                         mapKeyMetadata[vchPubKey.GetID()]);
-        else
-            return WalletBatch(*database).WriteCryptedKey(vchPubKey,
-                                                            vchCryptedSecret,
-                                                            mapKeyMetadata[vchPubKey.GetID()]);
+        std::unique_ptr<WalletBatch> owned_batch;
+        return GetBatch(owned_batch).WriteCryptedKey(vchPubKey,
+                                                     vchCryptedSecret,
+                                                     mapKeyMetadata[vchPubKey.GetID()]);
     }
 }
 
@@ -352,7 +356,8 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
-    return WalletBatch(*database).WriteCScript(Hash160(redeemScript), redeemScript);
+    std::unique_ptr<WalletBatch> owned_batch;
+    return GetBatch(owned_batch).WriteCScript(Hash160(redeemScript), redeemScript);
 }
 
 bool CWallet::LoadCScript(const CScript& redeemScript)
@@ -377,7 +382,8 @@ bool CWallet::AddWatchOnly(const CScript& dest)
     const CKeyMetadata& meta = m_script_metadata[CScriptID(dest)];
     UpdateTimeFirstKey(meta.nCreateTime);
     NotifyWatchonlyChanged(true);
-    return WalletBatch(*database).WriteWatchOnly(dest, meta);
+    std::unique_ptr<WalletBatch> owned_batch;
+    return GetBatch(owned_batch).WriteWatchOnly(dest, meta);
 }
 
 bool CWallet::AddWatchOnly(const CScript& dest, int64_t nCreateTime)
@@ -393,7 +399,8 @@ bool CWallet::RemoveWatchOnly(const CScript &dest)
         return false;
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
-    if (!WalletBatch(*database).EraseWatchOnly(dest))
+    std::unique_ptr<WalletBatch> owned_batch;
+    if (!GetBatch(owned_batch).EraseWatchOnly(dest))
         return false;
 
     return true;
@@ -472,6 +479,10 @@ bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase,
 
 void CWallet::ChainStateFlushed(const CBlockLocator& loc)
 {
+    if (m_block_sync_failed) {
+        // A block's changes were rolled back, keep the best block before it
+        return;
+    }
     WalletBatch batch(*database);
     batch.WriteBestBlock(loc);
 }
@@ -612,6 +623,7 @@ bool CWallet::IsSpent(interfaces::Chain::Lock& locked_chain, const uint256& hash
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
+    MarkBalancesDirty(outpoint.hash);
 
     setLockedCoins.erase(outpoint);
 
@@ -793,11 +805,122 @@ int64_t CWallet::IncOrderPosNext(WalletBatch *batch)
     if (batch) {
         batch->WriteOrderPosNext(nOrderPosNext);
     } else {
-        WalletBatch(*database).WriteOrderPosNext(nOrderPosNext);
+        std::unique_ptr<WalletBatch> owned_batch;
+        GetBatch(owned_batch).WriteOrderPosNext(nOrderPosNext);
     }
     return nRet;
 }
 
+WalletBatch& CWallet::GetBatch(std::unique_ptr<WalletBatch>& owned_batch, const char* pszMode, bool fFlushOnClose) const
+{
+    LOCK(cs_wallet);
+    if (m_block_batch) {
+        return *m_block_batch->m_batch;
+    }
+    owned_batch = MakeUnique<WalletBatch>(*database, pszMode, fFlushOnClose);
+    return *owned_batch;
+}
+
+WalletBlockBatch::WalletBlockBatch(CWallet* w) : m_wallet(w)
+{
+    AssertLockHeld(m_wallet->cs_wallet);
+    if (m_wallet->m_block_batch) {
+        return; // already inside the scope of a block
+    }
+    // The periodic wallet flush takes care of the checkpoint
+    m_batch = MakeUnique<WalletBatch>(*m_wallet->database, "r+", false);
+    if (!m_batch->TxnBegin()) {
+        // Dummy database, writes go through unbatched
+        m_batch.reset();
+        return;
+    }
+    m_order_pos_next = m_wallet->nOrderPosNext;
+    m_wallet->m_block_batch = this;
+}
+
+bool WalletBlockBatch::Commit()
+{
+    if (!m_batch) {
+        return true;
+    }
+    m_wallet->m_block_batch = nullptr;
+    bool ret = m_batch->TxnCommit();
+    m_batch.reset();
+    if (!ret) {
+        m_wallet->WalletLogPrintf("%s: Committing the block's wallet changes failed\n", __func__);
+        Rollback();
+    }
+    m_undo_txs.clear();
+    return ret;
+}
+
+void WalletBlockBatch::Rollback()
+{
+    AssertLockHeld(m_wallet->cs_wallet);
+    for (auto& item : m_undo_txs) {
+        auto it = m_wallet->mapWallet.find(item.first);
+        if (it == m_wallet->mapWallet.end()) {
+            continue;
+        }
+        if (item.second) {
+            // Same transaction and order position, so wtxOrdered and
+            // mapTxSpends still hold
+            it->second = *item.second;
+            m_wallet->NotifyTransactionChanged(m_wallet, item.first, CT_UPDATED);
+        } else {
+            // Looked up rather than taken from m_it_wtxOrdered, which isn't
+            // set yet if AddToWallet() threw half way
+            auto ordered = m_wallet->wtxOrdered.equal_range(it->second.nOrderPos);
+            for (auto entry = ordered.first; entry != ordered.second; ++entry) {
+                if (entry->second == &it->second) {
+                    m_wallet->wtxOrdered.erase(entry);
+                    break;
+                }
+            }
+            for (const CTxIn& txin : it->second.tx->vin) {
+                auto range = m_wallet->mapTxSpends.equal_range(txin.prevout);
+                for (auto spend = range.first; spend != range.second;) {
+                    if (spend->second == item.first) {
+                        spend = m_wallet->mapTxSpends.erase(spend);
+                    } else {
+                        ++spend;
+                    }
+                }
+            }
+            m_wallet->mapWallet.erase(it);
+            m_wallet->MarkBalancesDirty(item.first);
+            m_wallet->NotifyTransactionChanged(m_wallet, item.first, CT_DELETED);
+        }
+    }
+    m_wallet->nOrderPosNext = m_order_pos_next;
+    m_wallet->MarkDirty();
+    m_wallet->m_cached_balance.reset();
+
+    // Keys, stealth metadata and anon records the block added in memory are
+    // left; the rescan from the last good best block writes them again
+    m_wallet->m_block_sync_failed = true;
+    m_wallet->WalletLogPrintf("%s: Rolled back %u wallet transactions, the wallet rescans on the next start\n", __func__, m_undo_txs.size());
+}
+
+WalletBlockBatch::~WalletBlockBatch()
+{
+    if (m_batch) {
+        m_wallet->m_block_batch = nullptr;
+        m_batch->TxnAbort();
+        Rollback();
+    }
+}
+
+void CWallet::SaveForBlockUndo(const uint256& hash)
+{
+    AssertLockHeld(cs_wallet);
+    if (!m_block_batch || m_block_batch->m_undo_txs.count(hash)) {
+        return;
+    }
+    auto it = mapWallet.find(hash);
+    m_block_batch->m_undo_txs.emplace(hash, it == mapWallet.end() ? nullptr : MakeUnique<CWalletTx>(it->second));
+}
+
 void CWallet::MarkDirty()
 {
     {
@@ -840,9 +963,11 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 {
     LOCK(cs_wallet);
 
-    WalletBatch batch(*database, "r+", fFlushOnClose);
+    std::unique_ptr<WalletBatch> owned_batch;
+    WalletBatch& batch = GetBatch(owned_batch, "r+", fFlushOnClose);
 
     uint256 hash = wtxIn.GetHash();
+    SaveForBlockUndo(hash);
 
     // Inserts only if not already there, returns tx inserted or tx found
     std::pair<std::map<uint256, CWalletTx>::iterator, bool> ret = mapWallet.insert(std::make_pair(hash, wtxIn));
@@ -930,6 +1055,7 @@ void CWallet::LoadToWallet(const CWalletTx& wtxIn)
         wtx.m_it_wtxOrdered = wtxOrdered.insert(std::make_pair(wtx.nOrderPos, &wtx));
     }
     AddToSpends(hash);
+    MarkBalancesDirty(hash);
     for (const CTxIn& txin : wtx.tx->vin) {
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
@@ -966,10 +1092,10 @@ static int IsAnonCoinCompromised(CPubKey &pubKey, CAnonOutput &ao, ec_point &vch
 
     RingSignatureMgr::GetInstance().getOldKeyImage(pubKey, pkImage);
 
-    if (vchSpentImage == pkImage || GetKeyImage(*pblocktree, pkImage, kis, fInMempool))
+    if (vchSpentImage == pkImage || GetKeyImage(*panondb, pkImage, kis, fInMempool))
     {
         ao.nCompromised = 1;
-        pblocktree->WriteAnonOutput(pubKey, ao);
+        panondb->WriteAnonOutput(pubKey, ao);
         if(fDebugRingSig)
             LogPrintf("Spent key image, mark as compromised: %s\n", pubKey.GetID().ToString());
         return 1;
@@ -1030,7 +1156,7 @@ bool CWallet::UpdateAnonTransaction(const CTransaction& tx, const uint256& block
 
         pkRingCoin = CPubKey(&pPubkeys[0 * EC_COMPRESSED_SIZE], EC_COMPRESSED_SIZE);
 
-        if (false == pblocktree->ReadAnonOutput(pkRingCoin, ao))
+        if (false == panondb->ReadAnonOutput(pkRingCoin, ao))
         {
             LogPrintf("UpdateAnonTransaction(): Error input %u AnonOutput %s not found.\n", i, pkRingCoin.GetID().ToString());
             //LogPrintf("%s, %s\n", pkRingCoin.GetID().ToString(), CBitcoinAddress(pkRingCoin.GetID()).ToString());
@@ -1043,7 +1169,7 @@ bool CWallet::UpdateAnonTransaction(const CTransaction& tx, const uint256& block
         spentKeyImage.inputNo = i;
         spentKeyImage.nValue = nCoinValue;
 
-        if (false == pblocktree->WriteKeyImage(vchImage, spentKeyImage))
+        if (false == panondb->WriteKeyImage(vchImage, spentKeyImage))
         {
             LogPrintf("UpdateAnonTransaction(): Error input %d WriteKeyImage failed %s .\n", i, HexStr(vchImage).c_str());
             return false;
@@ -1064,7 +1190,7 @@ bool CWallet::UpdateAnonTransaction(const CTransaction& tx, const uint256& block
 
         CPubKey pkCoin = CPubKey(&s[2+1], EC_COMPRESSED_SIZE);
         CAnonOutput ao;
-        if (false == pblocktree->ReadAnonOutput(pkCoin, ao))
+        if (false == panondb->ReadAnonOutput(pkCoin, ao))
         {
             LogPrintf("ReadAnonOutput %d failed.\n", i);
             return false;
@@ -1072,7 +1198,7 @@ bool CWallet::UpdateAnonTransaction(const CTransaction& tx, const uint256& block
 
         ao.nBlockHeight = nNewHeight;
 
-        if (false == pblocktree->WriteAnonOutput(pkCoin, ao))
+        if (false == panondb->WriteAnonOutput(pkCoin, ao))
         {
             LogPrintf("ReadAnonOutput %d failed.\n", i);
             return false;
@@ -1115,7 +1241,7 @@ bool CWallet::ProcessAnonTransaction(const CTransaction& tx, const uint256& bloc
         CKeyImageSpent spentKeyImage;
 
         bool fInMempool;
-        if (GetKeyImage(*pblocktree, vchImage, spentKeyImage, fInMempool))
+        if (GetKeyImage(*panondb, vchImage, spentKeyImage, fInMempool))
         {
             if (spentKeyImage.txnHash == txnHash && spentKeyImage.inputNo == i)
             {
@@ -1127,7 +1253,7 @@ bool CWallet::ProcessAnonTransaction(const CTransaction& tx, const uint256& bloc
                 return UpdateAnonTransaction(tx, blockHash);
             }
 
-            if (TxnHashInSystem(*pblocktree, spentKeyImage.txnHash))
+            if (TxnHashInSystem(*panondb, spentKeyImage.txnHash))
             {
                 return error("%s: Error input %d keyimage %s already spent.", __func__, i, HexStr(vchImage).c_str());
             }
@@ -1142,7 +1268,8 @@ bool CWallet::ProcessAnonTransaction(const CTransaction& tx, const uint256& bloc
             //    continue
         }
 
-        WalletBatch wdb{*database};
+        std::unique_ptr<WalletBatch> owned_batch;
+        WalletBatch& wdb = GetBatch(owned_batch);
         COwnedAnonOutput oao;
         ec_point vchNewImage;
         if (!wdb.ReadOldOutputLink(vchImage, vchNewImage))
@@ -1215,7 +1342,7 @@ bool CWallet::ProcessAnonTransaction(const CTransaction& tx, const uint256& bloc
         for (uint32_t ri = 0; ri < (uint32_t)nRingSize; ++ri)
         {
             pkRingCoin = CPubKey(&pPubkeys[ri * EC_COMPRESSED_SIZE], EC_COMPRESSED_SIZE);
-            if (!pblocktree->ReadAnonOutput(pkRingCoin, ao))
+            if (!panondb->ReadAnonOutput(pkRingCoin, ao))
                 return error("%s: Input %u AnonOutput %s not found, rsType: %d.", __func__, i, HexStr(pkRingCoin).c_str(), rsType);
 
             if (IsAnonCoinCompromised(pkRingCoin, ao, vchImage) && Params().GetConsensus().IsProtocolV3(pindexBestHeader ? pindexBestHeader->nHeight : 0))
@@ -1234,7 +1361,7 @@ bool CWallet::ProcessAnonTransaction(const CTransaction& tx, const uint256& bloc
             if (nRingSize == 1)
             {
                 ao.nCompromised = 1;
-                if (!pblocktree->WriteAnonOutput(pkRingCoin, ao))
+                if (!panondb->WriteAnonOutput(pkRingCoin, ao))
                     return error("%s: Input %d WriteAnonOutput failed %s.", __func__, i, HexStr(vchImage).c_str());
 
                 // TODO TSB
@@ -1250,7 +1377,7 @@ bool CWallet::ProcessAnonTransaction(const CTransaction& tx, const uint256& bloc
 
         if (false == blockHash.IsNull())
         {
-            if (!pblocktree->WriteKeyImage(vchImage, spentKeyImage))
+            if (!panondb->WriteKeyImage(vchImage, spentKeyImage))
                 return error("%s: Input %d WriteKeyImage failed %s.", __func__, i, HexStr(vchImage).c_str());
         }
         else
@@ -1307,7 +1434,7 @@ bool CWallet::ProcessAnonTransaction(const CTransaction& tx, const uint256& bloc
         // -- add all anon outputs to txdb
         CAnonOutput ao;
 
-        if (pblocktree->ReadAnonOutput(pkCoin, ao)) // check if exists
+        if (panondb->ReadAnonOutput(pkCoin, ao)) // check if exists
         {
             if (false == blockHash.IsNull())
             {
@@ -1320,7 +1447,7 @@ bool CWallet::ProcessAnonTransaction(const CTransaction& tx, const uint256& bloc
         }
 
         ao = CAnonOutput(outpoint, txout.nValue, nBlockHeight, 0);
-        if (!pblocktree->WriteAnonOutput(pkCoin, ao))
+        if (!panondb->WriteAnonOutput(pkCoin, ao))
         {
             LogPrintf("%s: WriteAnonOutput failed.\n", __func__);
             continue;
@@ -1502,7 +1629,8 @@ bool CWallet::ProcessAnonTransaction(const CTransaction& tx, const uint256& bloc
             */
         }
 
-        WalletBatch wdb{*database};
+        std::unique_ptr<WalletBatch> owned_batch;
+        WalletBatch& wdb = GetBatch(owned_batch);
         if (!fHaveSpendKey)
         {
             std::vector<uint8_t> vchEmpty;
@@ -1587,8 +1715,8 @@ bool CWallet::ProcessAnonTransaction(const CTransaction& tx, const uint256& bloc
             bool fSpentAOut = false;
 
             // shouldn't be possible for kis to be in mempool here
-            fSpentAOut = GetKeyImage(*pblocktree, pkImage, kis, fInMemPool) ||
-                         GetKeyImage(*pblocktree, pkOldImage, kis, fInMemPool);
+            fSpentAOut = GetKeyImage(*panondb, pkImage, kis, fInMemPool) ||
+                         GetKeyImage(*panondb, pkOldImage, kis, fInMemPool);
 
             COwnedAnonOutput oao(outpoint, fSpentAOut);
 
@@ -1610,6 +1738,227 @@ bool CWallet::ProcessAnonTransaction(const CTransaction& tx, const uint256& bloc
     return true;
 }
 
+bool CWallet::ExpandLockedOutputs()
+{
+    // Secrets of a stealth address (or account stealth key), looked up by scan pubkey
+    struct ScanKey
+    {
+        CKey kScan;
+        ec_point pkSpend;
+        CKey kSpend;
+    };
+
+    struct LockedOutput
+    {
+        LockedOutput(const CKeyID& id_, const CPubKey& pkEphem_, const ScanKey* scanKey_, bool fAnon_, const COutPoint& outpoint_)
+            : id(id_), pkEphem(pkEphem_.begin(), pkEphem_.end()), scanKey(scanKey_), fAnon(fAnon_), outpoint(outpoint_) {}
+
+        CKeyID id;
+        ec_point pkEphem;
+        const ScanKey* scanKey;
+        bool fAnon;
+        COutPoint outpoint;
+        CKey key; // set by the workers
+        ec_point pkImage;
+        ec_point pkOldImage;
+        bool fSpent = false;
+    };
+
+    int64_t nStart = GetTimeMillis();
+    std::vector<std::pair<CKeyID, CLockedAnonOutput>> vLockedAnon;
+    std::vector<std::pair<CKeyID, CStealthKeyMetadata>> vLockedStealth;
+    std::map<ec_point, ScanKey> mapScanKeys;
+    std::vector<LockedOutput> vLocked;
+    {
+        LOCK(cs_wallet);
+        if (IsLocked() || IsWalletFlagSet(WALLET_FLAG_DISABLE_PRIVATE_KEYS))
+            return false;
+
+        if (WalletBatch(*database).FindLockedOutputs(vLockedAnon, vLockedStealth) != DBErrors::LOAD_OK)
+            return error("%s: Reading locked outputs failed.", __func__);
+
+        if (vLockedAnon.empty() && vLockedStealth.empty())
+            return true;
+
+        for (const CStealthAddress& sxAddr : stealthAddresses)
+        {
+            ScanKey scanKey;
+            scanKey.kScan.Set(sxAddr.scan_secret.begin(), sxAddr.scan_secret.end(), true);
+            scanKey.kSpend.Set(sxAddr.spend_secret.begin(), sxAddr.spend_secret.end(), true);
+            if (!scanKey.kScan.IsValid() || !scanKey.kSpend.IsValid())
+                continue;
+
+            scanKey.pkSpend = sxAddr.spend_pubkey;
+            mapScanKeys[sxAddr.scan_pubkey] = scanKey;
+        }
+
+        for (const auto& mi : mapExtAccounts)
+        {
+            CExtKeyAccount *ea = mi.second;
+            for (const auto& it : ea->mapStealthKeys)
+            {
+                const CEKAStealthKey &aks = it.second;
+                ScanKey scanKey;
+                if (!aks.skScan.IsValid() || ea->IsLocked(aks) || !ea->GetKey(aks.akSpend, scanKey.kSpend))
+                    continue;
+
+                // Fetched once here rather than through ExpandStealthChildKey(), which takes the account lock per output
+                scanKey.kScan = aks.skScan;
+                scanKey.pkSpend = aks.pkSpend;
+                mapScanKeys[aks.pkScan] = scanKey;
+            }
+        }
+
+        auto addLocked = [&](const CKeyID& id, const CPubKey& pkEphem, const CPubKey& pkScan, bool fAnon, const COutPoint& outpoint) {
+            auto mi = mapScanKeys.find(ec_point(pkScan.begin(), pkScan.end()));
+            if (mi == mapScanKeys.end())
+                return; // spend secret still unavailable
+            vLocked.emplace_back(id, pkEphem, &mi->second, fAnon, outpoint);
+        };
+        for (const auto& lao : vLockedAnon)
+            addLocked(lao.first, lao.second.r_pkEphem, lao.second.r_pkScan, true, lao.second.r_outpoint);
+        for (const auto& sxm : vLockedStealth)
+            addLocked(sxm.first, sxm.second.r_pkEphem, sxm.second.r_pkScan, false, COutPoint());
+    }
+
+    if (vLocked.empty())
+        return true;
+
+    // The EC math is independent per output, spread it over all cores
+    std::atomic<size_t> nNext{0};
+    std::atomic<size_t> nDone{0};
+    auto expand = [&vLocked, &nNext, &nDone]() {
+        size_t i;
+        while ((i = nNext++) < vLocked.size())
+        {
+            LockedOutput& out = vLocked[i];
+            ec_secret sScan;
+            ec_secret sShared;
+            ec_point pkExtracted;
+            memcpy(&sScan.e[0], out.scanKey->kScan.begin(), EC_SECRET_SIZE);
+            if (StealthSecret(sScan, out.pkEphem, out.scanKey->pkSpend, sShared, pkExtracted) == 0 &&
+                CPubKey(pkExtracted).GetID() == out.id)
+            {
+                StealthSharedToSecretSpend(sShared, out.scanKey->kSpend, out.key);
+            }
+            memory_cleanse(&sScan.e[0], EC_SECRET_SIZE);
+            memory_cleanse(&sShared.e[0], EC_SECRET_SIZE);
+            nDone++;
+        }
+    };
+
+    const std::string strProgress = strprintf("%s " + _("Expanding locked outputs..."), GetDisplayName());
+    ShowProgress(strProgress, 0);
+    const size_t nThreads = std::max<size_t>(1, std::min<size_t>(GetNumCores(), vLocked.size() / MIN_LOCKED_OUTPUTS_PER_THREAD));
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < nThreads; ++i)
+        threads.emplace_back(expand);
+    while (nDone < vLocked.size())
+    {
+        ShowProgress(strProgress, std::max(1, std::min(99, (int)(nDone * 100 / vLocked.size()))));
+        MilliSleep(100);
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    ShowProgress(strProgress, 100);
+
+    // Key images come from the shared RingSignatureMgr context, which the
+    // wallet only uses under cs_wallet.
+    {
+        LOCK(cs_wallet);
+        for (LockedOutput& out : vLocked)
+        {
+            if (!out.fAnon || !out.key.IsValid())
+                continue;
+            CPubKey pkCoin = out.key.GetPubKey();
+            ec_point pkSpendR(pkCoin.begin(), pkCoin.end());
+            ec_secret sSpendR;
+            memcpy(&sSpendR.e[0], out.key.begin(), EC_SECRET_SIZE);
+
+            RingSignatureMgr::GetInstance().getOldKeyImage(pkCoin, out.pkOldImage);
+            if (RingSignatureMgr::GetInstance().generateKeyImage(pkSpendR, sSpendR, out.pkImage) != 0)
+            {
+                LogPrintf("%s: generateKeyImage() failed.\n", __func__);
+                out.key = CKey();
+            }
+            memory_cleanse(&sSpendR.e[0], EC_SECRET_SIZE);
+        }
+    }
+
+    // Only this wallet can spend the outputs, and it could not until now, so
+    // their key images can't become spent before the results are applied.
+    {
+        LOCK(cs_main);
+        for (LockedOutput& out : vLocked)
+        {
+            if (!out.fAnon || !out.key.IsValid())
+                continue;
+            CKeyImageSpent kis;
+            bool fInMemPool;
+            out.fSpent = GetKeyImage(*panondb, out.pkImage, kis, fInMemPool) ||
+                         GetKeyImage(*panondb, out.pkOldImage, kis, fInMemPool);
+        }
+    }
+
+    // Everything is written in a single db transaction
+    size_t nExpanded = 0;
+    {
+        LOCK(cs_wallet);
+        if (IsLocked())
+            return false;
+
+        WalletBatch wdb{*database};
+        if (!wdb.TxnBegin())
+            return error("%s: TxnBegin failed.", __func__);
+
+        for (LockedOutput& out : vLocked)
+        {
+            CPubKey pkCoin = out.key.IsValid() ? out.key.GetPubKey() : CPubKey();
+            if (!pkCoin.IsValid() || pkCoin.GetID() != out.id)
+            {
+                LogPrintf("%s: Could not derive key %s.\n", __func__, CBitcoinAddress(out.id).ToString().c_str());
+                continue;
+            }
+
+            if (!AddKeyPubKeyWithDB(wdb, out.key, pkCoin))
+            {
+                LogPrintf("%s: AddKeyPubKey failed.\n", __func__);
+                continue;
+            }
+
+            if (out.fAnon)
+            {
+                COwnedAnonOutput oao(out.outpoint, out.fSpent);
+                if (!wdb.WriteOwnedAnonOutput(out.pkImage, oao)          ||
+                    !wdb.WriteOldOutputLink(out.pkOldImage, out.pkImage) ||
+                    !wdb.WriteOwnedAnonOutputLink(pkCoin, out.pkImage)   ||
+                    !wdb.EraseLockedAnonOutput(out.id))
+                {
+                    LogPrintf("%s: WriteOwnedAnonOutput() failed.\n", __func__);
+                    continue;
+                }
+            }
+            else
+            {
+                if (!wdb.EraseStealthKeyMeta(out.id))
+                {
+                    LogPrintf("%s: EraseStealthKeyMeta() failed.\n", __func__);
+                    continue;
+                }
+                mapStealthKeyMeta.erase(out.id);
+            }
+            nExpanded++;
+        }
+
+        if (!wdb.TxnCommit())
+            return error("%s: TxnCommit failed.", __func__);
+    }
+
+    LogPrintf("%s: Expanded %u of %u locked outputs using %u threads in %dms.\n", __func__,
+        nExpanded, vLocked.size(), nThreads, GetTimeMillis() - nStart);
+    return true;
+}
+
 int CWallet::ExtKeySaveKey(CExtKeyAccount *sea, const CKeyID &keyId, CEKASCKey &asck) const
 {
     AssertLockHeld(cs_wallet);
@@ -1626,7 +1975,8 @@ int CWallet::ExtKeySaveKey(CExtKeyAccount *sea, const CKeyID &keyId, CEKASCKey &
     }
 
     bool fUpdateAcc;
-    WalletBatch wdb{*database};
+    std::unique_ptr<WalletBatch> owned_batch;
+    WalletBatch& wdb = GetBatch(owned_batch);
 
     if (0 != ExtKeyAppendToPack(sea, keyId, asck, fUpdateAcc))
     {
@@ -1653,7 +2003,8 @@ int CWallet::ExtKeyAppendToPack(CExtKeyAccount *sea, const CKeyID &idKey, CEKASC
     //
     CKeyID idAccount = sea->GetID();
     std::vector<CEKASCKeyPack> asckPak;
-    WalletBatch wdb{*database};
+    std::unique_ptr<WalletBatch> owned_batch;
+    WalletBatch& wdb = GetBatch(owned_batch);
 
     if (!wdb.ReadExtStealthKeyChildPack(idAccount, sea->nPackStealthKeys, asckPak))
     {
@@ -1862,8 +2213,8 @@ bool CWallet::FindStealthTransactions(const CTransaction& tx, mapValue_t& mapNar
                     CPubKey cpkScan(it->scan_pubkey);
                     CStealthKeyMetadata lockedSkMeta(cpkEphem, cpkScan);
 
-                    WalletBatch wdb{*database};
-                    if (!wdb.WriteStealthKeyMeta(keyId, lockedSkMeta))
+                    std::unique_ptr<WalletBatch> owned_batch;
+                    if (!GetBatch(owned_batch).WriteStealthKeyMeta(keyId, lockedSkMeta))
                     {
                         LogPrintf("WriteStealthKeyMeta failed for %s.\n", coinAddress.ToString().c_str());
                     }
@@ -2272,7 +2623,8 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
         return;
 
     // Do not flush the wallet here for performance reasons
-    WalletBatch batch(*database, "r+", false);
+    std::unique_ptr<WalletBatch> owned_batch;
+    WalletBatch& batch = GetBatch(owned_batch, "r+", false);
 
     std::set<uint256> todo;
     std::set<uint256> done;
@@ -2290,6 +2642,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
         if (conflictconfirms < currentconfirm) {
             // Block is 'more conflicted' than current confirm; update.
             // Mark transaction as conflicted with this block.
+            SaveForBlockUndo(now);
             wtx.nIndex = -1;
             wtx.hashBlock = hashBlock;
             wtx.MarkDirty();
@@ -2324,9 +2677,12 @@ void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx) {
     LOCK(cs_wallet);
     SyncTransaction(ptx, {} /* block hash */, 0 /* position in block */);
 
+    // Transactions that aren't ours leave the cached balances alone, and
+    // SyncTransaction() already reset them if it added or updated one
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = true;
+        m_cached_balance.reset();
     }
 }
 
@@ -2335,12 +2691,14 @@ void CWallet::TransactionRemovedFromMempool(const CTransactionRef &ptx) {
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = false;
+        m_cached_balance.reset();
     }
 }
 
 void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) {
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
+    WalletBlockBatch block_batch(this);
     // TODO: Temporarily ensure that mempool removals are notified before
     // connected transactions.  This shouldn't matter, but the abandoned
     // state of transactions in our wallet is currently cleared when we
@@ -2358,16 +2716,23 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
         TransactionRemovedFromMempool(pblock->vtx[i]);
     }
 
+    block_batch.Commit();
+
     m_last_block_processed = pindex->GetBlockHash();
+    // Depths and maturity changed
+    m_cached_balance.reset();
 }
 
 void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) {
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
 
+    WalletBlockBatch block_batch(this);
     for (const CTransactionRef& ptx : pblock->vtx) {
         SyncTransaction(ptx, {} /* block hash */, 0 /* position in block */);
     }
+    block_batch.Commit();
+    m_cached_balance.reset();
 }
 
 void CWallet::BlockUntilSyncedToCurrentChain()
@@ -2877,9 +3242,11 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
                     result.status = ScanResult::FAILURE;
                     break;
                 }
+                WalletBlockBatch block_batch(this);
                 for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
                     SyncTransaction(block.vtx[posInBlock], block_hash, posInBlock, fUpdate);
                 }
+                block_batch.Commit();
                 // scan succeeded, record block as most recent successfully scanned
                 result.stop_block = block_hash;
                 result.stop_height = *block_height;
@@ -2990,6 +3357,22 @@ std::set<uint256> CWalletTx::GetConflicts() const
     return result;
 }
 
+void CWalletTx::MarkDirty()
+{
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fImmatureCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+    if (pwallet) {
+        pwallet->MarkBalancesDirty(GetHash());
+    }
+}
+
 CAmount CWalletTx::GetDebit(const isminefilter& filter) const
 {
     if (tx->vin.empty())
@@ -3241,15 +3624,93 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
+void CWallet::UpdateUnspentCandidates(interfaces::Chain::Lock& locked_chain) const
+{
+    AssertLockHeld(cs_wallet);
+
+    for (const uint256& hash : m_unspent_changed) {
+        const auto mi = mapWallet.find(hash);
+        bool unspent = false;
+        if (mi != mapWallet.end()) {
+            const CWalletTx& wtx = mi->second;
+            // Immature credit counts spent outputs as well
+            unspent = wtx.IsImmatureCoinBase(locked_chain);
+            for (unsigned int i = 0; i < wtx.tx->vout.size() && !unspent; i++) {
+                unspent = IsMine(wtx.tx->vout[i]) != ISMINE_NO && !IsSpent(locked_chain, hash, i);
+            }
+        }
+        if (unspent) {
+            m_unspent_candidates.insert(hash);
+        } else {
+            m_unspent_candidates.erase(hash);
+        }
+    }
+    m_unspent_changed.clear();
+}
+
+std::vector<const CWalletTx*> CWallet::GetUnspentCandidates(interfaces::Chain::Lock& locked_chain) const
+{
+    AssertLockHeld(cs_wallet);
+
+    UpdateUnspentCandidates(locked_chain);
+    std::vector<const CWalletTx*> result;
+    result.reserve(m_unspent_candidates.size());
+    for (const uint256& hash : m_unspent_candidates) {
+        result.push_back(&mapWallet.at(hash));
+    }
+    return result;
+}
+
+void CWallet::MarkBalancesDirty(const uint256& hash) const
+{
+    LOCK(cs_wallet);
+    m_unspent_changed.insert(hash);
+    m_cached_balance.reset();
+}
+
+CWallet::Balance CWallet::GetBalances() const
+{
+    auto locked_chain = chain().lock();
+    LOCK(cs_wallet);
+    if (!m_cached_balance) {
+        std::unique_ptr<Balance> ret(new Balance());
+        UpdateUnspentCandidates(*locked_chain);
+        for (const uint256& hash : m_unspent_candidates) {
+            const CWalletTx* pcoin = &mapWallet.at(hash);
+            const bool is_trusted = pcoin->IsTrusted(*locked_chain);
+            const int depth = pcoin->GetDepthInMainChain(*locked_chain);
+            if (is_trusted && depth >= 0) {
+                ret->m_mine_trusted += pcoin->GetAvailableCredit(*locked_chain, true, ISMINE_SPENDABLE);
+                ret->m_watchonly_trusted += pcoin->GetAvailableCredit(*locked_chain, true, ISMINE_WATCH_ONLY);
+            }
+            if (!is_trusted && depth == 0 && pcoin->InMempool()) {
+                ret->m_mine_untrusted_pending += pcoin->GetAvailableCredit(*locked_chain, true, ISMINE_SPENDABLE);
+                ret->m_watchonly_untrusted_pending += pcoin->GetAvailableCredit(*locked_chain, true, ISMINE_WATCH_ONLY);
+            }
+            ret->m_mine_immature += pcoin->GetImmatureCredit(*locked_chain);
+            ret->m_watchonly_immature += pcoin->GetImmatureWatchOnlyCredit(*locked_chain);
+        }
+        m_cached_balance = std::move(ret);
+    }
+    return *m_cached_balance;
+}
+
 CAmount CWallet::GetBalance(const isminefilter& filter, const int min_depth) const
 {
+    if (min_depth <= 0) {
+        const Balance balance = GetBalances();
+        CAmount nTotal = 0;
+        if (filter & ISMINE_SPENDABLE) nTotal += balance.m_mine_trusted;
+        if (filter & ISMINE_WATCH_ONLY) nTotal += balance.m_watchonly_trusted;
+        return nTotal;
+    }
+
     CAmount nTotal = 0;
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
-        for (const auto& entry : mapWallet)
+        for (const CWalletTx* pcoin : GetUnspentCandidates(*locked_chain))
         {
-            const CWalletTx* pcoin = &entry.second;
             if (pcoin->IsTrusted(*locked_chain) && pcoin->GetDepthInMainChain(*locked_chain) >= min_depth) {
                 nTotal += pcoin->GetAvailableCredit(*locked_chain, true, filter);
             }
@@ -3261,64 +3722,22 @@ CAmount CWallet::GetBalance(const isminefilter& filter, const int min_depth) con
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        auto locked_chain = chain().lock();
-        LOCK(cs_wallet);
-        for (const auto& entry : mapWallet)
-        {
-            const CWalletTx* pcoin = &entry.second;
-            if (!pcoin->IsTrusted(*locked_chain) && pcoin->GetDepthInMainChain(*locked_chain) == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit(*locked_chain);
-        }
-    }
-    return nTotal;
+    return GetBalances().m_mine_untrusted_pending;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        auto locked_chain = chain().lock();
-        LOCK(cs_wallet);
-        for (const auto& entry : mapWallet)
-        {
-            const CWalletTx* pcoin = &entry.second;
-            nTotal += pcoin->GetImmatureCredit(*locked_chain);
-        }
-    }
-    return nTotal;
+    return GetBalances().m_mine_immature;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        auto locked_chain = chain().lock();
-        LOCK(cs_wallet);
-        for (const auto& entry : mapWallet)
-        {
-            const CWalletTx* pcoin = &entry.second;
-            if (!pcoin->IsTrusted(*locked_chain) && pcoin->GetDepthInMainChain(*locked_chain) == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit(*locked_chain, true, ISMINE_WATCH_ONLY);
-        }
-    }
-    return nTotal;
+    return GetBalances().m_watchonly_untrusted_pending;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        auto locked_chain = chain().lock();
-        LOCK(cs_wallet);
-        for (const auto& entry : mapWallet)
-        {
-            const CWalletTx* pcoin = &entry.second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit(*locked_chain);
-        }
-    }
-    return nTotal;
+    return GetBalances().m_watchonly_immature;
 }
 
 // Calculate total balance in a different way from GetBalance. The biggest
@@ -3386,10 +3805,9 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
     vCoins.clear();
     CAmount nTotal = 0;
 
-    for (const auto& entry : mapWallet)
+    for (const CWalletTx* pcoin : GetUnspentCandidates(locked_chain))
     {
-        const uint256& wtxid = entry.first;
-        const CWalletTx* pcoin = &entry.second;
+        const uint256& wtxid = pcoin->GetHash();
 
         if (!CheckFinalTx(*pcoin->tx))
             continue;
@@ -3450,10 +3868,10 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
             if (pcoin->tx->vout[i].nValue < nMinimumAmount || pcoin->tx->vout[i].nValue > nMaximumAmount)
                 continue;
 
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(entry.first, i)))
+            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(wtxid, i)))
                 continue;
 
-            if (IsLockedCoin(entry.first, i))
+            if (IsLockedCoin(wtxid, i))
                 continue;
 
             if (IsSpent(locked_chain, wtxid, i))
@@ -4260,7 +4678,12 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
     for (uint256 hash : vHashOut) {
         const auto& it = mapWallet.find(hash);
         wtxOrdered.erase(it->second.m_it_wtxOrdered);
+        // Whatever it spent is unspent again
+        for (const CTxIn& txin : it->second.tx->vin) {
+            MarkBalancesDirty(txin.prevout.hash);
+        }
         mapWallet.erase(it);
+        MarkBalancesDirty(hash);
     }
 
     if (nZapSelectTxRet == DBErrors::NEED_REWRITE)
@@ -4456,7 +4879,8 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             missingInternal = 0;
         }
         bool internal = false;
-        WalletBatch batch(*database);
+        std::unique_ptr<WalletBatch> owned_batch;
+        WalletBatch& batch = GetBatch(owned_batch);
         for (int64_t i = missingInternal + missingExternal; i--;)
         {
             if (i < missingInternal) {
@@ -4799,7 +5223,8 @@ void CWallet::MarkReserveKeysAsUsed(int64_t keypool_id)
     std::set<int64_t> *setKeyPool = internal ? &setInternalKeyPool : (set_pre_split_keypool.empty() ? &setExternalKeyPool : &set_pre_split_keypool);
     auto it = setKeyPool->begin();
 
-    WalletBatch batch(*database);
+    std::unique_ptr<WalletBatch> owned_batch;
+    WalletBatch& batch = GetBatch(owned_batch);
     while (it != std::end(*setKeyPool)) {
         const int64_t& index = *(it);
         if (index > keypool_id) break; // set*KeyPool is ordered
@@ -471,18 +471,7 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fImmatureCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -627,12 +616,23 @@ struct CoinSelectionParams
 };
 
 class WalletRescanReserver; //forward declarations for ScanForWalletTransactions/RescanFromTime
+class WalletBlockBatch;
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
  */
 class CWallet final : public CCryptoKeyStore, public CValidationInterface
 {
+public:
+    struct Balance {
+        CAmount m_mine_trusted{0};                 //!< Trusted, confirmed or our own in mempool
+        CAmount m_mine_untrusted_pending{0};       //!< Untrusted, but in mempool (pending)
+        CAmount m_mine_immature{0};                //!< Immature coinbases and coinstakes in the main chain
+        CAmount m_watchonly_trusted{0};
+        CAmount m_watchonly_untrusted_pending{0};
+        CAmount m_watchonly_immature{0};
+    };
+
 private:
     uint32_t nStealth;
     uint32_t nFoundStealth;
@@ -644,6 +644,24 @@ private:
 
     WalletBatch *encrypted_batch GUARDED_BY(cs_wallet) = nullptr;
 
+    //! Shared by all writes while a block is synced, see WalletBlockBatch
+    WalletBlockBatch *m_block_batch GUARDED_BY(cs_wallet) = nullptr;
+    friend class WalletBlockBatch;
+    /** Keep a copy of a wallet transaction, as it is before the block being
+      * synced changes it, for WalletBlockBatch to roll back to */
+    void SaveForBlockUndo(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    //! Set when a block's changes were rolled back, the best block is then
+    //! left where it is so the wallet rescans from there on the next start
+    std::atomic<bool> m_block_sync_failed{false};
+
+    /**
+     * Batch to write with: the one of the block being synced, if any, or a
+     * new one that is kept in owned_batch. Wallet writes that can happen
+     * while a block is synced must go through here, a separate db
+     * transaction would block on the pages locked by the block's.
+     */
+    WalletBatch& GetBatch(std::unique_ptr<WalletBatch>& owned_batch, const char* pszMode = "r+", bool fFlushOnClose = true) const;
+
     //! the current wallet version: clients below this version are not able to load the wallet
     int nWalletVersion = FEATURE_BASE;
 
@@ -670,6 +688,23 @@ private:
     void AddToSpends(const COutPoint& outpoint, const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void AddToSpends(const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /**
+     * Transactions that may still have unspent outputs of ours, so that
+     * balance and coin queries don't have to look at all of mapWallet.
+     * Transactions that are received, spent from, marked dirty or removed
+     * are queued in m_unspent_changed, and only those are checked again by
+     * UpdateUnspentCandidates(), which needs the chain locked to tell which
+     * spends count.
+     */
+    mutable std::set<uint256> m_unspent_candidates GUARDED_BY(cs_wallet);
+    mutable std::set<uint256> m_unspent_changed GUARDED_BY(cs_wallet);
+    void UpdateUnspentCandidates(interfaces::Chain::Lock& locked_chain) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    std::vector<const CWalletTx*> GetUnspentCandidates(interfaces::Chain::Lock& locked_chain) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
+    /** Result of GetBalances(), reset when a transaction, the chain tip or
+     * the mempool state of a transaction changes. */
+    mutable std::unique_ptr<Balance> m_cached_balance GUARDED_BY(cs_wallet);
+
     /**
      * Add a transaction to the wallet, or update it.  pIndex and posInBlock should
      * be set when the transaction was known to be included in a block.  When
@@ -925,6 +960,14 @@ public:
     bool UpdateAnonTransaction(const CTransaction& tx, const uint256& blockHash) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool ProcessAnonTransaction(const CTransaction& tx, const uint256& blockHash, bool& fIsMine, mapValue_t& mapNarr) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /**
+     * Derive the spend keys of anon and stealth outputs that were received
+     * while the wallet was locked, and store them with their key images.
+     * Called after Unlock(), once the caller released its locks, as
+     * cs_main and cs_wallet are only taken for the lookups and the writes.
+     */
+    bool ExpandLockedOutputs() LOCKS_EXCLUDED(cs_main, cs_wallet);
+
     void TransactionAddedToMempool(const CTransactionRef& tx) override;
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
@@ -951,6 +994,11 @@ public:
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     // ResendWalletTransactionsBefore may only be called if fBroadcastTransactions!
     std::vector<uint256> ResendWalletTransactionsBefore(interfaces::Chain::Lock& locked_chain, int64_t nTime, CConnman* connman);
+    /** All balance buckets at once. Cached until the wallet or chain changes. */
+    Balance GetBalances() const;
+    /** Queue a transaction to be checked for unspent outputs of ours, and forget the cached balances */
+    void MarkBalancesDirty(const uint256& hash) const;
+
     CAmount GetBalance(const isminefilter& filter=ISMINE_SPENDABLE, const int min_depth=0) const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
@@ -1281,6 +1329,34 @@ public:
     }
 };
 
+/**
+ * Makes all wallet writes of a connected, disconnected or rescanned block
+ * one db transaction, so a block costs a single log flush and is written
+ * atomically. cs_wallet must be held while this exists. Writes are rolled
+ * back unless Commit() is called, and so are the wallet transactions the
+ * block added or changed in memory.
+ */
+class WalletBlockBatch
+{
+private:
+    CWallet* m_wallet;
+    std::unique_ptr<WalletBatch> m_batch;
+    //! Wallet transactions the block changed as they were before, null for the ones it added
+    std::map<uint256, std::unique_ptr<CWalletTx>> m_undo_txs;
+    int64_t m_order_pos_next{0};
+
+    void Rollback();
+    friend class CWallet;
+public:
+    explicit WalletBlockBatch(CWallet* w);
+    ~WalletBlockBatch();
+
+    WalletBlockBatch(const WalletBlockBatch&) = delete;
+    WalletBlockBatch& operator=(const WalletBlockBatch&) = delete;
+
+    bool Commit();
+};
+
 // Calculate the size of the transaction assuming all signatures are max size
 // Use DummySignatureCreator, which inserts 71 byte signatures everywhere.
 // NOTE: this requires that all inputs must be in mapWallet (eg the tx should
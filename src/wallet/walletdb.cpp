@@ -14,11 +14,13 @@
 #include <sync.h>
 #include <util/system.h>
 #include <util/time.h>
+#include <wallet/logdb.h>
 #include <wallet/wallet.h>
 #include <anonymous.h>
 
 #include <atomic>
 #include <string>
+#include <thread>
 
 #include <boost/thread.hpp>
 
@@ -123,8 +125,8 @@ bool WalletBatch::WriteBestBlock(const CBlockLocator& locator)
 
 bool WalletBatch::ReadBestBlock(CBlockLocator& locator)
 {
-    if (m_batch.Read(std::string("bestblock"), locator) && !locator.vHave.empty()) return true;
-    return m_batch.Read(std::string("bestblock_nomerkle"), locator);
+    if (m_batch->Read(std::string("bestblock"), locator) && !locator.vHave.empty()) return true;
+    return m_batch->Read(std::string("bestblock_nomerkle"), locator);
 }
 
 bool WalletBatch::WriteOrderPosNext(int64_t nOrderPosNext)
@@ -134,7 +136,7 @@ bool WalletBatch::WriteOrderPosNext(int64_t nOrderPosNext)
 
 bool WalletBatch::ReadPool(int64_t nPool, CKeyPool& keypool)
 {
-    return m_batch.Read(std::make_pair(std::string("pool"), nPool), keypool);
+    return m_batch->Read(std::make_pair(std::string("pool"), nPool), keypool);
 }
 
 bool WalletBatch::WritePool(int64_t nPool, const CKeyPool& keypool)
@@ -152,6 +154,11 @@ bool WalletBatch::WriteMinVersion(int nVersion)
     return WriteIC(std::string("minversion"), nVersion);
 }
 
+//! Records read from the cursor before they are decoded and loaded
+static const size_t LOAD_BATCH_RECORDS = 10000;
+//! Don't spin up another decoding thread for fewer records than this
+static const size_t MIN_LOAD_RECORDS_PER_THREAD = 500;
+
 class CWalletScanState {
 public:
     unsigned int nKeys{0};
@@ -168,6 +175,128 @@ public:
     }
 };
 
+/** Read a "tx" record. Does not touch the wallet, so it can run on any thread. */
+static bool
+DecodeTx(CDataStream& ssKey, CDataStream& ssValue, CWalletTx& wtx, bool& fUpgrade, std::string& strErr)
+{
+    uint256 hash;
+    ssKey >> hash;
+    ssValue >> wtx;
+    CValidationState state;
+    if (!(CheckTransaction(*wtx.tx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+        return false;
+
+    // Undo serialize changes in 31600
+    fUpgrade = false;
+    if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+    {
+        if (!ssValue.empty())
+        {
+            char fTmp;
+            char fUnused;
+            std::string unused_string;
+            ssValue >> fTmp >> fUnused >> unused_string;
+            strErr = strprintf("LoadWallet() upgrading tx ver=%d %d %s",
+                               wtx.fTimeReceivedIsTxTime, fTmp, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = fTmp;
+        }
+        else
+        {
+            strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = 0;
+        }
+        fUpgrade = true;
+    }
+    return true;
+}
+
+static void
+LoadTx(CWallet* pwallet, const CWalletTx& wtx, bool fUpgrade, CWalletScanState& wss) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
+{
+    if (fUpgrade)
+        wss.vWalletUpgrade.push_back(wtx.GetHash());
+
+    if (wtx.nOrderPos == -1)
+        wss.fAnyUnordered = true;
+
+    pwallet->LoadToWallet(wtx);
+}
+
+/** Read and check a "key" or "wkey" record. Does not touch the wallet, so it can run on any thread. */
+static bool
+DecodeKey(const std::string& strType, CDataStream& ssKey, CDataStream& ssValue, CKey& key, CPubKey& vchPubKey, std::string& strErr)
+{
+    ssKey >> vchPubKey;
+    if (!vchPubKey.IsValid())
+    {
+        strErr = "Error reading wallet database: CPubKey corrupt";
+        return false;
+    }
+    CPrivKey pkey;
+    uint256 hash;
+
+    if (strType == "key")
+    {
+        ssValue >> pkey;
+    } else {
+        CWalletKey wkey;
+        ssValue >> wkey;
+        pkey = wkey.vchPrivKey;
+    }
+
+    // Old wallets store keys as "key" [pubkey] => [privkey]
+    // ... which was slow for wallets with lots of keys, because the public key is re-derived from the private key
+    // using EC operations as a checksum.
+    // Newer wallets store keys as "key"[pubkey] => [privkey][hash(pubkey,privkey)], which is much faster while
+    // remaining backwards-compatible.
+    try
+    {
+        ssValue >> hash;
+    }
+    catch (...) {}
+
+    bool fSkipCheck = false;
+
+    if (!hash.IsNull())
+    {
+        // hash pubkey/privkey to accelerate wallet load
+        std::vector<unsigned char> vchKey;
+        vchKey.reserve(vchPubKey.size() + pkey.size());
+        vchKey.insert(vchKey.end(), vchPubKey.begin(), vchPubKey.end());
+        vchKey.insert(vchKey.end(), pkey.begin(), pkey.end());
+
+        if (Hash(vchKey.begin(), vchKey.end()) != hash)
+        {
+            strErr = "Error reading wallet database: CPubKey/CPrivKey corrupt";
+            return false;
+        }
+
+        fSkipCheck = true;
+    }
+
+    if (!key.Load(pkey, vchPubKey, fSkipCheck))
+    {
+        strErr = "Error reading wallet database: CPrivKey corrupt";
+        return false;
+    }
+    return true;
+}
+
+static bool
+LoadKey(CWallet* pwallet, const std::string& strType, const CKey& key, const CPubKey& vchPubKey,
+        CWalletScanState& wss, std::string& strErr) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
+{
+    if (strType == "key")
+        wss.nKeys++;
+
+    if (!pwallet->LoadKey(key, vchPubKey))
+    {
+        strErr = "Error reading wallet database: LoadKey failed";
+        return false;
+    }
+    return true;
+}
+
 static bool
 ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
              CWalletScanState &wss, std::string& strType, std::string& strErr) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
@@ -191,39 +320,11 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         }
         else if (strType == "tx")
         {
-            uint256 hash;
-            ssKey >> hash;
             CWalletTx wtx(nullptr /* pwallet */, MakeTransactionRef());
-            ssValue >> wtx;
-            CValidationState state;
-            if (!(CheckTransaction(*wtx.tx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+            bool fUpgrade;
+            if (!DecodeTx(ssKey, ssValue, wtx, fUpgrade, strErr))
                 return false;
-
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
-            {
-                if (!ssValue.empty())
-                {
-                    char fTmp;
-                    char fUnused;
-                    std::string unused_string;
-                    ssValue >> fTmp >> fUnused >> unused_string;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d %s",
-                                       wtx.fTimeReceivedIsTxTime, fTmp, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                }
-                else
-                {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
-
-            if (wtx.nOrderPos == -1)
-                wss.fAnyUnordered = true;
-
-            pwallet->LoadToWallet(wtx);
+            LoadTx(pwallet, wtx, fUpgrade, wss);
         }
         else if (strType == "watchs")
         {
@@ -237,67 +338,12 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         }
         else if (strType == "key" || strType == "wkey")
         {
-            CPubKey vchPubKey;
-            ssKey >> vchPubKey;
-            if (!vchPubKey.IsValid())
-            {
-                strErr = "Error reading wallet database: CPubKey corrupt";
-                return false;
-            }
             CKey key;
-            CPrivKey pkey;
-            uint256 hash;
-
-            if (strType == "key")
-            {
-                wss.nKeys++;
-                ssValue >> pkey;
-            } else {
-                CWalletKey wkey;
-                ssValue >> wkey;
-                pkey = wkey.vchPrivKey;
-            }
-
-            // Old wallets store keys as "key" [pubkey] => [privkey]
-            // ... which was slow for wallets with lots of keys, because the public key is re-derived from the private key
-            // using EC operations as a checksum.
-            // Newer wallets store keys as "key"[pubkey] => [privkey][hash(pubkey,privkey)], which is much faster while
-            // remaining backwards-compatible.
-            try
-            {
-                ssValue >> hash;
-            }
-            catch (...) {}
-
-            bool fSkipCheck = false;
-
-            if (!hash.IsNull())
-            {
-                // hash pubkey/privkey to accelerate wallet load
-                std::vector<unsigned char> vchKey;
-                vchKey.reserve(vchPubKey.size() + pkey.size());
-                vchKey.insert(vchKey.end(), vchPubKey.begin(), vchPubKey.end());
-                vchKey.insert(vchKey.end(), pkey.begin(), pkey.end());
-
-                if (Hash(vchKey.begin(), vchKey.end()) != hash)
-                {
-                    strErr = "Error reading wallet database: CPubKey/CPrivKey corrupt";
-                    return false;
-                }
-
-                fSkipCheck = true;
-            }
-
-            if (!key.Load(pkey, vchPubKey, fSkipCheck))
-            {
-                strErr = "Error reading wallet database: CPrivKey corrupt";
+            CPubKey vchPubKey;
+            if (!DecodeKey(strType, ssKey, ssValue, key, vchPubKey, strErr))
                 return false;
-            }
-            if (!pwallet->LoadKey(key, vchPubKey))
-            {
-                strErr = "Error reading wallet database: LoadKey failed";
+            if (!LoadKey(pwallet, strType, key, vchPubKey, wss, strErr))
                 return false;
-            }
         }
         else if (strType == "mkey")
         {
@@ -431,6 +477,72 @@ bool WalletBatch::IsKeyType(const std::string& strType)
             strType == "mkey" || strType == "ckey");
 }
 
+/** A record read from the wallet database cursor */
+struct WalletRecord
+{
+    CDataStream ssKey{SER_DISK, CLIENT_VERSION};
+    CDataStream ssValue{SER_DISK, CLIENT_VERSION};
+    std::string strType;
+    std::string strErr;
+    //! Set if the record was decoded by DecodeRecord(), fOK holds the result
+    bool fDecoded{false};
+    bool fOK{false};
+    //! "tx" records
+    std::unique_ptr<CWalletTx> wtx;
+    bool fUpgradeTx{false};
+    //! "key" and "wkey" records
+    CKey key;
+    CPubKey vchPubKey;
+};
+
+/**
+ * Decode the records that are expensive to read: transactions, which are
+ * hashed and checked, and plaintext keys, which are hashed or re-derived.
+ * Other records are left for ReadKeyValue().
+ */
+static void DecodeRecord(WalletRecord& rec)
+{
+    try {
+        // Copy the key, ReadKeyValue() still needs it if the record is not decoded here
+        CDataStream ssKey(rec.ssKey);
+        ssKey >> rec.strType;
+        if (rec.strType == "tx")
+        {
+            rec.fDecoded = true;
+            rec.wtx = MakeUnique<CWalletTx>(nullptr /* pwallet */, MakeTransactionRef());
+            rec.fOK = DecodeTx(ssKey, rec.ssValue, *rec.wtx, rec.fUpgradeTx, rec.strErr);
+        }
+        else if (rec.strType == "key" || rec.strType == "wkey")
+        {
+            rec.fDecoded = true;
+            rec.fOK = DecodeKey(rec.strType, ssKey, rec.ssValue, rec.key, rec.vchPubKey, rec.strErr);
+        }
+    } catch (...) {
+        rec.fDecoded = true;
+        rec.fOK = false;
+    }
+}
+
+/** Decode a batch of records, spread over up to one thread per core */
+static void DecodeRecords(std::vector<WalletRecord>& records)
+{
+    std::atomic<size_t> nNext{0};
+    auto decode = [&records, &nNext]() {
+        size_t i;
+        while ((i = nNext++) < records.size())
+            DecodeRecord(records[i]);
+    };
+
+    // The calling thread decodes as well
+    const size_t nThreads = std::min<size_t>(GetNumCores(), records.size() / MIN_LOAD_RECORDS_PER_THREAD);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < nThreads; ++i)
+        threads.emplace_back(decode);
+    decode();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
 DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
 {
     CWalletScanState wss;
@@ -440,7 +552,7 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
     LOCK(pwallet->cs_wallet);
     try {
         int nMinVersion = 0;
-        if (m_batch.Read((std::string)"minversion", nMinVersion))
+        if (m_batch->Read((std::string)"minversion", nMinVersion))
         {
             if (nMinVersion > FEATURE_LATEST)
                 return DBErrors::TOO_NEW;
@@ -448,50 +560,78 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
         }
 
         // Get cursor
-        Dbc* pcursor = m_batch.GetCursor();
-        if (!pcursor)
+        if (!m_batch->StartCursor())
         {
             pwallet->WalletLogPrintf("Error getting wallet database cursor\n");
             return DBErrors::CORRUPT;
         }
 
-        while (true)
+        std::vector<WalletRecord> records;
+        bool fDone = false;
+        while (!fDone)
         {
-            // Read next record
-            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            int ret = m_batch.ReadAtCursor(pcursor, ssKey, ssValue);
-            if (ret == DB_NOTFOUND)
-                break;
-            else if (ret != 0)
+            // Read the next batch of records
+            records.clear();
+            while (records.size() < LOAD_BATCH_RECORDS)
             {
-                pwallet->WalletLogPrintf("Error reading next record from wallet database\n");
-                return DBErrors::CORRUPT;
+                records.emplace_back();
+                WalletRecord& rec = records.back();
+                bool complete;
+                bool ret = m_batch->ReadAtCursor(rec.ssKey, rec.ssValue, complete);
+                if (complete)
+                {
+                    records.pop_back();
+                    fDone = true;
+                    break;
+                }
+                else if (!ret)
+                {
+                    pwallet->WalletLogPrintf("Error reading next record from wallet database\n");
+                    return DBErrors::CORRUPT;
+                }
             }
 
-            // Try to be tolerant of single corrupt records:
-            std::string strType, strErr;
-            if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
+            DecodeRecords(records);
+
+            for (WalletRecord& rec : records)
             {
-                // losing keys is considered a catastrophic error, anything else
-                // we assume the user can live with:
-                if (IsKeyType(strType) || strType == "defaultkey") {
-                    result = DBErrors::CORRUPT;
-                } else if(strType == "flags") {
-                    // reading the wallet flags can only fail if unknown flags are present
-                    result = DBErrors::TOO_NEW;
-                } else {
-                    // Leave other errors alone, if we try to fix them we might make things worse.
-                    fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
-                    if (strType == "tx")
-                        // Rescan if there is a bad transaction record:
-                        gArgs.SoftSetBoolArg("-rescan", true);
+                bool fReadOK;
+                if (!rec.fDecoded)
+                    fReadOK = ReadKeyValue(pwallet, rec.ssKey, rec.ssValue, wss, rec.strType, rec.strErr);
+                else if (!rec.fOK)
+                    fReadOK = false;
+                else if (rec.strType == "tx")
+                {
+                    LoadTx(pwallet, *rec.wtx, rec.fUpgradeTx, wss);
+                    fReadOK = true;
                 }
+                else
+                    fReadOK = LoadKey(pwallet, rec.strType, rec.key, rec.vchPubKey, wss, rec.strErr);
+
+                // Try to be tolerant of single corrupt records:
+                const std::string& strType = rec.strType;
+                if (!fReadOK)
+                {
+                    // losing keys is considered a catastrophic error, anything else
+                    // we assume the user can live with:
+                    if (IsKeyType(strType) || strType == "defaultkey") {
+                        result = DBErrors::CORRUPT;
+                    } else if(strType == "flags") {
+                        // reading the wallet flags can only fail if unknown flags are present
+                        result = DBErrors::TOO_NEW;
+                    } else {
+                        // Leave other errors alone, if we try to fix them we might make things worse.
+                        fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
+                        if (strType == "tx")
+                            // Rescan if there is a bad transaction record:
+                            gArgs.SoftSetBoolArg("-rescan", true);
+                    }
+                }
+                if (!rec.strErr.empty())
+                    pwallet->WalletLogPrintf("%s\n", rec.strErr);
             }
-            if (!strErr.empty())
-                pwallet->WalletLogPrintf("%s\n", strErr);
         }
-        pcursor->close();
+        m_batch->CloseCursor();
     }
     catch (const boost::thread_interrupted&) {
         throw;
@@ -539,15 +679,14 @@ DBErrors WalletBatch::FindWalletTx(std::vector<uint256>& vTxHash, std::vector<CW
 
     try {
         int nMinVersion = 0;
-        if (m_batch.Read((std::string)"minversion", nMinVersion))
+        if (m_batch->Read((std::string)"minversion", nMinVersion))
         {
             if (nMinVersion > FEATURE_LATEST)
                 return DBErrors::TOO_NEW;
         }
 
         // Get cursor
-        Dbc* pcursor = m_batch.GetCursor();
-        if (!pcursor)
+        if (!m_batch->StartCursor())
         {
             LogPrintf("Error getting wallet database cursor\n");
             return DBErrors::CORRUPT;
@@ -558,10 +697,11 @@ DBErrors WalletBatch::FindWalletTx(std::vector<uint256>& vTxHash, std::vector<CW
             // Read next record
             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
             CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            int ret = m_batch.ReadAtCursor(pcursor, ssKey, ssValue);
-            if (ret == DB_NOTFOUND)
+            bool complete;
+            bool ret = m_batch->ReadAtCursor(ssKey, ssValue, complete);
+            if (complete)
                 break;
-            else if (ret != 0)
+            else if (!ret)
             {
                 LogPrintf("Error reading next record from wallet database\n");
                 return DBErrors::CORRUPT;
@@ -580,7 +720,7 @@ DBErrors WalletBatch::FindWalletTx(std::vector<uint256>& vTxHash, std::vector<CW
                 vWtx.push_back(wtx);
             }
         }
-        pcursor->close();
+        m_batch->CloseCursor();
     }
     catch (const boost::thread_interrupted&) {
         throw;
@@ -668,7 +808,7 @@ void MaybeCompactWalletDB()
         }
 
         if (dbh.nLastFlushed != nUpdateCounter && GetTime() - dbh.nLastWalletUpdate >= 2) {
-            if (BerkeleyBatch::PeriodicFlush(dbh)) {
+            if (dbh.PeriodicFlush()) {
                 dbh.nLastFlushed = nUpdateCounter;
             }
         }
@@ -682,6 +822,11 @@ void MaybeCompactWalletDB()
 //
 bool WalletBatch::Recover(const fs::path& wallet_path, void *callbackDataIn, bool (*recoverKVcallback)(void* callbackData, CDataStream ssKey, CDataStream ssValue), std::string& out_backup_filename)
 {
+    if (LogDatabase::IsLogFile(WalletDataFilePath(wallet_path))) {
+        // Frames are checksummed and a damaged tail is dropped on load, there is nothing to salvage
+        LogPrintf("Salvaging is not supported for log format wallet %s\n", wallet_path.string());
+        return false;
+    }
     return BerkeleyBatch::Recover(wallet_path, callbackDataIn, recoverKVcallback, out_backup_filename);
 }
 
@@ -717,11 +862,18 @@ bool WalletBatch::RecoverKeysOnlyFilter(void *callbackData, CDataStream ssKey, C
 
 bool WalletBatch::VerifyEnvironment(const fs::path& wallet_path, std::string& errorStr)
 {
+    if (LogDatabase::IsLogFile(WalletDataFilePath(wallet_path))) {
+        return true;
+    }
     return BerkeleyBatch::VerifyEnvironment(wallet_path, errorStr);
 }
 
 bool WalletBatch::VerifyDatabaseFile(const fs::path& wallet_path, std::string& warningStr, std::string& errorStr)
 {
+    const fs::path file_path = WalletDataFilePath(wallet_path);
+    if (LogDatabase::IsLogFile(file_path)) {
+        return LogDatabase::Verify(file_path, warningStr, errorStr);
+    }
     return BerkeleyBatch::VerifyDatabaseFile(wallet_path, warningStr, errorStr, WalletBatch::Recover);
 }
 
@@ -748,32 +900,32 @@ bool WalletBatch::WriteWalletFlags(const uint64_t flags)
 
 bool WalletBatch::TxnBegin()
 {
-    return m_batch.TxnBegin();
+    return m_batch->TxnBegin();
 }
 
 bool WalletBatch::TxnCommit()
 {
-    return m_batch.TxnCommit();
+    return m_batch->TxnCommit();
 }
 
 bool WalletBatch::TxnAbort()
 {
-    return m_batch.TxnAbort();
+    return m_batch->TxnAbort();
 }
 
 bool WalletBatch::ReadVersion(int& nVersion)
 {
-    return m_batch.ReadVersion(nVersion);
+    return m_batch->ReadVersion(nVersion);
 }
 
 bool WalletBatch::WriteVersion(int nVersion)
 {
-    return m_batch.WriteVersion(nVersion);
+    return m_batch->WriteVersion(nVersion);
 }
 
 bool WalletBatch::ReadOwnedAnonOutput(const ec_point& vchImage, COwnedAnonOutput& ownAo)
 {
-    return m_batch.Read(std::make_pair(std::string("oao"), vchImage), ownAo);
+    return m_batch->Read(std::make_pair(std::string("oao"), vchImage), ownAo);
 }
 
 bool WalletBatch::WriteOwnedAnonOutput(const ec_point& vchImage, const COwnedAnonOutput& ownAo)
@@ -788,7 +940,7 @@ bool WalletBatch::EraseOwnedAnonOutput(const ec_point& vchImage)
 
 bool WalletBatch::ReadLockedAnonOutput(const CKeyID& keyId, CLockedAnonOutput& lockedAo)
 {
-    return m_batch.Read(std::make_pair(std::string("lao"), keyId), lockedAo);
+    return m_batch->Read(std::make_pair(std::string("lao"), keyId), lockedAo);
 }
 
 bool WalletBatch::WriteLockedAnonOutput(const CKeyID& keyId, const CLockedAnonOutput& lockedAo)
@@ -803,7 +955,7 @@ bool WalletBatch::EraseLockedAnonOutput(const CKeyID& keyId)
 
 bool WalletBatch::ReadOwnedAnonOutputLink(const CPubKey& pkCoin, ec_point& vchImage)
 {
-    return m_batch.Read(std::make_pair(std::string("oal"), pkCoin), vchImage);
+    return m_batch->Read(std::make_pair(std::string("oal"), pkCoin), vchImage);
 }
 
 bool WalletBatch::WriteOwnedAnonOutputLink(const CPubKey& pkCoin, const ec_point& vchImage)
@@ -818,7 +970,7 @@ bool WalletBatch::EraseOwnedAnonOutputLink(const CPubKey& pkCoin)
 
 bool WalletBatch::ReadOldOutputLink(const ec_point& pkImage, ec_point& vchImage)
 {
-    return m_batch.Read(std::make_pair(std::string("ool"), pkImage), vchImage);
+    return m_batch->Read(std::make_pair(std::string("ool"), pkImage), vchImage);
 }
 
 bool WalletBatch::WriteOldOutputLink(const ec_point& pkImage, const ec_point& vchImage)
@@ -841,9 +993,61 @@ bool WalletBatch::EraseStealthKeyMeta(const CKeyID& keyId)
     return EraseIC(std::make_pair(std::string("sxKeyMeta"), keyId));
 }
 
+DBErrors WalletBatch::FindLockedOutputs(std::vector<std::pair<CKeyID, CLockedAnonOutput>>& vLockedAnon, std::vector<std::pair<CKeyID, CStealthKeyMetadata>>& vLockedStealth)
+{
+    try {
+        if (!m_batch->StartCursor())
+        {
+            LogPrintf("Error getting wallet database cursor\n");
+            return DBErrors::CORRUPT;
+        }
+
+        while (true)
+        {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            bool complete;
+            bool ret = m_batch->ReadAtCursor(ssKey, ssValue, complete);
+            if (complete)
+                break;
+            else if (!ret)
+            {
+                LogPrintf("Error reading next record from wallet database\n");
+                m_batch->CloseCursor();
+                return DBErrors::CORRUPT;
+            }
+
+            std::string strType;
+            ssKey >> strType;
+            if (strType == "lao") {
+                CKeyID keyId;
+                ssKey >> keyId;
+                CLockedAnonOutput lockedAo;
+                ssValue >> lockedAo;
+                vLockedAnon.emplace_back(keyId, lockedAo);
+            } else if (strType == "sxKeyMeta") {
+                CKeyID keyId;
+                ssKey >> keyId;
+                CStealthKeyMetadata sxKeyMeta;
+                ssValue >> sxKeyMeta;
+                vLockedStealth.emplace_back(keyId, sxKeyMeta);
+            }
+        }
+        m_batch->CloseCursor();
+    }
+    catch (const boost::thread_interrupted&) {
+        throw;
+    }
+    catch (...) {
+        return DBErrors::CORRUPT;
+    }
+
+    return DBErrors::LOAD_OK;
+}
+
 bool WalletBatch::ReadExtAccount(const CKeyID &identifier, CExtKeyAccount &ekAcc)
 {
-    return m_batch.Read(std::make_pair(std::string("eacc"), identifier), ekAcc);
+    return m_batch->Read(std::make_pair(std::string("eacc"), identifier), ekAcc);
 }
 
 bool WalletBatch::WriteExtAccount(const CKeyID &identifier, const CExtKeyAccount &ekAcc)
@@ -855,7 +1059,7 @@ bool WalletBatch::ReadExtStealthKeyChildPack(const CKeyID&               identif
                                              const uint32_t              nPack,
                                              std::vector<CEKASCKeyPack>& asckPak)
 {
-    return m_batch.Read(boost::make_tuple(std::string("ecpk"), identifier, nPack), asckPak);
+    return m_batch->Read(boost::make_tuple(std::string("ecpk"), identifier, nPack), asckPak);
 }
 
 bool WalletBatch::WriteExtStealthKeyChildPack(const CKeyID&                     identifier,
@@ -23,10 +23,13 @@
  * - WalletBatch is an abstract modifier object for the wallet database, and encapsulates a database
  *   batch update as well as methods to act on the database. It should be agnostic to the database implementation.
  *
+ * - WalletDatabase represents a wallet database, and DatabaseBatch is a low-level database batch update.
+ *
  * The following classes are implementation specific:
  * - BerkeleyEnvironment is an environment in which the database exists.
- * - BerkeleyDatabase represents a wallet database.
- * - BerkeleyBatch is a low-level database batch update.
+ * - BerkeleyDatabase represents a BerkeleyDB wallet database.
+ * - BerkeleyBatch is a low-level BerkeleyDB database batch update.
+ * - LogDatabase and LogBatch are the same for a wallet kept as an append-only log.
  */
 
 static const bool DEFAULT_FLUSHWALLET = true;
@@ -45,9 +48,6 @@ class CStealthKeyMetadata;
 class CEKASCKeyPack;
 class CExtKeyAccount;
 
-/** Backend-agnostic database type. */
-using WalletDatabase = BerkeleyDatabase;
-
 /** Error statuses for the wallet database */
 enum class DBErrors
 {
@@ -147,7 +147,7 @@ private:
     template <typename K, typename T>
     bool WriteIC(const K& key, const T& value, bool fOverwrite = true)
     {
-        if (!m_batch.Write(key, value, fOverwrite)) {
+        if (!m_batch->Write(key, value, fOverwrite)) {
             return false;
         }
         m_database.IncrementUpdateCounter();
@@ -157,7 +157,7 @@ private:
     template <typename K>
     bool EraseIC(const K& key)
     {
-        if (!m_batch.Erase(key)) {
+        if (!m_batch->Erase(key)) {
             return false;
         }
         m_database.IncrementUpdateCounter();
@@ -166,7 +166,7 @@ private:
 
 public:
     explicit WalletBatch(WalletDatabase& database, const char* pszMode = "r+", bool _fFlushOnClose = true) :
-        m_batch(database, pszMode, _fFlushOnClose),
+        m_batch(database.MakeBatch(pszMode, _fFlushOnClose)),
         m_database(database)
     {
     }
@@ -265,6 +265,9 @@ public:
 
     bool WriteStealthKeyMeta(const CKeyID& keyId, const CStealthKeyMetadata& sxKeyMeta);
 
+    //! Read all anon and stealth outputs that were received while the wallet was locked
+    DBErrors FindLockedOutputs(std::vector<std::pair<CKeyID, CLockedAnonOutput>>& vLockedAnon, std::vector<std::pair<CKeyID, CStealthKeyMetadata>>& vLockedStealth);
+
     bool EraseStealthKeyMeta(const CKeyID& keyId);
 
     bool ReadExtAccount(const CKeyID &identifier, CExtKeyAccount &ekAcc);
@@ -280,7 +283,7 @@ public:
                                      const std::vector<CEKASCKeyPack>& asckPak);
 
 private:
-    BerkeleyBatch   m_batch;
+    std::unique_ptr<DatabaseBatch> m_batch;
     WalletDatabase& m_database;
 };
 
@@ -6,6 +6,7 @@
 #include <fs.h>
 #include <interfaces/chain.h>
 #include <util/system.h>
+#include <wallet/logdb.h>
 #include <wallet/wallet.h>
 #include <wallet/walletutil.h>
 
@@ -105,6 +106,85 @@ static void WalletShowInfo(CWallet* wallet_instance)
     fprintf(stdout, "Address Book: %zu\n", wallet_instance->mapAddressBook.size());
 }
 
+//! Records copied per db transaction by ConvertWallet()
+static const size_t CONVERT_RECORDS_PER_TXN = 1000;
+
+static bool ConvertWallet(const std::string& name, const fs::path& path, const std::string& format)
+{
+    const fs::path file_path = WalletDataFilePath(path);
+    const bool from_log = LogDatabase::IsLogFile(file_path);
+    if (format != "bdb" && format != "log") {
+        fprintf(stderr, "Error: Unknown wallet format %s\n", format.c_str());
+        return false;
+    }
+    if ((format == "log") == from_log) {
+        fprintf(stderr, "Error: %s is in %s format already\n", name.c_str(), format.c_str());
+        return false;
+    }
+
+    // Copy all records into a new file next to the wallet file
+    const std::string tmp_filename = file_path.filename().string() + ".convert";
+    const fs::path tmp_path = file_path.parent_path() / tmp_filename;
+    if (fs::exists(tmp_path)) {
+        fprintf(stderr, "Error: %s exists already\n", tmp_path.string().c_str());
+        return false;
+    }
+    size_t records = 0;
+    bool success = true;
+    try {
+        std::unique_ptr<WalletDatabase> source = WalletDatabase::Create(path);
+        std::unique_ptr<WalletDatabase> target;
+        if (from_log) {
+            std::string unused_filename;
+            target = MakeUnique<BerkeleyDatabase>(GetWalletEnv(file_path.parent_path(), unused_filename), tmp_filename);
+        } else {
+            target = MakeUnique<LogDatabase>(tmp_path);
+        }
+        {
+            std::unique_ptr<DatabaseBatch> source_batch = source->MakeBatch("r");
+            std::unique_ptr<DatabaseBatch> target_batch = target->MakeBatch("cr+", false);
+            success = source_batch->StartCursor();
+            while (success) {
+                CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+                CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+                bool complete;
+                if (!source_batch->ReadAtCursor(ssKey, ssValue, complete)) {
+                    success = complete;
+                    break;
+                }
+                if (records % CONVERT_RECORDS_PER_TXN == 0) target_batch->TxnBegin();
+                success = target_batch->Write(ssKey, ssValue);
+                if (++records % CONVERT_RECORDS_PER_TXN == 0) success = success && target_batch->TxnCommit();
+            }
+            source_batch->CloseCursor();
+            if (success && records % CONVERT_RECORDS_PER_TXN != 0) success = target_batch->TxnCommit();
+        }
+        source->Flush(true);
+        target->Flush(true);
+    } catch (const std::runtime_error& e) {
+        fprintf(stderr, "Error converting %s: %s. Is wallet being used by another process?\n", name.c_str(), e.what());
+        success = false;
+    }
+    if (!success) {
+        fprintf(stderr, "Error: Failed to copy the records of %s\n", name.c_str());
+        fs::remove(tmp_path);
+        return false;
+    }
+
+    // Keep the original file as a backup
+    const fs::path backup_path = file_path.string() + strprintf(".%d.bak", GetTime());
+    try {
+        fs::rename(file_path, backup_path);
+        fs::rename(tmp_path, file_path);
+    } catch (const fs::filesystem_error& e) {
+        fprintf(stderr, "Error: Failed to replace %s: %s\n", file_path.string().c_str(), fsbridge::get_filesystem_error_message(e).c_str());
+        return false;
+    }
+    fprintf(stdout, "Converted %zu records of %s from %s to %s format, the original file was kept as %s\n",
+        records, name.c_str(), from_log ? "log" : "bdb", format.c_str(), backup_path.string().c_str());
+    return true;
+}
+
 bool ExecuteWalletToolFunc(const std::string& command, const std::string& name)
 {
     fs::path path = fs::absolute(name, GetWalletDir());
@@ -129,6 +209,17 @@ bool ExecuteWalletToolFunc(const std::string& command, const std::string& name)
         if (!wallet_instance) return false;
         WalletShowInfo(wallet_instance.get());
         wallet_instance->Flush();
+    } else if (command == "convert") {
+        if (!fs::exists(WalletDataFilePath(path))) {
+            fprintf(stderr, "Error: no wallet file at %s\n", name.c_str());
+            return false;
+        }
+        std::string error;
+        if (!WalletBatch::VerifyEnvironment(path, error)) {
+            fprintf(stderr, "Error loading %s. Is wallet being used by other process?\n", name.c_str());
+            return false;
+        }
+        if (!ConvertWallet(name, path, gArgs.GetArg("-format", "log"))) return false;
     } else {
         fprintf(stderr, "Invalid command: %s\n", command.c_str());
         return false;
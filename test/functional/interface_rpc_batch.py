@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test concurrent execution of JSON-RPC batch requests.
+
+Read-only calls of a batch are spread over the RPC worker threads. Check
+that results still come back in request order, that other calls still run
+in order with respect to the calls around them, and compare the throughput
+of a batch with a single worker thread and with several.
+"""
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+BATCH_ROUNDS = 5
+
+
+class RPCBatchTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.extra_args = [["-rpcthreads=1"], ["-rpcthreads=8"]]
+
+    def test_order(self, node):
+        self.log.info("Test that results are returned in request order")
+        height = node.getblockcount()
+        requests = []
+        for h in range(height + 1):
+            requests.append(node.getblockhash.get_request(h))
+            requests.append(node.echo.get_request(h))
+        results = node.batch(requests)
+        assert_equal(len(results), len(requests))
+        for request, result in zip(requests, results):
+            assert_equal(result['id'], request['id'])
+            assert_equal(result['error'], None)
+        for h in range(height + 1):
+            assert_equal(results[2 * h]['result'], self.nodes[0].getblockhash(h))
+            assert_equal(results[2 * h + 1]['result'], [h])
+
+    def test_barrier(self, node):
+        self.log.info("Test that calls with side effects separate the concurrent calls around them")
+        height = node.getblockcount()
+        tip = node.getbestblockhash()
+        results = node.batch([
+            node.getblockcount.get_request(),
+            node.getbestblockhash.get_request(),
+            node.invalidateblock.get_request(tip),
+            node.getblockcount.get_request(),
+            node.getblockhash.get_request(height - 1),
+            node.reconsiderblock.get_request(tip),
+            node.getblockcount.get_request(),
+            node.getbestblockhash.get_request(),
+        ])
+        assert_equal([r['error'] for r in results], [None] * 8)
+        assert_equal(results[0]['result'], height)
+        assert_equal(results[1]['result'], tip)
+        assert_equal(results[3]['result'], height - 1)
+        assert_equal(results[6]['result'], height)
+        assert_equal(results[7]['result'], tip)
+
+    def test_throughput(self):
+        self.log.info("Compare batch throughput with one and with several RPC threads")
+        height = self.nodes[0].getblockcount()
+        hashes = [self.nodes[0].getblockhash(h) for h in range(height + 1)]
+        for node, threads in zip(self.nodes, [1, 8]):
+            requests = [node.getblock.get_request(h, 2) for h in hashes]
+            start = time.time()
+            for _ in range(BATCH_ROUNDS):
+                results = node.batch(requests)
+                assert_equal(len(results), len(requests))
+            elapsed = time.time() - start
+            self.log.info("%d calls with -rpcthreads=%d: %.3fs (%.0f calls/s)" % (
+                BATCH_ROUNDS * len(requests), threads, elapsed, BATCH_ROUNDS * len(requests) / elapsed))
+
+    def run_test(self):
+        self.test_order(self.nodes[1])
+        self.test_barrier(self.nodes[1])
+        self.test_barrier(self.nodes[0])
+        self.test_throughput()
+
+
+if __name__ == '__main__':
+    RPCBatchTest().main()
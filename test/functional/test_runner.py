@@ -122,6 +122,7 @@ BASE_SCRIPTS = [
     'wallet_disableprivatekeys.py --usecli',
     'interface_http.py',
     'interface_rpc.py',
+    'interface_rpc_batch.py',
     'rpc_psbt.py',
     'rpc_users.py',
     'feature_proxy.py',
@@ -97,5 +97,40 @@ class ToolWalletTest(BitcoinTestFramework):
         assert_equal(1000, out['keypoolsize_hd_internal'])
         assert_equal(True, 'hdseedid' in out)
 
+        self.test_convert()
+
+    def assert_tool_converts(self, wallet, format):
+        p = self.bitcoin_wallet_process('-wallet={}'.format(wallet), '-format={}'.format(format), 'convert')
+        stdout, stderr = p.communicate()
+        assert_equal(p.poll(), 0)
+        assert_equal(stderr, '')
+        assert stdout.startswith('Converted ')
+
+    def test_convert(self):
+        self.log.info("Test converting a wallet to the log format and back")
+        self.start_node(0, ['-wallet=foo'])
+        info = self.nodes[0].getwalletinfo()
+        self.stop_node(0)
+
+        self.assert_raises_tool_error('Error: foo is in bdb format already', '-wallet=foo', '-format=bdb', 'convert')
+        self.assert_tool_converts('foo', 'log')
+        self.assert_raises_tool_error('Error: foo is in log format already', '-wallet=foo', '-format=log', 'convert')
+
+        # The node uses the log format wallet, and keeps writing to it
+        self.start_node(0, ['-wallet=foo'])
+        assert_equal(self.nodes[0].getwalletinfo()['hdseedid'], info['hdseedid'])
+        address = self.nodes[0].getnewaddress()
+        self.nodes[0].generatetoaddress(1, address)
+        assert_equal(self.nodes[0].getwalletinfo()['txcount'], 1)
+        self.stop_node(0)
+
+        self.assert_tool_converts('foo', 'bdb')
+        self.start_node(0, ['-wallet=foo'])
+        out = self.nodes[0].getwalletinfo()
+        assert_equal(out['hdseedid'], info['hdseedid'])
+        assert_equal(out['txcount'], 1)
+        assert_equal(self.nodes[0].getaddressinfo(address)['ismine'], True)
+        self.stop_node(0)
+
 if __name__ == '__main__':
     ToolWalletTest().main()